@@ -0,0 +1,208 @@
+#include "..\..\..\src\hax.h"
+#include <stdio.h>
+#include <stdint.h>
+
+// This is a benchmark for comparing the launch methods of EasyWinHax.
+// Compile the project and run the executable. It starts a second instance of itself as a controlled test host
+// and launches a function within the host with each method multiple times.
+// Usage: LaunchBench.exe [runs]
+// Prints the failure rate, latency percentiles and the time split by phase of each method.
+
+constexpr size_t DEFAULT_RUNS = 100u;
+constexpr const char* HOST_ARG = "host";
+
+typedef struct Method {
+	const char* label;
+	hax::launch::tLaunchAsyncFunc pLaunchAsync;
+}Method;
+
+static const Method methods[]{
+	{ "createThread", hax::launch::createThreadAsync },
+	{ "hijackThread", hax::launch::hijackThreadAsync },
+	{ "setWindowsHook", hax::launch::setWindowsHookAsync },
+	{ "hookBeginPaint", hax::launch::hookBeginPaintAsync },
+	{ "queueUserApc", hax::launch::queueUserApcAsync }
+};
+
+enum Phase {
+	ALLOCATION,
+	WRITE,
+	TRIGGER,
+	WAIT,
+	CLEANUP,
+	PHASE_COUNT
+};
+
+static const char* const phaseLabels[PHASE_COUNT]{ "  allocation", "  write", "  trigger", "  wait", "  cleanup" };
+
+// function that is launched within the host, returns the argument to verify the execution
+static void* WINAPI hostFunc(void* pArg) {
+
+	return pArg;
+}
+
+
+static DWORD WINAPI alertableThread(LPVOID lpParameter) {
+	UNREFERENCED_PARAMETER(lpParameter);
+
+	// waiting alertable for queueUserApc
+	while (SleepEx(INFINITE, TRUE) == WAIT_IO_COMPLETION) {}
+
+	return 0ul;
+}
+
+
+static int runHost() {
+	const HANDLE hAlertableThread = CreateThread(nullptr, 0u, alertableThread, nullptr, 0ul, nullptr);
+
+	if (!hAlertableThread) return 1;
+
+	CloseHandle(hAlertableThread);
+
+	WNDCLASSEXA wndClass{};
+	wndClass.cbSize = sizeof(wndClass);
+	wndClass.lpfnWndProc = DefWindowProcA;
+	wndClass.hInstance = GetModuleHandleA(nullptr);
+	wndClass.lpszClassName = "LaunchBenchHost";
+
+	if (!RegisterClassExA(&wndClass)) return 1;
+
+	// a visible window for setWindowsHook and hookBeginPaint
+	const HWND hWnd = CreateWindowExA(0ul, wndClass.lpszClassName, "LaunchBench Host", WS_OVERLAPPEDWINDOW | WS_VISIBLE, CW_USEDEFAULT, CW_USEDEFAULT, 320, 240, nullptr, nullptr, wndClass.hInstance, nullptr);
+
+	if (!hWnd) return 1;
+
+	MSG msg{};
+
+	// the main thread is hijacked by hijackThread
+	while (GetMessageA(&msg, nullptr, 0u, 0u) > 0) {
+		TranslateMessage(&msg);
+		DispatchMessageA(&msg);
+	}
+
+	return 0;
+}
+
+
+static double ticksToSeconds(LONGLONG ticks, LONGLONG frequency) {
+
+	return static_cast<double>(ticks) / static_cast<double>(frequency);
+}
+
+
+static void benchMethod(HANDLE hProc, hax::launch::tLaunchableFunc pFunc, const Method* pMethod, size_t runs, LONGLONG frequency) {
+	hax::BenchStats total(pMethod->label, runs);
+	hax::BenchStats* phases[PHASE_COUNT]{};
+
+	for (size_t i = 0u; i < PHASE_COUNT; i++) {
+		phases[i] = new hax::BenchStats(phaseLabels[i], runs);
+	}
+
+	for (size_t i = 0u; i < runs; i++) {
+		const uint64_t arg = i + 1u;
+		const double start = hax::BenchStats::now();
+		hax::launch::AsyncLaunch* const pLaunch = pMethod->pLaunchAsync(hProc, pFunc, reinterpret_cast<void*>(static_cast<uintptr_t>(arg)));
+
+		if (!pLaunch) {
+			total.addFailure();
+
+			continue;
+		}
+
+		hax::launch::wait(pLaunch, INFINITE);
+
+		uint64_t ret = 0u;
+		const bool success = hax::launch::getReturnValue(pLaunch, &ret) && ret == arg;
+		hax::launch::LaunchTimes times{};
+		hax::launch::getLaunchTimes(pLaunch, &times);
+		hax::launch::close(pLaunch);
+
+		const double end = hax::BenchStats::now();
+
+		if (!success) {
+			total.addFailure();
+
+			continue;
+		}
+
+		total.addSample(end - start);
+		phases[ALLOCATION]->addSample(ticksToSeconds(times.allocated - times.start, frequency));
+		phases[WRITE]->addSample(ticksToSeconds(times.written - times.allocated, frequency));
+		phases[TRIGGER]->addSample(ticksToSeconds(times.triggered - times.written, frequency));
+		phases[WAIT]->addSample(ticksToSeconds(times.completed - times.triggered, frequency));
+		phases[CLEANUP]->addSample(ticksToSeconds(times.finished - times.completed, frequency));
+	}
+
+	total.printRow(stdout);
+
+	for (size_t i = 0u; i < PHASE_COUNT; i++) {
+		phases[i]->printRow(stdout);
+		delete phases[i];
+	}
+
+	return;
+}
+
+
+int main(int argc, char* argv[]) {
+
+	if (argc > 1 && !strcmp(argv[1], HOST_ARG)) return runHost();
+
+	size_t runs = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_RUNS;
+
+	if (!runs) {
+		runs = DEFAULT_RUNS;
+	}
+
+	char path[MAX_PATH]{};
+
+	if (!GetModuleFileNameA(nullptr, path, MAX_PATH)) return 1;
+
+	char cmdLine[MAX_PATH + 0x10]{};
+	sprintf_s(cmdLine, "\"%s\" %s", path, HOST_ARG);
+
+	STARTUPINFOA startupInfo{};
+	startupInfo.cb = sizeof(startupInfo);
+	PROCESS_INFORMATION procInfo{};
+
+	if (!CreateProcessA(nullptr, cmdLine, nullptr, nullptr, FALSE, CREATE_NO_WINDOW, nullptr, nullptr, &startupInfo, &procInfo)) {
+		printf("Failed to start host.\n");
+
+		return 1;
+	}
+
+	CloseHandle(procInfo.hThread);
+
+	// wait for the message loop of the host
+	WaitForInputIdle(procInfo.hProcess, 5000ul);
+
+	const char* const exeName = strrchr(path, '\\') ? strrchr(path, '\\') + 1 : path;
+	const HMODULE hHostModule = hax::proc::ex::getModuleHandle(procInfo.hProcess, exeName);
+
+	if (!hHostModule) {
+		printf("Failed to find host module.\n");
+		TerminateProcess(procInfo.hProcess, 0u);
+		CloseHandle(procInfo.hProcess);
+
+		return 1;
+	}
+
+	// host and benchmark are the same image, so the function has the same offset within the host module
+	const uintptr_t funcOffset = reinterpret_cast<uintptr_t>(hostFunc) - reinterpret_cast<uintptr_t>(GetModuleHandleA(nullptr));
+	const hax::launch::tLaunchableFunc pHostFunc = reinterpret_cast<hax::launch::tLaunchableFunc>(reinterpret_cast<uintptr_t>(hHostModule) + funcOffset);
+
+	LARGE_INTEGER frequency{};
+	QueryPerformanceFrequency(&frequency);
+
+	printf("%zu runs per method\n", runs);
+	hax::BenchStats::printHeader(stdout);
+
+	for (size_t i = 0u; i < _countof(methods); i++) {
+		benchMethod(procInfo.hProcess, pHostFunc, &methods[i], runs, frequency.QuadPart);
+	}
+
+	TerminateProcess(procInfo.hProcess, 0u);
+	CloseHandle(procInfo.hProcess);
+
+	return 0;
+}
\ No newline at end of file
@@ -1,46 +1,209 @@
 #include "Bench.h"
-#include <chrono>
-#include <iostream>
+#include "BenchStats.h"
+#include "TraceSink.h"
+#include <Windows.h>
+#include <intrin.h>
+#include <stdlib.h>
+#include <math.h>
 
 namespace hax {
-	
-	Bench::Bench(const char* label, size_t runs): _label{ label }, _runs{ runs }, _startTime{}, _endTime{}, _counter{} {
-		this->_durations = new double[this->_runs];
+
+	// the time stamp counter is compared to the performance counter for a fraction of a second (20 milliseconds)
+	constexpr LONGLONG CALIBRATION_DIVISOR = 50ll;
+	// states of the one time calibration
+	constexpr LONG CALIBRATION_NONE = 0l;
+	constexpr LONG CALIBRATION_PENDING = 1l;
+	constexpr LONG CALIBRATION_DONE = 2l;
+
+	static double calibrateTicksPerSecond();
+	static int compareTicks(const void* pA, const void* pB);
+
+	Bench::Bench(const char* label, size_t runs, size_t warmup) :
+		_label{ label }, _ticks{ new uint64_t[runs ? runs : 1u]{} }, _sorted{ new double[runs ? runs : 1u]{} }, _runs{ runs ? runs : 1u }, _warmup{ warmup },
+		_startTicks{}, _counter{}, _warmupLeft{ warmup }, _pSink{}
+	{
+		// calibrate on construction instead of the first calculation
+		getTicksPerSecond();
 	}
 
 
 	Bench::~Bench() {
-		delete[] this->_durations;
+		delete[] this->_ticks;
+		delete[] this->_sorted;
 	}
 
 
 	void Bench::start() {
-		this->_startTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+		// prevents the meassured code from being executed before the time stamp counter is read
+		_mm_lfence();
+		this->_startTicks = __rdtsc();
+		_mm_lfence();
 	}
 
 
 	void Bench::end() {
-		this->_endTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-		this->_durations[_counter] = this->_endTime - this->_startTime;
+		unsigned int aux = 0u;
+		// waits for the meassured code to complete before the time stamp counter is read
+		const uint64_t endTicks = __rdtscp(&aux);
+		_mm_lfence();
+
+		if (this->_warmupLeft) {
+			this->_warmupLeft--;
+
+			return;
+		}
+
+		this->_ticks[this->_counter % this->_runs] = endTicks - this->_startTicks;
 		this->_counter++;
+
+		if (this->_pSink) {
+			this->_pSink->push(this->_label, this->_startTicks, endTicks - this->_startTicks, GetCurrentThreadId());
+		}
+
+	}
+
+
+	void Bench::reset() {
+		this->_counter = 0u;
+		this->_warmupLeft = this->_warmup;
+	}
+
+
+	bool Bench::getResult(BenchResult* pResult) {
+
+		if (!this->_counter) return false;
+
+		const size_t count = this->_counter < this->_runs ? this->_counter : this->_runs;
+
+		for (size_t i = 0u; i < count; i++) {
+			this->_sorted[i] = static_cast<double>(this->_ticks[i]);
+		}
+
+		qsort(this->_sorted, count, sizeof(double), compareTicks);
+
+		double sum = 0.;
+
+		for (size_t i = 0u; i < count; i++) {
+			sum += this->_sorted[i];
+		}
+
+		const double mean = sum / static_cast<double>(count);
+		double squares = 0.;
+
+		for (size_t i = 0u; i < count; i++) {
+			const double deviation = this->_sorted[i] - mean;
+			squares += deviation * deviation;
+		}
+
+		const double secondsPerTick = 1. / getTicksPerSecond();
+
+		pResult->count = count;
+		pResult->min = this->_sorted[0] * secondsPerTick;
+		pResult->p50 = BenchStats::getPercentile(this->_sorted, count, 50.) * secondsPerTick;
+		pResult->p90 = BenchStats::getPercentile(this->_sorted, count, 90.) * secondsPerTick;
+		pResult->p99 = BenchStats::getPercentile(this->_sorted, count, 99.) * secondsPerTick;
+		pResult->max = this->_sorted[count - 1u] * secondsPerTick;
+		pResult->mean = mean * secondsPerTick;
+		pResult->stdDev = sqrt(squares / static_cast<double>(count)) * secondsPerTick;
+
+		return true;
+	}
+
+
+	void Bench::print(FILE* pFile) {
+		constexpr double US_PER_S = 1000000.;
+
+		BenchResult result{};
+
+		if (!this->getResult(&result)) {
+			fprintf(pFile, "%s: no samples\n", this->_label);
+
+			return;
+		}
+
+		fprintf(
+			pFile, "%s: n %zu min %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f mean %.3f sd %.3f us\n",
+			this->_label, result.count, result.min * US_PER_S, result.p50 * US_PER_S, result.p90 * US_PER_S, result.p99 * US_PER_S, result.max * US_PER_S,
+			result.mean * US_PER_S, result.stdDev * US_PER_S
+		);
+
+		return;
 	}
 
 
 	void Bench::printAvg() {
-		
+
 		if (this->_counter >= this->_runs) {
-			double avg = 0.;
+			this->print(stdout);
+			this->reset();
+		}
+
+	}
+
+
+	void Bench::setTraceSink(TraceSink* pSink) {
+		this->_pSink = pSink;
+
+		return;
+	}
+
+
+	double Bench::getTicksPerSecond() {
+		// constant initialized instead of initialized by the calibration, since the thread safe initialization of local statics uses thread local storage
+		// that is not set up in manually mapped modules
+		static volatile LONG state = CALIBRATION_NONE;
+		static double ticksPerSecond = 0.;
+
+		LONG curState = state;
 
-			for (size_t i = 0; i < this->_counter; i++) {
-				avg += this->_durations[i];
+		// the first caller calibrates, other threads wait for it
+		while (curState != CALIBRATION_DONE) {
+
+			if (curState == CALIBRATION_NONE && InterlockedCompareExchange(&state, CALIBRATION_PENDING, CALIBRATION_NONE) == CALIBRATION_NONE) {
+				ticksPerSecond = calibrateTicksPerSecond();
+				InterlockedExchange(&state, CALIBRATION_DONE);
+
+				return ticksPerSecond;
 			}
 
-			avg /= this->_counter;
-			std::cout << "Average time " << this->_label << ": " << avg << std::endl;
-			
-			this->_counter = 0;
+			YieldProcessor();
+			curState = state;
 		}
 
+		return ticksPerSecond;
+	}
+
+
+	static double calibrateTicksPerSecond() {
+		LARGE_INTEGER frequency{};
+		LARGE_INTEGER startCounter{};
+		LARGE_INTEGER endCounter{};
+
+		if (!QueryPerformanceFrequency(&frequency) || !QueryPerformanceCounter(&startCounter)) return 1.;
+
+		const uint64_t startTicks = __rdtsc();
+		const LONGLONG duration = frequency.QuadPart / CALIBRATION_DIVISOR;
+
+		// busy waiting, since the thread might not be scheduled back in time after sleeping
+		do {
+			QueryPerformanceCounter(&endCounter);
+		} while (endCounter.QuadPart - startCounter.QuadPart < duration);
+
+		const uint64_t endTicks = __rdtsc();
+
+		return static_cast<double>(endTicks - startTicks) * static_cast<double>(frequency.QuadPart) / static_cast<double>(endCounter.QuadPart - startCounter.QuadPart);
+	}
+
+
+	static int compareTicks(const void* pA, const void* pB) {
+		const double a = *static_cast<const double*>(pA);
+		const double b = *static_cast<const double*>(pB);
+
+		if (a < b) return -1;
+
+		if (a > b) return 1;
+
+		return 0;
 	}
 
 }
\ No newline at end of file
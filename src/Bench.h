@@ -1,41 +1,109 @@
 #pragma once
+#include <stdio.h>
+#include <stdint.h>
 
-// Class to benchmark the average execution time of multiple code executions and write it to standard out.
+// Class to benchmark the latency of multiple code executions and write the statistics to a file like standard out.
 // Can be used to meassure the execution time of a function hook for gui apps with an allocated console.
+// The durations are recorded as raw time stamp counter ticks in a ring buffer that is allocated once on construction. When the ring is full the oldest durations are overwritten.
+// Recording does not allocate, convert or write anything, so start() and end() can be called on every execution of a hot function like a render hook.
+// The ticks are converted to seconds only when the statistics are calculated, based on the time stamp counter frequency calibrated once against QueryPerformanceCounter.
+// Reports minimum, 50th, 90th and 99th percentile, maximum, mean and standard deviation, since stutters are hidden by the mean.
+// Requires an invariant time stamp counter, which all x86 processors of the last decade provide.
+// Meassurements can additionally be forwarded to a TraceSink to write every single duration to a file.
 
 namespace hax {
-	
+
+	class TraceSink;
+
+	typedef struct BenchResult {
+		// number of durations the statistics are calculated from
+		size_t count;
+		// all following values are in seconds
+		double min;
+		double p50;
+		double p90;
+		double p99;
+		double max;
+		double mean;
+		double stdDev;
+	}BenchResult;
+
 	class Bench {
 	private:
-		double _startTime;
-		double _endTime;
 		const char* const _label;
-		double* _durations;
-		size_t _counter;
+		// ring of durations in ticks
+		uint64_t* const _ticks;
+		// copy of the ring converted to doubles and sorted for the percentiles
+		double* const _sorted;
 		const size_t _runs;
+		const size_t _warmup;
+		uint64_t _startTicks;
+		// number of durations recorded since the last reset, excluding the warmup
+		size_t _counter;
+		size_t _warmupLeft;
+		TraceSink* _pSink;
 
 	public:
-		// Initializes members
-		// 
+		// Initializes members and allocates the ring.
+		//
 		// Parameters:
-		// 
+		//
 		// [in] label:
-		// Label for the output. Format: "Average time <label>: <average time in seconds>"
-		// 
+		// Label for the output. Format: "<label>: n <count> min <min> p50 <p50> p90 <p90> p99 <p99> max <max> mean <mean> sd <standard deviation>" with durations in microseconds.
+		//
 		// [in] runs:
-		// How many times the code execution is meassured before the average is calculated and printed when calling printAvg.
-		Bench(const char* label, size_t runs);
-		
+		// Capacity of the ring. How many times the code execution is meassured before the statistics are printed when calling printAvg.
+		//
+		// [in] warmup:
+		// How many meassurements after construction and after every reset are discarded, eg. to exclude cold caches and lazy initialization of the first calls.
+		Bench(const char* label, size_t runs, size_t warmup = 0u);
+
 		~Bench();
-		
+
 		// Starts the meassurement.
 		void start();
-		
-		// Ends the meassurement.
+
+		// Ends the meassurement and records the duration since the last call to start().
 		void end();
 
-		// Writes the output to std out after the code inbetween start() and end() is executed the amount of times passed as runs to the constructor.
+		// Discards all recorded durations. The next meassurements are discarded as warmup again.
+		void reset();
+
+		// Calculates the statistics of the durations currently held by the ring. Does not allocate but sorts a copy of the ring, so it should not be called on a hot path.
+		//
+		// Parameters:
+		//
+		// [out] pResult:
+		// Receives the statistics.
+		//
+		// Return:
+		// True on success, false if no durations have been recorded.
+		bool getResult(BenchResult* pResult);
+
+		// Writes the statistics of the durations currently held by the ring.
+		//
+		// Parameters:
+		//
+		// [in] pFile:
+		// File the statistics are written to (eg. stdout).
+		void print(FILE* pFile);
+
+		// Writes the statistics to std out and resets after the code inbetween start() and end() is executed the amount of times passed as runs to the constructor.
 		void printAvg();
+
+		// Forwards every meassurement after the warmup to a trace sink as an event named by the label of the object.
+		//
+		// Parameters:
+		//
+		// [in] pSink:
+		// Sink the meassurements are pushed to. Pass nullptr to stop forwarding.
+		void setTraceSink(TraceSink* pSink);
+
+		// Gets the frequency of the time stamp counter. Calibrated against QueryPerformanceCounter on the first call, which takes about 20 milliseconds. Thread safe.
+		//
+		// Return:
+		// Ticks per second.
+		static double getTicksPerSecond();
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "BenchStats.h"
+#include <chrono>
+#include <stdlib.h>
+
+namespace hax {
+
+	static int compareSamples(const void* pA, const void* pB);
+
+	BenchStats::BenchStats(const char* label, size_t capacity) : _label{ label }, _capacity{ capacity }, _count{}, _failures{}, _sorted{ true } {
+		this->_samples = new double[this->_capacity];
+	}
+
+
+	BenchStats::~BenchStats() {
+		delete[] this->_samples;
+	}
+
+
+	double BenchStats::now() {
+
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+
+	void BenchStats::addSample(double seconds) {
+
+		if (this->_count >= this->_capacity) return;
+
+		this->_samples[this->_count] = seconds;
+		this->_count++;
+		this->_sorted = false;
+
+		return;
+	}
+
+
+	void BenchStats::addFailure() {
+		this->_failures++;
+
+		return;
+	}
+
+
+	void BenchStats::reset() {
+		this->_count = 0u;
+		this->_failures = 0u;
+		this->_sorted = true;
+
+		return;
+	}
+
+
+	double BenchStats::getPercentile(double percent) {
+		this->sort();
+
+		return getPercentile(this->_samples, this->_count, percent);
+	}
+
+
+	double BenchStats::getPercentile(const double sorted[], size_t count, double percent) {
+
+		if (!sorted || !count) return 0.;
+
+		if (percent <= 0.) return sorted[0];
+
+		if (percent >= 100.) return sorted[count - 1u];
+
+		const double rank = percent / 100. * static_cast<double>(count - 1u);
+		const size_t lower = static_cast<size_t>(rank);
+
+		if (lower + 1u >= count) return sorted[lower];
+
+		const double fraction = rank - static_cast<double>(lower);
+
+		return sorted[lower] + (sorted[lower + 1u] - sorted[lower]) * fraction;
+	}
+
+
+	double BenchStats::getMean() const {
+
+		if (!this->_count) return 0.;
+
+		double sum = 0.;
+
+		for (size_t i = 0u; i < this->_count; i++) {
+			sum += this->_samples[i];
+		}
+
+		return sum / static_cast<double>(this->_count);
+	}
+
+
+	double BenchStats::getFailureRate() const {
+		const size_t total = this->_count + this->_failures;
+
+		if (!total) return 0.;
+
+		return static_cast<double>(this->_failures) / static_cast<double>(total);
+	}
+
+
+	size_t BenchStats::getCount() const {
+
+		return this->_count;
+	}
+
+
+	size_t BenchStats::getFailures() const {
+
+		return this->_failures;
+	}
+
+
+	const char* BenchStats::getLabel() const {
+
+		return this->_label;
+	}
+
+
+	void BenchStats::printHeader(FILE* pFile) {
+		fprintf(pFile, "%-24s %8s %8s %12s %12s %12s %12s %12s\n", "label", "runs", "fail %", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+
+		return;
+	}
+
+
+	void BenchStats::printRow(FILE* pFile) {
+		constexpr double US_PER_S = 1000000.;
+
+		fprintf(
+			pFile, "%-24s %8zu %8.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n",
+			this->_label, this->_count + this->_failures, this->getFailureRate() * 100.,
+			this->getMean() * US_PER_S, this->getPercentile(50.) * US_PER_S, this->getPercentile(90.) * US_PER_S, this->getPercentile(99.) * US_PER_S, this->getPercentile(100.) * US_PER_S
+		);
+
+		return;
+	}
+
+
+	void BenchStats::sort() {
+
+		if (this->_sorted) return;
+
+		qsort(this->_samples, this->_count, sizeof(double), compareSamples);
+		this->_sorted = true;
+
+		return;
+	}
+
+
+	static int compareSamples(const void* pA, const void* pB) {
+		const double a = *static_cast<const double*>(pA);
+		const double b = *static_cast<const double*>(pB);
+
+		if (a < b) return -1;
+
+		if (a > b) return 1;
+
+		return 0;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+#include <stdio.h>
+
+// Class to collect duration samples and failures of repeated operations and calculate statistics over them.
+// Unlike the Bench class it does not meassure by itself and keeps all samples to calculate percentiles.
+// Only depends on the C++ standard library, so it can be used and tested on any platform.
+
+namespace hax {
+
+	class BenchStats {
+	private:
+		const char* const _label;
+		double* _samples;
+		const size_t _capacity;
+		size_t _count;
+		size_t _failures;
+		bool _sorted;
+
+	public:
+		// Initializes members.
+		// 
+		// Parameters:
+		// 
+		// [in] label:
+		// Label for the row of the output table.
+		// 
+		// [in] capacity:
+		// Maximum count of samples. Further samples are ignored.
+		BenchStats(const char* label, size_t capacity);
+
+		~BenchStats();
+
+		// Gets a timestamp from a high resolution clock.
+		//
+		// Return:
+		// Timestamp in seconds.
+		static double now();
+
+		// Adds the duration of a successful operation.
+		// 
+		// Parameters:
+		// 
+		// [in] seconds:
+		// Duration of the operation in seconds.
+		void addSample(double seconds);
+
+		// Counts a failed operation. Failures do not add a duration.
+		void addFailure();
+
+		// Removes all samples and failures.
+		void reset();
+
+		// Calculates a percentile of the samples via linear interpolation between the closest ranks.
+		// 
+		// Parameters:
+		// 
+		// [in] percent:
+		// Percentile between 0 and 100.
+		// 
+		// Return:
+		// Percentile in seconds or 0 if there are no samples.
+		double getPercentile(double percent);
+
+		// Calculates a percentile of sorted values via linear interpolation between the closest ranks. Shared by the Bench class.
+		// 
+		// Parameters:
+		// 
+		// [in] sorted:
+		// Values sorted in ascending order.
+		// 
+		// [in] count:
+		// Number of values.
+		// 
+		// [in] percent:
+		// Percentile between 0 and 100.
+		// 
+		// Return:
+		// Percentile of the values or 0 if there are no values.
+		static double getPercentile(const double sorted[], size_t count, double percent);
+
+		// Calculates the arithmetic mean of the samples.
+		// 
+		// Return:
+		// Mean in seconds or 0 if there are no samples.
+		double getMean() const;
+
+		// Calculates the share of failed operations of all operations.
+		// 
+		// Return:
+		// Failure rate between 0 and 1.
+		double getFailureRate() const;
+
+		size_t getCount() const;
+		size_t getFailures() const;
+		const char* getLabel() const;
+
+		// Writes the header of the output table.
+		// 
+		// Parameters:
+		// 
+		// [in] pFile:
+		// File the header is written to (eg. stdout).
+		static void printHeader(FILE* pFile);
+
+		// Writes a row with the label, the operation count, the failure rate, the mean and the 50th, 90th, 99th percentile and maximum in microseconds.
+		// 
+		// Parameters:
+		// 
+		// [in] pFile:
+		// File the row is written to (eg. stdout).
+		void printRow(FILE* pFile);
+
+	private:
+		void sort();
+	};
+
+}
\ No newline at end of file
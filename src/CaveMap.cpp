@@ -0,0 +1,274 @@
+#include "CaveMap.h"
+#include <emmintrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+namespace hax {
+
+	namespace mem {
+
+		// bytes compared at once, caves are aligned to and a multiple of this size
+		constexpr size_t CAVE_BLOCK_SIZE = 0x10u;
+		// compare mask of a block that consists of padding bytes only
+		constexpr int FULL_BLOCK_MASK = 0xFFFF;
+		// maximum number of trailing bytes of an instruction that are operand bytes (imm64 or disp32 and imm32)
+		constexpr unsigned int MAX_OPERAND_TAIL = 8u;
+		// size of the PE headers that are read to locate the sections
+		constexpr size_t HEADERS_SIZE = 0x1000u;
+		constexpr BYTE INT3 = 0xCC;
+
+		// the section alignment is at the same offset in both optional headers
+		static_assert(offsetof(IMAGE_OPTIONAL_HEADER32, SectionAlignment) == offsetof(IMAGE_OPTIONAL_HEADER64, SectionAlignment), "Section alignment offset mismatch.");
+
+		static size_t alignUp(size_t value, size_t alignment);
+		static unsigned int countTrailingFill(int mask);
+		static int compareCaves(const void* pLeft, const void* pRight);
+
+		CaveMap::CaveMap(HANDLE hProc) : _hProc{ hProc }, _pCaves{}, _count{}, _capacity{} {}
+
+
+		CaveMap::~CaveMap() {
+
+			if (this->_pCaves) {
+				delete[] this->_pCaves;
+			}
+
+		}
+
+
+		bool CaveMap::scan(HMODULE hModule, size_t minSize) {
+
+			if (!hModule) return false;
+
+			BYTE* const moduleBase = reinterpret_cast<BYTE*>(hModule);
+			BYTE* const headers = new BYTE[HEADERS_SIZE]{};
+
+			if (!ReadProcessMemory(this->_hProc, moduleBase, headers, HEADERS_SIZE, nullptr)) {
+				delete[] headers;
+
+				return false;
+			}
+
+			const IMAGE_DOS_HEADER* const pDosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(headers);
+
+			if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE || pDosHeader->e_lfanew < 0) {
+				delete[] headers;
+
+				return false;
+			}
+
+			const size_t ntOffset = static_cast<size_t>(pDosHeader->e_lfanew);
+			const size_t optOffset = ntOffset + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+
+			if (optOffset + sizeof(IMAGE_OPTIONAL_HEADER32) > HEADERS_SIZE || *reinterpret_cast<const DWORD*>(headers + ntOffset) != IMAGE_NT_SIGNATURE) {
+				delete[] headers;
+
+				return false;
+			}
+
+			const IMAGE_FILE_HEADER* const pFileHeader = reinterpret_cast<const IMAGE_FILE_HEADER*>(headers + ntOffset + sizeof(DWORD));
+			const size_t sectionOffset = optOffset + pFileHeader->SizeOfOptionalHeader;
+
+			if (sectionOffset + pFileHeader->NumberOfSections * sizeof(IMAGE_SECTION_HEADER) > HEADERS_SIZE) {
+				delete[] headers;
+
+				return false;
+			}
+
+			const size_t sectionAlignment = reinterpret_cast<const IMAGE_OPTIONAL_HEADER32*>(headers + optOffset)->SectionAlignment;
+			const IMAGE_SECTION_HEADER* const pSectionHeaders = reinterpret_cast<const IMAGE_SECTION_HEADER*>(headers + sectionOffset);
+			const size_t blockMinSize = alignUp(minSize ? minSize : CAVE_BLOCK_SIZE, CAVE_BLOCK_SIZE);
+			bool success = true;
+
+			for (WORD i = 0u; i < pFileHeader->NumberOfSections; i++) {
+				const IMAGE_SECTION_HEADER* const pCurSection = &pSectionHeaders[i];
+
+				if (!(pCurSection->Characteristics & IMAGE_SCN_MEM_EXECUTE)) continue;
+
+				const size_t virtualSize = pCurSection->Misc.VirtualSize ? pCurSection->Misc.VirtualSize : pCurSection->SizeOfRawData;
+
+				if (!virtualSize) continue;
+
+				BYTE* const sectionBase = moduleBase + pCurSection->VirtualAddress;
+
+				// padding between functions
+				if (!this->scanRange(sectionBase, virtualSize, INT3, blockMinSize)) {
+					success = false;
+				}
+
+				// the rest of the last page of the section is mapped but not part of the image
+				const size_t slackOffset = alignUp(virtualSize, CAVE_BLOCK_SIZE);
+				const size_t sectionEnd = sectionAlignment ? alignUp(virtualSize, sectionAlignment) : virtualSize;
+
+				if (sectionEnd > slackOffset && !this->scanRange(sectionBase + slackOffset, sectionEnd - slackOffset, 0x00u, blockMinSize)) {
+					success = false;
+				}
+
+			}
+
+			delete[] headers;
+
+			qsort(this->_pCaves, this->_count, sizeof(Cave), compareCaves);
+
+			return success;
+		}
+
+
+		void CaveMap::clear() {
+			this->_count = 0u;
+
+			return;
+		}
+
+
+		size_t CaveMap::findCaves(const BYTE code[], size_t size, BYTE* base, BYTE fill, size_t minSize, Cave caves[], size_t capacity) {
+			const __m128i pattern = _mm_set1_epi8(static_cast<char>(fill));
+			const size_t blockCount = size / CAVE_BLOCK_SIZE;
+			size_t count = 0u;
+			size_t runStart = SIZE_MAX;
+			int prevMask = 0;
+
+			// one iteration past the last block closes a run that reaches the end
+			for (size_t i = 0u; i <= blockCount; i++) {
+				int mask = 0;
+
+				if (i < blockCount) {
+					const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i * CAVE_BLOCK_SIZE));
+					mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+				}
+
+				if (mask == FULL_BLOCK_MASK) {
+
+					if (runStart == SIZE_MAX) {
+						runStart = i;
+
+						// the first block might contain the operand of an instruction that ends with 0xCC bytes in the previous block
+						if (fill == INT3 && i && countTrailingFill(prevMask) < MAX_OPERAND_TAIL) {
+							runStart++;
+						}
+
+					}
+
+					continue;
+				}
+
+				if (runStart != SIZE_MAX) {
+
+					if (i > runStart && (i - runStart) * CAVE_BLOCK_SIZE >= minSize) {
+
+						if (caves && count < capacity) {
+							caves[count] = Cave{ base + runStart * CAVE_BLOCK_SIZE, (i - runStart) * CAVE_BLOCK_SIZE, fill };
+						}
+
+						count++;
+					}
+
+					runStart = SIZE_MAX;
+				}
+
+				prevMask = mask;
+			}
+
+			return count;
+		}
+
+
+		HANDLE CaveMap::getProcessHandle() const {
+
+			return this->_hProc;
+		}
+
+
+		const Cave* CaveMap::getCaves() const {
+
+			return this->_pCaves;
+		}
+
+
+		size_t CaveMap::getCount() const {
+
+			return this->_count;
+		}
+
+
+		void CaveMap::append(const Cave* pCave) {
+
+			if (this->_count >= this->_capacity) {
+				const size_t newCapacity = this->_capacity ? this->_capacity * 2u : 0x40u;
+				Cave* const pGrown = new Cave[newCapacity];
+
+				if (this->_pCaves) {
+					memcpy(pGrown, this->_pCaves, this->_count * sizeof(Cave));
+					delete[] this->_pCaves;
+				}
+
+				this->_pCaves = pGrown;
+				this->_capacity = newCapacity;
+			}
+
+			this->_pCaves[this->_count] = *pCave;
+			this->_count++;
+
+			return;
+		}
+
+
+		bool CaveMap::scanRange(BYTE* base, size_t size, BYTE fill, size_t minSize) {
+			BYTE* const code = new BYTE[size]{};
+
+			if (!ReadProcessMemory(this->_hProc, base, code, size, nullptr)) {
+				delete[] code;
+
+				return false;
+			}
+
+			// caves are separated by at least one block that is not padding
+			const size_t capacity = size / (minSize + CAVE_BLOCK_SIZE) + 1u;
+			Cave* const caves = new Cave[capacity]{};
+			const size_t count = findCaves(code, size, base, fill, minSize, caves, capacity);
+
+			for (size_t i = 0u; i < count && i < capacity; i++) {
+				this->append(&caves[i]);
+			}
+
+			delete[] caves;
+			delete[] code;
+
+			return true;
+		}
+
+
+		static size_t alignUp(size_t value, size_t alignment) {
+
+			return (value + alignment - 1u) & ~(alignment - 1u);
+		}
+
+
+		static unsigned int countTrailingFill(int mask) {
+			unsigned int count = 0u;
+
+			// the mask holds one bit per byte, the last byte of the block is the highest bit
+			for (int bit = static_cast<int>(CAVE_BLOCK_SIZE) - 1; bit >= 0 && (mask >> bit & 1); bit--) {
+				count++;
+			}
+
+			return count;
+		}
+
+
+		static int compareCaves(const void* pLeft, const void* pRight) {
+			const Cave* const pLeftCave = static_cast<const Cave*>(pLeft);
+			const Cave* const pRightCave = static_cast<const Cave*>(pRight);
+
+			// larger caves first
+			if (pLeftCave->size != pRightCave->size) return pLeftCave->size > pRightCave->size ? -1 : 1;
+
+			if (pLeftCave->base != pRightCave->base) return pLeftCave->base < pRightCave->base ? -1 : 1;
+
+			return 0;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+#include <Windows.h>
+
+// Class to find code caves within the executable sections of modules of a process.
+// A code cave is a run of padding bytes that is never executed: 0xCC bytes between functions and 0x00 bytes between the end of a section and the end of its last page.
+// The sections are located via the PE headers of the module and copied once, then the copies are scanned 16 bytes at a time with SSE2 compares.
+// Zero bytes within the virtual size of a section are not considered, since they might be data like jump tables. Runs of 0xCC do not start within 8 bytes after
+// the preceding instruction, since these bytes might belong to an operand of the instruction.
+// Caves are 16 bytes aligned and sorted by size in descending order and by address in ascending order for equal sizes.
+// Caves can be added to a RemotePool to serve blocks like gateways close to functions of the module without allocating memory.
+// Works for the caller process (pass GetCurrentProcess()) as well as for external processes.
+// Compiled to x64 the class works both on x64 and x86 targets. Compiled to x86 it only works on x86 targets.
+
+namespace hax {
+
+	namespace mem {
+
+		typedef struct Cave {
+			BYTE* base;
+			size_t size;
+			// value of the padding bytes, 0xCC or 0x00
+			BYTE fill;
+		}Cave;
+
+		class CaveMap {
+		private:
+			const HANDLE _hProc;
+			Cave* _pCaves;
+			size_t _count;
+			size_t _capacity;
+
+		public:
+			// Initializes members. Call scan() to find the caves of a module.
+			//
+			// Parameters:
+			//
+			// [in] hProc:
+			// Handle to the process which modules should be scanned. Pass GetCurrentProcess() for the caller process.
+			// Needs at least PROCESS_VM_READ access rights.
+			CaveMap(HANDLE hProc);
+
+			~CaveMap();
+
+			// Finds the caves within the executable sections of a module and adds them to the caves found so far.
+			// Call it again for further modules. The caves of all scanned modules are sorted together.
+			//
+			// Parameters:
+			//
+			// [in] hModule:
+			// Base address of the module within the virtual address space of the process.
+			//
+			// [in] minSize:
+			// Minimum size of a cave in bytes. Smaller caves are skipped. Gets rounded up to a multiple of 16 bytes.
+			//
+			// Return:
+			// True on success, false if the headers or sections of the module could not be read.
+			bool scan(HMODULE hModule, size_t minSize = 0x20u);
+
+			// Removes all caves found so far.
+			void clear();
+
+			// Finds the caves within a copy of the code of a section.
+			// Does not call any API functions, so it works on arbitrary buffers.
+			//
+			// Parameters:
+			//
+			// [in] code:
+			// Copy of the code that should be scanned.
+			//
+			// [in] size:
+			// Size of the copy in bytes.
+			//
+			// [in] base:
+			// Address of the code within the virtual address space of the process. Has to be 16 bytes aligned.
+			//
+			// [in] fill:
+			// Value of the padding bytes, 0xCC or 0x00.
+			//
+			// [in] minSize:
+			// Minimum size of a cave in bytes. Has to be a multiple of 16 bytes.
+			//
+			// [out] caves:
+			// Buffer that receives the caves. Pass nullptr to only count them.
+			//
+			// [in] capacity:
+			// Number of caves the buffer can hold.
+			//
+			// Return:
+			// Number of caves found, even if the buffer is too small to hold all of them.
+			static size_t findCaves(const BYTE code[], size_t size, BYTE* base, BYTE fill, size_t minSize, Cave caves[], size_t capacity);
+
+			HANDLE getProcessHandle() const;
+			const Cave* getCaves() const;
+			size_t getCount() const;
+
+		private:
+			void append(const Cave* pCave);
+			bool scanRange(BYTE* base, size_t size, BYTE fill, size_t minSize);
+		};
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,615 @@
+#include "Channel.h"
+#include "proc.h"
+
+#define LOW_DWORD(ptr) (static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ptr)))
+
+namespace hax {
+
+	namespace launch {
+		// how long to wait for the execution of a call request or the worker thread to stop in milliseconds
+		constexpr DWORD CHANNEL_TIMEOUT = 5000ul;
+
+		namespace x86 {
+
+			// struct for a call request within the ring buffer
+			typedef struct ChannelSlot {
+				uint32_t pFunc;
+				uint32_t pArg;
+				uint32_t ret;
+				uint32_t pad;
+			}ChannelSlot;
+
+			// struct for data of the channel followed by the ring buffer of call requests
+			typedef struct ChannelData {
+				uint32_t pWaitForSingleObject;
+				uint32_t pSetEvent;
+				uint32_t pCreateThread;
+				uint32_t hRequestEvent;
+				uint32_t hDoneEvent;
+				uint32_t pWorker;
+				// index of the next request written by the caller
+				uint32_t head;
+				// index of the next request executed by the worker
+				uint32_t tail;
+				// slot count - 1
+				uint32_t mask;
+				uint32_t pad;
+			}ChannelData;
+
+			// ASM:
+			// mov    eax, DWORD PTR[esp + 0x4]		load pChannelData
+			// push   0x0							lpThreadId
+			// push   0x0							dwCreationFlags
+			// push   eax							lpParameter = pChannelData
+			// push   DWORD PTR[eax + 0x14]			lpStartAddress = pChannelData->pWorker
+			// push   0x0							dwStackSize
+			// push   0x0							lpThreadAttributes
+			// call   DWORD PTR[eax + 0x8]			call pChannelData->pCreateThread
+			// ret    0x4							return handle of the worker thread
+			static constexpr BYTE CHANNEL_BOOTSTRAP_SHELL[]{ 0x8B, 0x44, 0x24, 0x04, 0x6A, 0x00, 0x6A, 0x00, 0x50, 0xFF, 0x70, 0x14, 0x6A, 0x00, 0x6A, 0x00, 0xFF, 0x50, 0x08, 0xC2, 0x04, 0x00 };
+
+			// ASM:
+			// push   ebx							save registers
+			// push   esi
+			// push   edi
+			// mov    ebx, DWORD PTR[esp + 0x10]	load pChannelData
+			// loop:
+			// mov    eax, DWORD PTR[ebx + 0x1c]	load pChannelData->tail
+			// cmp    eax, DWORD PTR[ebx + 0x18]	compare to pChannelData->head
+			// jne    process						process request if ring buffer is not empty
+			// push   0xffffffff					dwMilliseconds = INFINITE
+			// push   DWORD PTR[ebx + 0xc]			hHandle = pChannelData->hRequestEvent
+			// call   DWORD PTR[ebx]				call pChannelData->pWaitForSingleObject
+			// jmp    loop
+			// process:
+			// mov    esi, eax						save tail
+			// and    eax, DWORD PTR[ebx + 0x20]	index = tail & pChannelData->mask
+			// shl    eax, 0x4						offset = index * sizeof(ChannelSlot)
+			// lea    edi, [ebx + eax + 0x28]		load pSlot
+			// mov    eax, DWORD PTR[edi]			load pSlot->pFunc
+			// test   eax, eax
+			// je     exit							nullptr as function stops the worker
+			// push   DWORD PTR[edi + 0x4]			push pSlot->pArg for pSlot->pFunc call
+			// call   eax							call pSlot->pFunc
+			// mov    DWORD PTR[edi + 0x8], eax		write return value to pSlot->ret
+			// inc    esi
+			// mov    DWORD PTR[ebx + 0x1c], esi	advance pChannelData->tail
+			// push   DWORD PTR[ebx + 0x10]			hEvent = pChannelData->hDoneEvent
+			// call   DWORD PTR[ebx + 0x4]			call pChannelData->pSetEvent
+			// jmp    loop
+			// exit:
+			// inc    esi
+			// mov    DWORD PTR[ebx + 0x1c], esi	advance pChannelData->tail
+			// push   DWORD PTR[ebx + 0x10]			hEvent = pChannelData->hDoneEvent
+			// call   DWORD PTR[ebx + 0x4]			call pChannelData->pSetEvent
+			// pop    edi							restore registers
+			// pop    esi
+			// pop    ebx
+			// xor    eax, eax
+			// ret    0x4
+			static constexpr BYTE CHANNEL_WORKER_SHELL[]{
+				0x53, 0x56, 0x57, 0x8B, 0x5C, 0x24, 0x10, 0x8B, 0x43, 0x1C, 0x3B, 0x43, 0x18, 0x75, 0x09, 0x6A, 0xFF, 0xFF, 0x73, 0x0C, 0xFF, 0x13, 0xEB, 0xEF, 0x89, 0xC6,
+				0x23, 0x43, 0x20, 0xC1, 0xE0, 0x04, 0x8D, 0x7C, 0x03, 0x28, 0x8B, 0x07, 0x85, 0xC0, 0x74, 0x14, 0xFF, 0x77, 0x04, 0xFF, 0xD0, 0x89, 0x47, 0x08, 0x46, 0x89,
+				0x73, 0x1C, 0xFF, 0x73, 0x10, 0xFF, 0x53, 0x04, 0xEB, 0xC9, 0x46, 0x89, 0x73, 0x1C, 0xFF, 0x73, 0x10, 0xFF, 0x53, 0x04, 0x5F, 0x5E, 0x5B, 0x31, 0xC0, 0xC2,
+				0x04, 0x00
+			};
+
+		}
+
+		#ifdef _WIN64
+
+		namespace x64 {
+
+			// struct for a call request within the ring buffer
+			typedef struct ChannelSlot {
+				uint64_t pFunc;
+				uint64_t pArg;
+				uint64_t ret;
+				uint64_t pad;
+			}ChannelSlot;
+
+			// struct for data of the channel followed by the ring buffer of call requests
+			typedef struct ChannelData {
+				uint64_t pWaitForSingleObject;
+				uint64_t pSetEvent;
+				uint64_t pCreateThread;
+				uint64_t hRequestEvent;
+				uint64_t hDoneEvent;
+				uint64_t pWorker;
+				// index of the next request written by the caller
+				uint32_t head;
+				// index of the next request executed by the worker
+				uint32_t tail;
+				// slot count - 1
+				uint32_t mask;
+				uint32_t pad;
+			}ChannelData;
+
+			// ASM:
+			// sub    rsp, 0x38								setup shadow space and stack arguments for function call
+			// mov    r9, rcx								lpParameter = pChannelData
+			// mov    r8, QWORD PTR[rcx + 0x28]				lpStartAddress = pChannelData->pWorker
+			// mov    rax, QWORD PTR[rcx + 0x10]			load pChannelData->pCreateThread
+			// xor    ecx, ecx								lpThreadAttributes
+			// xor    edx, edx								dwStackSize
+			// mov    QWORD PTR[rsp + 0x20], 0x0			dwCreationFlags
+			// mov    QWORD PTR[rsp + 0x28], 0x0			lpThreadId
+			// call   rax									call pChannelData->pCreateThread
+			// add    rsp, 0x38								cleanup stack
+			// ret											return handle of the worker thread
+			static constexpr BYTE CHANNEL_BOOTSTRAP_SHELL[]{
+				0x48, 0x83, 0xEC, 0x38, 0x49, 0x89, 0xC9, 0x4C, 0x8B, 0x41, 0x28, 0x48, 0x8B, 0x41, 0x10, 0x31, 0xC9, 0x31, 0xD2, 0x48, 0xC7, 0x44, 0x24, 0x20, 0x00, 0x00,
+				0x00, 0x00, 0x48, 0xC7, 0x44, 0x24, 0x28, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xD0, 0x48, 0x83, 0xC4, 0x38, 0xC3
+			};
+
+			// ASM:
+			// push   rbx									save registers
+			// push   rsi
+			// push   rdi
+			// sub    rsp, 0x20								setup shadow space for function calls
+			// mov    rbx, rcx								save pChannelData
+			// loop:
+			// mov    eax, DWORD PTR[rbx + 0x34]			load pChannelData->tail
+			// cmp    eax, DWORD PTR[rbx + 0x30]			compare to pChannelData->head
+			// jne    process								process request if ring buffer is not empty
+			// mov    rcx, QWORD PTR[rbx + 0x18]			hHandle = pChannelData->hRequestEvent
+			// mov    edx, 0xffffffff						dwMilliseconds = INFINITE
+			// call   QWORD PTR[rbx]						call pChannelData->pWaitForSingleObject
+			// jmp    loop
+			// process:
+			// mov    esi, eax								save tail
+			// and    eax, DWORD PTR[rbx + 0x38]			index = tail & pChannelData->mask
+			// shl    rax, 0x5								offset = index * sizeof(ChannelSlot)
+			// lea    rdi, [rbx + rax + 0x40]				load pSlot
+			// mov    rax, QWORD PTR[rdi]					load pSlot->pFunc
+			// test   rax, rax
+			// je     exit									nullptr as function stops the worker
+			// mov    rcx, QWORD PTR[rdi + 0x8]				load pSlot->pArg for pSlot->pFunc call
+			// call   rax									call pSlot->pFunc
+			// mov    QWORD PTR[rdi + 0x10], rax			write return value to pSlot->ret
+			// inc    esi
+			// mov    DWORD PTR[rbx + 0x34], esi			advance pChannelData->tail
+			// mov    rcx, QWORD PTR[rbx + 0x20]			hEvent = pChannelData->hDoneEvent
+			// call   QWORD PTR[rbx + 0x8]					call pChannelData->pSetEvent
+			// jmp    loop
+			// exit:
+			// inc    esi
+			// mov    DWORD PTR[rbx + 0x34], esi			advance pChannelData->tail
+			// mov    rcx, QWORD PTR[rbx + 0x20]			hEvent = pChannelData->hDoneEvent
+			// call   QWORD PTR[rbx + 0x8]					call pChannelData->pSetEvent
+			// add    rsp, 0x20								cleanup shadow space
+			// pop    rdi									restore registers
+			// pop    rsi
+			// pop    rbx
+			// xor    eax, eax
+			// ret
+			static constexpr BYTE CHANNEL_WORKER_SHELL[]{
+				0x53, 0x56, 0x57, 0x48, 0x83, 0xEC, 0x20, 0x48, 0x89, 0xCB, 0x8B, 0x43, 0x34, 0x3B, 0x43, 0x30, 0x75, 0x0D, 0x48, 0x8B, 0x4B, 0x18, 0xBA, 0xFF, 0xFF, 0xFF,
+				0xFF, 0xFF, 0x13, 0xEB, 0xEB, 0x89, 0xC6, 0x23, 0x43, 0x38, 0x48, 0xC1, 0xE0, 0x05, 0x48, 0x8D, 0x7C, 0x03, 0x40, 0x48, 0x8B, 0x07, 0x48, 0x85, 0xC0, 0x74,
+				0x18, 0x48, 0x8B, 0x4F, 0x08, 0xFF, 0xD0, 0x48, 0x89, 0x47, 0x10, 0xFF, 0xC6, 0x89, 0x73, 0x34, 0x48, 0x8B, 0x4B, 0x20, 0xFF, 0x53, 0x08, 0xEB, 0xBD, 0xFF,
+				0xC6, 0x89, 0x73, 0x34, 0x48, 0x8B, 0x4B, 0x20, 0xFF, 0x53, 0x08, 0x48, 0x83, 0xC4, 0x20, 0x5F, 0x5E, 0x5B, 0x31, 0xC0, 0xC3
+			};
+
+		}
+
+		#endif // _WIN64
+
+		// the channel data is placed behind the shell code at this offset
+		constexpr size_t CHANNEL_DATA_OFFSET = 0x100u;
+
+		static uint32_t roundUpPowerOfTwo(uint32_t value);
+		// size of the channel data including the ring buffer
+		static size_t getChannelDataSize(bool isWow64, uint32_t slotCount);
+
+
+		Channel::Channel(HANDLE hProc, uint32_t slotCount) :
+			_hProc{ hProc }, _slotCount{ roundUpPowerOfTwo(slotCount) }, _pShellCode{}, _pChannelData{}, _hRequestEvent{}, _hDoneEvent{},
+			_hRemoteRequestEvent{}, _hRemoteDoneEvent{}, _hWorkerThread{}, _head{}, _tail{}, _isWow64{} {}
+
+
+		Channel::~Channel() {
+			this->close();
+		}
+
+
+		bool Channel::open(tLaunchFunc pLaunchFunc) {
+
+			if (this->isOpen()) return true;
+
+			BOOL isWow64 = FALSE;
+			IsWow64Process(this->_hProc, &isWow64);
+			this->_isWow64 = isWow64;
+
+			// x64 targets only feasable for x64 compilations
+			#ifndef _WIN64
+
+			if (!this->_isWow64) return false;
+
+			#endif // !_WIN64
+
+			const HMODULE hKernel32 = proc::ex::getModuleHandle(this->_hProc, "kernel32.dll");
+
+			if (!hKernel32) return false;
+
+			const FARPROC pWaitForSingleObject = proc::ex::getProcAddress(this->_hProc, hKernel32, "WaitForSingleObject");
+			const FARPROC pSetEvent = proc::ex::getProcAddress(this->_hProc, hKernel32, "SetEvent");
+			const FARPROC pCreateThread = proc::ex::getProcAddress(this->_hProc, hKernel32, "CreateThread");
+
+			if (!pWaitForSingleObject || !pSetEvent || !pCreateThread) return false;
+
+			// auto reset events, the worker checks the ring buffer before waiting so no request gets lost
+			this->_hRequestEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+			this->_hDoneEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+
+			if (!this->_hRequestEvent || !this->_hDoneEvent) {
+				this->close();
+
+				return false;
+			}
+
+			const HANDLE hCurProc = GetCurrentProcess();
+
+			if (!DuplicateHandle(hCurProc, this->_hRequestEvent, this->_hProc, &this->_hRemoteRequestEvent, SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, 0ul)) {
+				this->close();
+
+				return false;
+			}
+
+			if (!DuplicateHandle(hCurProc, this->_hDoneEvent, this->_hProc, &this->_hRemoteDoneEvent, SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, 0ul)) {
+				this->close();
+
+				return false;
+			}
+
+			const size_t size = CHANNEL_DATA_OFFSET + getChannelDataSize(this->_isWow64, this->_slotCount);
+
+			this->_pShellCode = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+
+			if (!this->_pShellCode) {
+				this->close();
+
+				return false;
+			}
+
+			this->_pChannelData = this->_pShellCode + CHANNEL_DATA_OFFSET;
+
+			// build shell code, channel data and empty ring buffer locally to write it with one call
+			BYTE* const localShell = new BYTE[size]{};
+			bool success = false;
+
+			if (this->_isWow64) {
+				memcpy(localShell, x86::CHANNEL_BOOTSTRAP_SHELL, sizeof(x86::CHANNEL_BOOTSTRAP_SHELL));
+				memcpy(localShell + sizeof(x86::CHANNEL_BOOTSTRAP_SHELL), x86::CHANNEL_WORKER_SHELL, sizeof(x86::CHANNEL_WORKER_SHELL));
+
+				x86::ChannelData* const pChannelData = reinterpret_cast<x86::ChannelData*>(localShell + CHANNEL_DATA_OFFSET);
+				pChannelData->pWaitForSingleObject = LOW_DWORD(pWaitForSingleObject);
+				pChannelData->pSetEvent = LOW_DWORD(pSetEvent);
+				pChannelData->pCreateThread = LOW_DWORD(pCreateThread);
+				pChannelData->hRequestEvent = LOW_DWORD(this->_hRemoteRequestEvent);
+				pChannelData->hDoneEvent = LOW_DWORD(this->_hRemoteDoneEvent);
+				pChannelData->pWorker = LOW_DWORD(this->_pShellCode + sizeof(x86::CHANNEL_BOOTSTRAP_SHELL));
+				pChannelData->mask = this->_slotCount - 1u;
+
+				success = WriteProcessMemory(this->_hProc, this->_pShellCode, localShell, size, nullptr);
+			}
+			else {
+
+				#ifdef _WIN64
+
+				memcpy(localShell, x64::CHANNEL_BOOTSTRAP_SHELL, sizeof(x64::CHANNEL_BOOTSTRAP_SHELL));
+				memcpy(localShell + sizeof(x64::CHANNEL_BOOTSTRAP_SHELL), x64::CHANNEL_WORKER_SHELL, sizeof(x64::CHANNEL_WORKER_SHELL));
+
+				x64::ChannelData* const pChannelData = reinterpret_cast<x64::ChannelData*>(localShell + CHANNEL_DATA_OFFSET);
+				pChannelData->pWaitForSingleObject = reinterpret_cast<uint64_t>(pWaitForSingleObject);
+				pChannelData->pSetEvent = reinterpret_cast<uint64_t>(pSetEvent);
+				pChannelData->pCreateThread = reinterpret_cast<uint64_t>(pCreateThread);
+				pChannelData->hRequestEvent = reinterpret_cast<uint64_t>(this->_hRemoteRequestEvent);
+				pChannelData->hDoneEvent = reinterpret_cast<uint64_t>(this->_hRemoteDoneEvent);
+				pChannelData->pWorker = reinterpret_cast<uint64_t>(this->_pShellCode + sizeof(x64::CHANNEL_BOOTSTRAP_SHELL));
+				pChannelData->mask = this->_slotCount - 1u;
+
+				success = WriteProcessMemory(this->_hProc, this->_pShellCode, localShell, size, nullptr);
+
+				#endif // _WIN64
+
+			}
+
+			delete[] localShell;
+
+			if (!success) {
+				this->close();
+
+				return false;
+			}
+
+			// the bootstrap shell code creates the worker thread and returns its handle within the target process
+			uint64_t hRemoteWorkerThread = 0u;
+
+			if (!pLaunchFunc(this->_hProc, reinterpret_cast<tLaunchableFunc>(this->_pShellCode), this->_pChannelData, &hRemoteWorkerThread) || !hRemoteWorkerThread) {
+				this->close();
+
+				return false;
+			}
+
+			// take over the handle to be able to wait for the worker thread to stop
+			if (!DuplicateHandle(
+				this->_hProc, reinterpret_cast<HANDLE>(hRemoteWorkerThread), hCurProc, &this->_hWorkerThread, SYNCHRONIZE, FALSE, DUPLICATE_CLOSE_SOURCE
+			)) {
+				// the worker is running but can not be waited for, so the memory and the handles within the target can not be freed safely
+				this->writeRequest(0u, 0u);
+				this->_pShellCode = nullptr;
+				this->_hRemoteRequestEvent = nullptr;
+				this->_hRemoteDoneEvent = nullptr;
+				this->close();
+
+				return false;
+			}
+
+			return true;
+		}
+
+
+		void Channel::close() {
+			bool stopped = true;
+
+			if (this->_hWorkerThread) {
+				// a request with nullptr as function stops the worker thread, it needs a free slot like any other request
+				const bool hasSlot = this->_head - this->_tail < this->_slotCount || this->waitForTail(this->_head - this->_slotCount);
+
+				if (hasSlot) {
+					this->writeRequest(0u, 0u);
+				}
+
+				// without a free slot the worker can not be stopped, it only counts as stopped if it has exited by itself
+				stopped = WaitForSingleObject(this->_hWorkerThread, hasSlot ? CHANNEL_TIMEOUT : 0ul) == WAIT_OBJECT_0;
+
+				CloseHandle(this->_hWorkerThread);
+				this->_hWorkerThread = nullptr;
+			}
+
+			if (this->_pShellCode && stopped) {
+				VirtualFreeEx(this->_hProc, this->_pShellCode, 0, MEM_RELEASE);
+			}
+
+			this->_pShellCode = nullptr;
+			this->_pChannelData = nullptr;
+
+			// the worker might still execute the shell code and wait for the events, so the memory and the handles within the target are leaked intentionally
+			if (!stopped) {
+				this->_hRemoteRequestEvent = nullptr;
+				this->_hRemoteDoneEvent = nullptr;
+			}
+
+			// close the duplicated handles within the target process
+			if (this->_hRemoteRequestEvent) {
+				DuplicateHandle(this->_hProc, this->_hRemoteRequestEvent, nullptr, nullptr, 0ul, FALSE, DUPLICATE_CLOSE_SOURCE);
+				this->_hRemoteRequestEvent = nullptr;
+			}
+
+			if (this->_hRemoteDoneEvent) {
+				DuplicateHandle(this->_hProc, this->_hRemoteDoneEvent, nullptr, nullptr, 0ul, FALSE, DUPLICATE_CLOSE_SOURCE);
+				this->_hRemoteDoneEvent = nullptr;
+			}
+
+			if (this->_hRequestEvent) {
+				CloseHandle(this->_hRequestEvent);
+				this->_hRequestEvent = nullptr;
+			}
+
+			if (this->_hDoneEvent) {
+				CloseHandle(this->_hDoneEvent);
+				this->_hDoneEvent = nullptr;
+			}
+
+			this->_head = 0u;
+			this->_tail = 0u;
+
+			return;
+		}
+
+
+		bool Channel::call(tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			uint32_t ticket = 0u;
+
+			if (!this->submit(pFunc, pArg, &ticket)) return false;
+
+			return this->wait(ticket, pRet);
+		}
+
+
+		bool Channel::submit(tLaunchableFunc pFunc, void* pArg, uint32_t* pTicket) {
+
+			if (!this->isOpen() || !pFunc) return false;
+
+			// wait for a free slot if the ring buffer is full
+			if (this->_head - this->_tail >= this->_slotCount) {
+
+				if (!this->waitForTail(this->_head - this->_slotCount)) return false;
+
+			}
+
+			*pTicket = this->_head;
+
+			return this->writeRequest(reinterpret_cast<uintptr_t>(pFunc), reinterpret_cast<uintptr_t>(pArg));
+		}
+
+
+		bool Channel::wait(uint32_t ticket, void* pRet) {
+
+			if (!this->isOpen()) return false;
+
+			if (!this->waitForTail(ticket)) return false;
+
+			if (!pRet) return true;
+
+			if (this->_isWow64) {
+				const x86::ChannelSlot* const pSlotEx = reinterpret_cast<x86::ChannelSlot*>(this->getSlotAddress(ticket));
+
+				return ReadProcessMemory(this->_hProc, &pSlotEx->ret, pRet, sizeof(uint32_t), nullptr);
+			}
+
+			#ifdef _WIN64
+
+			const x64::ChannelSlot* const pSlotEx = reinterpret_cast<x64::ChannelSlot*>(this->getSlotAddress(ticket));
+
+			return ReadProcessMemory(this->_hProc, &pSlotEx->ret, pRet, sizeof(uint64_t), nullptr);
+
+			#else
+
+			return false;
+
+			#endif // _WIN64
+
+		}
+
+
+		bool Channel::isOpen() const {
+
+			return this->_hWorkerThread != nullptr;
+		}
+
+
+		bool Channel::writeRequest(uint64_t pFunc, uint64_t pArg) {
+			BYTE* const pSlot = this->getSlotAddress(this->_head);
+			const uint32_t newHead = this->_head + 1u;
+			BYTE* pHead = nullptr;
+
+			if (this->_isWow64) {
+				x86::ChannelSlot slot{};
+				slot.pFunc = static_cast<uint32_t>(pFunc);
+				slot.pArg = static_cast<uint32_t>(pArg);
+
+				if (!WriteProcessMemory(this->_hProc, pSlot, &slot, sizeof(slot), nullptr)) return false;
+
+				pHead = this->_pChannelData + offsetof(x86::ChannelData, head);
+			}
+			else {
+
+				#ifdef _WIN64
+
+				x64::ChannelSlot slot{};
+				slot.pFunc = pFunc;
+				slot.pArg = pArg;
+
+				if (!WriteProcessMemory(this->_hProc, pSlot, &slot, sizeof(slot), nullptr)) return false;
+
+				pHead = this->_pChannelData + offsetof(x64::ChannelData, head);
+
+				#endif // _WIN64
+
+			}
+
+			if (!pHead) return false;
+
+			// publish the request after the slot is written
+			if (!WriteProcessMemory(this->_hProc, pHead, &newHead, sizeof(newHead), nullptr)) return false;
+
+			this->_head = newHead;
+
+			return SetEvent(this->_hRequestEvent);
+		}
+
+
+		bool Channel::waitForTail(uint32_t ticket) {
+			const HANDLE handles[]{ this->_hDoneEvent, this->_hWorkerThread };
+			const ULONGLONG start = GetTickCount64();
+
+			// the ticket is done as soon as the tail has passed it, the difference handles the wrap around of the indices
+			while (static_cast<int32_t>(this->_tail - ticket) <= 0) {
+
+				if (!this->readTail()) return false;
+
+				if (static_cast<int32_t>(this->_tail - ticket) > 0) break;
+
+				const ULONGLONG elapsed = GetTickCount64() - start;
+
+				if (elapsed >= CHANNEL_TIMEOUT) return false;
+
+				// the done event gets signaled after every executed request
+				const DWORD waitResult = WaitForMultipleObjects(_countof(handles), handles, FALSE, static_cast<DWORD>(CHANNEL_TIMEOUT - elapsed));
+
+				// worker thread has stopped or the wait failed
+				if (waitResult != WAIT_OBJECT_0 && waitResult != WAIT_TIMEOUT) return false;
+
+			}
+
+			return true;
+		}
+
+
+		bool Channel::readTail() {
+			const BYTE* pTail = nullptr;
+
+			if (this->_isWow64) {
+				pTail = this->_pChannelData + offsetof(x86::ChannelData, tail);
+			}
+			else {
+
+				#ifdef _WIN64
+
+				pTail = this->_pChannelData + offsetof(x64::ChannelData, tail);
+
+				#endif // _WIN64
+
+			}
+
+			if (!pTail) return false;
+
+			return ReadProcessMemory(this->_hProc, pTail, &this->_tail, sizeof(this->_tail), nullptr);
+		}
+
+
+		BYTE* Channel::getSlotAddress(uint32_t index) const {
+			const uint32_t slotIndex = index & (this->_slotCount - 1u);
+
+			if (this->_isWow64) {
+
+				return this->_pChannelData + sizeof(x86::ChannelData) + slotIndex * sizeof(x86::ChannelSlot);
+			}
+
+			#ifdef _WIN64
+
+			return this->_pChannelData + sizeof(x64::ChannelData) + slotIndex * sizeof(x64::ChannelSlot);
+
+			#else
+
+			return nullptr;
+
+			#endif // _WIN64
+
+		}
+
+
+		static size_t getChannelDataSize(bool isWow64, uint32_t slotCount) {
+
+			if (isWow64) {
+
+				return sizeof(x86::ChannelData) + slotCount * sizeof(x86::ChannelSlot);
+			}
+
+			#ifdef _WIN64
+
+			return sizeof(x64::ChannelData) + slotCount * sizeof(x64::ChannelSlot);
+
+			#else
+
+			return 0u;
+
+			#endif // _WIN64
+
+		}
+
+
+		static uint32_t roundUpPowerOfTwo(uint32_t value) {
+			uint32_t result = 1u;
+
+			while (result < value && result < 0x80000000u) {
+				result <<= 1;
+			}
+
+			return result;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+#include "launch.h"
+#include <stdint.h>
+
+// Class to launch code execution in an external target process repeatedly via a persistent channel.
+// Installs a worker thread in the target once with any of the launch functions. The worker pulls call requests from a ring buffer in the virtual memory of the target and signals their completion via an event.
+// Subsequent calls only write a request and wait for the completion event. They do not need any memory allocations, shell code writes or thread creations.
+// x64 compilations of the class can launch code in x64 and x86 targets.
+// x86 compilations of the class can only launch code in x86 targets.
+// The class is not thread safe. Calls from multiple threads have to be synchronized by the caller.
+
+namespace hax {
+
+	namespace launch {
+
+		class Channel {
+		private:
+			const HANDLE _hProc;
+			const uint32_t _slotCount;
+			BYTE* _pShellCode;
+			BYTE* _pChannelData;
+			HANDLE _hRequestEvent;
+			HANDLE _hDoneEvent;
+			HANDLE _hRemoteRequestEvent;
+			HANDLE _hRemoteDoneEvent;
+			HANDLE _hWorkerThread;
+			uint32_t _head;
+			uint32_t _tail;
+			bool _isWow64;
+
+		public:
+			// Initializes members. Call open() to install the channel.
+			//
+			// Parameters:
+			//
+			// [in] hProc:
+			// Handle to the process in which context the code should be launched.
+			// Needs at least PROCESS_DUP_HANDLE, PROCESS_QUERY_LIMITED_INFORMATION, PROCESS_VM_OPERATION, PROCESS_VM_WRITE, and PROCESS_VM_READ access rights
+			// plus the access rights needed by the launch function passed to open().
+			//
+			// [in] slotCount:
+			// Capacity of the ring buffer for call requests. Gets rounded up to the next power of two.
+			Channel(HANDLE hProc, uint32_t slotCount = 0x40u);
+
+			~Channel();
+
+			// Installs the channel in the target process.
+			// Allocates and writes the worker shell code and the ring buffer and launches the creation of the worker thread.
+			//
+			// Parameters:
+			//
+			// [in] pLaunchFunc:
+			// Launch function that is used to create the worker thread within the target process. The launch function is only called once.
+			//
+			// Return:
+			// True on success or false on failure.
+			bool open(tLaunchFunc pLaunchFunc);
+
+			// Stops the worker thread and frees the resources of the channel within the target process.
+			// If no slot gets free for the stop request or the worker thread does not stop in time, the memory of the channel is not freed, because the worker might still execute it.
+			void close();
+
+			// Launches code execution via the channel and waits for the return value.
+			//
+			// Parameters:
+			//
+			// [in] pFunc:
+			// Pointer to the code that should be executed by the worker thread. Assumes the calling conventions:
+			// x86: __stdcall void* pFunc(void* pArg)
+			// x64: __fastcall void* pFunc(void* pArg)
+			// Additional arguments can be passed in a struct pointed to by pArg.
+			// To call API functions with different calling conventions use as a wrapper function.
+			//
+			// [in] pArg:
+			// Argument of the function called by the worker thread.
+			//
+			// [out] pRet:
+			// Pointer for the return value of the function called by the worker thread.
+			//
+			// Return:
+			// True on success or false on failure.
+			bool call(tLaunchableFunc pFunc, void* pArg, void* pRet);
+
+			// Queues a call request without waiting for its execution.
+			// Multiple requests can be queued before waiting. The requests are executed in order of submission.
+			//
+			// Parameters:
+			//
+			// [in] pFunc:
+			// Pointer to the code that should be executed by the worker thread. Same calling conventions as for call().
+			//
+			// [in] pArg:
+			// Argument of the function called by the worker thread.
+			//
+			// [out] pTicket:
+			// Ticket of the request that can be passed to wait() to retrive the return value.
+			//
+			// Return:
+			// True on success or false on failure.
+			bool submit(tLaunchableFunc pFunc, void* pArg, uint32_t* pTicket);
+
+			// Waits for the execution of a queued call request and retrives the return value.
+			// The return value of a request is only available until the ring buffer wraps around, so wait for a ticket before submitting slotCount further requests.
+			//
+			// Parameters:
+			//
+			// [in] ticket:
+			// Ticket returned by submit().
+			//
+			// [out] pRet:
+			// Pointer for the return value of the function called by the worker thread. Can be nullptr if the return value is not needed.
+			//
+			// Return:
+			// True on success or false on failure or timeout.
+			bool wait(uint32_t ticket, void* pRet);
+
+			bool isOpen() const;
+
+		private:
+			bool writeRequest(uint64_t pFunc, uint64_t pArg);
+			bool waitForTail(uint32_t ticket);
+			bool readTail();
+			BYTE* getSlotAddress(uint32_t index) const;
+		};
+
+	}
+
+}
\ No newline at end of file
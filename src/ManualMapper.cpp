@@ -0,0 +1,516 @@
+#include "ManualMapper.h"
+#include "proc.h"
+
+#define LOW_DWORD(ptr) (static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ptr)))
+
+namespace hax {
+
+	namespace launch {
+		static_assert(IMAGE_PROTECT_NOACCESS == PAGE_NOACCESS && IMAGE_PROTECT_READONLY == PAGE_READONLY && IMAGE_PROTECT_READWRITE == PAGE_READWRITE, "Image protection mismatch.");
+		static_assert(IMAGE_PROTECT_EXECUTE == PAGE_EXECUTE && IMAGE_PROTECT_EXECUTE_READ == PAGE_EXECUTE_READ && IMAGE_PROTECT_EXECUTE_READWRITE == PAGE_EXECUTE_READWRITE, "Image protection mismatch.");
+
+		namespace x86 {
+
+			typedef struct LoaderData {
+				uint32_t base;
+				// address of the null terminated array of TLS callbacks, zero if there are none
+				uint32_t pCallbacks;
+				// address of DllMain, zero if there is none
+				uint32_t pEntry;
+			}LoaderData;
+
+			// ASM:
+			// push   ebx							save registers
+			// push   esi
+			// mov    ebx, DWORD PTR[esp + 0xc]		load pLoaderData
+			// mov    esi, DWORD PTR[ebx + 0x4]		load pLoaderData->pCallbacks
+			// test   esi, esi
+			// je     entry
+			// loop:
+			// mov    eax, DWORD PTR[esi]			load current TLS callback
+			// test   eax, eax
+			// je     entry							callback array is null terminated
+			// push   0x0							lpvReserved
+			// push   0x1							fdwReason = DLL_PROCESS_ATTACH
+			// push   DWORD PTR[ebx]				hinstDLL = pLoaderData->base
+			// call   eax							call TLS callback
+			// add    esi, 0x4						advance to next TLS callback
+			// jmp    loop
+			// entry:
+			// mov    eax, 0x1						return TRUE if there is no DllMain
+			// mov    ecx, DWORD PTR[ebx + 0x8]		load pLoaderData->pEntry
+			// test   ecx, ecx
+			// je     done
+			// push   0x0							lpvReserved
+			// push   0x1							fdwReason = DLL_PROCESS_ATTACH
+			// push   DWORD PTR[ebx]				hinstDLL = pLoaderData->base
+			// call   ecx							call DllMain
+			// done:
+			// pop    esi							restore registers
+			// pop    ebx
+			// ret    0x4							return result of DllMain
+			static constexpr BYTE LOADER_SHELL[]{
+				0x53, 0x56, 0x8B, 0x5C, 0x24, 0x0C, 0x8B, 0x73, 0x04, 0x85, 0xF6, 0x74, 0x13, 0x8B, 0x06, 0x85, 0xC0, 0x74, 0x0D, 0x6A, 0x00, 0x6A, 0x01, 0xFF, 0x33, 0xFF,
+				0xD0, 0x83, 0xC6, 0x04, 0xEB, 0xED, 0xB8, 0x01, 0x00, 0x00, 0x00, 0x8B, 0x4B, 0x08, 0x85, 0xC9, 0x74, 0x08, 0x6A, 0x00, 0x6A, 0x01, 0xFF, 0x33, 0xFF, 0xD1,
+				0x5E, 0x5B, 0xC2, 0x04, 0x00
+			};
+
+		}
+
+		#ifdef _WIN64
+
+		namespace x64 {
+
+			typedef struct LoaderData {
+				uint64_t base;
+				// address of the null terminated array of TLS callbacks, zero if there are none
+				uint64_t pCallbacks;
+				// address of DllMain, zero if there is none
+				uint64_t pEntry;
+				// address of RtlAddFunctionTable to register the exception handling data of the image, zero if there is none
+				uint64_t pRtlAddFunctionTable;
+				uint64_t pFunctionTable;
+				uint64_t entryCount;
+			}LoaderData;
+
+			// ASM:
+			// push   rbx							save registers
+			// push   rsi
+			// sub    rsp, 0x28						setup shadow space for function calls and align stack
+			// mov    rbx, rcx						save pLoaderData
+			// mov    rax, QWORD PTR[rbx + 0x18]	load pLoaderData->pRtlAddFunctionTable
+			// test   rax, rax
+			// je     tls
+			// mov    rcx, QWORD PTR[rbx + 0x20]	FunctionTable = pLoaderData->pFunctionTable
+			// mov    edx, DWORD PTR[rbx + 0x28]	EntryCount = pLoaderData->entryCount
+			// mov    r8, QWORD PTR[rbx]			BaseAddress = pLoaderData->base
+			// call   rax							call RtlAddFunctionTable
+			// tls:
+			// mov    rsi, QWORD PTR[rbx + 0x8]		load pLoaderData->pCallbacks
+			// test   rsi, rsi
+			// je     entry
+			// loop:
+			// mov    rax, QWORD PTR[rsi]			load current TLS callback
+			// test   rax, rax
+			// je     entry							callback array is null terminated
+			// mov    rcx, QWORD PTR[rbx]			hinstDLL = pLoaderData->base
+			// mov    edx, 0x1						fdwReason = DLL_PROCESS_ATTACH
+			// xor    r8d, r8d						lpvReserved
+			// call   rax							call TLS callback
+			// add    rsi, 0x8						advance to next TLS callback
+			// jmp    loop
+			// entry:
+			// mov    eax, 0x1						return TRUE if there is no DllMain
+			// mov    r9, QWORD PTR[rbx + 0x10]		load pLoaderData->pEntry
+			// test   r9, r9
+			// je     done
+			// mov    rcx, QWORD PTR[rbx]			hinstDLL = pLoaderData->base
+			// mov    edx, 0x1						fdwReason = DLL_PROCESS_ATTACH
+			// xor    r8d, r8d						lpvReserved
+			// call   r9							call DllMain
+			// mov    eax, eax						zero upper half of the returned BOOL
+			// done:
+			// add    rsp, 0x28						cleanup shadow space
+			// pop    rsi							restore registers
+			// pop    rbx
+			// ret									return result of DllMain
+			static constexpr BYTE LOADER_SHELL[]{
+				0x53, 0x56, 0x48, 0x83, 0xEC, 0x28, 0x48, 0x89, 0xCB, 0x48, 0x8B, 0x43, 0x18, 0x48, 0x85, 0xC0, 0x74, 0x0C, 0x48, 0x8B, 0x4B, 0x20, 0x8B, 0x53, 0x28, 0x4C,
+				0x8B, 0x03, 0xFF, 0xD0, 0x48, 0x8B, 0x73, 0x08, 0x48, 0x85, 0xF6, 0x74, 0x1B, 0x48, 0x8B, 0x06, 0x48, 0x85, 0xC0, 0x74, 0x13, 0x48, 0x8B, 0x0B, 0xBA, 0x01,
+				0x00, 0x00, 0x00, 0x45, 0x31, 0xC0, 0xFF, 0xD0, 0x48, 0x83, 0xC6, 0x08, 0xEB, 0xE5, 0xB8, 0x01, 0x00, 0x00, 0x00, 0x4C, 0x8B, 0x4B, 0x10, 0x4D, 0x85, 0xC9,
+				0x74, 0x10, 0x48, 0x8B, 0x0B, 0xBA, 0x01, 0x00, 0x00, 0x00, 0x45, 0x31, 0xC0, 0x41, 0xFF, 0xD1, 0x89, 0xC0, 0x48, 0x83, 0xC4, 0x28, 0x5E, 0x5B, 0xC3
+			};
+
+		}
+
+		#endif // _WIN64
+
+
+		ManualMapper::ManualMapper(HANDLE hProc) :
+			_hProc{ hProc }, _image{}, _base{}, _isMapped{} {}
+
+
+		ManualMapper::~ManualMapper() {
+			this->reset();
+		}
+
+
+		bool ManualMapper::map(const BYTE* pFile, size_t fileSize, tLaunchFunc pLaunchFunc) {
+
+			if (!this->layout(pFile, fileSize)) return false;
+
+			#ifdef _WIN64
+
+			BOOL isWow64 = FALSE;
+
+			// without the architecture of the target an x64 image could be mapped into an x86 target
+			if (!IsWow64Process(this->_hProc, &isWow64)) {
+				this->reset();
+
+				return false;
+			}
+
+			// the architecture of the image has to match the target
+			const bool isMatching = this->_image.is64Bit() != (isWow64 == TRUE);
+
+			#else
+
+			// x86 compilations can only map x86 images into x86 targets
+			const bool isMatching = !this->_image.is64Bit();
+
+			#endif // _WIN64
+
+			if (!isMatching) {
+				this->reset();
+
+				return false;
+			}
+
+			// images without relocations can only be mapped at their preferred base
+			const pe::DirectoryEntry* const pRelocDir = this->_image.getDataDirectory(IMAGE_DIRECTORY_ENTRY_BASERELOC);
+			const bool isRelocatable = pRelocDir && pRelocDir->VirtualAddress && pRelocDir->Size;
+			void* const pPreferredBase = isRelocatable ? nullptr : reinterpret_cast<void*>(static_cast<uintptr_t>(this->_image.getPreferredBase()));
+
+			// the image and the page of the loader shell code are allocated at once
+			BYTE* const pBaseEx = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, pPreferredBase, this->_image.getSize(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+			if (!pBaseEx) {
+				this->reset();
+
+				return false;
+			}
+
+			this->_base = reinterpret_cast<uintptr_t>(pBaseEx);
+
+			tLaunchableFunc pLoader = nullptr;
+			void* pLoaderData = nullptr;
+
+			if (!this->_image.relocate(this->_base) || !this->resolveImports(pLaunchFunc) || !this->writeLoader(&pLoader, &pLoaderData) || !this->commit()) {
+				VirtualFreeEx(this->_hProc, pBaseEx, 0u, MEM_RELEASE);
+				this->reset();
+
+				return false;
+			}
+
+			// x86 targets return four byte values
+			uint64_t ret = 0u;
+
+			// the image is not freed if the launch fails, because the loader shell code might still get executed after a timeout
+			if (!pLaunchFunc(this->_hProc, pLoader, pLoaderData, &ret)) return false;
+
+			// the loader shell code is not needed anymore
+			VirtualFreeEx(this->_hProc, pBaseEx + alignToPage(this->_image.getImageSize()), IMAGE_PAGE_SIZE, MEM_DECOMMIT);
+
+			// unmap the image like LoadLibrary if DllMain fails
+			if (!static_cast<BOOL>(ret)) {
+				VirtualFreeEx(this->_hProc, pBaseEx, 0u, MEM_RELEASE);
+				this->_base = 0u;
+
+				return false;
+			}
+
+			this->_isMapped = true;
+
+			return true;
+		}
+
+
+		bool ManualMapper::layout(const BYTE* pFile, size_t fileSize) {
+			this->reset();
+
+			// one additional page for the loader shell code
+			return this->_image.layout(pFile, fileSize, IMAGE_PAGE_SIZE);
+		}
+
+
+		bool ManualMapper::relocate(uint64_t base) {
+
+			return this->_image.relocate(base);
+		}
+
+
+		bool ManualMapper::resolveImports(tLaunchFunc pLaunchFunc) {
+
+			if (!this->_image.getImage()) return false;
+
+			const pe::DirectoryEntry* const pImportDir = this->_image.getDataDirectory(IMAGE_DIRECTORY_ENTRY_IMPORT);
+
+			if (!pImportDir || !pImportDir->VirtualAddress) return true;
+
+			const size_t thunkSize = this->_image.is64Bit() ? sizeof(uint64_t) : sizeof(uint32_t);
+			const uint64_t ordinalFlag = this->_image.is64Bit() ? IMAGE_ORDINAL_FLAG64 : IMAGE_ORDINAL_FLAG32;
+			// buffer for the names of dependencies loaded within the target, allocated on demand
+			BYTE* pRemoteName = nullptr;
+			bool success = true;
+
+			for (uint64_t descRva = pImportDir->VirtualAddress; success; descRva += sizeof(IMAGE_IMPORT_DESCRIPTOR)) {
+				const IMAGE_IMPORT_DESCRIPTOR* const pImportDesc = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(this->_image.getRvaAddress(descRva, sizeof(IMAGE_IMPORT_DESCRIPTOR)));
+
+				if (!pImportDesc) {
+					success = false;
+
+					break;
+				}
+
+				// the descriptor array is null terminated
+				if (!pImportDesc->Name) break;
+
+				const char* const modName = this->_image.getRvaString(pImportDesc->Name);
+				const HMODULE hMod = modName ? this->loadModule(modName, pLaunchFunc, &pRemoteName) : nullptr;
+
+				if (!hMod) {
+					success = false;
+
+					break;
+				}
+
+				// some linkers only emit the import address table
+				const uint64_t lookupRva = pImportDesc->OriginalFirstThunk ? pImportDesc->OriginalFirstThunk : pImportDesc->FirstThunk;
+
+				for (uint64_t i = 0u; ; i++) {
+					const BYTE* const pLookup = this->_image.getRvaAddress(lookupRva + i * thunkSize, thunkSize);
+					BYTE* const pIatEntry = this->_image.getRvaAddress(pImportDesc->FirstThunk + i * thunkSize, thunkSize);
+
+					if (!pLookup || !pIatEntry) {
+						success = false;
+
+						break;
+					}
+
+					const uint64_t lookup = this->_image.is64Bit() ? *reinterpret_cast<const uint64_t*>(pLookup) : *reinterpret_cast<const uint32_t*>(pLookup);
+
+					// the thunk array is null terminated
+					if (!lookup) break;
+
+					const char* funcName = nullptr;
+
+					if (lookup & ordinalFlag) {
+						// ordinals are passed in the lowest word of the name like to GetProcAddress
+						funcName = reinterpret_cast<const char*>(static_cast<uintptr_t>(lookup & MAXWORD));
+					}
+					else {
+						// skip the hint of IMAGE_IMPORT_BY_NAME
+						funcName = this->_image.getRvaString((lookup & MAXDWORD) + sizeof(WORD));
+					}
+
+					const FARPROC pFunc = funcName ? proc::ex::getProcAddress(this->_hProc, hMod, funcName) : nullptr;
+
+					if (!pFunc) {
+						success = false;
+
+						break;
+					}
+
+					if (this->_image.is64Bit()) {
+						*reinterpret_cast<uint64_t*>(pIatEntry) = reinterpret_cast<uintptr_t>(pFunc);
+					}
+					else {
+						*reinterpret_cast<uint32_t*>(pIatEntry) = LOW_DWORD(pFunc);
+					}
+
+				}
+
+			}
+
+			if (pRemoteName) {
+				VirtualFreeEx(this->_hProc, pRemoteName, 0u, MEM_RELEASE);
+			}
+
+			return success;
+		}
+
+
+		HMODULE ManualMapper::getModule() const {
+
+			if (!this->_isMapped) return nullptr;
+
+			return reinterpret_cast<HMODULE>(static_cast<uintptr_t>(this->_base));
+		}
+
+
+		const BYTE* ManualMapper::getImage() const {
+
+			return this->_image.getImage();
+		}
+
+
+		uint32_t ManualMapper::getImageSize() const {
+
+			return this->_image.getImageSize();
+		}
+
+
+		const ImageProtection* ManualMapper::getProtections() const {
+
+			return this->_image.getProtections();
+		}
+
+
+		size_t ManualMapper::getProtectionCount() const {
+
+			return this->_image.getProtectionCount();
+		}
+
+
+		bool ManualMapper::is64Bit() const {
+
+			return this->_image.is64Bit();
+		}
+
+
+		void ManualMapper::reset() {
+			this->_image.reset();
+			this->_base = 0u;
+			this->_isMapped = false;
+
+			return;
+		}
+
+
+		HMODULE ManualMapper::loadModule(const char* modName, tLaunchFunc pLaunchFunc, BYTE** ppRemoteName) {
+			const HMODULE hMod = proc::ex::getModuleHandle(this->_hProc, modName);
+
+			if (hMod) return hMod;
+
+			// virtual dlls of the ApiSetSchema (e.g. api-ms-win-...dll) are never found by name but resolved to their host dll by LoadLibraryA
+			const size_t nameSize = strlen(modName) + 1u;
+
+			if (nameSize > MAX_PATH) return nullptr;
+
+			const HMODULE hKernel32 = proc::ex::getModuleHandle(this->_hProc, "kernel32.dll");
+
+			if (!hKernel32) return nullptr;
+
+			const FARPROC pLoadLibraryA = proc::ex::getProcAddress(this->_hProc, hKernel32, "LoadLibraryA");
+
+			if (!pLoadLibraryA) return nullptr;
+
+			if (!*ppRemoteName) {
+				*ppRemoteName = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, MAX_PATH, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+				if (!*ppRemoteName) return nullptr;
+			}
+
+			if (!WriteProcessMemory(this->_hProc, *ppRemoteName, modName, nameSize, nullptr)) return nullptr;
+
+			// x86 targets return four byte values
+			uint64_t hRemoteMod = 0u;
+
+			if (!pLaunchFunc(this->_hProc, reinterpret_cast<tLaunchableFunc>(pLoadLibraryA), *ppRemoteName, &hRemoteMod)) {
+				// a timed out launch might still read the name, so the buffer must not be freed
+				*ppRemoteName = nullptr;
+
+				return nullptr;
+			}
+
+			return reinterpret_cast<HMODULE>(static_cast<uintptr_t>(hRemoteMod));
+		}
+
+
+		bool ManualMapper::writeLoader(tLaunchableFunc* ppLoader, void** ppLoaderData) {
+			const uint64_t loaderRva = alignToPage(this->_image.getImageSize());
+			BYTE* const pLoader = this->_image.getImage() + loaderRva;
+			const uint64_t pLoaderEx = this->_base + loaderRva;
+			const pe::DirectoryEntry* const pTlsDir = this->_image.getDataDirectory(IMAGE_DIRECTORY_ENTRY_TLS);
+			// the callback addresses are already relocated
+			uint64_t pCallbacks = 0u;
+			const uint32_t entryRva = this->_image.getEntryRva();
+
+			if (this->_image.is64Bit()) {
+
+				if (pTlsDir && pTlsDir->VirtualAddress) {
+					const IMAGE_TLS_DIRECTORY64* const pTlsDir64 = reinterpret_cast<const IMAGE_TLS_DIRECTORY64*>(this->_image.getRvaAddress(pTlsDir->VirtualAddress, sizeof(IMAGE_TLS_DIRECTORY64)));
+
+					if (!pTlsDir64) return false;
+
+					pCallbacks = pTlsDir64->AddressOfCallBacks;
+				}
+			}
+			else {
+
+				if (pTlsDir && pTlsDir->VirtualAddress) {
+					const IMAGE_TLS_DIRECTORY32* const pTlsDir32 = reinterpret_cast<const IMAGE_TLS_DIRECTORY32*>(this->_image.getRvaAddress(pTlsDir->VirtualAddress, sizeof(IMAGE_TLS_DIRECTORY32)));
+
+					if (!pTlsDir32) return false;
+
+					pCallbacks = pTlsDir32->AddressOfCallBacks;
+				}
+			}
+
+			const uint64_t pEntry = entryRva ? this->_base + entryRva : 0u;
+
+			if (this->_image.is64Bit()) {
+
+				// x64 images only feasable for x64 compilations
+				#ifdef _WIN64
+
+				memcpy(pLoader, x64::LOADER_SHELL, sizeof(x64::LOADER_SHELL));
+
+				x64::LoaderData* const pLoaderData = reinterpret_cast<x64::LoaderData*>(pLoader + sizeof(x64::LOADER_SHELL));
+				pLoaderData->base = this->_base;
+				pLoaderData->pCallbacks = pCallbacks;
+				pLoaderData->pEntry = pEntry;
+
+				const pe::DirectoryEntry* const pExceptionDir = this->_image.getDataDirectory(IMAGE_DIRECTORY_ENTRY_EXCEPTION);
+
+				// without a registered function table exceptions thrown within the image can not be handled
+				if (pExceptionDir && pExceptionDir->VirtualAddress && pExceptionDir->Size) {
+					const HMODULE hNtdll = proc::ex::getModuleHandle(this->_hProc, "ntdll.dll");
+
+					if (!hNtdll) return false;
+
+					pLoaderData->pRtlAddFunctionTable = reinterpret_cast<uintptr_t>(proc::ex::getProcAddress(this->_hProc, hNtdll, "RtlAddFunctionTable"));
+					pLoaderData->pFunctionTable = this->_base + pExceptionDir->VirtualAddress;
+					pLoaderData->entryCount = pExceptionDir->Size / sizeof(RUNTIME_FUNCTION);
+				}
+
+				*ppLoaderData = reinterpret_cast<void*>(pLoaderEx + sizeof(x64::LOADER_SHELL));
+
+				#else
+
+				return false;
+
+				#endif // _WIN64
+
+			}
+			else {
+				memcpy(pLoader, x86::LOADER_SHELL, sizeof(x86::LOADER_SHELL));
+
+				x86::LoaderData* const pLoaderData = reinterpret_cast<x86::LoaderData*>(pLoader + sizeof(x86::LOADER_SHELL));
+				pLoaderData->base = static_cast<uint32_t>(this->_base);
+				pLoaderData->pCallbacks = static_cast<uint32_t>(pCallbacks);
+				pLoaderData->pEntry = static_cast<uint32_t>(pEntry);
+
+				*ppLoaderData = reinterpret_cast<void*>(static_cast<uintptr_t>(pLoaderEx + sizeof(x86::LOADER_SHELL)));
+			}
+
+			*ppLoader = reinterpret_cast<tLaunchableFunc>(static_cast<uintptr_t>(pLoaderEx));
+
+			return true;
+		}
+
+
+		bool ManualMapper::commit() {
+			BYTE* const pBaseEx = reinterpret_cast<BYTE*>(static_cast<uintptr_t>(this->_base));
+
+			// the image and the loader shell code are written at once
+			if (!WriteProcessMemory(this->_hProc, pBaseEx, this->_image.getImage(), this->_image.getSize(), nullptr)) return false;
+
+			const ImageProtection* const pProtections = this->_image.getProtections();
+			DWORD oldProtect = 0ul;
+
+			for (size_t i = 0u; i < this->_image.getProtectionCount(); i++) {
+				const ImageProtection* const pCurProtection = &pProtections[i];
+
+				// the memory is allocated as read-write
+				if (pCurProtection->protect == PAGE_READWRITE) continue;
+
+				if (!VirtualProtectEx(this->_hProc, pBaseEx + pCurProtection->rva, pCurProtection->size, pCurProtection->protect, &oldProtect)) return false;
+			}
+
+			return VirtualProtectEx(this->_hProc, pBaseEx + alignToPage(this->_image.getImageSize()), IMAGE_PAGE_SIZE, PAGE_EXECUTE_READ, &oldProtect);
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+#include "launch.h"
+#include "peImage.h"
+#include <stdint.h>
+
+// Class to load a DLL into an external target process by mapping it manually instead of calling LoadLibrary within the target.
+// The image is prepared completely in a local buffer: the sections are laid out, the base relocations are applied, the imports are resolved and the protections of the pages are determined.
+// Laying out the sections, applying the relocations and determining the protections is done by the PeImage class (see peImage.h), which does not depend on windows headers.
+// The prepared image is committed to the target with one VirtualAllocEx call, one WriteProcessMemory call and one VirtualProtectEx call per run of pages with equal protection.
+// TLS callbacks and DllMain are executed via any of the launch functions.
+// Dependencies of the image that are not loaded by the target are loaded via LoadLibraryA within the target.
+// Static TLS data (__declspec(thread) variables) of the image is not supported.
+// x64 compilations of the class can map x64 and x86 images. x86 compilations of the class can only map x86 images.
+
+namespace hax {
+
+	namespace launch {
+
+		class ManualMapper {
+		private:
+			const HANDLE _hProc;
+			// local buffer of the image followed by a page for the loader shell code
+			PeImage _image;
+			uint64_t _base;
+			bool _isMapped;
+
+		public:
+			// Initializes members. Call map() to map an image.
+			//
+			// Parameters:
+			//
+			// [in] hProc:
+			// Handle to the process into which the image should be mapped.
+			// Needs at least PROCESS_QUERY_LIMITED_INFORMATION, PROCESS_VM_OPERATION, PROCESS_VM_WRITE, and PROCESS_VM_READ access rights
+			// plus the access rights needed by the launch function passed to map().
+			ManualMapper(HANDLE hProc);
+
+			// Frees the local buffers. The mapped image stays in the target.
+			~ManualMapper();
+
+			// owns the local image buffers, so copies would free them twice
+			ManualMapper(const ManualMapper&) = delete;
+			ManualMapper& operator=(const ManualMapper&) = delete;
+
+			// Maps an image into the target process and executes its TLS callbacks and DllMain with DLL_PROCESS_ATTACH.
+			// If DllMain returns FALSE the image is unmapped again.
+			//
+			// Parameters:
+			//
+			// [in] pFile:
+			// Pointer to the raw bytes of the DLL file (eg. loaded by FileLoader).
+			//
+			// [in] fileSize:
+			// Size of the DLL file in bytes.
+			//
+			// [in] pLaunchFunc:
+			// Launch function that is used to execute the loader shell code and to load missing dependencies within the target process.
+			//
+			// Return:
+			// True on success or false on failure, if the architecture of the image does not match the target or if the architecture of the target can not be determined.
+			bool map(const BYTE* pFile, size_t fileSize, tLaunchFunc pLaunchFunc);
+
+			// Copies the headers and sections of a DLL file to their virtual offsets within a local buffer and determines the protections of the pages.
+			// Does not call any API functions.
+			//
+			// Parameters:
+			//
+			// [in] pFile:
+			// Pointer to the raw bytes of the DLL file.
+			//
+			// [in] fileSize:
+			// Size of the DLL file in bytes.
+			//
+			// Return:
+			// True on success or false on failure or if the file is not a valid DLL.
+			bool layout(const BYTE* pFile, size_t fileSize);
+
+			// Applies the base relocations of the laid out image for a base address.
+			// Does not call any API functions.
+			//
+			// Parameters:
+			//
+			// [in] base:
+			// Base address the image is relocated to.
+			//
+			// Return:
+			// True on success or false on failure or if the image can not be relocated to the base address.
+			bool relocate(uint64_t base);
+
+			// Writes the addresses of the functions imported by the laid out image within the target process to the import address table.
+			// Dependencies that are not loaded by the target process are loaded via LoadLibraryA within the target.
+			//
+			// Parameters:
+			//
+			// [in] pLaunchFunc:
+			// Launch function that is used to call LoadLibraryA within the target process.
+			//
+			// Return:
+			// True on success or false on failure.
+			bool resolveImports(tLaunchFunc pLaunchFunc);
+
+			// Gets a handle to the mapped image within the target process.
+			//
+			// Return:
+			// Base address of the image within the target process or nullptr if no image is mapped.
+			HMODULE getModule() const;
+
+			// Gets the local buffer of the image.
+			//
+			// Return:
+			// Pointer to the local buffer or nullptr if no image is laid out.
+			const BYTE* getImage() const;
+			uint32_t getImageSize() const;
+
+			// Gets the protections of the laid out image. Adjacent pages with equal protection are combined to one range.
+			//
+			// Return:
+			// Pointer to an array of getProtectionCount() protections ordered by their offset.
+			const ImageProtection* getProtections() const;
+			size_t getProtectionCount() const;
+
+			bool is64Bit() const;
+
+		private:
+			void reset();
+			HMODULE loadModule(const char* modName, tLaunchFunc pLaunchFunc, BYTE** ppRemoteName);
+			bool writeLoader(tLaunchableFunc* ppLoader, void** ppLoaderData);
+			bool commit();
+		};
+
+	}
+
+}
\ No newline at end of file
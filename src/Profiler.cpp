@@ -0,0 +1,304 @@
+#include "Profiler.h"
+#include "TraceSink.h"
+#include <intrin.h>
+
+namespace hax {
+
+	// A meassurement as written by the thread. Converted to a ProfileRecord when the frame ends.
+	typedef struct ProfileEvent {
+		uint64_t start;
+		uint64_t end;
+		uint16_t zone;
+		uint16_t depth;
+	}ProfileEvent;
+
+	// Ring written by its thread and read by the thread ending the frames.
+	// The writer only advances head and the reader only advances tail. Both are volatile, so the event is written before head is advanced.
+	struct Profiler::ThreadBuffer {
+		ProfileEvent* events;
+		// capacity - 1, the capacity is a power of two
+		size_t mask;
+		volatile size_t head;
+		volatile size_t tail;
+		volatile size_t dropped;
+		// dropped meassurements already counted by the reader
+		size_t droppedRead;
+		// only accessed by the thread
+		uint16_t depth;
+		uint32_t index;
+		DWORD threadId;
+		ThreadBuffer* pNext;
+	};
+
+	// states of the zone variable of a HAX_PROFILE_SCOPE declaration besides the index of the zone
+	// the zone is registered by another thread
+	constexpr LONG ZONE_PENDING = 0x10000l;
+	// the name table was full
+	constexpr LONG ZONE_UNAVAILABLE = 0x10001l;
+
+	// rounds up to the next power of two
+	static size_t roundUpToPowerOfTwo(size_t value);
+
+	Profiler::Profiler(size_t frameCount, size_t threadCapacity) :
+		_names{}, _zoneReserved{}, _zoneCount{}, _tlsIndex{ TlsAlloc() }, _pBuffers{}, _threadCount{}, _threadCapacity{ roundUpToPowerOfTwo(threadCapacity) },
+		_pFrames{ new ProfileFrame[frameCount ? frameCount : 1u]{} }, _frameCount{ frameCount ? frameCount : 1u }, _frameIndex{}, _completed{}, _frameStart{}, _dropped{}, _pSink{}
+	{
+
+		for (size_t i = 0u; i < this->_frameCount; i++) {
+			this->_pFrames[i].records = new ProfileRecord[PROFILER_MAX_RECORDS]{};
+		}
+
+	}
+
+
+	Profiler::~Profiler() {
+
+		if (this->_tlsIndex != TLS_OUT_OF_INDEXES) {
+			TlsFree(this->_tlsIndex);
+		}
+
+		ThreadBuffer* pBuffer = this->_pBuffers;
+
+		while (pBuffer) {
+			ThreadBuffer* const pNext = pBuffer->pNext;
+			delete[] pBuffer->events;
+			delete pBuffer;
+			pBuffer = pNext;
+		}
+
+		for (size_t i = 0u; i < this->_frameCount; i++) {
+			delete[] this->_pFrames[i].records;
+		}
+
+		delete[] this->_pFrames;
+	}
+
+
+	uint16_t Profiler::addZone(const char* name) {
+
+		// checked before reserving, so calls on a full table do not keep counting up
+		if (this->_zoneReserved >= PROFILER_MAX_ZONES) return PROFILER_INVALID_ZONE;
+
+		const LONG index = InterlockedIncrement(&this->_zoneReserved) - 1;
+
+		if (index >= PROFILER_MAX_ZONES) return PROFILER_INVALID_ZONE;
+
+		this->_names[index] = name;
+
+		// publish the zones in the order of their indices, so the count never covers a zone whose name is not written yet
+		while (InterlockedCompareExchange(&this->_zoneCount, index + 1, index) != index) {
+			YieldProcessor();
+		}
+
+		return static_cast<uint16_t>(index);
+	}
+
+
+	uint16_t Profiler::resolveZone(volatile LONG* pZone, const char* name) {
+		LONG zone = *pZone;
+
+		// the first thread executing the declaration registers the zone, other threads wait for it
+		while (zone == PROFILER_INVALID_ZONE || zone == ZONE_PENDING) {
+
+			if (zone == PROFILER_INVALID_ZONE && InterlockedCompareExchange(pZone, ZONE_PENDING, PROFILER_INVALID_ZONE) == PROFILER_INVALID_ZONE) {
+				const uint16_t index = this->addZone(name);
+				InterlockedExchange(pZone, index == PROFILER_INVALID_ZONE ? ZONE_UNAVAILABLE : static_cast<LONG>(index));
+
+				return index;
+			}
+
+			YieldProcessor();
+			zone = *pZone;
+		}
+
+		if (zone == ZONE_UNAVAILABLE) return PROFILER_INVALID_ZONE;
+
+		return static_cast<uint16_t>(zone);
+	}
+
+
+	const char* Profiler::getZoneName(uint16_t zone) const {
+
+		if (zone >= this->getZoneCount()) return nullptr;
+
+		return this->_names[zone];
+	}
+
+
+	uint16_t Profiler::getZoneCount() const {
+		const LONG count = this->_zoneCount;
+
+		return static_cast<uint16_t>(count < PROFILER_MAX_ZONES ? count : PROFILER_MAX_ZONES);
+	}
+
+
+	void Profiler::beginFrame() {
+		this->_frameStart = __rdtsc();
+
+		return;
+	}
+
+
+	void Profiler::endFrame() {
+		const uint64_t end = __rdtsc();
+		ProfileFrame* const pFrame = &this->_pFrames[this->_frameIndex];
+
+		// frames without a call to beginFrame() start at the end of the previous frame
+		pFrame->start = this->_frameStart ? this->_frameStart : end;
+		pFrame->duration = end - pFrame->start;
+		pFrame->count = 0u;
+		pFrame->dropped = 0u;
+
+		for (ThreadBuffer* pBuffer = this->_pBuffers; pBuffer; pBuffer = pBuffer->pNext) {
+			const size_t head = pBuffer->head;
+
+			for (size_t i = pBuffer->tail; i != head; i++) {
+				const ProfileEvent* const pEvent = &pBuffer->events[i & pBuffer->mask];
+
+				if (this->_pSink) {
+					this->_pSink->push(this->getZoneName(pEvent->zone), pEvent->start, pEvent->end - pEvent->start, pBuffer->threadId);
+				}
+
+				if (pFrame->count >= PROFILER_MAX_RECORDS) {
+					pFrame->dropped++;
+
+					continue;
+				}
+
+				ProfileRecord* const pRecord = &pFrame->records[pFrame->count];
+				pRecord->start = pEvent->start;
+				pRecord->duration = pEvent->end - pEvent->start;
+				pRecord->zone = pEvent->zone;
+				pRecord->depth = pEvent->depth;
+				pRecord->thread = pBuffer->index;
+				pFrame->count++;
+			}
+
+			// releases the slots to the thread
+			pBuffer->tail = head;
+
+			const size_t dropped = pBuffer->dropped;
+			pFrame->dropped += dropped - pBuffer->droppedRead;
+			pBuffer->droppedRead = dropped;
+		}
+
+		if (this->_pSink) {
+			this->_pSink->push("frame", pFrame->start, pFrame->duration, GetCurrentThreadId());
+		}
+
+		this->_dropped += pFrame->dropped;
+		this->_frameStart = end;
+		this->_frameIndex = (this->_frameIndex + 1u) % this->_frameCount;
+
+		if (this->_completed < this->_frameCount) {
+			this->_completed++;
+		}
+
+		return;
+	}
+
+
+	const ProfileFrame* Profiler::getFrame(size_t age) const {
+
+		if (age >= this->_completed) return nullptr;
+
+		return &this->_pFrames[(this->_frameIndex + this->_frameCount - 1u - age) % this->_frameCount];
+	}
+
+
+	size_t Profiler::getFrameCount() const {
+
+		return this->_completed;
+	}
+
+
+	size_t Profiler::getDropped() const {
+
+		return this->_dropped;
+	}
+
+
+	void Profiler::setTraceSink(TraceSink* pSink) {
+		this->_pSink = pSink;
+
+		return;
+	}
+
+
+	Profiler::ThreadBuffer* Profiler::getThreadBuffer() {
+
+		if (this->_tlsIndex == TLS_OUT_OF_INDEXES) return nullptr;
+
+		ThreadBuffer* pBuffer = static_cast<ThreadBuffer*>(TlsGetValue(this->_tlsIndex));
+
+		if (pBuffer) return pBuffer;
+
+		pBuffer = new ThreadBuffer{};
+		pBuffer->events = new ProfileEvent[this->_threadCapacity]{};
+		pBuffer->mask = this->_threadCapacity - 1u;
+		pBuffer->index = static_cast<uint32_t>(InterlockedIncrement(&this->_threadCount) - 1);
+		pBuffer->threadId = GetCurrentThreadId();
+
+		// lock free push to the front of the list, the reader only walks from the front
+		ThreadBuffer* pHead = nullptr;
+
+		do {
+			pHead = this->_pBuffers;
+			pBuffer->pNext = pHead;
+		} while (InterlockedCompareExchangePointer(reinterpret_cast<void* volatile*>(&this->_pBuffers), pBuffer, pHead) != pHead);
+
+		TlsSetValue(this->_tlsIndex, pBuffer);
+
+		return pBuffer;
+	}
+
+
+	ProfileScope::ProfileScope(Profiler* pProfiler, uint16_t zone) : _pBuffer{ pProfiler->getThreadBuffer() }, _zone{ zone }, _depth{}, _start{} {
+
+		if (!this->_pBuffer) return;
+
+		this->_depth = this->_pBuffer->depth;
+		this->_pBuffer->depth++;
+		this->_start = __rdtsc();
+	}
+
+
+	ProfileScope::~ProfileScope() {
+		const uint64_t end = __rdtsc();
+
+		if (!this->_pBuffer) return;
+
+		this->_pBuffer->depth--;
+
+		if (this->_zone == PROFILER_INVALID_ZONE) return;
+
+		const size_t head = this->_pBuffer->head;
+
+		if (head - this->_pBuffer->tail > this->_pBuffer->mask) {
+			this->_pBuffer->dropped++;
+
+			return;
+		}
+
+		ProfileEvent* const pEvent = &this->_pBuffer->events[head & this->_pBuffer->mask];
+		pEvent->start = this->_start;
+		pEvent->end = end;
+		pEvent->zone = this->_zone;
+		pEvent->depth = this->_depth;
+
+		// publishes the event to the reader
+		this->_pBuffer->head = head + 1u;
+	}
+
+
+	static size_t roundUpToPowerOfTwo(size_t value) {
+		size_t result = 1u;
+
+		while (result < value) {
+			result <<= 1;
+		}
+
+		return result;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+// Classes to profile nested scopes of code within the frames of a graphics API hook.
+// A zone is a named scope that is registered once in a fixed size name table of the profiler. A ProfileScope object meassures the zone it is declared in until it goes out of scope.
+// Every thread that enters a zone gets a ring buffer of its own on its first meassurement. The ring is written by the thread only and read by the thread ending the frame,
+// so recording takes no locks and does not allocate. If a ring is full the meassurement is dropped and counted instead of blocking the thread.
+// When a frame ends the meassurements of all threads are moved to the record of the frame. The records of the last frames are kept for drawing, eg. with draw::Engine::drawProfilerFlame.
+// Times are raw time stamp counter ticks. Bench::getTicksPerSecond converts them to seconds.
+// The thread buffers are allocated via TlsAlloc instead of thread_local, so the profiler also works in manually mapped modules.
+// Thread buffers are kept until the destruction of the profiler, even if their threads have exited.
+// The meassurements and frames can additionally be forwarded to a TraceSink when the frames end.
+
+// Declares a ProfileScope for the rest of the enclosing scope. The zone is registered on the first execution of the declaration.
+// The index of the zone is kept in a constant initialized static, so the declaration does not rely on the thread safe initialization of local statics,
+// which uses thread local storage that is not set up in manually mapped modules.
+// Example:
+// void hkPresent() {
+// 	HAX_PROFILE_SCOPE(&profiler, "present");
+// 	...
+// }
+#define HAX_PROFILE_MERGE_IMPL(a, b) a##b
+#define HAX_PROFILE_MERGE(a, b) HAX_PROFILE_MERGE_IMPL(a, b)
+#define HAX_PROFILE_SCOPE(pProfiler, name) \
+	static volatile LONG HAX_PROFILE_MERGE(_profileZone, __LINE__) = hax::PROFILER_INVALID_ZONE; \
+	hax::ProfileScope HAX_PROFILE_MERGE(_profileScope, __LINE__)((pProfiler), (pProfiler)->resolveZone(&HAX_PROFILE_MERGE(_profileZone, __LINE__), name))
+
+namespace hax {
+
+	class TraceSink;
+
+	// maximum number of zones of a profiler
+	constexpr uint16_t PROFILER_MAX_ZONES = 0x40u;
+	// maximum number of meassurements stored per frame
+	constexpr size_t PROFILER_MAX_RECORDS = 0x200u;
+	constexpr uint16_t PROFILER_INVALID_ZONE = 0xFFFFu;
+
+	// A single meassurement of a zone.
+	typedef struct ProfileRecord {
+		// time stamp counter at the beginning of the zone
+		uint64_t start;
+		// duration in ticks
+		uint64_t duration;
+		uint16_t zone;
+		// number of zones the zone is nested in on the same thread
+		uint16_t depth;
+		// index of the thread buffer in order of the first meassurement of each thread
+		uint32_t thread;
+	}ProfileRecord;
+
+	typedef struct ProfileFrame {
+		// time stamp counter at the beginning of the frame
+		uint64_t start;
+		// duration in ticks
+		uint64_t duration;
+		// meassurements that ended since the previous frame in order of their end per thread
+		ProfileRecord* records;
+		size_t count;
+		// meassurements that were dropped because a thread buffer or the records of the frame were full
+		size_t dropped;
+	}ProfileFrame;
+
+	class Profiler {
+	private:
+		friend class ProfileScope;
+
+		struct ThreadBuffer;
+
+		const char* _names[PROFILER_MAX_ZONES];
+		// zones whose index is handed out, the count only covers the zones whose name is written
+		volatile LONG _zoneReserved;
+		volatile LONG _zoneCount;
+		const DWORD _tlsIndex;
+		// threads buffers in reverse order of their creation
+		ThreadBuffer* volatile _pBuffers;
+		volatile LONG _threadCount;
+		const size_t _threadCapacity;
+		ProfileFrame* const _pFrames;
+		const size_t _frameCount;
+		// index of the frame that gets written by the next call to endFrame()
+		size_t _frameIndex;
+		size_t _completed;
+		uint64_t _frameStart;
+		size_t _dropped;
+		TraceSink* _pSink;
+
+	public:
+		// Initializes members and allocates the frame records.
+		//
+		// Parameters:
+		//
+		// [in] frameCount:
+		// Number of completed frames that are kept.
+		//
+		// [in] threadCapacity:
+		// Number of meassurements a thread can record between two ends of a frame. Gets rounded up to a power of two.
+		Profiler(size_t frameCount = 0x10u, size_t threadCapacity = 0x400u);
+
+		~Profiler();
+
+		// Registers a zone in the name table. Thread safe.
+		//
+		// Parameters:
+		//
+		// [in] name:
+		// Name of the zone. Is not copied, so it has to be valid for the lifetime of the profiler (eg. a string literal).
+		//
+		// Return:
+		// Index of the zone or PROFILER_INVALID_ZONE if the table is full.
+		uint16_t addZone(const char* name);
+
+		// Gets the zone of a declaration and registers it on the first call. Used by the HAX_PROFILE_SCOPE macro. Thread safe.
+		//
+		// Parameters:
+		//
+		// [in, out] pZone:
+		// Static variable of the declaration initialized to PROFILER_INVALID_ZONE. Receives the index of the zone.
+		//
+		// [in] name:
+		// Name of the zone. See addZone.
+		//
+		// Return:
+		// Index of the zone or PROFILER_INVALID_ZONE if the table is full.
+		uint16_t resolveZone(volatile LONG* pZone, const char* name);
+
+		// Gets the name of a zone.
+		//
+		// Parameters:
+		//
+		// [in] zone:
+		// Index of the zone.
+		//
+		// Return:
+		// Name of the zone or nullptr if the zone is not registered.
+		const char* getZoneName(uint16_t zone) const;
+
+		uint16_t getZoneCount() const;
+
+		// Starts a frame. Has to be called by the thread that ends the frame, eg. at the beginning of a present hook.
+		void beginFrame();
+
+		// Ends a frame and moves the meassurements of all threads to the records of the frame. Has to be called by the thread that started the frame.
+		void endFrame();
+
+		// Gets a completed frame. Has to be called by the thread that ends the frames.
+		//
+		// Parameters:
+		//
+		// [in] age:
+		// Number of frames completed after the requested frame. Pass 0 for the latest frame.
+		//
+		// Return:
+		// The frame or nullptr if the frame is not kept anymore or has not been completed yet.
+		const ProfileFrame* getFrame(size_t age) const;
+
+		// Gets the number of completed frames currently kept.
+		size_t getFrameCount() const;
+
+		// Gets the number of meassurements dropped since construction.
+		size_t getDropped() const;
+
+		// Forwards all meassurements and every frame as an event named "frame" to a trace sink when a frame ends, including meassurements that do not fit into the frame record.
+		//
+		// Parameters:
+		//
+		// [in] pSink:
+		// Sink the meassurements are pushed to. Pass nullptr to stop forwarding.
+		void setTraceSink(TraceSink* pSink);
+
+	private:
+		// gets the buffer of the calling thread and allocates it on the first call of the thread
+		ThreadBuffer* getThreadBuffer();
+	};
+
+	// Meassures a zone of a profiler from construction until destruction. Usually declared via the HAX_PROFILE_SCOPE macro.
+	class ProfileScope {
+	private:
+		Profiler::ThreadBuffer* const _pBuffer;
+		const uint16_t _zone;
+		uint16_t _depth;
+		uint64_t _start;
+
+	public:
+		// Starts the meassurement.
+		//
+		// Parameters:
+		//
+		// [in] pProfiler:
+		// Profiler the meassurement is recorded by.
+		//
+		// [in] zone:
+		// Index of the zone returned by Profiler::addZone.
+		ProfileScope(Profiler* pProfiler, uint16_t zone);
+
+		// Ends the meassurement and records it in the buffer of the calling thread.
+		~ProfileScope();
+	};
+
+}
\ No newline at end of file
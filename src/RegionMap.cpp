@@ -0,0 +1,248 @@
+#include "RegionMap.h"
+#include <stdint.h>
+
+namespace hax {
+
+	namespace mem {
+
+		static_assert(REGION_STATE_FREE == MEM_FREE, "Free region state mismatch.");
+
+		static void appendRegion(Region** ppRegions, size_t* pCount, size_t* pCapacity, const MEMORY_BASIC_INFORMATION* pMbi);
+
+		RegionMap::RegionMap(HANDLE hProc) : _hProc{ hProc }, _pRegions{}, _count{}, _capacity{} {}
+
+
+		RegionMap::~RegionMap() {
+
+			if (this->_pRegions) {
+				delete[] this->_pRegions;
+			}
+
+		}
+
+
+		bool RegionMap::refresh() {
+			this->_count = 0u;
+
+			MEMORY_BASIC_INFORMATION mbi{};
+			const BYTE* address = nullptr;
+
+			// VirtualQueryEx fails above the highest user mode address
+			while (VirtualQueryEx(this->_hProc, address, &mbi, sizeof(mbi))) {
+
+				appendRegion(&this->_pRegions, &this->_count, &this->_capacity, &mbi);
+
+				const BYTE* const nextAddress = static_cast<const BYTE*>(mbi.BaseAddress) + mbi.RegionSize;
+
+				// checks for wrap around
+				if (nextAddress <= address) break;
+
+				address = nextAddress;
+			}
+
+			return this->_count != 0u;
+		}
+
+
+		bool RegionMap::refresh(const BYTE* base, size_t size) {
+
+			if (!this->_count) return this->refresh();
+
+			const Region* const pFirst = this->first(REGION_ANY, base);
+
+			if (!pFirst) return this->refresh();
+
+			const uintptr_t end = reinterpret_cast<uintptr_t>(base) + size;
+			const size_t firstIndex = pFirst - this->_pRegions;
+
+			Region* pNewRegions = nullptr;
+			size_t newCount = 0u;
+			size_t newCapacity = 0u;
+
+			MEMORY_BASIC_INFORMATION mbi{};
+			const BYTE* address = pFirst->base;
+			size_t resumeIndex = this->_count;
+
+			while (VirtualQueryEx(this->_hProc, address, &mbi, sizeof(mbi))) {
+
+				appendRegion(&pNewRegions, &newCount, &newCapacity, &mbi);
+
+				const BYTE* const nextAddress = static_cast<const BYTE*>(mbi.BaseAddress) + mbi.RegionSize;
+
+				if (nextAddress <= address) break;
+
+				address = nextAddress;
+
+				if (reinterpret_cast<uintptr_t>(address) < end) continue;
+
+				// the old regions can only be kept from a region boundary on that is the same in the old snapshot
+				const Region* const pOld = this->find(address);
+
+				if (!pOld) break;
+
+				if (pOld->base == address) {
+					resumeIndex = pOld - this->_pRegions;
+
+					break;
+				}
+
+			}
+
+			if (!newCount) {
+				delete[] pNewRegions;
+
+				return false;
+			}
+
+			// splice the new regions in place of the old regions [firstIndex, resumeIndex)
+			const size_t tailCount = this->_count - resumeIndex;
+			const size_t totalCount = firstIndex + newCount + tailCount;
+
+			if (totalCount > this->_capacity) {
+				Region* const pGrown = new Region[totalCount];
+				memcpy(pGrown, this->_pRegions, firstIndex * sizeof(Region));
+				memcpy(pGrown + firstIndex + newCount, this->_pRegions + resumeIndex, tailCount * sizeof(Region));
+				delete[] this->_pRegions;
+				this->_pRegions = pGrown;
+				this->_capacity = totalCount;
+			}
+			else {
+				memmove(this->_pRegions + firstIndex + newCount, this->_pRegions + resumeIndex, tailCount * sizeof(Region));
+			}
+
+			memcpy(this->_pRegions + firstIndex, pNewRegions, newCount * sizeof(Region));
+			this->_count = totalCount;
+
+			delete[] pNewRegions;
+
+			return true;
+		}
+
+
+		const Region* RegionMap::find(const BYTE* address) const {
+			const Region* const pRegion = this->first(REGION_ANY, address);
+
+			if (!pRegion || pRegion->base > address) return nullptr;
+
+			return pRegion;
+		}
+
+
+		const Region* RegionMap::first(DWORD filter, const BYTE* address) const {
+			size_t low = 0u;
+			size_t high = this->_count;
+
+			// binary search for the first region that ends after the address
+			while (low < high) {
+				const size_t mid = low + (high - low) / 2u;
+				const Region* const pMid = &this->_pRegions[mid];
+
+				if (reinterpret_cast<uintptr_t>(pMid->base) + pMid->size <= reinterpret_cast<uintptr_t>(address)) {
+					low = mid + 1u;
+				}
+				else {
+					high = mid;
+				}
+
+			}
+
+			if (low >= this->_count) return nullptr;
+
+			const Region* const pRegion = &this->_pRegions[low];
+
+			if (matches(pRegion, filter)) return pRegion;
+
+			return this->next(pRegion, filter);
+		}
+
+
+		const Region* RegionMap::next(const Region* pCur, DWORD filter) const {
+			const Region* const pEnd = this->_pRegions + this->_count;
+
+			for (const Region* pRegion = pCur + 1; pRegion < pEnd; pRegion++) {
+
+				if (matches(pRegion, filter)) return pRegion;
+
+			}
+
+			return nullptr;
+		}
+
+
+		bool RegionMap::matches(const Region* pRegion, DWORD filter) {
+			const bool committed = pRegion->state == MEM_COMMIT;
+
+			if ((filter & REGION_COMMITTED) && !committed) return false;
+
+			if ((filter & REGION_FREE) && pRegion->state != MEM_FREE) return false;
+
+			if ((filter & REGION_IMAGE) && pRegion->type != MEM_IMAGE) return false;
+
+			if (filter & REGION_READABLE) {
+				constexpr DWORD READABLE = PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+
+				if (!committed || !(pRegion->protect & READABLE) || (pRegion->protect & PAGE_GUARD)) return false;
+
+			}
+
+			if (filter & REGION_EXECUTABLE) {
+				constexpr DWORD EXECUTABLE = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+
+				if (!committed || !(pRegion->protect & EXECUTABLE)) return false;
+
+			}
+
+			return true;
+		}
+
+
+		HANDLE RegionMap::getProcessHandle() const {
+
+			return this->_hProc;
+		}
+
+
+		const Region* RegionMap::getRegions() const {
+
+			return this->_pRegions;
+		}
+
+
+		size_t RegionMap::getCount() const {
+
+			return this->_count;
+		}
+
+
+		static void appendRegion(Region** ppRegions, size_t* pCount, size_t* pCapacity, const MEMORY_BASIC_INFORMATION* pMbi) {
+
+			if (*pCount >= *pCapacity) {
+				const size_t newCapacity = *pCapacity ? *pCapacity * 2u : 0x100u;
+				Region* const pGrown = new Region[newCapacity];
+
+				if (*ppRegions) {
+					memcpy(pGrown, *ppRegions, *pCount * sizeof(Region));
+					delete[] *ppRegions;
+				}
+
+				*ppRegions = pGrown;
+				*pCapacity = newCapacity;
+			}
+
+			Region* const pRegion = &(*ppRegions)[*pCount];
+			pRegion->base = static_cast<BYTE*>(pMbi->BaseAddress);
+			pRegion->size = pMbi->RegionSize;
+			pRegion->state = pMbi->State;
+			pRegion->protect = pMbi->Protect;
+			pRegion->type = pMbi->Type;
+			// the allocation base of an image backed region is the base address of the module
+			pRegion->hModule = pMbi->Type == MEM_IMAGE ? pMbi->AllocationBase : nullptr;
+
+			(*pCount)++;
+
+			return;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+#include "regionSearch.h"
+#include <Windows.h>
+
+// Class to take a snapshot of the memory regions of a process.
+// Enumerates the virtual address space once via VirtualQueryEx so multiple scanning and allocation operations can share one enumeration instead of querying from scratch.
+// Works for the caller process (pass GetCurrentProcess()) as well as for external processes.
+// Compiled to x64 the class works both on x64 and x86 targets. Compiled to x86 it only works on x86 targets.
+
+namespace hax {
+
+	namespace mem {
+
+		// Filter flags for the iteration over regions. Can be combined. A region has to fulfill all set flags.
+		constexpr DWORD REGION_ANY = 0ul;
+		// State is MEM_COMMIT.
+		constexpr DWORD REGION_COMMITTED = 1ul << 0;
+		// Committed and readable without changing the protection.
+		constexpr DWORD REGION_READABLE = 1ul << 1;
+		// Committed and executable.
+		constexpr DWORD REGION_EXECUTABLE = 1ul << 2;
+		// Type is MEM_IMAGE.
+		constexpr DWORD REGION_IMAGE = 1ul << 3;
+		// State is MEM_FREE.
+		constexpr DWORD REGION_FREE = 1ul << 4;
+
+		class RegionMap {
+		private:
+			const HANDLE _hProc;
+			Region* _pRegions;
+			size_t _count;
+			size_t _capacity;
+
+		public:
+			// Initializes members. Call refresh() to take the snapshot.
+			//
+			// Parameters:
+			//
+			// [in] hProc:
+			// Handle to the process which memory regions should be enumerated. Pass GetCurrentProcess() for the caller process.
+			// Needs at least PROCESS_QUERY_INFORMATION access rights.
+			RegionMap(HANDLE hProc);
+
+			// owns the region array, so copies would free it twice
+			RegionMap(const RegionMap&) = delete;
+			RegionMap& operator=(const RegionMap&) = delete;
+
+			~RegionMap();
+
+			// Enumerates all memory regions of the process from scratch.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool refresh();
+
+			// Enumerates the memory regions overlapping an address range again and updates the snapshot accordingly.
+			// Should be called after allocating, freeing or protecting memory within the range.
+			//
+			// Parameters:
+			//
+			// [in] base:
+			// Start address of the range.
+			//
+			// [in] size:
+			// Size of the range in bytes.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool refresh(const BYTE* base, size_t size);
+
+			// Finds the region containing an address via binary search.
+			//
+			// Parameters:
+			//
+			// [in] address:
+			// Address that should be looked up.
+			//
+			// Return:
+			// Pointer to the region containing the address or nullptr if the address is not within the snapshot.
+			const Region* find(const BYTE* address) const;
+
+			// Gets the first region fulfilling a filter that ends after an address.
+			//
+			// Parameters:
+			//
+			// [in] filter:
+			// Combination of the REGION_* filter flags.
+			//
+			// [in] address:
+			// Address from which the iteration should start. The returned region may start before but ends after this address.
+			//
+			// Return:
+			// Pointer to the first region fulfilling the filter or nullptr if there is none.
+			const Region* first(DWORD filter, const BYTE* address = nullptr) const;
+
+			// Gets the next region fulfilling a filter.
+			// Example: for (const Region* pCur = map.first(REGION_READABLE); pCur; pCur = map.next(pCur, REGION_READABLE))
+			//
+			// Parameters:
+			//
+			// [in] pCur:
+			// Current region returned by first() or next().
+			//
+			// [in] filter:
+			// Combination of the REGION_* filter flags.
+			//
+			// Return:
+			// Pointer to the next region fulfilling the filter or nullptr if there is none.
+			const Region* next(const Region* pCur, DWORD filter) const;
+
+			// Checks if a region fulfills a filter.
+			//
+			// Parameters:
+			//
+			// [in] pRegion:
+			// Region that should be checked.
+			//
+			// [in] filter:
+			// Combination of the REGION_* filter flags.
+			//
+			// Return:
+			// True if the region fulfills all flags of the filter, false if it does not.
+			static bool matches(const Region* pRegion, DWORD filter);
+
+			HANDLE getProcessHandle() const;
+			const Region* getRegions() const;
+			size_t getCount() const;
+		};
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,466 @@
+#include "RemotePool.h"
+#include "mem.h"
+#include <stdint.h>
+
+namespace hax {
+
+	namespace mem {
+		// alignment and granularity of the blocks
+		constexpr size_t BLOCK_ALIGNMENT = 0x10u;
+		// allocation granularity of windows, arenas smaller than this would waste the rest of the reserved address space
+		constexpr size_t ARENA_GRANULARITY = 0x10000u;
+		// slightly less than the reach of a relative jump, so a block is reachable from anywhere within the page of the near address
+		constexpr uintptr_t NEAR_REACH = 0x7FFF0000u;
+
+		// range within an arena
+		typedef struct PoolRange {
+			size_t offset;
+			size_t size;
+			PoolRange* pNext;
+		}PoolRange;
+
+		struct RemotePool::Arena {
+			BYTE* base;
+			size_t size;
+			// free ranges ordered by offset, adjacent ranges are merged
+			PoolRange* pFree;
+			// blocks handed out
+			PoolRange* pUsed;
+			size_t blockCount;
+			// caves are part of a module and are neither allocated nor released by the pool
+			bool isCave;
+			// padding of the cave and protection of its pages before it was added
+			BYTE fill;
+			DWORD oldProtect;
+			Arena* pNext;
+		};
+
+		static size_t alignUp(size_t value, size_t alignment);
+		static void deleteRanges(PoolRange* pRange);
+
+		RemotePool::RemotePool(HANDLE hProc, size_t arenaSize) :
+			_hProc{ hProc }, _processId{ GetProcessId(hProc) }, _arenaSize{ alignUp(arenaSize ? arenaSize : ARENA_GRANULARITY, ARENA_GRANULARITY) }, _pArenas{}, _stats{},
+			_lock{ SRWLOCK_INIT }, _isWow64{}
+		{
+			BOOL isWow64 = FALSE;
+			IsWow64Process(this->_hProc, &isWow64);
+			this->_isWow64 = isWow64 == TRUE;
+		}
+
+
+		RemotePool::~RemotePool() {
+
+			while (this->_pArenas) {
+				this->releaseArena(this->_pArenas);
+			}
+
+		}
+
+
+		BYTE* RemotePool::allocate(size_t size, const BYTE* near) {
+
+			if (!size) return nullptr;
+
+			const size_t blockSize = alignUp(size, BLOCK_ALIGNMENT);
+			BYTE* pBlock = nullptr;
+
+			AcquireSRWLockExclusive(&this->_lock);
+
+			// caves first, so arenas are only allocated for blocks that do not fit into any cave in reach
+			if (!this->findBlockArena(blockSize, near, true, &pBlock)) {
+				this->findBlockArena(blockSize, near, false, &pBlock);
+			}
+
+			if (!pBlock) {
+				Arena* const pNewArena = this->createArena(blockSize, near);
+
+				if (pNewArena) {
+					pBlock = takeBlock(pNewArena, blockSize);
+				}
+
+			}
+
+			if (pBlock) {
+				this->_stats.allocations++;
+				this->_stats.blockCount++;
+				this->_stats.usedBytes += blockSize;
+
+				if (this->_stats.usedBytes > this->_stats.peakUsedBytes) {
+					this->_stats.peakUsedBytes = this->_stats.usedBytes;
+				}
+
+			}
+			else {
+				this->_stats.failures++;
+			}
+
+			ReleaseSRWLockExclusive(&this->_lock);
+
+			return pBlock;
+		}
+
+
+		bool RemotePool::free(BYTE* pBlock) {
+
+			if (!pBlock) return false;
+
+			bool success = false;
+
+			AcquireSRWLockExclusive(&this->_lock);
+
+			for (Arena* pCur = this->_pArenas; pCur; pCur = pCur->pNext) {
+
+				if (pBlock < pCur->base || pBlock >= pCur->base + pCur->size) continue;
+
+				size_t blockSize = 0u;
+				success = returnBlock(pCur, pBlock, &blockSize);
+
+				if (success) {
+					this->_stats.frees++;
+					this->_stats.blockCount--;
+					this->_stats.usedBytes -= blockSize;
+
+					if (!pCur->blockCount && !pCur->isCave) {
+						this->releaseArena(pCur);
+					}
+
+				}
+
+				break;
+			}
+
+			ReleaseSRWLockExclusive(&this->_lock);
+
+			return success;
+		}
+
+
+		size_t RemotePool::addCaves(const Cave caves[], size_t count) {
+
+			if (!caves) return 0u;
+
+			size_t added = 0u;
+
+			AcquireSRWLockExclusive(&this->_lock);
+
+			for (size_t i = 0u; i < count; i++) {
+				const Cave* const pCave = &caves[i];
+
+				// the cave has to be large enough for a block after aligning its base
+				const size_t padding = alignUp(reinterpret_cast<uintptr_t>(pCave->base), BLOCK_ALIGNMENT) - reinterpret_cast<uintptr_t>(pCave->base);
+
+				if (pCave->size < padding + BLOCK_ALIGNMENT) continue;
+
+				BYTE* const base = pCave->base + padding;
+				const size_t size = (pCave->size - padding) & ~(BLOCK_ALIGNMENT - 1u);
+				bool isOverlapping = false;
+
+				for (const Arena* pCur = this->_pArenas; pCur; pCur = pCur->pNext) {
+
+					if (base < pCur->base + pCur->size && pCur->base < base + size) {
+						isOverlapping = true;
+
+						break;
+					}
+
+				}
+
+				if (isOverlapping) continue;
+
+				// gateways are written in place by the caller of allocate()
+				DWORD oldProtect = 0ul;
+
+				if (!VirtualProtectEx(this->_hProc, base, size, PAGE_EXECUTE_READWRITE, &oldProtect)) continue;
+
+				Arena* const pArena = new Arena{};
+				pArena->base = base;
+				pArena->size = size;
+				pArena->pFree = new PoolRange{ 0u, size, nullptr };
+				pArena->isCave = true;
+				pArena->fill = pCave->fill;
+				pArena->oldProtect = oldProtect;
+				pArena->pNext = this->_pArenas;
+				this->_pArenas = pArena;
+
+				this->_stats.caveCount++;
+				this->_stats.caveBytes += size;
+				added++;
+			}
+
+			ReleaseSRWLockExclusive(&this->_lock);
+
+			return added;
+		}
+
+
+		void RemotePool::getStats(PoolStats* pStats) const {
+			AcquireSRWLockShared(&this->_lock);
+			*pStats = this->_stats;
+			ReleaseSRWLockShared(&this->_lock);
+
+			return;
+		}
+
+
+		HANDLE RemotePool::getProcessHandle() const {
+
+			return this->_hProc;
+		}
+
+
+		DWORD RemotePool::getProcessId() const {
+
+			return this->_processId;
+		}
+
+
+		RemotePool::Arena* RemotePool::createArena(size_t size, const BYTE* near) {
+			const size_t arenaSize = size > this->_arenaSize ? alignUp(size, ARENA_GRANULARITY) : this->_arenaSize;
+			BYTE* base = nullptr;
+
+			#ifdef _WIN64
+
+			// the whole x86 address space can be reached by a relative jump
+			if (near && !this->_isWow64) {
+				base = ex::virtualAllocNear(this->_hProc, near, arenaSize);
+			}
+			else {
+				base = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, arenaSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+			}
+
+			#else
+
+			base = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, arenaSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+
+			#endif // _WIN64
+
+			if (!base) return nullptr;
+
+			Arena* const pArena = new Arena{};
+			pArena->base = base;
+			pArena->size = arenaSize;
+			pArena->pFree = new PoolRange{ 0u, arenaSize, nullptr };
+			pArena->pNext = this->_pArenas;
+			this->_pArenas = pArena;
+
+			this->_stats.arenaCount++;
+			this->_stats.arenaAllocations++;
+			this->_stats.reservedBytes += arenaSize;
+
+			// virtualAllocNear only guarantees the start of the allocation to be in reach
+			if (near && !this->isInReach(pArena, near)) {
+				this->releaseArena(pArena);
+
+				return nullptr;
+			}
+
+			return pArena;
+		}
+
+
+		void RemotePool::releaseArena(Arena* pArena) {
+
+			if (this->_pArenas == pArena) {
+				this->_pArenas = pArena->pNext;
+			}
+			else {
+
+				for (Arena* pCur = this->_pArenas; pCur; pCur = pCur->pNext) {
+
+					if (pCur->pNext == pArena) {
+						pCur->pNext = pArena->pNext;
+
+						break;
+					}
+
+				}
+
+			}
+
+			if (pArena->isCave) {
+				// restore the padding, so the cave is found again by later scans
+				BYTE* const padding = new BYTE[pArena->size];
+				memset(padding, pArena->fill, pArena->size);
+				WriteProcessMemory(this->_hProc, pArena->base, padding, pArena->size, nullptr);
+				delete[] padding;
+
+				DWORD protect = 0ul;
+				VirtualProtectEx(this->_hProc, pArena->base, pArena->size, pArena->oldProtect, &protect);
+
+				this->_stats.caveCount--;
+				this->_stats.caveBytes -= pArena->size;
+			}
+			else {
+
+				if (VirtualFreeEx(this->_hProc, pArena->base, 0u, MEM_RELEASE)) {
+					this->_stats.arenaReleases++;
+				}
+
+				this->_stats.arenaCount--;
+				this->_stats.reservedBytes -= pArena->size;
+			}
+
+			this->_stats.blockCount -= pArena->blockCount;
+
+			for (const PoolRange* pCur = pArena->pUsed; pCur; pCur = pCur->pNext) {
+				this->_stats.usedBytes -= pCur->size;
+			}
+
+			deleteRanges(pArena->pFree);
+			deleteRanges(pArena->pUsed);
+			delete pArena;
+
+			return;
+		}
+
+
+		RemotePool::Arena* RemotePool::findBlockArena(size_t size, const BYTE* near, bool cave, BYTE** ppBlock) {
+
+			for (Arena* pCur = this->_pArenas; pCur; pCur = pCur->pNext) {
+
+				if (pCur->isCave != cave || (near && !this->isInReach(pCur, near))) continue;
+
+				*ppBlock = takeBlock(pCur, size);
+
+				if (*ppBlock) return pCur;
+
+			}
+
+			return nullptr;
+		}
+
+
+		bool RemotePool::isInReach(const Arena* pArena, const BYTE* near) const {
+
+			if (this->_isWow64) return true;
+
+			const uintptr_t nearAddress = reinterpret_cast<uintptr_t>(near);
+			const uintptr_t start = reinterpret_cast<uintptr_t>(pArena->base);
+			const uintptr_t end = start + pArena->size;
+			const uintptr_t lowDistance = nearAddress > start ? nearAddress - start : start - nearAddress;
+			const uintptr_t highDistance = nearAddress > end ? nearAddress - end : end - nearAddress;
+
+			return lowDistance < NEAR_REACH && highDistance < NEAR_REACH;
+		}
+
+
+		BYTE* RemotePool::takeBlock(Arena* pArena, size_t size) {
+			PoolRange* pPrev = nullptr;
+
+			// first fit, the ranges are aligned so no padding is needed
+			for (PoolRange* pCur = pArena->pFree; pCur; pCur = pCur->pNext) {
+
+				if (pCur->size >= size) {
+					const size_t offset = pCur->offset;
+
+					if (pCur->size == size) {
+
+						if (pPrev) {
+							pPrev->pNext = pCur->pNext;
+						}
+						else {
+							pArena->pFree = pCur->pNext;
+						}
+
+						delete pCur;
+					}
+					else {
+						pCur->offset += size;
+						pCur->size -= size;
+					}
+
+					pArena->pUsed = new PoolRange{ offset, size, pArena->pUsed };
+					pArena->blockCount++;
+
+					return pArena->base + offset;
+				}
+
+				pPrev = pCur;
+			}
+
+			return nullptr;
+		}
+
+
+		bool RemotePool::returnBlock(Arena* pArena, BYTE* pBlock, size_t* pSize) {
+			const size_t offset = static_cast<size_t>(pBlock - pArena->base);
+			PoolRange* pUsed = nullptr;
+			PoolRange* pPrev = nullptr;
+
+			for (PoolRange* pCur = pArena->pUsed; pCur; pCur = pCur->pNext) {
+
+				if (pCur->offset == offset) {
+					pUsed = pCur;
+
+					break;
+				}
+
+				pPrev = pCur;
+			}
+
+			if (!pUsed) return false;
+
+			if (pPrev) {
+				pPrev->pNext = pUsed->pNext;
+			}
+			else {
+				pArena->pUsed = pUsed->pNext;
+			}
+
+			*pSize = pUsed->size;
+			pArena->blockCount--;
+
+			// insert the range into the ordered free list and merge it with its neighbours
+			PoolRange* pBefore = nullptr;
+			PoolRange* pAfter = pArena->pFree;
+
+			while (pAfter && pAfter->offset < offset) {
+				pBefore = pAfter;
+				pAfter = pAfter->pNext;
+			}
+
+			pUsed->pNext = pAfter;
+
+			if (pBefore) {
+				pBefore->pNext = pUsed;
+			}
+			else {
+				pArena->pFree = pUsed;
+			}
+
+			if (pAfter && pUsed->offset + pUsed->size == pAfter->offset) {
+				pUsed->size += pAfter->size;
+				pUsed->pNext = pAfter->pNext;
+				delete pAfter;
+			}
+
+			if (pBefore && pBefore->offset + pBefore->size == pUsed->offset) {
+				pBefore->size += pUsed->size;
+				pBefore->pNext = pUsed->pNext;
+				delete pUsed;
+			}
+
+			return true;
+		}
+
+
+		static size_t alignUp(size_t value, size_t alignment) {
+
+			return (value + alignment - 1u) & ~(alignment - 1u);
+		}
+
+
+		static void deleteRanges(PoolRange* pRange) {
+
+			while (pRange) {
+				PoolRange* const pNext = pRange->pNext;
+				delete pRange;
+				pRange = pNext;
+			}
+
+			return;
+		}
+
+	}
+
+}
\ No newline at end of file
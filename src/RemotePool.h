@@ -0,0 +1,140 @@
+#pragma once
+#include "CaveMap.h"
+#include <Windows.h>
+
+// Class to sub-allocate small blocks of executable memory in an external process.
+// Reserves arenas of memory with PAGE_EXECUTE_READWRITE protection in the target and serves blocks aligned to 16 bytes from a free list per arena.
+// The protection is not split into writable and executable arenas, because shell code keeps its data right behind the code and writes to it.
+// Blocks that have to be reachable by a relative jump from an address are served from arenas within the reach of that address.
+// Arenas are released as soon as their last block is freed.
+// Code caves found by a CaveMap can be added to the pool. Blocks are served from caves before arenas, so blocks near functions of a module usually need no allocation.
+// The protection of the pages of a cave is changed to PAGE_EXECUTE_READWRITE while the cave belongs to the pool. On destruction the padding and the protection are restored.
+// The bookkeeping happens in the caller process, so serving and freeing blocks from existing arenas does not call any API functions.
+// The class is thread safe.
+// Compiled to x64 the class works both on x64 and x86 targets. Compiled to x86 it only works on x86 targets.
+
+namespace hax {
+
+	namespace mem {
+
+		// Counters of a remote pool.
+		typedef struct PoolStats {
+			// arenas currently reserved within the target
+			size_t arenaCount;
+			// bytes of all arenas currently reserved within the target
+			size_t reservedBytes;
+			// bytes of all blocks currently handed out
+			size_t usedBytes;
+			// highest value of usedBytes so far
+			size_t peakUsedBytes;
+			// blocks currently handed out
+			size_t blockCount;
+			// successful calls of allocate()
+			size_t allocations;
+			// successful calls of free()
+			size_t frees;
+			// calls of allocate() that failed
+			size_t failures;
+			// arenas reserved so far, each costs a VirtualAllocEx call
+			size_t arenaAllocations;
+			// arenas released so far, each costs a VirtualFreeEx call
+			size_t arenaReleases;
+			// code caves added to the pool, they are not counted as arenas
+			size_t caveCount;
+			// bytes of all code caves added to the pool
+			size_t caveBytes;
+		}PoolStats;
+
+		class RemotePool {
+		private:
+			struct Arena;
+
+			const HANDLE _hProc;
+			const DWORD _processId;
+			const size_t _arenaSize;
+			Arena* _pArenas;
+			PoolStats _stats;
+			mutable SRWLOCK _lock;
+			bool _isWow64;
+
+		public:
+			// Initializes members. Arenas are reserved on demand.
+			//
+			// Parameters:
+			//
+			// [in] hProc:
+			// Handle to the process in which the blocks should be allocated.
+			// Needs at least PROCESS_QUERY_LIMITED_INFORMATION and PROCESS_VM_OPERATION access rights.
+			//
+			// [in] arenaSize:
+			// Size of the arenas in bytes. Blocks larger than an arena get an arena of their own.
+			RemotePool(HANDLE hProc, size_t arenaSize = 0x10000u);
+
+			// Releases all arenas. Blocks that are still in use become invalid, so the pool has to outlive the users of its blocks.
+			~RemotePool();
+
+			// Allocates a block within the target process.
+			//
+			// Parameters:
+			//
+			// [in] size:
+			// Size of the block in bytes. Gets rounded up to a multiple of 16 bytes.
+			//
+			// [in] near:
+			// Address within the virtual address space of the target process from which the whole block has to be reachable by a relative jump (op code: E9).
+			// Only relevant for x64 targets because the whole x86 address space can be reached by a relative jump. Pass nullptr if the block can be located anywhere.
+			//
+			// Return:
+			// Address of the block within the virtual address space of the target process or nullptr on failure.
+			BYTE* allocate(size_t size, const BYTE* near = nullptr);
+
+			// Returns a block to the pool. Releases the arena of the block if it was the last block in use.
+			//
+			// Parameters:
+			//
+			// [in] pBlock:
+			// Address of the block returned by allocate().
+			//
+			// Return:
+			// True on success, false if the block was not allocated by this pool.
+			bool free(BYTE* pBlock);
+
+			// Adds code caves of modules of the target process to the pool. Blocks are served from the caves before any arena.
+			// Caves overlapping a cave already added are skipped, so the caves of a CaveMap can be added again after scanning further modules.
+			// Caves are kept until destruction of the pool, even if none of their blocks is in use.
+			//
+			// Parameters:
+			//
+			// [in] caves:
+			// Caves within the virtual address space of the target process, eg. the caves of a CaveMap created for the same process.
+			//
+			// [in] count:
+			// Number of caves.
+			//
+			// Return:
+			// Number of caves added.
+			size_t addCaves(const Cave caves[], size_t count);
+
+			// Gets a consistent copy of the counters of the pool.
+			//
+			// Parameters:
+			//
+			// [out] pStats:
+			// Pointer to the struct that receives the counters.
+			void getStats(PoolStats* pStats) const;
+
+			HANDLE getProcessHandle() const;
+			DWORD getProcessId() const;
+
+		private:
+			Arena* createArena(size_t size, const BYTE* near);
+			Arena* findBlockArena(size_t size, const BYTE* near, bool cave, BYTE** ppBlock);
+			void releaseArena(Arena* pArena);
+			bool isInReach(const Arena* pArena, const BYTE* near) const;
+			static BYTE* takeBlock(Arena* pArena, size_t size);
+			static bool returnBlock(Arena* pArena, BYTE* pBlock, size_t* pSize);
+		};
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "TraceSink.h"
+#include "Bench.h"
+#include <intrin.h>
+#include <string.h>
+#include <stddef.h>
+
+namespace hax {
+
+	constexpr char TRACE_MAGIC[]{ 'H', 'A', 'X', 'T', 'R', 'A', 'C', 'E' };
+	constexpr uint32_t TRACE_VERSION = 1u;
+	constexpr uint16_t TRACE_UNKNOWN_NAME = 0xFFFFu;
+	// type, name id, thread id, start, duration
+	constexpr size_t TRACE_EVENT_SIZE = sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint32_t) + 2u * sizeof(uint64_t);
+
+	static_assert(sizeof(TraceFileHeader) == 0x28u, "Unexpected trace file header layout.");
+
+	// A slot of the ring. The sequence tells producers and the consumer whether the slot is free or holds an event of the current lap.
+	struct TraceSink::Cell {
+		volatile LONG sequence;
+		DWORD threadId;
+		const char* name;
+		uint64_t start;
+		uint64_t duration;
+	};
+
+	// rounds up to the next power of two
+	static LONG roundUpToPowerOfTwo(size_t value);
+
+	// writes the beginning of the JSON document
+	static void writeJsonHeader(FILE* pFile);
+
+	// writes an event as complete event ("ph":"X") with times in microseconds relative to the start of the trace
+	static void writeJsonEvent(FILE* pFile, bool isFirst, const char* name, uint64_t start, uint64_t duration, DWORD threadId, uint32_t processId, uint64_t startTicks, double ticksPerMicrosecond);
+
+	// writes the end of the JSON document including the number of dropped events as metadata
+	static void writeJsonFooter(FILE* pFile, size_t dropped);
+
+	// writes the event record of a binary trace
+	static void writeBinaryEvent(FILE* pFile, uint16_t nameId, uint64_t start, uint64_t duration, DWORD threadId);
+
+	TraceSink::TraceSink(size_t capacity) :
+		_cells{ new Cell[static_cast<size_t>(roundUpToPowerOfTwo(capacity))]{} }, _mask{ roundUpToPowerOfTwo(capacity) - 1 }, _enqueuePos{}, _dequeuePos{}, _dropped{},
+		_pFile{}, _format{ TraceFormat::JSON }, _interval{}, _hThread{}, _hStopEvent{}, _startTicks{}, _written{}, _names{}, _nameCount{}
+	{
+
+		// a slot is free for the producer of the position equal to its sequence
+		for (LONG i = 0; i <= this->_mask; i++) {
+			this->_cells[i].sequence = i;
+		}
+
+	}
+
+
+	TraceSink::~TraceSink() {
+		this->stop();
+		delete[] this->_cells;
+	}
+
+
+	bool TraceSink::start(const char* path, TraceFormat format, DWORD interval) {
+
+		if (this->_hThread) return false;
+
+		if (fopen_s(&this->_pFile, path, format == TraceFormat::BINARY ? "wb" : "w") || !this->_pFile) return false;
+
+		this->_format = format;
+		this->_interval = interval;
+		this->_startTicks = __rdtsc();
+		this->_written = 0u;
+		this->_nameCount = 0u;
+
+		if (this->_format == TraceFormat::BINARY) {
+			TraceFileHeader header{};
+			memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+			header.version = TRACE_VERSION;
+			header.processId = GetCurrentProcessId();
+			header.ticksPerSecond = Bench::getTicksPerSecond();
+			header.startTicks = this->_startTicks;
+			fwrite(&header, sizeof(header), 1u, this->_pFile);
+		}
+		else {
+			writeJsonHeader(this->_pFile);
+		}
+
+		this->_hStopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+		if (this->_hStopEvent) {
+			this->_hThread = CreateThread(nullptr, 0u, threadProc, this, 0ul, nullptr);
+		}
+
+		if (!this->_hThread) {
+
+			if (this->_hStopEvent) {
+				CloseHandle(this->_hStopEvent);
+				this->_hStopEvent = nullptr;
+			}
+
+			fclose(this->_pFile);
+			this->_pFile = nullptr;
+
+			return false;
+		}
+
+		return true;
+	}
+
+
+	void TraceSink::stop() {
+
+		if (!this->_hThread) return;
+
+		// the thread drains the ring a last time and completes the file
+		SetEvent(this->_hStopEvent);
+		WaitForSingleObject(this->_hThread, INFINITE);
+
+		CloseHandle(this->_hThread);
+		this->_hThread = nullptr;
+		CloseHandle(this->_hStopEvent);
+		this->_hStopEvent = nullptr;
+
+		return;
+	}
+
+
+	bool TraceSink::push(const char* name, uint64_t start, uint64_t duration, DWORD threadId) {
+		LONG pos = this->_enqueuePos;
+
+		while (true) {
+			Cell* const pCell = &this->_cells[pos & this->_mask];
+			const LONG sequence = pCell->sequence;
+			// difference of the positions, correct across the wrap around of the counters
+			const LONG difference = static_cast<LONG>(static_cast<ULONG>(sequence) - static_cast<ULONG>(pos));
+
+			if (!difference) {
+				const LONG prevPos = InterlockedCompareExchange(&this->_enqueuePos, pos + 1, pos);
+
+				// another producer claimed the slot first
+				if (prevPos != pos) {
+					pos = prevPos;
+
+					continue;
+				}
+
+				pCell->threadId = threadId;
+				pCell->name = name;
+				pCell->start = start;
+				pCell->duration = duration;
+
+				// publishes the event to the consumer
+				pCell->sequence = static_cast<LONG>(static_cast<ULONG>(pos) + 1u);
+
+				return true;
+			}
+
+			// the slot still holds an event of the previous lap, so the ring is full
+			if (difference < 0) {
+				InterlockedIncrement(&this->_dropped);
+
+				return false;
+			}
+
+			// another producer advanced the position in the meantime
+			pos = this->_enqueuePos;
+		}
+
+	}
+
+
+	size_t TraceSink::getDropped() const {
+
+		return static_cast<size_t>(this->_dropped);
+	}
+
+
+	size_t TraceSink::getWritten() const {
+
+		return this->_written;
+	}
+
+
+	bool TraceSink::isRunning() const {
+
+		return this->_hThread != nullptr;
+	}
+
+
+	bool TraceSink::convertToJson(const char* binaryPath, const char* jsonPath) {
+		FILE* pBinary = nullptr;
+
+		if (fopen_s(&pBinary, binaryPath, "rb") || !pBinary) return false;
+
+		TraceFileHeader header{};
+
+		if (fread(&header, sizeof(header), 1u, pBinary) != 1u || memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) || header.version != TRACE_VERSION || header.ticksPerSecond <= 0.) {
+			fclose(pBinary);
+
+			return false;
+		}
+
+		FILE* pJson = nullptr;
+
+		if (fopen_s(&pJson, jsonPath, "w") || !pJson) {
+			fclose(pBinary);
+
+			return false;
+		}
+
+		writeJsonHeader(pJson);
+
+		char* names[TRACE_MAX_NAMES]{};
+		const double ticksPerMicrosecond = header.ticksPerSecond / 1000000.;
+		bool isFirst = true;
+		bool isValid = true;
+		uint8_t type = 0u;
+
+		while (fread(&type, sizeof(type), 1u, pBinary) == 1u) {
+
+			if (type == static_cast<uint8_t>(TraceRecordType::NAME)) {
+				uint16_t id = 0u;
+				uint16_t length = 0u;
+
+				if (fread(&id, sizeof(id), 1u, pBinary) != 1u || fread(&length, sizeof(length), 1u, pBinary) != 1u || id >= TRACE_MAX_NAMES) {
+					isValid = false;
+
+					break;
+				}
+
+				delete[] names[id];
+				names[id] = new char[length + 1u]{};
+
+				if (fread(names[id], sizeof(char), length, pBinary) != length) {
+					isValid = false;
+
+					break;
+				}
+
+			}
+			else if (type == static_cast<uint8_t>(TraceRecordType::EVENT)) {
+				BYTE record[TRACE_EVENT_SIZE - sizeof(uint8_t)]{};
+
+				if (fread(record, sizeof(record), 1u, pBinary) != 1u) {
+					isValid = false;
+
+					break;
+				}
+
+				uint16_t id = 0u;
+				uint32_t threadId = 0u;
+				uint64_t start = 0u;
+				uint64_t duration = 0u;
+				memcpy(&id, record, sizeof(id));
+				memcpy(&threadId, record + sizeof(id), sizeof(threadId));
+				memcpy(&start, record + sizeof(id) + sizeof(threadId), sizeof(start));
+				memcpy(&duration, record + sizeof(id) + sizeof(threadId) + sizeof(start), sizeof(duration));
+
+				const char* const name = id < TRACE_MAX_NAMES && names[id] ? names[id] : "?";
+				writeJsonEvent(pJson, isFirst, name, start, duration, threadId, header.processId, header.startTicks, ticksPerMicrosecond);
+				isFirst = false;
+			}
+			else {
+				isValid = false;
+
+				break;
+			}
+
+		}
+
+		writeJsonFooter(pJson, static_cast<size_t>(header.dropped));
+
+		for (uint16_t i = 0u; i < TRACE_MAX_NAMES; i++) {
+			delete[] names[i];
+		}
+
+		fclose(pJson);
+		fclose(pBinary);
+
+		return isValid;
+	}
+
+
+	DWORD WINAPI TraceSink::threadProc(LPVOID lpParameter) {
+		TraceSink* const pSink = static_cast<TraceSink*>(lpParameter);
+		DWORD result = WAIT_TIMEOUT;
+
+		while (result == WAIT_TIMEOUT) {
+			result = WaitForSingleObject(pSink->_hStopEvent, pSink->_interval);
+			pSink->drain();
+		}
+
+		if (pSink->_format == TraceFormat::JSON) {
+			writeJsonFooter(pSink->_pFile, pSink->getDropped());
+		}
+		else {
+			const uint64_t dropped = pSink->getDropped();
+			fseek(pSink->_pFile, offsetof(TraceFileHeader, dropped), SEEK_SET);
+			fwrite(&dropped, sizeof(dropped), 1u, pSink->_pFile);
+		}
+
+		fclose(pSink->_pFile);
+		pSink->_pFile = nullptr;
+
+		return 0ul;
+	}
+
+
+	void TraceSink::drain() {
+		const double ticksPerMicrosecond = Bench::getTicksPerSecond() / 1000000.;
+		const uint32_t processId = GetCurrentProcessId();
+		size_t count = 0u;
+
+		while (true) {
+			Cell* const pCell = &this->_cells[this->_dequeuePos & this->_mask];
+			const LONG sequence = pCell->sequence;
+
+			// the slot has not been published for the current lap yet
+			if (static_cast<LONG>(static_cast<ULONG>(sequence) - static_cast<ULONG>(this->_dequeuePos) - 1u) < 0) break;
+
+			const DWORD threadId = pCell->threadId;
+			const char* const name = pCell->name ? pCell->name : "?";
+			const uint64_t start = pCell->start;
+			const uint64_t duration = pCell->duration;
+
+			// frees the slot for the producer of the next lap
+			pCell->sequence = static_cast<LONG>(static_cast<ULONG>(this->_dequeuePos) + static_cast<ULONG>(this->_mask) + 1u);
+			this->_dequeuePos = static_cast<LONG>(static_cast<ULONG>(this->_dequeuePos) + 1u);
+
+			if (this->_format == TraceFormat::BINARY) {
+				writeBinaryEvent(this->_pFile, this->getNameId(name), start, duration, threadId);
+			}
+			else {
+				writeJsonEvent(this->_pFile, !this->_written, name, start, duration, threadId, processId, this->_startTicks, ticksPerMicrosecond);
+			}
+
+			this->_written++;
+			count++;
+		}
+
+		// the written events survive a crash of the process
+		if (count) {
+			fflush(this->_pFile);
+		}
+
+		return;
+	}
+
+
+	uint16_t TraceSink::getNameId(const char* name) {
+
+		for (uint16_t i = 0u; i < this->_nameCount; i++) {
+
+			if (this->_names[i] == name) return i;
+
+		}
+
+		if (this->_nameCount >= TRACE_MAX_NAMES) return TRACE_UNKNOWN_NAME;
+
+		const uint16_t id = this->_nameCount;
+		const size_t length = strnlen(name, UINT16_MAX);
+		const uint16_t length16 = static_cast<uint16_t>(length);
+		const uint8_t type = static_cast<uint8_t>(TraceRecordType::NAME);
+
+		fwrite(&type, sizeof(type), 1u, this->_pFile);
+		fwrite(&id, sizeof(id), 1u, this->_pFile);
+		fwrite(&length16, sizeof(length16), 1u, this->_pFile);
+		fwrite(name, sizeof(char), length, this->_pFile);
+
+		this->_names[id] = name;
+		this->_nameCount++;
+
+		return id;
+	}
+
+
+	static LONG roundUpToPowerOfTwo(size_t value) {
+		LONG result = 1;
+
+		// the positions are signed 32 bit values, so the capacity is limited to 2^30
+		while (static_cast<size_t>(result) < value && result < 0x40000000) {
+			result <<= 1;
+		}
+
+		return result;
+	}
+
+
+	static void writeJsonHeader(FILE* pFile) {
+		fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", pFile);
+
+		return;
+	}
+
+
+	static void writeJsonEvent(FILE* pFile, bool isFirst, const char* name, uint64_t start, uint64_t duration, DWORD threadId, uint32_t processId, uint64_t startTicks, double ticksPerMicrosecond) {
+		// events pushed before the sink was started have negative timestamps
+		const double timestamp = static_cast<double>(static_cast<int64_t>(start - startTicks)) / ticksPerMicrosecond;
+
+		fprintf(pFile, "%s{\"name\":\"", isFirst ? "" : ",\n");
+
+		// names are expected to be identifiers, characters that would break the string are replaced
+		for (const char* c = name; *c; c++) {
+			fputc(*c == '"' || *c == '\\' || static_cast<unsigned char>(*c) < 0x20u ? '_' : *c, pFile);
+		}
+
+		fprintf(
+			pFile, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+			timestamp, static_cast<double>(duration) / ticksPerMicrosecond, static_cast<unsigned long>(processId), static_cast<unsigned long>(threadId)
+		);
+
+		return;
+	}
+
+
+	static void writeJsonFooter(FILE* pFile, size_t dropped) {
+		fprintf(pFile, "\n],\"otherData\":{\"dropped\":\"%zu\"}}\n", dropped);
+
+		return;
+	}
+
+
+	static void writeBinaryEvent(FILE* pFile, uint16_t nameId, uint64_t start, uint64_t duration, DWORD threadId) {
+		BYTE record[TRACE_EVENT_SIZE]{};
+		const uint32_t threadId32 = static_cast<uint32_t>(threadId);
+		record[0] = static_cast<BYTE>(TraceRecordType::EVENT);
+		memcpy(record + sizeof(uint8_t), &nameId, sizeof(nameId));
+		memcpy(record + sizeof(uint8_t) + sizeof(nameId), &threadId32, sizeof(threadId32));
+		memcpy(record + sizeof(uint8_t) + sizeof(nameId) + sizeof(threadId32), &start, sizeof(start));
+		memcpy(record + sizeof(uint8_t) + sizeof(nameId) + sizeof(threadId32) + sizeof(start), &duration, sizeof(duration));
+		fwrite(record, sizeof(record), 1u, pFile);
+
+		return;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#pragma once
+#include <Windows.h>
+#include <stdio.h>
+#include <stdint.h>
+
+// Class to write timing events of hooks to a file for offline analysis without stalling the threads that record them.
+// Events are pushed into a bounded ring by any number of threads without locks. If the ring is full the event is dropped and counted instead of blocking the thread.
+// A background thread drains the ring periodically and writes the events either as Chrome trace_event JSON, which can be opened by chrome://tracing or Perfetto,
+// or in a compact binary format that can be converted to JSON later via convertToJson.
+// Bench objects and profilers forward their meassurements to a sink after calling setTraceSink on them.
+// Times are raw time stamp counter ticks like recorded by Bench and Profiler. They are converted to microseconds via Bench::getTicksPerSecond when written as JSON.
+// The names of the events are not copied, so they have to be valid until the events are written (eg. string literals).
+//
+// Binary format: A TraceFileHeader followed by records, each starting with a TraceRecordType byte.
+// TraceRecordType::NAME: uint16_t id, uint16_t length, <length> characters without terminator. Defines the name of an id before its first event.
+// TraceRecordType::EVENT: uint16_t name id, uint32_t thread id, uint64_t start ticks, uint64_t duration ticks.
+// All values are little endian without padding.
+
+namespace hax {
+
+	enum class TraceFormat {
+		JSON,
+		BINARY
+	};
+
+	enum class TraceRecordType : uint8_t {
+		NAME = 1,
+		EVENT = 2
+	};
+
+	typedef struct TraceFileHeader {
+		// "HAXTRACE"
+		char magic[8];
+		uint32_t version;
+		uint32_t processId;
+		double ticksPerSecond;
+		// time stamp counter when the sink was started, the events are relative to it in JSON
+		uint64_t startTicks;
+		// number of events dropped until the sink was stopped, written when the sink stops
+		uint64_t dropped;
+	}TraceFileHeader;
+
+	// maximum number of distinct names written to a binary trace, further names are written as "?"
+	constexpr uint16_t TRACE_MAX_NAMES = 0x100u;
+
+	class TraceSink {
+	private:
+		struct Cell;
+
+		Cell* const _cells;
+		const LONG _mask;
+		volatile LONG _enqueuePos;
+		// only accessed by the background thread
+		LONG _dequeuePos;
+		volatile LONG _dropped;
+		FILE* _pFile;
+		TraceFormat _format;
+		DWORD _interval;
+		HANDLE _hThread;
+		HANDLE _hStopEvent;
+		uint64_t _startTicks;
+		size_t _written;
+		const char* _names[TRACE_MAX_NAMES];
+		uint16_t _nameCount;
+
+	public:
+		// Initializes members and allocates the ring.
+		//
+		// Parameters:
+		//
+		// [in] capacity:
+		// Number of events the ring can hold. Gets rounded up to a power of two.
+		TraceSink(size_t capacity = 0x4000u);
+
+		// Stops the background thread if it is running. Must not be called while the loader lock is held, eg. in DllMain.
+		~TraceSink();
+
+		// Opens the file and starts the background thread. Events pushed before are written as well.
+		//
+		// Parameters:
+		//
+		// [in] path:
+		// Path of the file the events are written to. An existing file is overwritten.
+		//
+		// [in] format:
+		// Format the events are written in.
+		//
+		// [in] interval:
+		// Milliseconds the background thread sleeps between draining the ring. The ring has to hold the events recorded within this interval.
+		//
+		// Return:
+		// True on success, false if the sink is already running or the file or the thread could not be created.
+		bool start(const char* path, TraceFormat format, DWORD interval = 50ul);
+
+		// Drains the remaining events, completes and closes the file and stops the background thread. Must not be called while the loader lock is held, eg. in DllMain.
+		void stop();
+
+		// Adds an event to the ring. Thread safe and lock free.
+		//
+		// Parameters:
+		//
+		// [in] name:
+		// Name of the event. Has to be valid until the event is written (eg. a string literal).
+		//
+		// [in] start:
+		// Time stamp counter at the beginning of the event.
+		//
+		// [in] duration:
+		// Duration of the event in ticks.
+		//
+		// [in] threadId:
+		// Id of the thread the event was recorded by.
+		//
+		// Return:
+		// True on success, false if the ring is full and the event was dropped.
+		bool push(const char* name, uint64_t start, uint64_t duration, DWORD threadId);
+
+		// Gets the number of events dropped since construction because the ring was full.
+		size_t getDropped() const;
+
+		// Gets the number of events written to the file since the sink was started.
+		size_t getWritten() const;
+
+		bool isRunning() const;
+
+		// Converts a binary trace to Chrome trace_event JSON.
+		//
+		// Parameters:
+		//
+		// [in] binaryPath:
+		// Path of a file written by a sink in TraceFormat::BINARY.
+		//
+		// [in] jsonPath:
+		// Path of the JSON file. An existing file is overwritten.
+		//
+		// Return:
+		// True on success, false if a file could not be opened or the binary trace is invalid.
+		static bool convertToJson(const char* binaryPath, const char* jsonPath);
+
+	private:
+		static DWORD WINAPI threadProc(LPVOID lpParameter);
+
+		// writes all events in the ring to the file
+		void drain();
+
+		// writes the definition of a name to a binary trace if it has not been written yet and gets its id
+		uint16_t getNameId(const char* name);
+	};
+
+}
\ No newline at end of file
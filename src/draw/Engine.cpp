@@ -1,5 +1,8 @@
 #include "Engine.h"
+#include "..\Profiler.h"
+#include "..\Bench.h"
 #include <string.h>
+#include <stdio.h>
 
 namespace hax {
 
@@ -279,6 +282,142 @@ namespace hax {
 			return;
 		}
 
+
+		void Engine::drawProfilerFlame(const Profiler* pProfiler, const font::Font* pFont, const Vector2* pos, float width, float rowHeight, const Color palette[], size_t paletteSize, Color textColor) const {
+
+			if (!this->_frame || !paletteSize) return;
+
+			const size_t frameCount = pProfiler->getFrameCount();
+			uint64_t longest = 0u;
+			uint16_t maxDepth = 0u;
+
+			for (size_t i = 0u; i < frameCount; i++) {
+				const ProfileFrame* const pFrame = pProfiler->getFrame(i);
+
+				if (pFrame->duration > longest) {
+					longest = pFrame->duration;
+				}
+
+				for (size_t j = 0u; j < pFrame->count; j++) {
+
+					if (pFrame->records[j].depth > maxDepth) {
+						maxDepth = pFrame->records[j].depth;
+					}
+
+				}
+
+			}
+
+			if (!longest) return;
+
+			// one pixel gap between the lanes
+			const float laneHeight = (maxDepth + 1u) * rowHeight + 1.f;
+			const float pixelsPerTick = width / static_cast<float>(longest);
+
+			for (size_t i = 0u; i < frameCount; i++) {
+				const ProfileFrame* const pFrame = pProfiler->getFrame(i);
+				const float laneY = pos->y + i * laneHeight;
+
+				for (size_t j = 0u; j < pFrame->count; j++) {
+					const ProfileRecord* const pRecord = &pFrame->records[j];
+
+					// zones of other threads might have started before or ended after the frame
+					const uint64_t frameEnd = pFrame->start + pFrame->duration;
+					const uint64_t start = pRecord->start > pFrame->start ? pRecord->start : pFrame->start;
+					const uint64_t end = pRecord->start + pRecord->duration < frameEnd ? pRecord->start + pRecord->duration : frameEnd;
+
+					if (end <= start) continue;
+
+					const Vector2 barPos{ pos->x + static_cast<float>(start - pFrame->start) * pixelsPerTick, laneY + pRecord->depth * rowHeight };
+					float barWidth = static_cast<float>(end - start) * pixelsPerTick;
+
+					// short zones stay visible
+					if (barWidth < 1.f) {
+						barWidth = 1.f;
+					}
+
+					this->drawFilledRectangle(&barPos, barWidth, rowHeight - 1.f, palette[pRecord->zone % paletteSize]);
+
+					if (i || rowHeight < pFont->height + 2.f) continue;
+
+					const char* const name = pProfiler->getZoneName(pRecord->zone);
+
+					if (!name) continue;
+
+					// two pixels padding on both sides
+					const float textWidth = (pFont->width + 2.f) * strlen(name) + 2.f;
+
+					if (textWidth > barWidth) continue;
+
+					const Vector2 textPos{ barPos.x + 2.f, barPos.y + rowHeight - 2.f };
+					this->drawString(pFont, &textPos, name, textColor);
+				}
+
+			}
+
+			return;
+		}
+
+
+		void Engine::drawProfilerTable(const Profiler* pProfiler, const font::Font* pFont, const Vector2* pos, Color color) const {
+
+			if (!this->_frame) return;
+
+			const size_t frameCount = pProfiler->getFrameCount();
+			const uint16_t zoneCount = pProfiler->getZoneCount();
+
+			if (!frameCount || !zoneCount) return;
+
+			uint64_t totals[PROFILER_MAX_ZONES]{};
+			uint64_t maxima[PROFILER_MAX_ZONES]{};
+			size_t calls[PROFILER_MAX_ZONES]{};
+
+			for (size_t i = 0u; i < frameCount; i++) {
+				const ProfileFrame* const pFrame = pProfiler->getFrame(i);
+				uint64_t frameTotals[PROFILER_MAX_ZONES]{};
+
+				for (size_t j = 0u; j < pFrame->count; j++) {
+					const ProfileRecord* const pRecord = &pFrame->records[j];
+
+					if (pRecord->zone >= zoneCount) continue;
+
+					frameTotals[pRecord->zone] += pRecord->duration;
+					calls[pRecord->zone]++;
+				}
+
+				for (uint16_t j = 0u; j < zoneCount; j++) {
+					totals[j] += frameTotals[j];
+
+					if (frameTotals[j] > maxima[j]) {
+						maxima[j] = frameTotals[j];
+					}
+
+				}
+
+			}
+
+			const double msPerTick = 1000. / Bench::getTicksPerSecond();
+			const float lineHeight = pFont->height + 4.f;
+			char line[0x40]{};
+
+			Vector2 linePos{ pos->x, pos->y + lineHeight };
+			snprintf(line, sizeof(line), "%-16s %8s %8s %6s", "zone", "mean ms", "max ms", "calls");
+			this->drawString(pFont, &linePos, line, color);
+
+			for (uint16_t i = 0u; i < zoneCount; i++) {
+				const char* const name = pProfiler->getZoneName(i);
+
+				linePos.y += lineHeight;
+				snprintf(
+					line, sizeof(line), "%-16.16s %8.3f %8.3f %6.1f",
+					name ? name : "", totals[i] * msPerTick / frameCount, maxima[i] * msPerTick, static_cast<double>(calls[i]) / frameCount
+				);
+				this->drawString(pFont, &linePos, line, color);
+			}
+
+			return;
+		}
+
 	}
 
 }
\ No newline at end of file
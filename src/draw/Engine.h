@@ -6,6 +6,8 @@
 
 namespace hax {
 
+	class Profiler;
+
 	namespace draw {
 
 		class Engine {
@@ -176,6 +178,56 @@ namespace hax {
 			// [in] color:
 			// Line color. Color format: DirectX 9 -> argb, DirectX 11 -> abgr, OpenGL 2 -> abgr, Vulkan: application dependent
 			void draw3DBox(const Vector2 bot[4], const Vector2 top[4], float width, Color color) const;
+
+			// Draws the kept frames of a profiler as flame bars. Each frame is a lane, the latest frame at the top. Each zone is a bar within the lane of its frame.
+			// The horizontal position and length of a bar is its time relative to the beginning of its frame, scaled so the longest kept frame fills the width.
+			// Nested zones are drawn in rows below the zones they are nested in. Zones of different threads overlap. Zone names are drawn into the bars of the latest frame if they fit.
+			// Has to be called by the thread that ends the frames of the profiler.
+			//
+			// Parameters:
+			//
+			// [in] pProfiler:
+			// Profiler the frames are drawn of.
+			// 
+			// [in] pFont:
+			// Pointer to an appropriate Font object for the zone names. ogl2::Font* for OpenGL 2 hooks and dx::Font* for DirectX hooks.
+			// 
+			// [in] pos:
+			// Coordinates of the top left corner of the flame bars.
+			// 
+			// [in] width:
+			// Width of the flame bars in pixels.
+			// 
+			// [in] rowHeight:
+			// Height of a row of zones in pixels.
+			// 
+			// [in] palette:
+			// Colors of the bars. A zone is drawn in the color at its index modulo the palette size. Color format: DirectX 9 -> argb, DirectX 11 -> abgr, OpenGL 2 -> abgr, Vulkan: application dependent
+			// 
+			// [in] paletteSize:
+			// Number of colors in the palette.
+			// 
+			// [in] textColor:
+			// Color of the zone names.
+			void drawProfilerFlame(const Profiler* pProfiler, const font::Font* pFont, const Vector2* pos, float width, float rowHeight, const Color palette[], size_t paletteSize, Color textColor) const;
+
+			// Draws a table of the zones of a profiler with the mean and maximum time per frame in milliseconds and the mean number of meassurements per frame over the kept frames.
+			// Has to be called by the thread that ends the frames of the profiler.
+			//
+			// Parameters:
+			//
+			// [in] pProfiler:
+			// Profiler the zones are drawn of.
+			// 
+			// [in] pFont:
+			// Pointer to an appropriate Font object. ogl2::Font* for OpenGL 2 hooks and dx::Font* for DirectX hooks.
+			// 
+			// [in] pos:
+			// Coordinates of the top left corner of the table.
+			// 
+			// [in] color:
+			// Color of the text. Color format: DirectX 9 -> argb, DirectX 11 -> abgr, OpenGL 2 -> abgr, Vulkan: application dependent
+			void drawProfilerTable(const Profiler* pProfiler, const font::Font* pFont, const Vector2* pos, Color color) const;
 		};
 
 	}
@@ -77,7 +77,7 @@ namespace hax {
 
                 if (!hHookSemaphore) return false;
 
-                pExecuteHook = new hax::in::TrampHook(reinterpret_cast<BYTE*>(pExecuteCommandLists), reinterpret_cast<BYTE*>(hkExecuteCommandLists), 0x5u);
+                pExecuteHook = new hax::in::TrampHook(reinterpret_cast<BYTE*>(pExecuteCommandLists), reinterpret_cast<BYTE*>(hkExecuteCommandLists), 0u);
                 
                 if (!pExecuteHook->enable()) {
                     delete pExecuteHook;
@@ -71,7 +71,7 @@ namespace hax {
 
 				if (!hHookSemaphore) return false;
 
-				pAcquireHook = new hax::in::TrampHook(reinterpret_cast<BYTE*>(pVkAcquireNextImageKHR), reinterpret_cast<BYTE*>(hkvkAcquireNextImageKHR), 0xCu);
+				pAcquireHook = new hax::in::TrampHook(reinterpret_cast<BYTE*>(pVkAcquireNextImageKHR), reinterpret_cast<BYTE*>(hkvkAcquireNextImageKHR), 0u);
 				
 				if (!pAcquireHook->enable()) {
 					delete pAcquireHook;
@@ -2,13 +2,32 @@
 
 // Headers for functionallity not related to graphics apis
 #include "Bench.h"
+#include "BenchStats.h"
+#include "Profiler.h"
+#include "TraceSink.h"
 #include "FileLoader.h"
 #include "vecmath.h"
 #include "hooks\TrampHook.h"
 #include "hooks\IatHook.h"
+#include "hooks\ThreadSuspender.h"
+#include "hooks\HookGroup.h"
+#include "hooks\VTableHook.h"
+#include "hooks\HookProbe.h"
+#include "hooks\ChainHook.h"
+#include "hooks\MidHook.h"
 #include "mem.h"
+#include "instr.h"
+#include "shellcode.h"
+#include "regionSearch.h"
+#include "RegionMap.h"
+#include "CaveMap.h"
+#include "RemotePool.h"
 #include "proc.h"
+#include "threadRank.h"
 #include "launch.h"
+#include "Channel.h"
+#include "peImage.h"
+#include "ManualMapper.h"
 
 // Headers for engine
 #include "draw\Engine.h"
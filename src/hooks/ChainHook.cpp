@@ -0,0 +1,375 @@
+#include "ChainHook.h"
+#include "..\mem.h"
+#include <stddef.h>
+
+namespace hax {
+
+	namespace in {
+
+		// the data is placed on the page after the stub, so the stub is executed from a page that does not get written
+		constexpr size_t CHAIN_DATA_OFFSET = 0x1000u;
+
+		typedef struct ChainData {
+			BYTE* gateway;
+			// null terminated array of the callbacks of the current list
+			BYTE* const* volatile callbacks;
+		}ChainData;
+
+		// the stub addresses the data by these offsets
+		static_assert(offsetof(ChainData, callbacks) == sizeof(void*), "Unexpected chain data layout.");
+
+		struct ChainHook::CallbackList {
+			// null terminated, read by the stub
+			BYTE** callbacks;
+			int* priorities;
+			size_t count;
+			CallbackList* pNext;
+		};
+
+		#ifdef _WIN64
+
+		// The data is addressed relative to the instruction pointer and located at CHAIN_DATA_OFFSET from the beginning of the stub.
+		// The argument registers are saved in the frame of the stub and restored before every callback and before jumping to the gateway.
+		// The callbacks get a copy of the home space and 16 stack arguments of the caller. rbx, rsi and rdi are non-volatile, so they survive the calls.
+		//
+		// ASM:
+		// push    rbp
+		// mov     rbp, rsp
+		// push    rbx
+		// push    rsi
+		// push    rdi
+		// sub     rsp, 0xE8								home space, 16 stack arguments and the saved argument registers
+		// mov     [rbp - 0x20], rcx
+		// mov     [rbp - 0x28], rdx
+		// mov     [rbp - 0x30], r8
+		// mov     [rbp - 0x38], r9
+		// movq    [rbp - 0x40], xmm0
+		// movq    [rbp - 0x48], xmm1
+		// movq    [rbp - 0x50], xmm2
+		// movq    [rbp - 0x58], xmm3
+		// mov     rbx, [rip + callbacks]					the list is read once per call
+		// next:
+		// mov     rax, [rbx]
+		// test    rax, rax
+		// jz      done
+		// lea     rsi, [rbp + 0x30]						stack arguments of the caller
+		// lea     rdi, [rsp + 0x20]
+		// mov     ecx, 16
+		// rep movsq
+		// mov     rcx, [rbp - 0x20]
+		// mov     rdx, [rbp - 0x28]
+		// mov     r8, [rbp - 0x30]
+		// mov     r9, [rbp - 0x38]
+		// movq    xmm0, [rbp - 0x40]
+		// movq    xmm1, [rbp - 0x48]
+		// movq    xmm2, [rbp - 0x50]
+		// movq    xmm3, [rbp - 0x58]
+		// call    rax
+		// add     rbx, 8
+		// jmp     next
+		// done:
+		// mov     rcx, [rbp - 0x20]
+		// mov     rdx, [rbp - 0x28]
+		// mov     r8, [rbp - 0x30]
+		// mov     r9, [rbp - 0x38]
+		// movq    xmm0, [rbp - 0x40]
+		// movq    xmm1, [rbp - 0x48]
+		// movq    xmm2, [rbp - 0x50]
+		// movq    xmm3, [rbp - 0x58]
+		// lea     rsp, [rbp - 0x18]
+		// pop     rdi
+		// pop     rsi
+		// pop     rbx
+		// pop     rbp
+		// jmp     qword ptr [rip + gateway]				the origin function returns to the caller directly
+		static constexpr BYTE CHAIN_SHELL[]{
+			0x55, 0x48, 0x89, 0xE5, 0x53, 0x56, 0x57, 0x48, 0x81, 0xEC, 0xE8, 0x00, 0x00, 0x00, 0x48, 0x89,
+			0x4D, 0xE0, 0x48, 0x89, 0x55, 0xD8, 0x4C, 0x89, 0x45, 0xD0, 0x4C, 0x89, 0x4D, 0xC8, 0x66, 0x0F,
+			0xD6, 0x45, 0xC0, 0x66, 0x0F, 0xD6, 0x4D, 0xB8, 0x66, 0x0F, 0xD6, 0x55, 0xB0, 0x66, 0x0F, 0xD6,
+			0x5D, 0xA8, 0x48, 0x8B, 0x1D, 0xCF, 0x0F, 0x00, 0x00, 0x48, 0x8B, 0x03, 0x48, 0x85, 0xC0, 0x74,
+			0x3D, 0x48, 0x8D, 0x75, 0x30, 0x48, 0x8D, 0x7C, 0x24, 0x20, 0xB9, 0x10, 0x00, 0x00, 0x00, 0xF3,
+			0x48, 0xA5, 0x48, 0x8B, 0x4D, 0xE0, 0x48, 0x8B, 0x55, 0xD8, 0x4C, 0x8B, 0x45, 0xD0, 0x4C, 0x8B,
+			0x4D, 0xC8, 0xF3, 0x0F, 0x7E, 0x45, 0xC0, 0xF3, 0x0F, 0x7E, 0x4D, 0xB8, 0xF3, 0x0F, 0x7E, 0x55,
+			0xB0, 0xF3, 0x0F, 0x7E, 0x5D, 0xA8, 0xFF, 0xD0, 0x48, 0x83, 0xC3, 0x08, 0xEB, 0xBB, 0x48, 0x8B,
+			0x4D, 0xE0, 0x48, 0x8B, 0x55, 0xD8, 0x4C, 0x8B, 0x45, 0xD0, 0x4C, 0x8B, 0x4D, 0xC8, 0xF3, 0x0F,
+			0x7E, 0x45, 0xC0, 0xF3, 0x0F, 0x7E, 0x4D, 0xB8, 0xF3, 0x0F, 0x7E, 0x55, 0xB0, 0xF3, 0x0F, 0x7E,
+			0x5D, 0xA8, 0x48, 0x8D, 0x65, 0xE8, 0x5F, 0x5E, 0x5B, 0x5D, 0xFF, 0x25, 0x50, 0x0F, 0x00, 0x00
+		};
+
+		#else
+
+		// The data is addressed absolutely, the relocations hold the offsets of the addresses relative to the beginning of the stub.
+		// ecx and edx are saved for the fastcall and thiscall conventions and restored before every callback and before jumping to the gateway.
+		// The callbacks get a copy of 16 stack arguments of the caller. The stack pointer is restored from ebp after every callback, since stdcall callbacks pop their arguments.
+		//
+		// ASM:
+		// push    ebp
+		// mov     ebp, esp
+		// push    ebx
+		// push    esi
+		// push    edi
+		// push    ecx
+		// push    edx
+		// mov     ebx, [callbacks]							the list is read once per call
+		// next:
+		// mov     eax, [ebx]
+		// test    eax, eax
+		// jz      done
+		// sub     esp, 64
+		// lea     esi, [ebp + 8]							stack arguments of the caller
+		// mov     edi, esp
+		// mov     ecx, 16
+		// rep movsd
+		// mov     ecx, [ebp - 0x10]
+		// mov     edx, [ebp - 0x14]
+		// call    eax
+		// lea     esp, [ebp - 0x14]
+		// add     ebx, 4
+		// jmp     next
+		// done:
+		// pop     edx
+		// pop     ecx
+		// pop     edi
+		// pop     esi
+		// pop     ebx
+		// pop     ebp
+		// jmp     dword ptr [gateway]						the origin function returns to the caller directly
+		static constexpr BYTE CHAIN_SHELL[]{
+			0x55, 0x89, 0xE5, 0x53, 0x56, 0x57, 0x51, 0x52, 0x8B, 0x1D, 0x04, 0x10, 0x00, 0x00, 0x8B, 0x03,
+			0x85, 0xC0, 0x74, 0x1F, 0x83, 0xEC, 0x40, 0x8D, 0x75, 0x08, 0x89, 0xE7, 0xB9, 0x10, 0x00, 0x00,
+			0x00, 0xF3, 0xA5, 0x8B, 0x4D, 0xF0, 0x8B, 0x55, 0xEC, 0xFF, 0xD0, 0x8D, 0x65, 0xEC, 0x83, 0xC3,
+			0x04, 0xEB, 0xDB, 0x5A, 0x59, 0x5F, 0x5E, 0x5B, 0x5D, 0xFF, 0x25, 0x00, 0x10, 0x00, 0x00
+		};
+
+		static constexpr shellcode::AbsSlot<uint32_t> CHAIN_RELOCATIONS[]{ 0x0A, 0x3B };
+		static_assert(shellcode::fits(CHAIN_SHELL, CHAIN_RELOCATIONS), "Relocation out of shell code.");
+
+		#endif // _WIN64
+
+		// allocates and writes the dispatcher stub
+		static BYTE* createStub();
+
+		ChainHook::ChainHook(BYTE* origin, size_t size) : _code{ createStub() }, _hook(origin, _code, size), _pLists{}, _lock{ SRWLOCK_INIT } {
+			this->publish(new CallbackList{ new BYTE*[1]{}, nullptr, 0u, nullptr });
+		}
+
+
+		ChainHook::ChainHook(const char* modName, const char* funcName, size_t size) :
+			_code{ createStub() }, _hook(modName, funcName, _code, size), _pLists{}, _lock{ SRWLOCK_INIT }
+		{
+			this->publish(new CallbackList{ new BYTE*[1]{}, nullptr, 0u, nullptr });
+		}
+
+
+		ChainHook::~ChainHook() {
+			this->disable();
+
+			// the origin still jumps to the stub if it could not be restored, so the stub and the callback lists it reads are leaked
+			if (this->_hook.isHooked()) return;
+
+			shellcode::freeStub(this->_code);
+
+			while (this->_pLists) {
+				CallbackList* const pNext = this->_pLists->pNext;
+				delete[] this->_pLists->callbacks;
+				delete[] this->_pLists->priorities;
+				delete this->_pLists;
+				this->_pLists = pNext;
+			}
+
+		}
+
+
+		bool ChainHook::enable() {
+
+			if (this->_hook._hooked || !this->_code || !this->_hook._origin) return false;
+
+			if (!this->_hook.prepare()) return false;
+
+			// the stub has to know the gateway before the first call reaches it
+			reinterpret_cast<ChainData*>(this->_code + CHAIN_DATA_OFFSET)->gateway = this->_hook._gateway;
+
+			if (!mem::in::patchAtomic(this->_hook._origin, this->_hook._jump, this->_hook._size)) {
+				this->_hook.release();
+
+				return false;
+			}
+
+			this->_hook._hooked = true;
+
+			return true;
+		}
+
+
+		bool ChainHook::disable() {
+
+			return this->_hook.disable();
+		}
+
+
+		bool ChainHook::isHooked() const {
+
+			return this->_hook.isHooked();
+		}
+
+
+		bool ChainHook::add(const BYTE* callback, int priority) {
+
+			if (!callback) return false;
+
+			AcquireSRWLockExclusive(&this->_lock);
+
+			const CallbackList* const pCur = this->_pLists;
+
+			for (size_t i = 0u; i < pCur->count; i++) {
+
+				if (pCur->callbacks[i] == callback) {
+					ReleaseSRWLockExclusive(&this->_lock);
+
+					return false;
+				}
+
+			}
+
+			CallbackList* const pNew = new CallbackList{};
+			pNew->count = pCur->count + 1u;
+			pNew->callbacks = new BYTE*[pNew->count + 1u]{};
+			pNew->priorities = new int[pNew->count]{};
+
+			size_t index = 0u;
+			bool isInserted = false;
+
+			for (size_t i = 0u; i < pCur->count; i++) {
+
+				// behind all callbacks of the same priority
+				if (!isInserted && pCur->priorities[i] > priority) {
+					pNew->callbacks[index] = const_cast<BYTE*>(callback);
+					pNew->priorities[index] = priority;
+					index++;
+					isInserted = true;
+				}
+
+				pNew->callbacks[index] = pCur->callbacks[i];
+				pNew->priorities[index] = pCur->priorities[i];
+				index++;
+			}
+
+			if (!isInserted) {
+				pNew->callbacks[index] = const_cast<BYTE*>(callback);
+				pNew->priorities[index] = priority;
+			}
+
+			this->publish(pNew);
+
+			ReleaseSRWLockExclusive(&this->_lock);
+
+			return true;
+		}
+
+
+		bool ChainHook::remove(const BYTE* callback) {
+
+			if (!callback) return false;
+
+			AcquireSRWLockExclusive(&this->_lock);
+
+			const CallbackList* const pCur = this->_pLists;
+			bool isFound = false;
+
+			for (size_t i = 0u; i < pCur->count; i++) {
+
+				if (pCur->callbacks[i] == callback) {
+					isFound = true;
+
+					break;
+				}
+
+			}
+
+			if (!isFound) {
+				ReleaseSRWLockExclusive(&this->_lock);
+
+				return false;
+			}
+
+			CallbackList* const pNew = new CallbackList{};
+			pNew->count = pCur->count - 1u;
+			pNew->callbacks = new BYTE*[pNew->count + 1u]{};
+			pNew->priorities = pNew->count ? new int[pNew->count]{} : nullptr;
+
+			size_t index = 0u;
+
+			for (size_t i = 0u; i < pCur->count; i++) {
+
+				if (pCur->callbacks[i] == callback) continue;
+
+				pNew->callbacks[index] = pCur->callbacks[i];
+				pNew->priorities[index] = pCur->priorities[i];
+				index++;
+			}
+
+			this->publish(pNew);
+
+			ReleaseSRWLockExclusive(&this->_lock);
+
+			return true;
+		}
+
+
+		size_t ChainHook::getCount() const {
+			AcquireSRWLockShared(&this->_lock);
+			const size_t count = this->_pLists->count;
+			ReleaseSRWLockShared(&this->_lock);
+
+			return count;
+		}
+
+
+		BYTE* ChainHook::getOrigin() const {
+
+			return this->_hook.getOrigin();
+		}
+
+
+		BYTE* ChainHook::getDetour() const {
+
+			return this->_code;
+		}
+
+
+		BYTE* ChainHook::getGateway() const {
+
+			return this->_hook.getGateway();
+		}
+
+
+		void ChainHook::publish(CallbackList* pList) {
+			pList->pNext = this->_pLists;
+			this->_pLists = pList;
+
+			if (this->_code) {
+				ChainData* const pData = reinterpret_cast<ChainData*>(this->_code + CHAIN_DATA_OFFSET);
+				InterlockedExchangePointer(reinterpret_cast<void* volatile*>(const_cast<BYTE***>(&pData->callbacks)), pList->callbacks);
+			}
+
+			return;
+		}
+
+
+		static BYTE* createStub() {
+
+			#ifdef _WIN64
+
+			return shellcode::createStub(CHAIN_SHELL, sizeof(CHAIN_SHELL), CHAIN_DATA_OFFSET, sizeof(ChainData));
+
+			#else
+
+			return shellcode::createStub(CHAIN_SHELL, sizeof(CHAIN_SHELL), CHAIN_DATA_OFFSET, sizeof(ChainData), CHAIN_RELOCATIONS, _countof(CHAIN_RELOCATIONS));
+
+			#endif // _WIN64
+
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+#include "TrampHook.h"
+
+namespace hax {
+
+	namespace in {
+
+		// Class to chain multiple callbacks on a single trampoline hook inside the caller process.
+		// The origin function jumps to a dispatcher stub that calls every registered callback in order with a copy of the arguments and then jumps to the gateway.
+		// The origin function is executed once with the original arguments and returns directly to its caller, so its return value is not touched by the callbacks.
+		// The callbacks have to use the same calling convention and parameters as the origin function. Their return values are ignored.
+		// The registers holding arguments are restored before every callback. Of the arguments on the stack 16 pointer sized values are copied for every callback.
+		// Dispatching costs an indirect call per callback. The stub reads the list of callbacks once per call and takes no locks.
+		// Registering or unregistering a callback builds a new list and exchanges it atomically, so the list can be changed at any time while the hook is enabled.
+		// A call already in progress still uses the list from its beginning, so an unregistered callback might be called once more by another thread.
+		// Replaced lists are kept until destruction of the object, since threads might still iterate them.
+		// Exceptions must not be unwound through the dispatcher stub, since no unwind information is registered for it.
+		// The hook automatically uninstalls on desctuction of the installing object.
+		class ChainHook : public IHook {
+		private:
+			struct CallbackList;
+
+			// dispatcher stub, the data it reads is placed on the page after it
+			BYTE* const _code;
+			TrampHook _hook;
+			// current list first, replaced lists after it
+			CallbackList* _pLists;
+			mutable SRWLOCK _lock;
+
+		public:
+			// Initializes members.
+			//
+			// Parameters:
+			//
+			// [in] origin:
+			// Address of the origin function to be hooked. At least the first five bytes will be overwritten.
+			//
+			// [in] size:
+			// Number of bytes that get overwritten by the jump at the beginning of the origin function. See TrampHook.
+			// Pass 0 to determine the size on enabling the hook by decoding the instructions at the beginning of the origin function.
+			ChainHook(BYTE* origin, size_t size = 0u);
+
+			// Initializes members. Used to hook an exported function of a module by module name and export name.
+			//
+			// Parameters:
+			//
+			// [in] modName:
+			// Name of the module that exports the function to be hooked.
+			//
+			// [in] funcName:
+			// Export name of the function to be hooked.
+			//
+			// [in] size:
+			// Number of bytes that get overwritten by the jump at the beginning of the origin function. See TrampHook.
+			// Pass 0 to determine the size on enabling the hook by decoding the instructions at the beginning of the origin function.
+			ChainHook(const char* modName, const char* funcName, size_t size = 0u);
+
+			~ChainHook();
+
+			// Enables the hook. Execution of origin function is redirected to the dispatcher stub after calling this method.
+			// The gateway is known to the stub before the origin function gets patched.
+			//
+			// Return: True on success, false on failure
+			bool enable();
+
+			// Disables the hook. Execution of origin function is restored after calling this method. The registered callbacks are kept.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool disable();
+
+			// Checks if the hook is currently installed.
+			//
+			// Return:
+			// True if the hook is installed, false if it is not installed.
+			bool isHooked() const;
+
+			// Registers a callback. Can be called before or after enabling the hook.
+			//
+			// Parameters:
+			//
+			// [in] callback:
+			// Address of the callback function. Each callback can only be registered once.
+			//
+			// [in] priority:
+			// Callbacks with lower priority get called first. Callbacks with equal priority get called in the order they were registered.
+			//
+			// Return:
+			// True on success, false on failure or if the callback is already registered.
+			bool add(const BYTE* callback, int priority = 0);
+
+			// Unregisters a callback. Can be called before or after enabling the hook.
+			//
+			// Parameters:
+			//
+			// [in] callback:
+			// Address of the callback function.
+			//
+			// Return:
+			// True on success, false if the callback is not registered.
+			bool remove(const BYTE* callback);
+
+			// Gets the number of registered callbacks.
+			size_t getCount() const;
+
+			BYTE* getOrigin() const;
+			// Gets the address of the dispatcher stub.
+			BYTE* getDetour() const;
+			BYTE* getGateway() const;
+
+		private:
+			// makes a list the current one and keeps the replaced one
+			void publish(CallbackList* pList);
+		};
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "HookGroup.h"
+#include "..\mem.h"
+#include <stdint.h>
+
+namespace hax {
+
+	namespace in {
+
+		HookGroup::HookGroup(bool suspend) : _pHooks{}, _count{}, _capacity{}, _suspend{ suspend }, _enabled{} {}
+
+
+		HookGroup::~HookGroup() {
+			this->disable();
+
+			if (this->_pHooks) {
+				delete[] this->_pHooks;
+			}
+
+		}
+
+
+		bool HookGroup::add(TrampHook* pHook) {
+
+			if (this->_enabled || !pHook || pHook->_hooked) return false;
+
+			for (size_t i = 0u; i < this->_count; i++) {
+
+				if (this->_pHooks[i] == pHook) return false;
+
+			}
+
+			if (this->_count == this->_capacity) {
+				const size_t newCapacity = this->_capacity ? this->_capacity * 2u : 0x10u;
+				TrampHook** const pNewHooks = new TrampHook*[newCapacity]{};
+
+				if (this->_pHooks) {
+					memcpy(pNewHooks, this->_pHooks, this->_count * sizeof(TrampHook*));
+					delete[] this->_pHooks;
+				}
+
+				this->_pHooks = pNewHooks;
+				this->_capacity = newCapacity;
+			}
+
+			this->_pHooks[this->_count] = pHook;
+			this->_count++;
+
+			return true;
+		}
+
+
+		bool HookGroup::enable() {
+
+			if (this->_enabled || !this->_count) return false;
+
+			for (size_t i = 0u; i < this->_count; i++) {
+				const TrampHook* const pHook = this->_pHooks[i];
+
+				if (pHook->_hooked || !pHook->_origin || !pHook->_detour) return false;
+
+			}
+
+			// write all gateways before the first origin gets patched
+			for (size_t i = 0u; i < this->_count; i++) {
+
+				if (!this->_pHooks[i]->prepare()) {
+					this->releaseGateways();
+
+					return false;
+				}
+
+			}
+
+			// the sizes of the hooks are known after preparing them
+			size_t* const pOrder = this->getOrder();
+
+			if (!pOrder) {
+				this->releaseGateways();
+
+				return false;
+			}
+
+			ThreadSuspender suspender;
+
+			if (this->_suspend && !this->suspendThreads(&suspender)) {
+				delete[] pOrder;
+				this->releaseGateways();
+
+				return false;
+			}
+
+			const size_t patched = this->patch(pOrder, this->_count, false);
+
+			// roll back the origins already patched
+			if (patched != this->_count) {
+				this->patch(pOrder, patched, true);
+			}
+
+			suspender.resume();
+			delete[] pOrder;
+
+			if (patched != this->_count) {
+				this->releaseGateways();
+
+				return false;
+			}
+
+			for (size_t i = 0u; i < this->_count; i++) {
+				this->_pHooks[i]->_hooked = true;
+			}
+
+			this->_enabled = true;
+
+			return true;
+		}
+
+
+		bool HookGroup::disable() {
+
+			if (!this->_enabled) return false;
+
+			size_t* const pOrder = this->getOrder();
+
+			if (!pOrder) return false;
+
+			ThreadSuspender suspender;
+
+			if (this->_suspend && !this->suspendThreads(&suspender)) {
+				delete[] pOrder;
+
+				return false;
+			}
+
+			const size_t restored = this->patch(pOrder, this->_count, true);
+
+			// patch the jumps back to the origins already restored
+			if (restored != this->_count) {
+				this->patch(pOrder, restored, false);
+			}
+
+			suspender.resume();
+			delete[] pOrder;
+
+			if (restored != this->_count) return false;
+
+			for (size_t i = 0u; i < this->_count; i++) {
+				this->_pHooks[i]->_hooked = false;
+			}
+
+			this->_enabled = false;
+
+			return this->releaseGateways();
+		}
+
+
+		bool HookGroup::isEnabled() const {
+
+			return this->_enabled;
+		}
+
+
+		size_t HookGroup::getCount() const {
+
+			return this->_count;
+		}
+
+
+		size_t* HookGroup::getOrder() const {
+			size_t* const pOrder = new size_t[this->_count]{};
+
+			// insertion sort of the hooks by the address of their origin
+			for (size_t i = 0u; i < this->_count; i++) {
+				size_t j = i;
+
+				while (j && this->_pHooks[pOrder[j - 1u]]->_origin > this->_pHooks[i]->_origin) {
+					pOrder[j] = pOrder[j - 1u];
+					j--;
+				}
+
+				pOrder[j] = i;
+			}
+
+			// two hooks of the group overwriting the same bytes can not be restored
+			for (size_t i = 1u; i < this->_count; i++) {
+				const TrampHook* const pPrev = this->_pHooks[pOrder[i - 1u]];
+
+				if (pPrev->_origin + pPrev->_size > this->_pHooks[pOrder[i]]->_origin) {
+					delete[] pOrder;
+
+					return nullptr;
+				}
+
+			}
+
+			return pOrder;
+		}
+
+
+		size_t HookGroup::patch(const size_t order[], size_t count, bool restore) const {
+
+			// other threads might be executing the origins, so each one is written without exposing a partially written jump
+			if (!this->_suspend) {
+
+				for (size_t i = 0u; i < count; i++) {
+					const TrampHook* const pCur = this->_pHooks[order[i]];
+
+					if (!mem::in::patchAtomic(pCur->_origin, restore ? pCur->_stolen : pCur->_jump, pCur->_size)) return i;
+
+				}
+
+				return count;
+			}
+
+			SYSTEM_INFO sysInfo{};
+			GetSystemInfo(&sysInfo);
+			const uintptr_t pageSize = static_cast<uintptr_t>(sysInfo.dwPageSize);
+			const uintptr_t pageMask = ~(pageSize - 1u);
+
+			size_t first = 0u;
+
+			while (first < count) {
+				const uintptr_t start = reinterpret_cast<uintptr_t>(this->_pHooks[order[first]]->_origin) & pageMask;
+				MEMORY_BASIC_INFORMATION mbi{};
+
+				if (!VirtualQuery(reinterpret_cast<void*>(start), &mbi, sizeof(mbi))) return first;
+
+				const uintptr_t regionEnd = reinterpret_cast<uintptr_t>(mbi.BaseAddress) + mbi.RegionSize;
+				uintptr_t end = start;
+				size_t last = first;
+
+				// coalesce the origins within adjacent pages of the same region, so the protection is changed once for all of them
+				while (last < count) {
+					const TrampHook* const pCur = this->_pHooks[order[last]];
+					const uintptr_t curStart = reinterpret_cast<uintptr_t>(pCur->_origin) & pageMask;
+					const uintptr_t curEnd = (reinterpret_cast<uintptr_t>(pCur->_origin) + pCur->_size + pageSize - 1u) & pageMask;
+
+					if (last != first && (curStart > end || curEnd > regionEnd)) break;
+
+					if (curEnd > end) {
+						end = curEnd;
+					}
+
+					last++;
+				}
+
+				DWORD protect = 0ul;
+
+				if (!VirtualProtect(reinterpret_cast<void*>(start), end - start, PAGE_EXECUTE_READWRITE, &protect)) return first;
+
+				for (size_t i = first; i < last; i++) {
+					const TrampHook* const pCur = this->_pHooks[order[i]];
+
+					if (memcpy_s(pCur->_origin, pCur->_size, restore ? pCur->_stolen : pCur->_jump, pCur->_size)) {
+						VirtualProtect(reinterpret_cast<void*>(start), end - start, protect, &protect);
+
+						return i;
+					}
+
+				}
+
+				VirtualProtect(reinterpret_cast<void*>(start), end - start, protect, &protect);
+				FlushInstructionCache(GetCurrentProcess(), reinterpret_cast<void*>(start), end - start);
+
+				first = last;
+			}
+
+			return count;
+		}
+
+
+		bool HookGroup::suspendThreads(ThreadSuspender* pSuspender) const {
+			PatchRange* const pRanges = new PatchRange[this->_count]{};
+
+			for (size_t i = 0u; i < this->_count; i++) {
+				pRanges[i].address = this->_pHooks[i]->_origin;
+				pRanges[i].size = this->_pHooks[i]->_size;
+			}
+
+			const bool success = pSuspender->suspend(pRanges, this->_count);
+			delete[] pRanges;
+
+			return success;
+		}
+
+
+		bool HookGroup::releaseGateways() {
+			bool success = true;
+
+			for (size_t i = 0u; i < this->_count; i++) {
+
+				if (this->_pHooks[i]->_gateway && !this->_pHooks[i]->release()) {
+					success = false;
+				}
+
+			}
+
+			return success;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include "TrampHook.h"
+#include "ThreadSuspender.h"
+
+namespace hax {
+
+	namespace in {
+
+		// Class to enable and disable multiple trampoline hooks inside the caller process at once.
+		// All gateways are written before the first origin function gets patched. The gateways share the arenas of the gateway pool of the trampoline hooks.
+		// The origin functions are then patched in a single pass that changes the page protection only once for origins within the same pages of a memory region.
+		// Optionally all other threads of the process are suspended once for the whole pass, so no thread executes code in which only some of the hooks are installed.
+		// Without suspending the threads each origin function is patched on its own via mem::in::patchAtomic, so running threads never execute a partially written jump.
+		// If any step fails the origin functions already patched are restored and the gateways are freed, so either all hooks of the group are enabled or none.
+		// The group does not own the hooks. They have to outlive the group and should not be enabled or disabled individually while they are part of the group.
+		// The group automatically disables the hooks on destruction of the object.
+		class HookGroup {
+		private:
+			TrampHook** _pHooks;
+			size_t _count;
+			size_t _capacity;
+			const bool _suspend;
+			bool _enabled;
+
+		public:
+			// Initializes members.
+			//
+			// Parameters:
+			//
+			// [in] suspend:
+			// Suspend all other threads of the caller process while the origin functions are patched.
+			// Patching is retried while a thread executes within the bytes overwritten by a hook.
+			// Threads created while the hooks are enabled or disabled are not suspended.
+			HookGroup(bool suspend = true);
+
+			~HookGroup();
+
+			// Adds a hook to the group. Only possible while the group is disabled.
+			//
+			// Parameters:
+			//
+			// [in] pHook:
+			// Pointer to the hook. The hook has to be disabled.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool add(TrampHook* pHook);
+
+			// Enables all hooks of the group. Execution of all origin functions is redirected after calling this method.
+			//
+			// Return:
+			// True on success, false on failure. On failure none of the hooks is enabled.
+			bool enable();
+
+			// Disables all hooks of the group. Execution of all origin functions is restored after calling this method.
+			//
+			// Return:
+			// True on success, false on failure. If the origin functions can not be restored all hooks stay enabled.
+			// It is possible that the unhooking of the origin functions succeeds but the deallocation of a gateway fails.
+			// In this case the function will also return false but the group is disabled.
+			bool disable();
+
+			// Checks if the hooks of the group are currently enabled.
+			//
+			// Return:
+			// True if the hooks are enabled, false if they are disabled.
+			bool isEnabled() const;
+
+			size_t getCount() const;
+
+		private:
+			size_t* getOrder() const;
+			size_t patch(const size_t order[], size_t count, bool restore) const;
+			bool suspendThreads(ThreadSuspender* pSuspender) const;
+			bool releaseGateways();
+		};
+
+	}
+
+}
\ No newline at end of file
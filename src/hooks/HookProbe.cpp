@@ -0,0 +1,384 @@
+#include "HookProbe.h"
+#include "..\shellcode.h"
+#include <intrin.h>
+#include <stddef.h>
+
+namespace hax {
+
+	namespace in {
+
+		// number of measured calls that can be in progress at the same time
+		constexpr size_t SLOT_COUNT = 0x40u;
+		// durations below four cycles get a bucket each, every power of two above is split into four buckets
+		constexpr size_t BUCKET_COUNT = 0x100u;
+		constexpr uint32_t DEFAULT_SAMPLE_INTERVAL = 0x10u;
+		// the data is placed on the pages after the stubs, so writes of the stubs do not hit the page they are executed from
+		constexpr size_t DATA_OFFSET = 0x1000u;
+
+		// slot of a measured call in progress, each on a cache line of its own
+		typedef struct alignas(0x40) ProbeSlot {
+			// address the return address of the call was stored at, zero while the slot is free
+			volatile uintptr_t key;
+			uintptr_t returnAddress;
+			// time stamp counter at the entry of the detour function
+			uint64_t start;
+			// sum of the durations measured in this slot
+			volatile uint64_t cycles;
+		}ProbeSlot;
+
+		typedef struct ProbeData {
+			const BYTE* detour;
+			volatile uint32_t sampleMask;
+			alignas(0x40) volatile uint64_t calls;
+			ProbeSlot slots[SLOT_COUNT];
+			volatile uint64_t histogram[BUCKET_COUNT];
+		}ProbeData;
+
+		// the stubs address the data by these offsets
+		static_assert(offsetof(ProbeData, calls) == 0x40u && offsetof(ProbeData, slots) == 0x80u && offsetof(ProbeData, histogram) == 0x1080u, "Unexpected probe data layout.");
+
+		#ifdef _WIN64
+
+		// The data is addressed relative to the instruction pointer and located at DATA_OFFSET from the beginning of the stubs.
+		// The volatile registers rax, r10 and r11 are used by the entry stub, rdx is preserved since it holds the second argument.
+		// The exit stub preserves rax and rdx and uses rcx, r10 and r11.
+		//
+		// ASM:
+		// entry:
+		// mov     eax, 1
+		// lock xadd [rip + calls], rax				count the call
+		// test    eax, [rip + sampleMask]				only every interval-th call is measured
+		// jnz     untimed
+		// lea     r10, [rip + exitStub]
+		// cmp     [rsp], r10							tail call of the detour function back into the probe
+		// je      untimed
+		// push    rdx
+		// rdtsc
+		// shl     rdx, 32
+		// or      rdx, rax
+		// lea     r11, [rsp + 8]						address of the return address identifies the call
+		// lea     r10, [rip + slots]
+		// claim:
+		// xor     eax, eax
+		// lock cmpxchg [r10], r11						claim a free slot
+		// je      claimed
+		// add     r10, 64
+		// lea     rax, [rip + slots + SLOT_COUNT * 0x40]
+		// cmp     r10, rax
+		// jb      claim
+		// pop     rdx
+		// jmp     untimed
+		// claimed:
+		// mov     [r10 + 16], rdx
+		// mov     rax, [r11]
+		// mov     [r10 + 8], rax
+		// lea     rax, [rip + exitStub]
+		// mov     [r11], rax							return to the exit stub
+		// pop     rdx
+		// untimed:
+		// jmp     qword ptr [rip + detour]
+		// exitStub:
+		// sub     rsp, 8
+		// push    rax
+		// push    rdx
+		// rdtsc
+		// shl     rdx, 32
+		// or      rdx, rax
+		// lea     r11, [rsp + 16]						address the return address was popped from
+		// lea     r10, [rip + slots]
+		// find:
+		// cmp     [r10], r11
+		// je      found
+		// add     r10, 64
+		// lea     rax, [rip + slots + SLOT_COUNT * 0x40]
+		// cmp     r10, rax
+		// jb      find
+		// int3
+		// found:
+		// mov     rax, [r10 + 8]
+		// mov     [rsp + 16], rax						original return address
+		// sub     rdx, [r10 + 16]						duration
+		// add     [r10 + 24], rdx
+		// mov     qword ptr [r10], 0					free the slot
+		// mov     r10, rdx
+		// cmp     rdx, 4
+		// jb      bucket
+		// bsr     rcx, rdx
+		// sub     ecx, 2
+		// shr     r10, cl
+		// and     r10d, 3
+		// lea     r10, [r10 + rcx * 4 + 8]
+		// bucket:
+		// lea     r11, [rip + histogram]
+		// lock inc qword ptr [r11 + r10 * 8]			bucket index = 4 * log2(duration) + next two bits
+		// pop     rdx
+		// pop     rax
+		// ret
+		static constexpr BYTE PROBE_SHELL[]{
+			0xB8, 0x01, 0x00, 0x00, 0x00, 0xF0, 0x48, 0x0F, 0xC1, 0x05, 0x32, 0x10, 0x00, 0x00, 0x85, 0x05,
+			0xF4, 0x0F, 0x00, 0x00, 0x75, 0x55, 0x4C, 0x8D, 0x15, 0x54, 0x00, 0x00, 0x00, 0x4C, 0x39, 0x14,
+			0x24, 0x74, 0x48, 0x52, 0x0F, 0x31, 0x48, 0xC1, 0xE2, 0x20, 0x48, 0x09, 0xC2, 0x4C, 0x8D, 0x5C,
+			0x24, 0x08, 0x4C, 0x8D, 0x15, 0x47, 0x10, 0x00, 0x00, 0x31, 0xC0, 0xF0, 0x4D, 0x0F, 0xB1, 0x1A,
+			0x74, 0x13, 0x49, 0x83, 0xC2, 0x40, 0x48, 0x8D, 0x05, 0x33, 0x20, 0x00, 0x00, 0x49, 0x39, 0xC2,
+			0x72, 0xE7, 0x5A, 0xEB, 0x16, 0x49, 0x89, 0x52, 0x10, 0x49, 0x8B, 0x03, 0x49, 0x89, 0x42, 0x08,
+			0x48, 0x8D, 0x05, 0x0A, 0x00, 0x00, 0x00, 0x49, 0x89, 0x03, 0x5A, 0xFF, 0x25, 0x8F, 0x0F, 0x00,
+			0x00, 0x48, 0x83, 0xEC, 0x08, 0x50, 0x52, 0x0F, 0x31, 0x48, 0xC1, 0xE2, 0x20, 0x48, 0x09, 0xC2,
+			0x4C, 0x8D, 0x5C, 0x24, 0x10, 0x4C, 0x8D, 0x15, 0xF4, 0x0F, 0x00, 0x00, 0x4D, 0x39, 0x1A, 0x74,
+			0x11, 0x49, 0x83, 0xC2, 0x40, 0x48, 0x8D, 0x05, 0xE4, 0x1F, 0x00, 0x00, 0x49, 0x39, 0xC2, 0x72,
+			0xEB, 0xCC, 0x49, 0x8B, 0x42, 0x08, 0x48, 0x89, 0x44, 0x24, 0x10, 0x49, 0x2B, 0x52, 0x10, 0x49,
+			0x01, 0x52, 0x18, 0x49, 0xC7, 0x02, 0x00, 0x00, 0x00, 0x00, 0x49, 0x89, 0xD2, 0x48, 0x83, 0xFA,
+			0x04, 0x72, 0x13, 0x48, 0x0F, 0xBD, 0xCA, 0x83, 0xE9, 0x02, 0x49, 0xD3, 0xEA, 0x41, 0x83, 0xE2,
+			0x03, 0x4D, 0x8D, 0x54, 0x8A, 0x08, 0x4C, 0x8D, 0x1D, 0xA3, 0x1F, 0x00, 0x00, 0xF0, 0x4B, 0xFF,
+			0x04, 0xD3, 0x5A, 0x58, 0xC3
+		};
+
+		#else
+
+		// The data is addressed absolutely, the relocations hold the offsets of the addresses relative to the beginning of the stubs.
+		// The entry stub only uses eax and preserves ecx and edx for the fastcall and thiscall conventions.
+		// The exit stub preserves eax and edx and uses ecx.
+		//
+		// ASM:
+		// entry:
+		// mov     eax, 1
+		// lock xadd [calls], eax							count the call
+		// lock adc dword ptr [calls + 0x4], 0
+		// test    eax, [sampleMask]						only every interval-th call is measured
+		// jnz     untimed
+		// cmp     dword ptr [esp], exitStub				tail call of the detour function back into the probe
+		// je      untimed
+		// push    edx
+		// push    ecx
+		// push    ebx
+		// push    esi
+		// rdtsc
+		// mov     ecx, eax
+		// mov     esi, edx
+		// lea     ebx, [esp + 16]						address of the return address identifies the call
+		// mov     edx, slots
+		// claim:
+		// xor     eax, eax
+		// lock cmpxchg [edx], ebx						claim a free slot
+		// je      claimed
+		// add     edx, 64
+		// cmp     edx, slots + SLOT_COUNT * 0x40
+		// jb      claim
+		// pop     esi
+		// pop     ebx
+		// pop     ecx
+		// pop     edx
+		// jmp     untimed
+		// claimed:
+		// mov     [edx + 8], ecx
+		// mov     [edx + 12], esi
+		// mov     eax, [ebx]
+		// mov     [edx + 4], eax
+		// mov     dword ptr [ebx], exitStub				return to the exit stub
+		// pop     esi
+		// pop     ebx
+		// pop     ecx
+		// pop     edx
+		// untimed:
+		// jmp     dword ptr [detour]
+		// exitStub:
+		// sub     esp, 4
+		// push    eax
+		// push    edx
+		// push    ebx
+		// push    esi
+		// rdtsc
+		// lea     ebx, [esp + 20]						stack pointer after the return, arguments might have been popped by the callee
+		// mov     esi, slots
+		// find:
+		// mov     ecx, ebx
+		// sub     ecx, [esi]
+		// dec     ecx
+		// cmp     ecx, 0x1000							slot of the innermost call below the stack pointer
+		// jb      found
+		// add     esi, 64
+		// cmp     esi, slots + SLOT_COUNT * 0x40
+		// jb      find
+		// int3
+		// found:
+		// mov     ecx, [esi + 4]
+		// mov     [esp + 16], ecx						original return address
+		// sub     eax, [esi + 8]
+		// sbb     edx, [esi + 12]						duration
+		// add     [esi + 16], eax
+		// adc     [esi + 20], edx
+		// mov     dword ptr [esi], 0						free the slot
+		// test    edx, edx
+		// jnz     high
+		// cmp     eax, 4
+		// jb      small
+		// bsr     ecx, eax
+		// mov     ebx, eax
+		// sub     ecx, 2
+		// shr     ebx, cl
+		// jmp     mant
+		// high:
+		// bsr     ecx, edx
+		// cmp     ecx, 2
+		// jb      lowShift
+		// mov     ebx, edx
+		// sub     ecx, 2
+		// shr     ebx, cl
+		// add     ecx, 32
+		// jmp     mant
+		// lowShift:
+		// add     ecx, 30
+		// mov     ebx, eax
+		// shrd    ebx, edx, cl
+		// mant:
+		// and     ebx, 3
+		// lea     ebx, [ebx + ecx * 4 + 8]
+		// jmp     bucket
+		// small:
+		// mov     ebx, eax
+		// bucket:
+		// lock add dword ptr [histogram + ebx * 8], 1	bucket index = 4 * log2(duration) + next two bits
+		// lock adc dword ptr [histogram + 0x4 + ebx * 8], 0
+		// pop     esi
+		// pop     ebx
+		// pop     edx
+		// pop     eax
+		// ret
+		static constexpr BYTE PROBE_SHELL[]{
+			0xB8, 0x01, 0x00, 0x00, 0x00, 0xF0, 0x0F, 0xC1, 0x05, 0x40, 0x10, 0x00, 0x00, 0xF0, 0x83, 0x15,
+			0x44, 0x10, 0x00, 0x00, 0x00, 0x85, 0x05, 0x04, 0x10, 0x00, 0x00, 0x75, 0x4A, 0x81, 0x3C, 0x24,
+			0x6D, 0x00, 0x00, 0x00, 0x74, 0x41, 0x52, 0x51, 0x53, 0x56, 0x0F, 0x31, 0x89, 0xC1, 0x89, 0xD6,
+			0x8D, 0x5C, 0x24, 0x10, 0xBA, 0x80, 0x10, 0x00, 0x00, 0x31, 0xC0, 0xF0, 0x0F, 0xB1, 0x1A, 0x74,
+			0x11, 0x83, 0xC2, 0x40, 0x81, 0xFA, 0x80, 0x20, 0x00, 0x00, 0x72, 0xED, 0x5E, 0x5B, 0x59, 0x5A,
+			0xEB, 0x15, 0x89, 0x4A, 0x08, 0x89, 0x72, 0x0C, 0x8B, 0x03, 0x89, 0x42, 0x04, 0xC7, 0x03, 0x6D,
+			0x00, 0x00, 0x00, 0x5E, 0x5B, 0x59, 0x5A, 0xFF, 0x25, 0x00, 0x10, 0x00, 0x00, 0x83, 0xEC, 0x04,
+			0x50, 0x52, 0x53, 0x56, 0x0F, 0x31, 0x8D, 0x5C, 0x24, 0x14, 0xBE, 0x80, 0x10, 0x00, 0x00, 0x89,
+			0xD9, 0x2B, 0x0E, 0x49, 0x81, 0xF9, 0x00, 0x10, 0x00, 0x00, 0x72, 0x0C, 0x83, 0xC6, 0x40, 0x81,
+			0xFE, 0x80, 0x20, 0x00, 0x00, 0x72, 0xE8, 0xCC, 0x8B, 0x4E, 0x04, 0x89, 0x4C, 0x24, 0x10, 0x2B,
+			0x46, 0x08, 0x1B, 0x56, 0x0C, 0x01, 0x46, 0x10, 0x11, 0x56, 0x14, 0xC7, 0x06, 0x00, 0x00, 0x00,
+			0x00, 0x85, 0xD2, 0x75, 0x11, 0x83, 0xF8, 0x04, 0x72, 0x31, 0x0F, 0xBD, 0xC8, 0x89, 0xC3, 0x83,
+			0xE9, 0x02, 0xD3, 0xEB, 0xEB, 0x1C, 0x0F, 0xBD, 0xCA, 0x83, 0xF9, 0x02, 0x72, 0x0C, 0x89, 0xD3,
+			0x83, 0xE9, 0x02, 0xD3, 0xEB, 0x83, 0xC1, 0x20, 0xEB, 0x08, 0x83, 0xC1, 0x1E, 0x89, 0xC3, 0x0F,
+			0xAD, 0xD3, 0x83, 0xE3, 0x03, 0x8D, 0x5C, 0x8B, 0x08, 0xEB, 0x02, 0x89, 0xC3, 0xF0, 0x83, 0x04,
+			0xDD, 0x80, 0x20, 0x00, 0x00, 0x01, 0xF0, 0x83, 0x14, 0xDD, 0x84, 0x20, 0x00, 0x00, 0x00, 0x5E,
+			0x5B, 0x5A, 0x58, 0xC3
+		};
+
+		static constexpr shellcode::AbsSlot<uint32_t> PROBE_RELOCATIONS[]{ 0x09, 0x10, 0x17, 0x20, 0x35, 0x46, 0x5F, 0x69, 0x7B, 0x91, 0xF1, 0xFA };
+		static_assert(shellcode::fits(PROBE_SHELL, PROBE_RELOCATIONS), "Relocation out of shell code.");
+
+		#endif // _WIN64
+
+		// gets the largest duration counted in a histogram bucket
+		static uint64_t getBucketBound(size_t index);
+
+		HookProbe::HookProbe(const BYTE* detour) : _code{}, _startTime{}, _startCycles{} {
+
+			#ifdef _WIN64
+
+			this->_code = shellcode::createStub(PROBE_SHELL, sizeof(PROBE_SHELL), DATA_OFFSET, sizeof(ProbeData));
+
+			#else
+
+			this->_code = shellcode::createStub(PROBE_SHELL, sizeof(PROBE_SHELL), DATA_OFFSET, sizeof(ProbeData), PROBE_RELOCATIONS, _countof(PROBE_RELOCATIONS));
+
+			#endif // _WIN64
+
+			if (!this->_code) return;
+
+			ProbeData* const pData = reinterpret_cast<ProbeData*>(this->_code + DATA_OFFSET);
+			pData->detour = detour;
+			pData->sampleMask = DEFAULT_SAMPLE_INTERVAL - 1u;
+
+			QueryPerformanceCounter(&this->_startTime);
+			this->_startCycles = __rdtsc();
+		}
+
+
+		HookProbe::~HookProbe() {
+			shellcode::freeStub(this->_code);
+		}
+
+
+		BYTE* HookProbe::getEntry() const {
+
+			return this->_code;
+		}
+
+
+		bool HookProbe::setSampleInterval(uint32_t interval) {
+
+			if (!this->_code || !interval || (interval & (interval - 1u))) return false;
+
+			reinterpret_cast<ProbeData*>(this->_code + DATA_OFFSET)->sampleMask = interval - 1u;
+
+			return true;
+		}
+
+
+		bool HookProbe::getCallStats(CallStats* pStats) const {
+
+			if (!this->_code) return false;
+
+			const ProbeData* const pData = reinterpret_cast<const ProbeData*>(this->_code + DATA_OFFSET);
+
+			LARGE_INTEGER frequency{};
+			LARGE_INTEGER time{};
+
+			if (!QueryPerformanceFrequency(&frequency) || !QueryPerformanceCounter(&time)) return false;
+
+			const uint64_t cycles = __rdtsc();
+			const double seconds = static_cast<double>(time.QuadPart - this->_startTime.QuadPart) / static_cast<double>(frequency.QuadPart);
+
+			if (seconds <= 0.) return false;
+
+			// the frequency of the time stamp counter is derived from the time passed since the creation of the probe
+			const double cyclesPerMicrosecond = static_cast<double>(cycles - this->_startCycles) / (seconds * 1000000.);
+
+			uint64_t timedCalls = 0u;
+
+			for (size_t i = 0u; i < BUCKET_COUNT; i++) {
+				timedCalls += pData->histogram[i];
+			}
+
+			uint64_t timedCycles = 0u;
+
+			for (size_t i = 0u; i < SLOT_COUNT; i++) {
+				timedCycles += pData->slots[i].cycles;
+			}
+
+			// the bucket the measured call at the 99th percentile was counted in
+			const uint64_t rank = timedCalls - timedCalls / 100u;
+			uint64_t counted = 0u;
+			size_t bucket = 0u;
+
+			while (bucket < BUCKET_COUNT - 1u) {
+				counted += pData->histogram[bucket];
+
+				if (counted >= rank) break;
+
+				bucket++;
+			}
+
+			pStats->calls = pData->calls;
+			pStats->timedCalls = timedCalls;
+			pStats->callsPerSecond = static_cast<double>(pStats->calls) / seconds;
+			pStats->meanCycles = timedCalls ? static_cast<double>(timedCycles) / static_cast<double>(timedCalls) : 0.;
+			pStats->p99Cycles = timedCalls ? getBucketBound(bucket) : 0u;
+			pStats->meanMicroseconds = cyclesPerMicrosecond > 0. ? pStats->meanCycles / cyclesPerMicrosecond : 0.;
+			pStats->p99Microseconds = cyclesPerMicrosecond > 0. ? static_cast<double>(pStats->p99Cycles) / cyclesPerMicrosecond : 0.;
+
+			return true;
+		}
+
+
+		static uint64_t getBucketBound(size_t index) {
+
+			if (index < 4u) return index;
+
+			// the bound of the last bucket wraps around to UINT64_MAX
+			return ((5ull + index % 4u) << (index / 4u - 2u)) - 1u;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+
+// Instrumentation of the calls of a detour function.
+// Trampoline hooks are only instrumented if the library is compiled with HAX_HOOK_PROBES defined. Otherwise no probe is created and execution is redirected to the detour function directly.
+
+namespace hax {
+
+	namespace in {
+
+		// Statistics of the calls of a detour function.
+		typedef struct CallStats {
+			// calls of the detour function since the probe was created
+			uint64_t calls;
+			// calls of which the duration was measured
+			uint64_t timedCalls;
+			double callsPerSecond;
+			// mean duration of the measured calls in time stamp counter cycles
+			double meanCycles;
+			// upper bound of the duration of 99 percent of the measured calls in time stamp counter cycles, accurate to a quarter of the value
+			uint64_t p99Cycles;
+			double meanMicroseconds;
+			double p99Microseconds;
+		}CallStats;
+
+		// Class to count the calls of a detour function inside the caller process and to measure their duration.
+		// The probe consists of an entry stub that gets executed instead of the detour function and jumps to it and an exit stub the detour function returns to.
+		// The entry stub counts the call with a single atomic increment. For every sampled call it reads the time stamp counter, claims one of the slots for calls in progress
+		// with an atomic compare exchange and replaces the return address on the stack with the address of the exit stub.
+		// The exit stub reads the time stamp counter again, adds the duration to the claimed slot, increments the histogram bucket of the duration, frees the slot
+		// and returns to the original return address. A slot is only written by the thread that claimed it, so no locks are taken on any path.
+		// Tail calls from the detour function back into the probe and calls while all slots are claimed are counted but not timed.
+		// Exceptions must not be unwound through a timed call of the detour function, since the unwinder can not find the original return address.
+		// The probe has to outlive all calls of the detour function in progress.
+		class HookProbe {
+		private:
+			BYTE* _code;
+			LARGE_INTEGER _startTime;
+			uint64_t _startCycles;
+
+		public:
+			// Initializes members and writes the stubs.
+			//
+			// Parameters:
+			//
+			// [in] detour:
+			// Address of the detour function the entry stub jumps to.
+			HookProbe(const BYTE* detour);
+
+			~HookProbe();
+
+			// Gets the address of the entry stub. Execution should be redirected to this address instead of the detour function.
+			//
+			// Return:
+			// Address of the entry stub or nullptr if the stubs could not be written.
+			BYTE* getEntry() const;
+
+			// Sets how many calls are counted per measured call. Measuring a call costs two reads of the time stamp counter and two mispredicted returns.
+			// The default interval is 0x10.
+			//
+			// Parameters:
+			//
+			// [in] interval:
+			// Every interval-th call is measured. Has to be a power of two. Pass 1 to measure every call.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool setSampleInterval(uint32_t interval);
+
+			// Gets the statistics of the calls since the probe was created. The values are read while calls might be in progress, so they are not a consistent snapshot.
+			//
+			// Parameters:
+			//
+			// [out] pStats:
+			// Pointer to a buffer that receives the statistics.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool getCallStats(CallStats* pStats) const;
+		};
+
+	}
+
+}
\ No newline at end of file
@@ -7,60 +7,65 @@ namespace hax {
 
 	namespace ex {
 
-		IatHook::IatHook(HANDLE hProc, HMODULE hImportMod, const char* exportModName, const char* funcName, const BYTE* shell, size_t shellSize, const char* originCallPattern) :
-			_hProc{ hProc }, _origin{}, _detour{}, _pIatEntry{}, _hooked{}, _isWow64Proc{}
+		IatHook::IatHook(
+			HANDLE hProc, HMODULE hImportMod, const char* exportModName, const char* funcName, const BYTE* shell, size_t shellSize, const char* originCallPattern, mem::RemotePool* pPool
+		) : IatHook(hProc, hImportMod, exportModName, funcName, shell, shellSize, shellcode::findSlot(shell, shellSize, originCallPattern), pPool) {}
+
+
+		IatHook::IatHook(
+			HANDLE hProc, HMODULE hImportMod, const char* exportModName, const char* funcName, const BYTE* shell, size_t shellSize, shellcode::Slot originCall, mem::RemotePool* pPool
+		) : _hProc{ hProc }, _pPool{ pPool }, _origin{}, _detour{}, _pIatEntry{}, _hooked{}, _isWow64Proc{}
 		{
 			IsWow64Process(this->_hProc, &this->_isWow64Proc);
 			this->_pIatEntry = proc::ex::getIatEntryAddress(this->_hProc, hImportMod, exportModName, funcName);
+			size_t ptrSize = 0u;
 
-			if (this->_pIatEntry) {
-
-				if (this->_isWow64Proc) {
-					// saves original IAT entry
-					ReadProcessMemory(this->_hProc, this->_pIatEntry, &this->_origin, sizeof(uint32_t), nullptr);
-				}
-				else {
+			if (this->_isWow64Proc) {
+				ptrSize = sizeof(uint32_t);
+			}
+			else {
 
-					#ifdef _WIN64
+				#ifdef _WIN64
 
-					// saves original IAT entry
-					ReadProcessMemory(this->_hProc, this->_pIatEntry, &this->_origin, sizeof(uint64_t), nullptr);
-					
-					#endif // _WIN64
+				ptrSize = sizeof(uint64_t);
 
-				}
+				#endif // _WIN64
 
 			}
 
-			if (originCallPattern) {
-				// scan for the origin call in the shell code
-				BYTE* const shellOriginCall = mem::in::findSigAddress(shell, shellSize, originCallPattern);
-
-				if (shellOriginCall) {
-					
-					if (this->_isWow64Proc) {
-						memcpy_s(shellOriginCall, sizeof(uint32_t), &this->_origin, sizeof(uint32_t));
-					}
-					else {
+			if (this->_pIatEntry && ptrSize) {
+				// saves original IAT entry
+				ReadProcessMemory(this->_hProc, this->_pIatEntry, &this->_origin, ptrSize, nullptr);
+			}
 
-						#ifdef _WIN64
+			if (!shell) return;
 
-						memcpy_s(shellOriginCall, sizeof(uint64_t), &this->_origin, sizeof(uint64_t));
+			// copy the shell code so the placeholder can be replaced without modifying the passed buffer
+			BYTE* const shellCopy = new BYTE[shellSize]{};
 
-						#endif // _WIN64
+			if (memcpy_s(shellCopy, shellSize, shell, shellSize)) {
+				delete[] shellCopy;
 
-					}
-				
-				}
+				return;
+			}
 
+			// the placeholder is replaced with the origin function by a direct store
+			if (ptrSize && originCall.offset != shellcode::INVALID_OFFSET && originCall.offset <= shellSize && shellSize - originCall.offset >= ptrSize) {
+				memcpy(shellCopy + originCall.offset, &this->_origin, ptrSize);
 			}
 
-			this->_detour = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, shellSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+			if (this->_pPool) {
+				this->_detour = this->_pPool->allocate(shellSize);
+			}
+			else {
+				this->_detour = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, shellSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+			}
 
-			if (this->_detour && shell) {
-				WriteProcessMemory(hProc, this->_detour, shell, shellSize, nullptr);
+			if (this->_detour) {
+				WriteProcessMemory(hProc, this->_detour, shellCopy, shellSize, nullptr);
 			}
 
+			delete[] shellCopy;
 		}
 
 
@@ -68,7 +73,14 @@ namespace hax {
 			this->disable();
 
 			if (this->_detour) {
-				VirtualFreeEx(this->_hProc, this->_detour, 0, MEM_RELEASE);
+
+				if (this->_pPool) {
+					this->_pPool->free(this->_detour);
+				}
+				else {
+					VirtualFreeEx(this->_hProc, this->_detour, 0, MEM_RELEASE);
+				}
+
 			}
 
 		}
@@ -1,5 +1,7 @@
 #pragma once
 #include "IHook.h"
+#include "..\RemotePool.h"
+#include "..\shellcode.h"
 
 namespace hax {
 
@@ -8,9 +10,9 @@ namespace hax {
 		// Class to set up an import address table hook inside a module of an external process.
 		// It injects shell code into the target process which gets called instead of the origin function via the import address table.
 		// The shell code can contain a call of a placeholder address with the same calling convention as the origin function to ensure uninterrupted process execution.
-		// This placeholder pointer in the shell code gets replaced with the address of the origin function via pattern scanning at runtime.
-		// It is neccessary to use a value unique within the shell code (eg. 0XDEADBEEF for x86) as the placeholder.
-		// This pattern has to be passed as an argument on object construction.
+		// This placeholder pointer in the shell code gets replaced with the address of the origin function before the shell code is written to the target.
+		// The placeholder is either passed as a slot of a shell code template (see shellcode.h) or as a pattern that is scanned for in the shell code.
+		// It is neccessary to use a value unique within the shell code (eg. 0XDEADBEEF for x86) for a pattern.
 		// When the origin function gets called by the target process (after enabling the hook) execution jumps to the injected shell code via import address table.
 		// At the call of the placeholder execution jumps back to the origin function.
 		// Compiled to x64 the hook works both on x86 and x64 targets. Compiled to x86 it only works on x86 targets.
@@ -19,6 +21,7 @@ namespace hax {
 		class IatHook : public IHook {
 		private:
 			const HANDLE _hProc;
+			mem::RemotePool* const _pPool;
 			BYTE* _origin;
 			BYTE* _detour;
 			BYTE* _pIatEntry;
@@ -49,8 +52,27 @@ namespace hax {
 			// Pattern of the origin function call in the shell code. The pattern has to be of the format:
 			// "EF BE DA DE". "??" can be used as wildcards. Mind the endianness!
 			// Can be nullptr if there is no call to the origin function in the shell code.
+			//
+			// [in] pPool:
+			// Pool the shell code is allocated from. Has to be created for the same target process and has to outlive the hook.
+			// If nullptr is passed the shell code gets a VirtualAllocEx allocation of its own.
 			IatHook(
-				HANDLE hProc, HMODULE hImportMod, const char* funcName, const char* exportModName, const BYTE* shell, size_t shellSize, const char* originCallPattern
+				HANDLE hProc, HMODULE hImportMod, const char* funcName, const char* exportModName, const BYTE* shell, size_t shellSize, const char* originCallPattern,
+				mem::RemotePool* pPool = nullptr
+			);
+
+			// Initializes members. Takes the slot of the origin call placeholder of a shell code template instead of a pattern.
+			// 
+			// Parameters:
+			// 
+			// [in] originCall:
+			// Slot of the origin call placeholder within the shell code template.
+			// Has to be a shellcode::AbsSlot<uint32_t> for x86 targets and a shellcode::AbsSlot<uint64_t> for x64 targets.
+			// 
+			// See the constructor taking a pattern for the other parameters.
+			IatHook(
+				HANDLE hProc, HMODULE hImportMod, const char* funcName, const char* exportModName, const BYTE* shell, size_t shellSize, shellcode::Slot originCall,
+				mem::RemotePool* pPool = nullptr
 			);
 
 
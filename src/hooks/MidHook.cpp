@@ -0,0 +1,310 @@
+#include "MidHook.h"
+#include "TrampHook.h"
+#include "ThreadSuspender.h"
+#include "..\mem.h"
+#include "..\instr.h"
+#include "..\shellcode.h"
+#include <stddef.h>
+
+namespace hax {
+
+	namespace in {
+
+		// the data is placed on the page after the stub, so the stub is executed from a page that does not get written
+		constexpr size_t MID_DATA_OFFSET = 0x1000u;
+		// size of the relative jump patched to the hooked address
+		constexpr size_t MID_JUMP_SIZE = 5u;
+
+		typedef struct MidData {
+			BYTE* gateway;
+			tMidHookCallback callback;
+		}MidData;
+
+		// the stub addresses the data by these offsets
+		static_assert(offsetof(MidData, callback) == sizeof(void*), "Unexpected mid hook data layout.");
+
+		#ifdef _WIN64
+
+		static_assert(sizeof(MidHookContext) == 17u * sizeof(uintptr_t), "Unexpected mid hook context layout.");
+
+		// The data is addressed relative to the instruction pointer and located at MID_DATA_OFFSET from the beginning of the stub.
+		// The pushed registers form the context. The pushed value of rsp is replaced by the stack pointer at the hooked address and discarded on return.
+		// The stack is aligned to 16 bytes below the context and holds the home space and the volatile xmm registers. rbx is non-volatile, so it survives the call.
+		//
+		// ASM:
+		// pushfq
+		// push    rax
+		// push    rcx
+		// push    rdx
+		// push    rbx
+		// push    rsp
+		// push    rbp
+		// push    rsi
+		// push    rdi
+		// push    r8
+		// push    r9
+		// push    r10
+		// push    r11
+		// push    r12
+		// push    r13
+		// push    r14
+		// push    r15
+		// lea     rax, [rsp + 0x88]						stack pointer at the hooked address
+		// mov     [rsp + 0x58], rax
+		// mov     rbx, rsp
+		// and     rsp, -16
+		// sub     rsp, 0x80								home space and xmm0-xmm5
+		// movaps  [rsp + 0x20], xmm0
+		// movaps  [rsp + 0x30], xmm1
+		// movaps  [rsp + 0x40], xmm2
+		// movaps  [rsp + 0x50], xmm3
+		// movaps  [rsp + 0x60], xmm4
+		// movaps  [rsp + 0x70], xmm5
+		// mov     rcx, rbx									pointer to the context
+		// cld
+		// call    qword ptr [rip + callback]
+		// movaps  xmm0, [rsp + 0x20]
+		// movaps  xmm1, [rsp + 0x30]
+		// movaps  xmm2, [rsp + 0x40]
+		// movaps  xmm3, [rsp + 0x50]
+		// movaps  xmm4, [rsp + 0x60]
+		// movaps  xmm5, [rsp + 0x70]
+		// mov     rsp, rbx
+		// pop     r15
+		// pop     r14
+		// pop     r13
+		// pop     r12
+		// pop     r11
+		// pop     r10
+		// pop     r9
+		// pop     r8
+		// pop     rdi
+		// pop     rsi
+		// pop     rbp
+		// add     rsp, 8									skip rsp
+		// pop     rbx
+		// pop     rdx
+		// pop     rcx
+		// pop     rax
+		// popfq
+		// jmp     qword ptr [rip + gateway]				executes the stolen instructions and jumps back behind them
+		static constexpr BYTE MID_SHELL[]{
+			0x9C, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x41, 0x50, 0x41, 0x51, 0x41, 0x52, 0x41,
+			0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, 0x48, 0x8D, 0x84, 0x24, 0x88, 0x00, 0x00,
+			0x00, 0x48, 0x89, 0x44, 0x24, 0x58, 0x48, 0x89, 0xE3, 0x48, 0x83, 0xE4, 0xF0, 0x48, 0x81, 0xEC,
+			0x80, 0x00, 0x00, 0x00, 0x0F, 0x29, 0x44, 0x24, 0x20, 0x0F, 0x29, 0x4C, 0x24, 0x30, 0x0F, 0x29,
+			0x54, 0x24, 0x40, 0x0F, 0x29, 0x5C, 0x24, 0x50, 0x0F, 0x29, 0x64, 0x24, 0x60, 0x0F, 0x29, 0x6C,
+			0x24, 0x70, 0x48, 0x89, 0xD9, 0xFC, 0xFF, 0x15, 0xAC, 0x0F, 0x00, 0x00, 0x0F, 0x28, 0x44, 0x24,
+			0x20, 0x0F, 0x28, 0x4C, 0x24, 0x30, 0x0F, 0x28, 0x54, 0x24, 0x40, 0x0F, 0x28, 0x5C, 0x24, 0x50,
+			0x0F, 0x28, 0x64, 0x24, 0x60, 0x0F, 0x28, 0x6C, 0x24, 0x70, 0x48, 0x89, 0xDC, 0x41, 0x5F, 0x41,
+			0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x41, 0x5B, 0x41, 0x5A, 0x41, 0x59, 0x41, 0x58, 0x5F, 0x5E, 0x5D,
+			0x48, 0x83, 0xC4, 0x08, 0x5B, 0x5A, 0x59, 0x58, 0x9D, 0xFF, 0x25, 0x61, 0x0F, 0x00, 0x00
+		};
+
+		#else
+
+		static_assert(sizeof(MidHookContext) == 9u * sizeof(uintptr_t), "Unexpected mid hook context layout.");
+
+		// The data is addressed absolutely, the relocations hold the offsets of the addresses relative to the beginning of the stub.
+		// pushad and pushfd form the context. The pushed value of esp is replaced by the stack pointer at the hooked address and discarded by popad.
+		// The stack is aligned to 16 bytes below the context and holds the argument and xmm0-xmm7. ebx is non-volatile, so it survives the call.
+		//
+		// ASM:
+		// pushfd
+		// pushad
+		// lea     eax, [esp + 0x24]						stack pointer at the hooked address
+		// mov     [esp + 0xC], eax
+		// mov     ebx, esp
+		// and     esp, -16
+		// sub     esp, 0x90								argument and xmm0-xmm7
+		// movaps  [esp + 0x10], xmm0
+		// movaps  [esp + 0x20], xmm1
+		// movaps  [esp + 0x30], xmm2
+		// movaps  [esp + 0x40], xmm3
+		// movaps  [esp + 0x50], xmm4
+		// movaps  [esp + 0x60], xmm5
+		// movaps  [esp + 0x70], xmm6
+		// movaps  [esp + 0x80], xmm7
+		// mov     [esp], ebx								pointer to the context
+		// cld
+		// call    dword ptr [callback]
+		// movaps  xmm0, [esp + 0x10]
+		// movaps  xmm1, [esp + 0x20]
+		// movaps  xmm2, [esp + 0x30]
+		// movaps  xmm3, [esp + 0x40]
+		// movaps  xmm4, [esp + 0x50]
+		// movaps  xmm5, [esp + 0x60]
+		// movaps  xmm6, [esp + 0x70]
+		// movaps  xmm7, [esp + 0x80]
+		// mov     esp, ebx
+		// popad
+		// popfd
+		// jmp     dword ptr [gateway]						executes the stolen instructions and jumps back behind them
+		static constexpr BYTE MID_SHELL[]{
+			0x9C, 0x60, 0x8D, 0x44, 0x24, 0x24, 0x89, 0x44, 0x24, 0x0C, 0x89, 0xE3, 0x83, 0xE4, 0xF0, 0x81,
+			0xEC, 0x90, 0x00, 0x00, 0x00, 0x0F, 0x29, 0x44, 0x24, 0x10, 0x0F, 0x29, 0x4C, 0x24, 0x20, 0x0F,
+			0x29, 0x54, 0x24, 0x30, 0x0F, 0x29, 0x5C, 0x24, 0x40, 0x0F, 0x29, 0x64, 0x24, 0x50, 0x0F, 0x29,
+			0x6C, 0x24, 0x60, 0x0F, 0x29, 0x74, 0x24, 0x70, 0x0F, 0x29, 0xBC, 0x24, 0x80, 0x00, 0x00, 0x00,
+			0x89, 0x1C, 0x24, 0xFC, 0xFF, 0x15, 0x04, 0x10, 0x00, 0x00, 0x0F, 0x28, 0x44, 0x24, 0x10, 0x0F,
+			0x28, 0x4C, 0x24, 0x20, 0x0F, 0x28, 0x54, 0x24, 0x30, 0x0F, 0x28, 0x5C, 0x24, 0x40, 0x0F, 0x28,
+			0x64, 0x24, 0x50, 0x0F, 0x28, 0x6C, 0x24, 0x60, 0x0F, 0x28, 0x74, 0x24, 0x70, 0x0F, 0x28, 0xBC,
+			0x24, 0x80, 0x00, 0x00, 0x00, 0x89, 0xDC, 0x61, 0x9D, 0xFF, 0x25, 0x00, 0x10, 0x00, 0x00
+		};
+
+		static constexpr shellcode::AbsSlot<uint32_t> MID_RELOCATIONS[]{ 0x46, 0x7B };
+		static_assert(shellcode::fits(MID_SHELL, MID_RELOCATIONS), "Relocation out of shell code.");
+
+		#endif // _WIN64
+
+		// allocates and writes the stub
+		static BYTE* createStub(tMidHookCallback callback);
+
+		MidHook::MidHook(BYTE* address, tMidHookCallback callback, size_t size, bool suspend) :
+			_address(address), _callback(callback), _code{ createStub(callback) }, _gateway{}, _size(size), _stolen{}, _suspend{ suspend }, _hooked{} {}
+
+
+		MidHook::~MidHook() {
+			this->disable();
+
+			// the hooked address still jumps to the stub if it could not be restored, so the stub is leaked
+			if (!this->_hooked) {
+				shellcode::freeStub(this->_code);
+			}
+
+			delete[] this->_stolen;
+		}
+
+
+		bool MidHook::enable() {
+
+			if (this->_hooked || !this->_code || !this->_address) return false;
+
+			if (!this->_size) {
+
+				#ifdef _WIN64
+
+				constexpr bool x64 = true;
+
+				#else
+
+				constexpr bool x64 = false;
+
+				#endif // _WIN64
+
+				// the address might be close to the end of the readable memory
+				const size_t codeSize = mem::in::getReadableSize(this->_address, instr::MAX_STOLEN_SIZE + instr::MAX_LENGTH);
+				instr::StolenRange range{};
+
+				if (!instr::getStolenRange(this->_address, codeSize, MID_JUMP_SIZE, x64, &range)) return false;
+
+				this->_size = range.size;
+			}
+
+			delete[] this->_stolen;
+			this->_stolen = new BYTE[this->_size]{};
+
+			// save the overwritten bytes to patch them back on disabling
+			if (memcpy_s(this->_stolen, this->_size, this->_address, this->_size)) return false;
+
+			BYTE* const jump = new BYTE[this->_size]{};
+			this->_gateway = mem::in::prepareTrampHook(this->_address, this->_code, this->_size, SIZE_MAX, getGatewayPool(), jump);
+
+			if (!this->_gateway) {
+				delete[] jump;
+
+				return false;
+			}
+
+			// the stub has to know the gateway before the first execution reaches it
+			reinterpret_cast<MidData*>(this->_code + MID_DATA_OFFSET)->gateway = this->_gateway;
+
+			const bool success = this->patch(jump);
+			delete[] jump;
+
+			if (!success) {
+				getGatewayPool()->free(this->_gateway);
+				this->_gateway = nullptr;
+
+				return false;
+			}
+
+			this->_hooked = true;
+
+			return true;
+		}
+
+
+		bool MidHook::disable() {
+
+			if (!this->_hooked || !this->_gateway) return false;
+
+			// patch the stolen bytes back, the gateway only contains them with relocated relative operands
+			if (!this->patch(this->_stolen)) return false;
+
+			const bool success = getGatewayPool()->free(this->_gateway);
+			this->_gateway = nullptr;
+			this->_hooked = false;
+
+			return success;
+		}
+
+
+		bool MidHook::isHooked() const {
+
+			return this->_hooked;
+		}
+
+
+		BYTE* MidHook::getOrigin() const {
+
+			return this->_address;
+		}
+
+
+		BYTE* MidHook::getDetour() const {
+
+			return this->_code;
+		}
+
+
+		BYTE* MidHook::getGateway() const {
+
+			return this->_gateway;
+		}
+
+
+		bool MidHook::patch(const BYTE src[]) const {
+			ThreadSuspender suspender;
+			const PatchRange range{ this->_address, this->_size };
+
+			// a thread within the overwritten bytes would resume in the middle of an instruction
+			if (this->_suspend && !suspender.suspend(&range, 1u)) return false;
+
+			return mem::in::patchAtomic(this->_address, src, this->_size);
+		}
+
+
+		static BYTE* createStub(tMidHookCallback callback) {
+
+			if (!callback) return nullptr;
+
+			#ifdef _WIN64
+
+			BYTE* const code = shellcode::createStub(MID_SHELL, sizeof(MID_SHELL), MID_DATA_OFFSET, sizeof(MidData));
+
+			#else
+
+			BYTE* const code = shellcode::createStub(MID_SHELL, sizeof(MID_SHELL), MID_DATA_OFFSET, sizeof(MidData), MID_RELOCATIONS, _countof(MID_RELOCATIONS));
+
+			#endif // _WIN64
+
+			if (!code) return nullptr;
+
+			reinterpret_cast<MidData*>(code + MID_DATA_OFFSET)->callback = callback;
+
+			return code;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+#include "IHook.h"
+#include <stdint.h>
+
+namespace hax {
+
+	namespace in {
+
+		#ifdef _WIN64
+
+		// Registers at the hooked address. Ordered as they are pushed by the stub of a mid-function hook.
+		typedef struct MidHookContext {
+			uintptr_t r15;
+			uintptr_t r14;
+			uintptr_t r13;
+			uintptr_t r12;
+			uintptr_t r11;
+			uintptr_t r10;
+			uintptr_t r9;
+			uintptr_t r8;
+			uintptr_t rdi;
+			uintptr_t rsi;
+			uintptr_t rbp;
+			// stack pointer at the hooked address, writes are ignored
+			uintptr_t rsp;
+			uintptr_t rbx;
+			uintptr_t rdx;
+			uintptr_t rcx;
+			uintptr_t rax;
+			uintptr_t rflags;
+		}MidHookContext;
+
+		#else
+
+		// Registers at the hooked address. Ordered as they are pushed by the stub of a mid-function hook.
+		typedef struct MidHookContext {
+			uintptr_t edi;
+			uintptr_t esi;
+			uintptr_t ebp;
+			// stack pointer at the hooked address, writes are ignored
+			uintptr_t esp;
+			uintptr_t ebx;
+			uintptr_t edx;
+			uintptr_t ecx;
+			uintptr_t eax;
+			uintptr_t eflags;
+		}MidHookContext;
+
+		#endif // _WIN64
+
+		// Callback of a mid-function hook. Values written to the context are loaded into the registers when the callback returns.
+		typedef void(__cdecl* tMidHookCallback)(MidHookContext* pContext);
+
+		// Class to hook an arbitrary instruction within a function inside the caller process, eg. in the body of a loop to read a register holding an object pointer.
+		// The hooked address jumps to a stub that pushes the general purpose registers and the flags as a MidHookContext and calls the callback with it.
+		// Afterwards the stub pops the possibly modified registers and jumps to the gateway, which executes the stolen instructions and jumps back behind them.
+		// The volatile SSE registers (xmm0-xmm5 for x64, xmm0-xmm7 for x86) are preserved across the callback, the upper halves of AVX registers are not.
+		// The stack is aligned for the callback, so the hooked address does not have to be at a function boundary.
+		// The overhead per execution is the stub, the indirect call of the callback and the jump through the gateway, so hot loop bodies can be hooked.
+		// None of the stolen instructions may be the target of a branch from outside of the stolen range.
+		// Unlike the first instructions of a function, the hooked instructions are usually executed by other threads (eg. in a hot loop) while the hook is enabled or disabled.
+		// A thread within the overwritten bytes would resume in the middle of the patched instruction, so by default all other threads are suspended while the address is patched
+		// and patching is retried while any of them executes within the overwritten bytes. Without suspending, enabling and disabling is only safe while no other thread can reach the address.
+		// The gateway is written with mem::in::prepareTrampHook and known to the stub before the hooked address gets patched. It is sub-allocated from the gateway pool of the trampoline hooks (see getGatewayPool).
+		// The hook automatically uninstalls on desctuction of the installing object.
+		class MidHook : public IHook {
+		private:
+			BYTE* const _address;
+			const tMidHookCallback _callback;
+			// stub, the data it reads is placed on the page after it
+			BYTE* _code;
+			BYTE* _gateway;
+			size_t _size;
+			// original bytes at the hooked address overwritten by the hook
+			BYTE* _stolen;
+			const bool _suspend;
+			bool _hooked;
+
+		public:
+			// Initializes members and writes the stub.
+			//
+			// Parameters:
+			//
+			// [in] address:
+			// Address of the first instruction that should be hooked. At least the first five bytes will be overwritten.
+			//
+			// [in] callback:
+			// Function called with the registers at the address on every execution of the hooked instruction.
+			//
+			// [in] size:
+			// Number of bytes that get overwritten by the jump at the address. Has to be at least five! Only complete instructions should be overwritten!
+			// Pass 0 to determine the size on enabling the hook by decoding the instructions at the address.
+			// The overwritten instructions are decoded either way and their relative operands are relocated to the gateway.
+			//
+			// [in] suspend:
+			// Suspend all other threads of the caller process while the address is patched on enabling and disabling.
+			// Patching is retried while a thread executes within the overwritten bytes. Only pass false if no other thread can execute the address meanwhile.
+			MidHook(BYTE* address, tMidHookCallback callback, size_t size = 0u, bool suspend = true);
+
+			~MidHook();
+
+			// Enables the hook. Execution of the hooked address is redirected after calling this method.
+			//
+			// Return: True on success, false on failure
+			bool enable();
+
+			// Disables the hook. Execution of the hooked address is restored after calling this method.
+			//
+			// Return:
+			// True on success, false on failure.
+			// It is possible that the unhooking succeeds but returning the gateway to the pool fails. In this case the function also returns false but the hook is disabled.
+			bool disable();
+
+			// Checks if the hook is currently installed.
+			//
+			// Return:
+			// True if the hook is installed, false if it is not installed.
+			bool isHooked() const;
+
+			// Gets the hooked address.
+			BYTE* getOrigin() const;
+			// Gets the address of the stub.
+			BYTE* getDetour() const;
+			BYTE* getGateway() const;
+
+		private:
+			// patches the hooked address while no other thread executes within the overwritten bytes
+			bool patch(const BYTE src[]) const;
+		};
+
+	}
+
+}
\ No newline at end of file
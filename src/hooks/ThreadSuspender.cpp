@@ -0,0 +1,172 @@
+#include "ThreadSuspender.h"
+#include "..\proc.h"
+#include <stdint.h>
+
+namespace hax {
+
+	namespace in {
+
+		// maximum attempts to suspend the threads while none of them executes the bytes overwritten by a patch
+		constexpr unsigned int SUSPEND_ATTEMPTS = 0x10u;
+
+		ThreadSuspender::ThreadSuspender() : _hThreads{}, _count{}, _suspended{} {}
+
+
+		ThreadSuspender::~ThreadSuspender() {
+			this->resume();
+		}
+
+
+		bool ThreadSuspender::suspend(const PatchRange ranges[], size_t rangeCount) {
+
+			if (this->_suspended || (rangeCount && !ranges)) return false;
+
+			if (!this->openThreads()) return false;
+
+			for (unsigned int i = 0u; i < SUSPEND_ATTEMPTS; i++) {
+				size_t suspended = 0u;
+
+				while (suspended < this->_count) {
+
+					// the thread might have exited since it was opened
+					if (SuspendThread(this->_hThreads[suspended]) == 0xFFFFFFFF && WaitForSingleObject(this->_hThreads[suspended], 0ul) != WAIT_OBJECT_0) break;
+
+					suspended++;
+				}
+
+				if (suspended == this->_count) {
+					bool isExecuted = false;
+
+					for (size_t j = 0u; j < this->_count && !isExecuted; j++) {
+						isExecuted = isExecuting(this->_hThreads[j], ranges, rangeCount);
+					}
+
+					if (!isExecuted) {
+						this->_suspended = true;
+
+						return true;
+					}
+
+				}
+
+				resumeThreads(this->_hThreads, suspended);
+
+				if (suspended != this->_count) break;
+
+				// give the thread executing the overwritten bytes the chance to leave them
+				Sleep(0ul);
+			}
+
+			this->closeThreads();
+
+			return false;
+		}
+
+
+		void ThreadSuspender::resume() {
+
+			if (this->_suspended) {
+				resumeThreads(this->_hThreads, this->_count);
+				this->_suspended = false;
+			}
+
+			this->closeThreads();
+
+			return;
+		}
+
+
+		bool ThreadSuspender::openThreads() {
+			const DWORD processId = GetCurrentProcessId();
+			proc::ProcessEntry procEntry{};
+
+			if (!proc::getProcessEntry(processId, &procEntry) || !procEntry.threadCount) return false;
+
+			proc::ThreadEntry* const pThreadEntries = new proc::ThreadEntry[procEntry.threadCount];
+
+			if (!proc::getProcessThreadEntries(processId, pThreadEntries, procEntry.threadCount)) {
+				delete[] pThreadEntries;
+
+				return false;
+			}
+
+			this->_hThreads = new HANDLE[procEntry.threadCount]{};
+			this->_count = 0u;
+			const DWORD currentThreadId = GetCurrentThreadId();
+
+			for (DWORD i = 0ul; i < procEntry.threadCount; i++) {
+
+				if (pThreadEntries[i].threadId == currentThreadId) continue;
+
+				const HANDLE hThread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | SYNCHRONIZE, FALSE, pThreadEntries[i].threadId);
+
+				// the thread might have exited since the snapshot
+				if (!hThread) continue;
+
+				this->_hThreads[this->_count] = hThread;
+				this->_count++;
+			}
+
+			delete[] pThreadEntries;
+
+			return true;
+		}
+
+
+		void ThreadSuspender::closeThreads() {
+
+			if (!this->_hThreads) return;
+
+			for (size_t i = 0u; i < this->_count; i++) {
+				CloseHandle(this->_hThreads[i]);
+			}
+
+			delete[] this->_hThreads;
+			this->_hThreads = nullptr;
+			this->_count = 0u;
+
+			return;
+		}
+
+
+		void ThreadSuspender::resumeThreads(const HANDLE hThreads[], size_t count) {
+
+			for (size_t i = 0u; i < count; i++) {
+				ResumeThread(hThreads[i]);
+			}
+
+			return;
+		}
+
+
+		bool ThreadSuspender::isExecuting(HANDLE hThread, const PatchRange ranges[], size_t rangeCount) {
+			CONTEXT context{};
+			context.ContextFlags = CONTEXT_CONTROL;
+
+			// context of an exited thread can not be retrieved but does not matter
+			if (!GetThreadContext(hThread, &context)) return WaitForSingleObject(hThread, 0ul) != WAIT_OBJECT_0;
+
+			#ifdef _WIN64
+
+			const uintptr_t ip = static_cast<uintptr_t>(context.Rip);
+
+			#else
+
+			const uintptr_t ip = static_cast<uintptr_t>(context.Eip);
+
+			#endif // _WIN64
+
+			for (size_t i = 0u; i < rangeCount; i++) {
+				const uintptr_t address = reinterpret_cast<uintptr_t>(ranges[i].address);
+
+				// a thread at the first byte executes the new instruction after patching
+				if (ip > address && ip < address + ranges[i].size) return true;
+
+			}
+
+			return false;
+		}
+
+	}
+
+}
\ No newline at end of file
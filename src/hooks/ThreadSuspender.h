@@ -0,0 +1,61 @@
+#pragma once
+#include <Windows.h>
+
+namespace hax {
+
+	namespace in {
+
+		// Range of code within the caller process that gets overwritten while the threads are suspended.
+		typedef struct PatchRange {
+			const BYTE* address;
+			size_t size;
+		}PatchRange;
+
+		// Class to suspend all other threads of the caller process while code is patched.
+		// Suspending is retried while a thread executes within the bytes that get overwritten, so no thread resumes in the middle of a patched instruction.
+		// A thread at the first byte of a range is not considered executing within it, because it executes the new instruction after patching.
+		// Threads created while the others are suspended are not suspended.
+		// The threads are resumed on destruction of the object.
+		class ThreadSuspender {
+		private:
+			HANDLE* _hThreads;
+			size_t _count;
+			bool _suspended;
+
+		public:
+			ThreadSuspender();
+
+			// Resumes the threads if they are still suspended.
+			~ThreadSuspender();
+
+			// owns the thread handles, so copies would close them twice
+			ThreadSuspender(const ThreadSuspender&) = delete;
+			ThreadSuspender& operator=(const ThreadSuspender&) = delete;
+
+			// Suspends all other threads of the caller process while none of them executes within the ranges.
+			//
+			// Parameters:
+			//
+			// [in] ranges:
+			// Ranges of code that get overwritten.
+			//
+			// [in] rangeCount:
+			// Number of ranges.
+			//
+			// Return:
+			// True on success, false on failure or if a thread kept executing within a range. On failure no thread is suspended.
+			bool suspend(const PatchRange ranges[], size_t rangeCount);
+
+			// Resumes the threads suspended by suspend().
+			void resume();
+
+		private:
+			bool openThreads();
+			void closeThreads();
+			static void resumeThreads(const HANDLE hThreads[], size_t count);
+			static bool isExecuting(HANDLE hThread, const PatchRange ranges[], size_t rangeCount);
+		};
+
+	}
+
+}
\ No newline at end of file
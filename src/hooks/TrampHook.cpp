@@ -1,64 +1,48 @@
 #include "TrampHook.h"
 #include "..\mem.h"
 #include "..\proc.h"
+#include "..\instr.h"
 
 namespace hax {
 
-	namespace ex {
-
-		TrampHook::TrampHook(HANDLE hProc, BYTE* origin, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relativeAddressOffset) :
-			_hProc(hProc), _origin(origin), _size(size), _detour{}, _detourOriginCall{}, _gateway{}, _relativeAddressOffset(relativeAddressOffset), _relativeAddress{}, _hooked{}
-		{
-			// save the original relative address to patch it back later
-			if (this->_relativeAddressOffset != SIZE_MAX && this->_origin + this->_relativeAddressOffset) {
-
-				if (!ReadProcessMemory(hProc, this->_origin + this->_relativeAddressOffset, &this->_relativeAddress, sizeof(this->_relativeAddress), nullptr)) return;
-
-			}
-			
-			this->_detour = static_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, sizeof(shell), MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+	// size of the relative jump patched to the beginning of the origin function
+	constexpr size_t JUMP_SIZE = 5u;
 
-			if (this->_detour && shell) {
+	namespace ex {
 
-				if (WriteProcessMemory(hProc, this->_detour, shell, shellSize, nullptr)) {
-					// scan for the origin call in the shell code injected into the target
-					this->_detourOriginCall = mem::ex::findSigAddress(hProc, this->_detour, shellSize, originCallPattern);
-				}
+		TrampHook::TrampHook(
+			HANDLE hProc, BYTE* origin, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relativeAddressOffset, mem::RemotePool* pPool
+		) : TrampHook(hProc, origin, shell, shellSize, shellcode::findSlot(shell, shellSize, originCallPattern), size, relativeAddressOffset, pPool) {}
 
-			}
 
+		TrampHook::TrampHook(
+			HANDLE hProc, BYTE* origin, const BYTE* shell, size_t shellSize, shellcode::Slot originCall, size_t size, size_t relativeAddressOffset, mem::RemotePool* pPool
+		) : _hProc(hProc), _pPool(pPool), _origin(origin), _size(size), _detour{}, _originCallOffset{ shellcode::INVALID_OFFSET }, _gateway{},
+			_relativeAddressOffset(relativeAddressOffset), _stolen{}, _hooked{}
+		{
+			this->inject(shell, shellSize, originCall);
 		}
 
 
 		TrampHook::TrampHook(
-			HANDLE hProc, const char* modName, const char* funcName, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relativeAddressOffset
-		) : _hProc(hProc), _size(size), _origin{}, _detour{}, _detourOriginCall{}, _gateway{}, _relativeAddressOffset(relativeAddressOffset), _relativeAddress{}, _hooked{}
-		{
-			
-			// save the original relative address to patch it back later
-			if (this->_relativeAddressOffset != SIZE_MAX && this->_origin + this->_relativeAddressOffset) {
+			HANDLE hProc, const char* modName, const char* funcName, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relativeAddressOffset,
+			mem::RemotePool* pPool
+		) : TrampHook(hProc, modName, funcName, shell, shellSize, shellcode::findSlot(shell, shellSize, originCallPattern), size, relativeAddressOffset, pPool) {}
 
-				if (!ReadProcessMemory(hProc, this->_origin + this->_relativeAddressOffset, &this->_relativeAddress, sizeof(this->_relativeAddress), nullptr)) return;
 
-			}
-			
+		TrampHook::TrampHook(
+			HANDLE hProc, const char* modName, const char* funcName, const BYTE* shell, size_t shellSize, shellcode::Slot originCall, size_t size, size_t relativeAddressOffset,
+			mem::RemotePool* pPool
+		) : _hProc(hProc), _pPool(pPool), _size(size), _origin{}, _detour{}, _originCallOffset{ shellcode::INVALID_OFFSET }, _gateway{},
+			_relativeAddressOffset(relativeAddressOffset), _stolen{}, _hooked{}
+		{
 			const HMODULE hMod = proc::ex::getModuleHandle(hProc, modName);
 
 			if (hMod) {
 				this->_origin = reinterpret_cast<BYTE*>(proc::ex::getProcAddress(hProc, hMod, funcName));
 			}
 
-			this->_detour = static_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, shellSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
-
-			if (this->_detour && shell) {
-
-				if (WriteProcessMemory(this->_hProc, this->_detour, shell, shellSize, nullptr)) {
-					// scan for the origin call in the shell code injected into the target
-					this->_detourOriginCall = mem::ex::findSigAddress(hProc, this->_detour, shellSize, originCallPattern);
-				}
-
-			}
-
+			this->inject(shell, shellSize, originCall);
 		}
 
 
@@ -66,18 +50,49 @@ namespace hax {
 			this->disable();
 
 			if (this->_detour) {
-				VirtualFreeEx(this->_hProc, this->_detour, 0, MEM_RELEASE);
+
+				if (this->_pPool) {
+					this->_pPool->free(this->_detour);
+				}
+				else {
+					VirtualFreeEx(this->_hProc, this->_detour, 0, MEM_RELEASE);
+				}
+
 			}
-			
+
+			delete[] this->_stolen;
 		}
 
 
 		bool TrampHook::enable() {
 
-			if (this->_hooked || !this->_origin || !this->_detour || !this->_detourOriginCall) return false;
+			if (this->_hooked || !this->_origin || !this->_detour || this->_originCallOffset == shellcode::INVALID_OFFSET) return false;
+
+			if (!this->_size) {
+				BYTE code[instr::MAX_STOLEN_SIZE + instr::MAX_LENGTH]{};
+				// the origin might be close to the end of the readable memory
+				const size_t codeSize = mem::ex::getReadableSize(this->_hProc, this->_origin, sizeof(code));
+
+				if (!codeSize || !ReadProcessMemory(this->_hProc, this->_origin, code, codeSize, nullptr)) return false;
+
+				BOOL isWow64 = FALSE;
+				IsWow64Process(this->_hProc, &isWow64);
+
+				instr::StolenRange range{};
+
+				if (!instr::getStolenRange(code, codeSize, JUMP_SIZE, !isWow64, &range)) return false;
+
+				this->_size = range.size;
+			}
+
+			delete[] this->_stolen;
+			this->_stolen = new BYTE[this->_size]{};
+
+			// save the overwritten bytes to patch them back on disabling
+			if (!ReadProcessMemory(this->_hProc, this->_origin, this->_stolen, this->_size, nullptr)) return false;
 
 			// install the trampoline hook
-			this->_gateway = mem::ex::trampHook(this->_hProc, this->_origin, this->_detour, this->_detourOriginCall - this->_detour, this->_size, this->_relativeAddressOffset);
+			this->_gateway = mem::ex::trampHook(this->_hProc, this->_origin, this->_detour, this->_originCallOffset, this->_size, this->_relativeAddressOffset, this->_pPool);
 
 			if (!this->_gateway) return false;
 
@@ -90,31 +105,13 @@ namespace hax {
 		bool TrampHook::disable() {
 			if (!this->_hooked || !this->_origin || !this->_gateway) return false;
 
-			// overwritten/stolen bytes
-			BYTE* const stolen = new BYTE[this->_size]{};
-
-			// read the stolen bytes from the gateway
-			if (!ReadProcessMemory(this->_hProc, this->_gateway, stolen, this->_size, nullptr)) {
-				delete[] stolen;
-
-				return false;
-			}
+			// patch the stolen bytes back, the gateway only contains them with relocated relative operands
+			if (!mem::ex::patch(this->_hProc, this->_origin, this->_stolen, this->_size)) return false;
 
-			// patch the saved relative address back
-			if (this->_relativeAddress) {
-				*reinterpret_cast<uint32_t*>(stolen + this->_relativeAddressOffset) = this->_relativeAddress;
-			}
-
-			// patch the stolen bytes back
-			if (!mem::ex::patch(this->_hProc, this->_origin, stolen, this->_size)) {
-				delete[] stolen;
-
-				return false;
-			}
-
-			delete[] stolen;
 			this->_hooked = false;
 
+			if (this->_pPool) return this->_pPool->free(this->_gateway);
+
 			return VirtualFreeEx(this->_hProc, this->_gateway, 0, MEM_RELEASE);
 		}
 
@@ -142,31 +139,48 @@ namespace hax {
 			return this->_gateway;
 		}
 
-	}
 
+		void TrampHook::inject(const BYTE* shell, size_t shellSize, shellcode::Slot originCall) {
 
-	namespace in {
+			if (!shell) return;
 
-		TrampHook::TrampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset) :
-			_origin(origin), _detour(detour), _size(size), _gateway{}, _hooked{}, _relativeAddressOffset(relativeAddressOffset), _relativeAddress{} {
-			const int32_t* const pRelativeAddress = reinterpret_cast<int32_t*>(this->_origin + this->_relativeAddressOffset);
+			if (this->_pPool) {
+				this->_detour = this->_pPool->allocate(shellSize);
+			}
+			else {
+				this->_detour = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, shellSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+			}
+
+			if (!this->_detour) return;
+
+			if (!WriteProcessMemory(this->_hProc, this->_detour, shell, shellSize, nullptr)) return;
+
+			BOOL isWow64 = FALSE;
+			IsWow64Process(this->_hProc, &isWow64);
+			const size_t ptrSize = isWow64 ? sizeof(uint32_t) : sizeof(uint64_t);
 
-			if (this->_relativeAddressOffset != SIZE_MAX && pRelativeAddress) {
-				this->_relativeAddress = *pRelativeAddress;
+			// the gateway address is written over the placeholder on enabling
+			if (originCall.offset != shellcode::INVALID_OFFSET && originCall.offset <= shellSize && shellSize - originCall.offset >= ptrSize) {
+				this->_originCallOffset = originCall.offset;
 			}
-		
+
+			return;
 		}
 
+	}
+
+
+	namespace in {
+
+		TrampHook::TrampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset) :
+			_origin(origin), _detour(detour), _size(size), _gateway{}, _hooked{}, _relativeAddressOffset(relativeAddressOffset), _stolen{}, _jump{}, _pProbe{},
+			_pRelaySlot{}, _softDisabled{} {}
+
 
 		TrampHook::TrampHook(const char* modName, const char* funcName, const BYTE* detour, size_t size, size_t relativeAddressOffset) :
-			_origin{}, _detour(detour), _size(size), _gateway{}, _hooked{}, _relativeAddressOffset(relativeAddressOffset), _relativeAddress{}
+			_origin{}, _detour(detour), _size(size), _gateway{}, _hooked{}, _relativeAddressOffset(relativeAddressOffset), _stolen{}, _jump{}, _pProbe{},
+			_pRelaySlot{}, _softDisabled{}
 		{
-			const int32_t* const pRelativeAddress = reinterpret_cast<int32_t*>(this->_origin + this->_relativeAddressOffset);
-			
-			if (this->_relativeAddressOffset != SIZE_MAX && pRelativeAddress) {
-				this->_relativeAddress = *pRelativeAddress;
-			}
-			
 			const HMODULE hMod = proc::in::getModuleHandle(modName);
 
 			if (hMod) {
@@ -178,6 +192,9 @@ namespace hax {
 
 		TrampHook::~TrampHook() {
 			this->disable();
+			delete[] this->_stolen;
+			delete[] this->_jump;
+			delete this->_pProbe;
 		}
 
 
@@ -185,9 +202,14 @@ namespace hax {
 
 			if (this->_hooked || !this->_origin || !this->_detour) return false;
 
-			this->_gateway = mem::in::trampHook(this->_origin, this->_detour, this->_size, this->_relativeAddressOffset);
+			if (!this->prepare()) return false;
 
-			if (!this->_gateway) return false;
+			// jump from the origin to the relay or the detour
+			if (!mem::in::patchAtomic(this->_origin, this->_jump, this->_size)) {
+				this->release();
+
+				return false;
+			}
 
 			this->_hooked = true;
 
@@ -199,38 +221,51 @@ namespace hax {
 
 			if (!this->_hooked || !this->_origin || !this->_gateway) return false;
 
-			// overwritten/stolen bytes
-			BYTE* const stolen = new BYTE[this->_size]{};
+			// patch the stolen bytes back, the gateway only contains them with relocated relative operands
+			if (!mem::in::patchAtomic(this->_origin, this->_stolen, this->_size)) return false;
 
-			// read the stolen bytes from the gateway
-			if (memcpy_s(stolen, this->_size, this->_gateway, this->_size)) {
-				delete[] stolen;
+			this->_hooked = false;
 
-				return false;
-			}
+			return this->release();
+		}
 
-			// patch the saved relative address back
-			if (this->_relativeAddress) {
-				*reinterpret_cast<uint32_t*>(stolen + this->_relativeAddressOffset) = this->_relativeAddress;
-			}
 
-			// patch the stolen bytes back
-			if (!mem::in::patch(this->_origin, stolen, this->_size)) {
-				delete[] stolen;
+		bool TrampHook::isHooked() const {
 
-				return false;
-			}
+			return this->_hooked;
+		}
 
-			delete[] stolen;
-			this->_hooked = false;
 
-			return VirtualFree(this->_gateway, 0, MEM_RELEASE);
+		bool TrampHook::softDisable() {
+
+			if (!this->_hooked || !this->_pRelaySlot) return false;
+
+			// the gateway executes the stolen bytes and jumps back to the origin
+			InterlockedExchangePointer(reinterpret_cast<void**>(this->_pRelaySlot), this->_gateway);
+			this->_softDisabled = true;
+
+			return true;
 		}
 
 
-		bool TrampHook::isHooked() const {
+		bool TrampHook::softEnable() {
 
-			return this->_hooked;
+			if (!this->_hooked || !this->_pRelaySlot) return false;
+
+			const BYTE* const target = this->getTarget();
+
+			if (!target) return false;
+
+			InterlockedExchangePointer(reinterpret_cast<void**>(this->_pRelaySlot), const_cast<BYTE*>(target));
+			this->_softDisabled = false;
+
+			return true;
+		}
+
+
+		bool TrampHook::isSoftDisabled() const {
+
+			return this->_hooked && this->_softDisabled;
 		}
 
 
@@ -252,6 +287,129 @@ namespace hax {
 			return this->_gateway;
 		}
 
+
+		bool TrampHook::getCallStats(CallStats* pStats) const {
+
+			if (!this->_pProbe) return false;
+
+			return this->_pProbe->getCallStats(pStats);
+		}
+
+
+		bool TrampHook::setSampleInterval(uint32_t interval) {
+
+			if (!this->_pProbe) return false;
+
+			return this->_pProbe->setSampleInterval(interval);
+		}
+
+
+		size_t TrampHook::addCodeCaves(HMODULE hModule) {
+			mem::CaveMap caveMap(GetCurrentProcess());
+
+			if (!caveMap.scan(hModule)) return 0u;
+
+			return getGatewayPool()->addCaves(caveMap.getCaves(), caveMap.getCount());
+		}
+
+
+		bool TrampHook::prepare() {
+
+			if (!this->_size) {
+
+				#ifdef _WIN64
+
+				constexpr bool x64 = true;
+
+				#else
+
+				constexpr bool x64 = false;
+
+				#endif // _WIN64
+
+				// the origin might be close to the end of the readable memory
+				const size_t codeSize = mem::in::getReadableSize(this->_origin, instr::MAX_STOLEN_SIZE + instr::MAX_LENGTH);
+				instr::StolenRange range{};
+
+				if (!instr::getStolenRange(this->_origin, codeSize, JUMP_SIZE, x64, &range)) return false;
+
+				this->_size = range.size;
+			}
+
+			delete[] this->_stolen;
+			this->_stolen = new BYTE[this->_size]{};
+			delete[] this->_jump;
+			this->_jump = new BYTE[this->_size]{};
+
+			// save the overwritten bytes to patch them back on disabling
+			if (memcpy_s(this->_stolen, this->_size, this->_origin, this->_size)) return false;
+
+			#ifdef HAX_HOOK_PROBES
+
+			if (!this->_pProbe) {
+				this->_pProbe = new HookProbe(this->_detour);
+			}
+
+			#endif // HAX_HOOK_PROBES
+
+			const BYTE* const target = this->getTarget();
+
+			if (!target) return false;
+
+			size_t relaySlotOffset = 0u;
+			this->_gateway = mem::in::prepareTrampHook(this->_origin, target, this->_size, this->_relativeAddressOffset, getGatewayPool(), this->_jump, &relaySlotOffset);
+
+			if (!this->_gateway) return false;
+
+			this->_pRelaySlot = reinterpret_cast<BYTE**>(this->_gateway + relaySlotOffset);
+			this->_softDisabled = false;
+
+			return true;
+		}
+
+
+		bool TrampHook::release() {
+
+			if (!this->_gateway) return false;
+
+			const bool success = getGatewayPool()->free(this->_gateway);
+			this->_gateway = nullptr;
+			this->_pRelaySlot = nullptr;
+			this->_softDisabled = false;
+
+			return success;
+		}
+
+
+		const BYTE* TrampHook::getTarget() const {
+
+			// execution is redirected to the probe which jumps to the detour
+			if (this->_pProbe) return this->_pProbe->getEntry();
+
+			return this->_detour;
+		}
+
+
+		mem::RemotePool* getGatewayPool() {
+			// never destroyed: the destructor would restore the caves and release the arenas at exit while hooks of other static objects still use their gateways
+			static mem::RemotePool* volatile pGatewayPool = nullptr;
+			mem::RemotePool* pPool = pGatewayPool;
+
+			if (pPool) return pPool;
+
+			mem::RemotePool* const pNewPool = new mem::RemotePool(GetCurrentProcess());
+			pPool = static_cast<mem::RemotePool*>(InterlockedCompareExchangePointer(reinterpret_cast<void* volatile*>(&pGatewayPool), pNewPool, nullptr));
+
+			// another thread created the pool first, the new pool has not allocated anything yet
+			if (pPool) {
+				delete pNewPool;
+
+				return pPool;
+			}
+
+			return pNewPool;
+		}
+
 	}
 	
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 #include "IHook.h"
+#include "HookProbe.h"
+#include "..\RemotePool.h"
+#include "..\shellcode.h"
 #include <stdint.h>
 
 namespace hax {
@@ -9,9 +12,9 @@ namespace hax {
 		// Class to set up a tarmpoline function hook in an external process.
 		// It injects shell code into the target process and redirects execution of a function to this code.
 		// The shell code has to contain a call of a placeholder address with the same calling convention as the origin function to ensure uninterrupted process execution.
-		// This placeholder pointer in the shell code gets replaced with the address of the gateway/trampoline via pattern scanning at runtime.
-		// It is neccessary to use a value unique within the shell code (eg. 0XDEADBEEF for x86) as the placeholder.
-		// This pattern has to be passed as an argument on object construction.
+		// This placeholder pointer in the shell code gets replaced with the address of the gateway/trampoline before the shell code is written to the target.
+		// The placeholder is either passed as a slot of a shell code template (see shellcode.h), which needs no scan at all,
+		// or as a pattern that is scanned for in the shell code before it is injected. It is neccessary to use a value unique within the shell code (eg. 0XDEADBEEF for x86) for a pattern.
 		// When the origin function gets called by the target process (after enabling the hook) execution first jumps to the injected shell code.
 		// At the call of the placeholder execution jumps to the gateway containing the overwritten bytes of the origin function and then jumps back to the origin function.
 		// The stolen bytes overwritten by the jump from the origin function may not contain any references to data or code with static addresses.
@@ -21,13 +24,16 @@ namespace hax {
 		class TrampHook : public IHook {
 		private:
 			const HANDLE _hProc;
+			mem::RemotePool* const _pPool;
 			BYTE* _origin;
 			BYTE* _detour;
-			BYTE* _detourOriginCall;
+			// offset of the origin call placeholder within the shell code, shellcode::INVALID_OFFSET if there is none
+			size_t _originCallOffset;
 			BYTE* _gateway;
-			const size_t _size;
+			size_t _size;
 			const size_t _relativeAddressOffset;
-			uint32_t _relativeAddress;
+			// original bytes of the origin function overwritten by the hook
+			BYTE* _stolen;
 			bool _hooked;
 
 		public:
@@ -56,13 +62,34 @@ namespace hax {
 			// Number of bytes that get overwritten by the jump at the beginning of the origin function.
 			// The overwritten instructions get executed by the gateway right before executing the origin function.
 			// Has to be at least five! Only complete instructions should be overwritten!
-			// It is necessary to look at the disassembly of the origin function to determine when the first complete instruction finishes after the first five bytes.
+			// Pass 0 to determine the size on enabling the hook by decoding the instructions at the beginning of the origin function.
 			//			
 			// [in] relativeAddressOffset:
 			// The offset of a relative Address if there is one in the first <size> bytes of the origin function.
-			// It is necessary to look at the disassembly of the origin function to determine if there is a relative address in the first <size> bytes.
-			// If there is no relative address in the first <size> bytes of the origin function the default value of SIZE_MAX should be passed. This value will then be ignored.
-			TrampHook(HANDLE hProc, BYTE* origin, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relatvieAddressOffset = SIZE_MAX);
+			// If the default value of SIZE_MAX is passed the overwritten instructions are decoded and all their relative operands are relocated to the gateway.
+			//
+			// [in] pPool:
+			// Pool the shell code and the gateway are allocated from. Has to be created for the same target process and has to outlive the hook.
+			// The gateway is returned to the pool on disabling the hook, so gateways of many hooks near each other share the arenas of the pool.
+			// If nullptr is passed the shell code and the gateway get VirtualAllocEx allocations of their own.
+			TrampHook(
+				HANDLE hProc, BYTE* origin, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relatvieAddressOffset = SIZE_MAX,
+				mem::RemotePool* pPool = nullptr
+			);
+
+			// Injects shell code into the target process and initializes members. Takes the slot of the origin call placeholder of a shell code template instead of a pattern.
+			// 
+			// Parameters:
+			// 
+			// [in] originCall:
+			// Slot of the origin call placeholder within the shell code template.
+			// Has to be a shellcode::AbsSlot<uint32_t> for x86 targets and a shellcode::AbsSlot<uint64_t> for x64 targets.
+			// 
+			// See the constructor taking a pattern for the other parameters.
+			TrampHook(
+				HANDLE hProc, BYTE* origin, const BYTE* shell, size_t shellSize, shellcode::Slot originCall, size_t size, size_t relativeAddressOffset = SIZE_MAX,
+				mem::RemotePool* pPool = nullptr
+			);
 
 			// Injects shell code into the target process and initializes members. Used to hook a exported function of a module of the target process by module name and export name.
 			// Hooks the beginning of the function, not the import address table, import directory or export directory!
@@ -92,14 +119,34 @@ namespace hax {
 			// Number of bytes that get overwritten by the jump at the beginning of the origin function.
 			// The overwritten instructions get executed by the gateway right before executing the origin function.
 			// Has to be at least five! Only complete instructions should be overwritten!
-			// It is necessary to look at the disassembly of the origin function to determine when the first complete instruction finishes after the first five bytes.
+			// Pass 0 to determine the size on enabling the hook by decoding the instructions at the beginning of the origin function.
 			//			
 			// [in] relativeAddressOffset:
 			// The offset of a relative Address if there is one in the first <size> bytes of the origin function.
-			// It is necessary to look at the disassembly of the origin function to determine if there is a relative address in the first <size> bytes.
-			// If there is no relative address in the first <size> bytes of the origin function the default value of SIZE_MAX should be passed. This value will then be ignored.
+			// If the default value of SIZE_MAX is passed the overwritten instructions are decoded and all their relative operands are relocated to the gateway.
+			//
+			// [in] pPool:
+			// Pool the shell code and the gateway are allocated from. Has to be created for the same target process and has to outlive the hook.
+			// The gateway is returned to the pool on disabling the hook, so gateways of many hooks near each other share the arenas of the pool.
+			// If nullptr is passed the shell code and the gateway get VirtualAllocEx allocations of their own.
 			TrampHook(
-				HANDLE hProc, const char* modName, const char* funcName, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relativeAddressOffset = SIZE_MAX
+				HANDLE hProc, const char* modName, const char* funcName, const BYTE* shell, size_t shellSize, const char* originCallPattern, size_t size, size_t relativeAddressOffset = SIZE_MAX,
+				mem::RemotePool* pPool = nullptr
+			);
+
+			// Injects shell code into the target process and initializes members. Used to hook a exported function of a module of the target process by module name and export name.
+			// Takes the slot of the origin call placeholder of a shell code template instead of a pattern.
+			// 
+			// Parameters:
+			// 
+			// [in] originCall:
+			// Slot of the origin call placeholder within the shell code template.
+			// Has to be a shellcode::AbsSlot<uint32_t> for x86 targets and a shellcode::AbsSlot<uint64_t> for x64 targets.
+			// 
+			// See the constructor taking a pattern for the other parameters.
+			TrampHook(
+				HANDLE hProc, const char* modName, const char* funcName, const BYTE* shell, size_t shellSize, shellcode::Slot originCall, size_t size,
+				size_t relativeAddressOffset = SIZE_MAX, mem::RemotePool* pPool = nullptr
 			);
 
 			~TrampHook();
@@ -126,6 +173,10 @@ namespace hax {
 			BYTE* getOrigin() const;
 			BYTE* getDetour() const;
 			BYTE* getGateway() const;
+
+		private:
+			// allocates the shell code in the target and writes it, saves the offset of the origin call placeholder if it lies within the shell code
+			void inject(const BYTE* shell, size_t shellSize, shellcode::Slot originCall);
 		};
 
 	}
@@ -133,6 +184,13 @@ namespace hax {
 
 	namespace in {
 
+		// Gets the pool the gateways of all trampoline and mid-function hooks within the caller process are sub-allocated from.
+		// The pool is created on first use and never destroyed, so gateways stay valid for hooks of static objects destroyed at exit.
+		//
+		// Return:
+		// Pointer to the pool.
+		mem::RemotePool* getGatewayPool();
+
 		// Class to set up a trampoline function hook inside the caller process.
 		// Typically the detour function is defined in a dll that was injected into the process. This function has to call the gateway with the same calling convention
 		// as the hooked function for uninterrupted process execution.
@@ -140,16 +198,34 @@ namespace hax {
 		// When the gateway gets called execution jumps to the gateway containing the overwritten bytes of the origin function and then jumps back to the origin function.
 		// The stolen bytes overwritten by the jump from the origin function may not contain any references to data or code with static addresses.
 		// The injected dll has to be compiled to the same architecture (x86 or x64) as the target process.
+		// The gateways of all hooks are sub-allocated from a pool shared by the process, so gateways near each other share a single allocation instead of occupying one each.
+		// The gateway is returned to the pool on disabling the hook.
+		// After adding the code caves of a module to the pool via addCodeCaves, gateways of functions of that module are placed within its padding instead of newly allocated memory.
+		// If the library is compiled with HAX_HOOK_PROBES defined execution is redirected to a HookProbe that counts and times the calls of the detour function before jumping to it.
+		// The probe is kept across disabling and enabling the hook, so its statistics cover all calls since the hook was first enabled.
+		// The origin jumps to a relay in the gateway that jumps on through a pointer. For toggling the hook frequently it can be soft disabled and enabled.
+		// This only exchanges the pointer between the detour and the gateway, while the origin stays patched and the gateway stays allocated.
 		// The hook automatically uninstalls on desctuction of the installing object.
 		class TrampHook : public IHook {
 		private:
 			BYTE* _origin;
 			const BYTE* const _detour;
 			BYTE* _gateway;
-			const size_t _size;
+			size_t _size;
 			const size_t _relativeAddressOffset;
-			uint32_t _relativeAddress;
+			// original bytes of the origin function overwritten by the hook
+			BYTE* _stolen;
+			// jump patched to the origin function by the hook
+			BYTE* _jump;
+			// instrumentation of the detour function, nullptr unless compiled with HAX_HOOK_PROBES defined
+			HookProbe* _pProbe;
+			// address the relay within the gateway jumps to
+			BYTE** _pRelaySlot;
 			bool _hooked;
+			bool _softDisabled;
+
+			friend class HookGroup;
+			friend class ChainHook;
 
 		public:
 			// Initializes members.
@@ -166,12 +242,11 @@ namespace hax {
 			// Number of bytes that get overwritten by the jump at the beginning of the origin function.
 			// The overwritten instructions get executed by the gateway right before executing the origin function.
 			// Has to be at least five! Only complete instructions should be overwritten!
-			// It is necessary to look at the disassembly of the origin function to determine when the first complete instruction finishes after the first five bytes.
+			// Pass 0 to determine the size on enabling the hook by decoding the instructions at the beginning of the origin function.
 			//
 			// [in] relativeAddressOffset:
 			// The offset of a relative Address if there is one in the first <size> bytes of the origin function.
-			// It is necessary to look at the disassembly of the origin function to determine if there is a relative address in the first <size> bytes.
-			// If there is no relative address in the first <size> bytes of the origin function the default value of SIZE_MAX should be passed. This value will then be ignored.
+			// If the default value of SIZE_MAX is passed the overwritten instructions are decoded and all their relative operands are relocated to the gateway.
 			TrampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset = SIZE_MAX);
 
 			// Initializes members. Used to hook a exported function of a module of the target process by module name and export name.
@@ -192,12 +267,11 @@ namespace hax {
 			// Number of bytes that get overwritten by the jump at the beginning of the origin function.
 			// The overwritten instructions get executed by the gateway right before executing the origin function.
 			// Has to be at least five! Only complete instructions should be overwritten!
-			// It is necessary to look at the disassembly of the origin function to determine when the first complete instruction finishes after the first five bytes.
+			// Pass 0 to determine the size on enabling the hook by decoding the instructions at the beginning of the origin function.
 			//
 			// [in] relativeAddressOffset:
 			// The offset of a relative Address if there is one in the first <size> bytes of the origin function.
-			// It is necessary to look at the disassembly of the origin function to determine if there is a relative address in the first <size> bytes.
-			// If there is no relative address in the first <size> bytes of the origin function the default value of SIZE_MAX should be passed. This value will then be ignored.
+			// If the default value of SIZE_MAX is passed the overwritten instructions are decoded and all their relative operands are relocated to the gateway.
 			TrampHook(const char* modName, const char* funcName, const BYTE* detour, size_t size, size_t relativeAddressOffset = SIZE_MAX);
 
 			~TrampHook();
@@ -217,12 +291,75 @@ namespace hax {
 			// Checks if the hook is currently installed.
 			// 
 			// Return:
-			// True if the hook is installed, false if it is not installed.
+			// True if the hook is installed, false if it is not installed. A soft disabled hook is still installed.
 			bool isHooked() const;
 
+			// Soft disables the installed hook. Execution of the origin function bypasses the detour function after calling this method.
+			// The origin function stays patched, the relay is pointed to the gateway by a single atomic store. Threads that already passed the relay still execute the detour function.
+			// 
+			// Return:
+			// True on success, false on failure or if the hook is not installed.
+			bool softDisable();
+
+			// Soft enables the installed hook after soft disabling it. Execution of the origin function is redirected to the detour function again after calling this method.
+			// The relay is pointed back to the detour function by a single atomic store.
+			// 
+			// Return:
+			// True on success, false on failure or if the hook is not installed.
+			bool softEnable();
+
+			// Checks if the hook is currently soft disabled.
+			// 
+			// Return:
+			// True if the hook is installed and soft disabled, false if it is not.
+			bool isSoftDisabled() const;
+
 			BYTE* getOrigin() const;
 			BYTE* getDetour() const;
 			BYTE* getGateway() const;
+
+			// Gets the statistics of the calls of the detour function since the hook was first enabled.
+			// 
+			// Parameters:
+			// 
+			// [out] pStats:
+			// Pointer to a buffer that receives the statistics.
+			// 
+			// Return:
+			// True on success, false on failure or if the library is compiled without HAX_HOOK_PROBES defined.
+			bool getCallStats(CallStats* pStats) const;
+
+			// Sets how many calls of the detour function are counted per measured call. The probe is created on enabling the hook, so this has to be called afterwards.
+			// 
+			// Parameters:
+			// 
+			// [in] interval:
+			// Every interval-th call is measured. Has to be a power of two. Pass 1 to measure every call.
+			// 
+			// Return:
+			// True on success, false on failure or if the library is compiled without HAX_HOOK_PROBES defined.
+			bool setSampleInterval(uint32_t interval);
+
+			// Adds the code caves of a module to the pool the gateways of all internal trampoline hooks are allocated from. See CaveMap.h and RemotePool.h.
+			// Gateways and relays are placed within the caves if a cave in reach is large enough, otherwise they are allocated near the origin function as usual.
+			// The caves stay part of the pool for the lifetime of the process, so the module must not be unloaded afterwards.
+			// 
+			// Parameters:
+			// 
+			// [in] hModule:
+			// Module whose executable sections should be scanned for caves, usually the module of the functions to be hooked.
+			// 
+			// Return:
+			// Number of caves added to the pool.
+			static size_t addCodeCaves(HMODULE hModule);
+
+		private:
+			// determines the size, saves the stolen bytes and writes the gateway without patching the origin function
+			bool prepare();
+			// returns the gateway to the pool
+			bool release();
+			// gets the address execution is redirected to while the hook is not soft disabled
+			const BYTE* getTarget() const;
 		};
 
 	}
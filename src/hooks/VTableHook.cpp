@@ -0,0 +1,372 @@
+#include "VTableHook.h"
+#include "..\mem.h"
+#include <stdint.h>
+
+namespace hax {
+
+	// maximum number of entries counted in a virtual method table
+	constexpr size_t MAX_VTABLE_COUNT = 0x400u;
+
+	// counts the consecutive entries of a virtual method table that point to executable memory
+	static size_t countVTableEntries(HANDLE hProc, const BYTE* pVTable, size_t ptrSize);
+
+	namespace ex {
+
+		VTableHook::VTableHook(
+			HANDLE hProc, BYTE* pInterface, size_t index, const BYTE* shell, size_t shellSize, const char* originCallPattern, VTableHookMode mode, size_t count,
+			mem::RemotePool* pPool
+		) : VTableHook(hProc, pInterface, index, shell, shellSize, shellcode::findSlot(shell, shellSize, originCallPattern), mode, count, pPool) {}
+
+
+		VTableHook::VTableHook(
+			HANDLE hProc, BYTE* pInterface, size_t index, const BYTE* shell, size_t shellSize, shellcode::Slot originCall, VTableHookMode mode, size_t count,
+			mem::RemotePool* pPool
+		) : _hProc{ hProc }, _pPool{ pPool }, _pInterface{ pInterface }, _index{ index }, _mode{ mode }, _count{ count }, _pVTable{}, _pShadowVTable{}, _origin{}, _detour{},
+			_hooked{}, _ptrSize{}
+		{
+			BOOL isWow64Proc = FALSE;
+			IsWow64Process(this->_hProc, &isWow64Proc);
+
+			if (isWow64Proc) {
+				this->_ptrSize = sizeof(uint32_t);
+			}
+			else {
+
+				// x64 target is only supported for x64 compilation
+				#ifdef _WIN64
+
+				this->_ptrSize = sizeof(uint64_t);
+
+				#else
+
+				return;
+
+				#endif // _WIN64
+
+			}
+
+			// saves the table of the object and the original entry
+			if (!ReadProcessMemory(this->_hProc, this->_pInterface, &this->_pVTable, this->_ptrSize, nullptr)) return;
+
+			if (!ReadProcessMemory(this->_hProc, this->_pVTable + this->_index * this->_ptrSize, &this->_origin, this->_ptrSize, nullptr)) return;
+
+			// copy the shell code so the placeholder can be replaced without modifying the passed buffer
+			BYTE* const shellCopy = new BYTE[shellSize]{};
+
+			if (shell && !memcpy_s(shellCopy, shellSize, shell, shellSize)) {
+
+				// the placeholder is replaced with the origin function by a direct store
+				if (originCall.offset != shellcode::INVALID_OFFSET && originCall.offset <= shellSize && shellSize - originCall.offset >= this->_ptrSize) {
+					memcpy(shellCopy + originCall.offset, &this->_origin, this->_ptrSize);
+				}
+
+				if (this->_pPool) {
+					this->_detour = this->_pPool->allocate(shellSize);
+				}
+				else {
+					this->_detour = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, shellSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+				}
+
+				if (this->_detour) {
+					WriteProcessMemory(this->_hProc, this->_detour, shellCopy, shellSize, nullptr);
+				}
+
+			}
+
+			delete[] shellCopy;
+		}
+
+
+		VTableHook::~VTableHook() {
+			this->disable();
+
+			if (this->_detour) {
+
+				if (this->_pPool) {
+					this->_pPool->free(this->_detour);
+				}
+				else {
+					VirtualFreeEx(this->_hProc, this->_detour, 0, MEM_RELEASE);
+				}
+
+			}
+
+			if (this->_pShadowVTable) {
+				VirtualFreeEx(this->_hProc, this->_pShadowVTable, 0, MEM_RELEASE);
+			}
+
+		}
+
+
+		bool VTableHook::enable() {
+
+			if (this->_hooked || !this->_ptrSize || !this->_pVTable || !this->_origin || !this->_detour) return false;
+
+			if (this->_mode == VTableHookMode::SLOT) {
+
+				// overwrites the entry of the table in the process
+				if (!mem::ex::patch(this->_hProc, this->_pVTable + this->_index * this->_ptrSize, reinterpret_cast<const BYTE*>(&this->_detour), this->_ptrSize)) return false;
+
+			}
+			else {
+
+				if (!this->_pShadowVTable) {
+
+					if (!this->_count) {
+						this->_count = countVTableEntries(this->_hProc, this->_pVTable, this->_ptrSize);
+					}
+
+					if (this->_index >= this->_count) return false;
+
+					// the entry before the table is copied as well, it points to the run-time type information of classes compiled by MSVC
+					const size_t shadowSize = (this->_count + 1u) * this->_ptrSize;
+					BYTE* const entries = new BYTE[shadowSize]{};
+
+					if (!ReadProcessMemory(this->_hProc, this->_pVTable - this->_ptrSize, entries, shadowSize, nullptr)) {
+						delete[] entries;
+
+						return false;
+					}
+
+					if (memcpy_s(entries + (this->_index + 1u) * this->_ptrSize, this->_ptrSize, &this->_detour, this->_ptrSize)) {
+						delete[] entries;
+
+						return false;
+					}
+
+					this->_pShadowVTable = static_cast<BYTE*>(VirtualAllocEx(this->_hProc, nullptr, shadowSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+					if (!this->_pShadowVTable) {
+						delete[] entries;
+
+						return false;
+					}
+
+					const bool written = WriteProcessMemory(this->_hProc, this->_pShadowVTable, entries, shadowSize, nullptr) == TRUE;
+					delete[] entries;
+
+					if (!written) {
+						VirtualFreeEx(this->_hProc, this->_pShadowVTable, 0, MEM_RELEASE);
+						this->_pShadowVTable = nullptr;
+
+						return false;
+					}
+
+				}
+
+				const BYTE* const pShadowTable = this->_pShadowVTable + this->_ptrSize;
+
+				// points the object to the shadow table
+				if (!WriteProcessMemory(this->_hProc, this->_pInterface, &pShadowTable, this->_ptrSize, nullptr)) return false;
+
+			}
+
+			this->_hooked = true;
+
+			return true;
+		}
+
+
+		bool VTableHook::disable() {
+
+			if (!this->_hooked || !this->_pVTable || !this->_origin) return false;
+
+			if (this->_mode == VTableHookMode::SLOT) {
+
+				// restores the entry of the table in the process
+				if (!mem::ex::patch(this->_hProc, this->_pVTable + this->_index * this->_ptrSize, reinterpret_cast<const BYTE*>(&this->_origin), this->_ptrSize)) return false;
+
+			}
+			else {
+				const BYTE* const pShadowTable = this->_pShadowVTable + this->_ptrSize;
+				BYTE* pCurTable = nullptr;
+
+				if (!ReadProcessMemory(this->_hProc, this->_pInterface, &pCurTable, this->_ptrSize, nullptr)) return false;
+
+				// the object might have been destroyed or reconstructed in the meantime and must not be overwritten then
+				if (pCurTable == pShadowTable) {
+
+					// points the object back to its table
+					if (!WriteProcessMemory(this->_hProc, this->_pInterface, &this->_pVTable, this->_ptrSize, nullptr)) return false;
+
+				}
+
+			}
+
+			this->_hooked = false;
+
+			return true;
+		}
+
+
+		bool VTableHook::isHooked() const {
+
+			return this->_hooked;
+		}
+
+
+		BYTE* VTableHook::getOrigin() const {
+
+			return this->_origin;
+		}
+
+
+		BYTE* VTableHook::getDetour() const {
+
+			return this->_detour;
+		}
+
+
+		BYTE* VTableHook::getVTable() const {
+
+			return this->_pVTable;
+		}
+
+	}
+
+
+	namespace in {
+
+		VTableHook::VTableHook(void* pInterface, size_t index, const BYTE* detour, VTableHookMode mode, size_t count) :
+			_pInterface{ pInterface }, _index{ index }, _mode{ mode }, _count{ count }, _pVTable{}, _pShadowVTable{}, _origin{}, _detour{ detour }, _hooked{}
+		{
+
+			if (this->_pInterface) {
+				// saves the table of the object and the original entry
+				this->_pVTable = *reinterpret_cast<BYTE***>(this->_pInterface);
+				this->_origin = this->_pVTable[this->_index];
+			}
+
+		}
+
+
+		VTableHook::~VTableHook() {
+			this->disable();
+
+			if (this->_pShadowVTable) {
+				delete[] this->_pShadowVTable;
+			}
+
+		}
+
+
+		bool VTableHook::enable() {
+
+			if (this->_hooked || !this->_pVTable || !this->_origin || !this->_detour) return false;
+
+			if (this->_mode == VTableHookMode::SLOT) {
+
+				// overwrites the entry of the table
+				if (!mem::in::patch(reinterpret_cast<BYTE*>(&this->_pVTable[this->_index]), reinterpret_cast<const BYTE*>(&this->_detour), sizeof(BYTE*))) return false;
+
+			}
+			else {
+
+				if (!this->_pShadowVTable) {
+
+					if (!this->_count) {
+						this->_count = countVTableEntries(GetCurrentProcess(), reinterpret_cast<const BYTE*>(this->_pVTable), sizeof(BYTE*));
+					}
+
+					if (this->_index >= this->_count) return false;
+
+					// the entry before the table is copied as well, it points to the run-time type information of classes compiled by MSVC
+					this->_pShadowVTable = new BYTE*[this->_count + 1u]{};
+
+					if (memcpy_s(this->_pShadowVTable, (this->_count + 1u) * sizeof(BYTE*), this->_pVTable - 1, (this->_count + 1u) * sizeof(BYTE*))) {
+						delete[] this->_pShadowVTable;
+						this->_pShadowVTable = nullptr;
+
+						return false;
+					}
+
+					this->_pShadowVTable[this->_index + 1u] = const_cast<BYTE*>(this->_detour);
+				}
+
+				// points the object to the shadow table
+				InterlockedExchangePointer(reinterpret_cast<void**>(this->_pInterface), this->_pShadowVTable + 1);
+			}
+
+			this->_hooked = true;
+
+			return true;
+		}
+
+
+		bool VTableHook::disable() {
+
+			if (!this->_hooked || !this->_pVTable || !this->_origin) return false;
+
+			if (this->_mode == VTableHookMode::SLOT) {
+
+				// restores the entry of the table
+				if (!mem::in::patch(reinterpret_cast<BYTE*>(&this->_pVTable[this->_index]), reinterpret_cast<const BYTE*>(&this->_origin), sizeof(BYTE*))) return false;
+
+			}
+			else {
+				// points the object back to its table unless the object has been destroyed or reconstructed in the meantime
+				InterlockedCompareExchangePointer(reinterpret_cast<void**>(this->_pInterface), this->_pVTable, this->_pShadowVTable + 1);
+			}
+
+			this->_hooked = false;
+
+			return true;
+		}
+
+
+		bool VTableHook::isHooked() const {
+
+			return this->_hooked;
+		}
+
+
+		BYTE* VTableHook::getOrigin() const {
+
+			return this->_origin;
+		}
+
+
+		BYTE* VTableHook::getDetour() const {
+
+			return const_cast<BYTE*>(this->_detour);
+		}
+
+
+		BYTE* VTableHook::getVTable() const {
+
+			return reinterpret_cast<BYTE*>(this->_pVTable);
+		}
+
+	}
+
+
+	static size_t countVTableEntries(HANDLE hProc, const BYTE* pVTable, size_t ptrSize) {
+		constexpr DWORD EXECUTABLE = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+		MEMORY_BASIC_INFORMATION mbi{};
+		uintptr_t executableStart = 0u;
+		uintptr_t executableEnd = 0u;
+		size_t count = 0u;
+
+		while (count < MAX_VTABLE_COUNT) {
+			uintptr_t entry = 0u;
+
+			if (!ReadProcessMemory(hProc, pVTable + count * ptrSize, &entry, ptrSize, nullptr)) break;
+
+			// entries usually point into the same few code regions, so the last executable region is cached
+			if (entry < executableStart || entry >= executableEnd) {
+
+				if (!VirtualQueryEx(hProc, reinterpret_cast<void*>(entry), &mbi, sizeof(mbi))) break;
+
+				if (mbi.State != MEM_COMMIT || !(mbi.Protect & EXECUTABLE) || (mbi.Protect & PAGE_GUARD)) break;
+
+				executableStart = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+				executableEnd = executableStart + mbi.RegionSize;
+			}
+
+			count++;
+		}
+
+		return count;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#pragma once
+#include "IHook.h"
+#include "..\RemotePool.h"
+#include "..\shellcode.h"
+
+namespace hax {
+
+	// Ways to redirect a virtual function.
+	enum class VTableHookMode {
+		// Overwrites the entry of the function in the virtual method table. Affects all objects sharing the table.
+		SLOT,
+		// Copies the virtual method table to a shadow table with the entry of the function replaced and points the object to the shadow table.
+		// Only affects the hooked object. The table itself is not modified.
+		SHADOW
+	};
+
+	namespace ex {
+
+		// Class to set up a virtual method table hook on an object of an external process.
+		// It injects shell code into the target process which gets called instead of the origin function via the virtual method table of the object.
+		// No code of the target gets patched and no gateway is needed, the shell code calls the origin function directly.
+		// The shell code can contain a call of a placeholder address with the same calling convention as the origin function to ensure uninterrupted process execution.
+		// This placeholder pointer in the shell code gets replaced with the address of the origin function before the shell code is written to the target.
+		// The placeholder is either passed as a slot of a shell code template (see shellcode.h) or as a pattern that is scanned for in the shell code.
+		// It is neccessary to use a value unique within the shell code (eg. 0XDEADBEEF for x86) for a pattern.
+		// Compiled to x64 the hook works both on x86 and x64 targets. Compiled to x86 it only works on x86 targets.
+		// The shell code always has to be compiled to the same architecture as the target process.
+		// The hook automatically uninstalls on desctuction of the installing object.
+		class VTableHook : public IHook {
+		private:
+			const HANDLE _hProc;
+			mem::RemotePool* const _pPool;
+			BYTE* const _pInterface;
+			const size_t _index;
+			const VTableHookMode _mode;
+			size_t _count;
+			BYTE* _pVTable;
+			BYTE* _pShadowVTable;
+			BYTE* _origin;
+			BYTE* _detour;
+			bool _hooked;
+			// size of a pointer within the target process, zero if the architecture of the target is not supported
+			size_t _ptrSize;
+
+		public:
+			// Initializes members.
+			//
+			// Parameters:
+			//
+			// [in] hProc:
+			// Handle to the process in which the hook should be installed.
+			// Needs at least PROCESS_QUERY_LIMITED_INFORMATION, PROCESS_VM_OPERATION, PROCESS_VM_READ and PROCESS_VM_WRITE access rights.
+			//
+			// [in] pInterface:
+			// Address of the object whose virtual function should be hooked within the virtual address space of the target process.
+			//
+			// [in] index:
+			// Index of the function within the virtual method table.
+			//
+			// [in] shell:
+			// Address of the shell code that should be injected and executed on a call of the origin function.
+			//
+			// [in] shellSize:
+			// Size of the shell code in bytes.
+			//
+			// [in] originCallPattern:
+			// Pattern of the origin function call in the shell code. The pattern has to be of the format:
+			// "EF BE DA DE". "??" can be used as wildcards. Mind the endianness!
+			// Can be nullptr if there is no call to the origin function in the shell code.
+			//
+			// [in] mode:
+			// Whether the entry of the table or the table of the object gets replaced.
+			//
+			// [in] count:
+			// Number of entries of the virtual method table. Only used for VTableHookMode::SHADOW.
+			// Pass 0 to count the consecutive entries that point to executable memory.
+			//
+			// [in] pPool:
+			// Pool the shell code is allocated from. Has to be created for the same target process and has to outlive the hook.
+			// If nullptr is passed the shell code gets a VirtualAllocEx allocation of its own.
+			VTableHook(
+				HANDLE hProc, BYTE* pInterface, size_t index, const BYTE* shell, size_t shellSize, const char* originCallPattern, VTableHookMode mode = VTableHookMode::SLOT,
+				size_t count = 0u, mem::RemotePool* pPool = nullptr
+			);
+
+			// Initializes members. Takes the slot of the origin call placeholder of a shell code template instead of a pattern.
+			//
+			// Parameters:
+			//
+			// [in] originCall:
+			// Slot of the origin call placeholder within the shell code template.
+			// Has to be a shellcode::AbsSlot<uint32_t> for x86 targets and a shellcode::AbsSlot<uint64_t> for x64 targets.
+			//
+			// See the constructor taking a pattern for the other parameters.
+			VTableHook(
+				HANDLE hProc, BYTE* pInterface, size_t index, const BYTE* shell, size_t shellSize, shellcode::Slot originCall, VTableHookMode mode = VTableHookMode::SLOT,
+				size_t count = 0u, mem::RemotePool* pPool = nullptr
+			);
+
+			~VTableHook();
+
+			// Enables the hook. Execution of origin function is redirected after calling this method.
+			//
+			// Return: True on success, false on failure
+			bool enable();
+
+			// Disables the hook. Execution of origin function is restored after calling this method.
+			// The shadow table stays allocated until destruction of the object, since threads of the target might still read from it.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool disable();
+
+			// Checks if the hook is currently installed.
+			//
+			// Return:
+			// True if the hook is installed, false if it is not installed.
+			bool isHooked() const;
+
+			BYTE* getOrigin() const;
+			BYTE* getDetour() const;
+			BYTE* getVTable() const;
+		};
+
+	}
+
+
+	namespace in {
+
+		// Class to set up a virtual method table hook on an object of the caller process.
+		// Typically the detour function is defined in a dll that was injected into the process.
+		// When the origin function gets called by the process (after enabling the hook) execution jumps to the detour function via the virtual method table of the object.
+		// No code gets patched and no gateway is needed. The detour function calls the origin function returned by getOrigin directly with the same calling convention.
+		// The dll has to be compiled to the same architecture (x86 or x64) as the target process.
+		// The hook automatically uninstalls on desctuction of the installing object.
+		class VTableHook : public IHook {
+		private:
+			void* const _pInterface;
+			const size_t _index;
+			const VTableHookMode _mode;
+			size_t _count;
+			BYTE** _pVTable;
+			BYTE** _pShadowVTable;
+			BYTE* _origin;
+			const BYTE* const _detour;
+			bool _hooked;
+
+		public:
+			// Initializes members.
+			//
+			// Parameters:
+			//
+			// [in] pInterface:
+			// Address of the object whose virtual function should be hooked.
+			//
+			// [in] index:
+			// Index of the function within the virtual method table.
+			//
+			// [in] detour:
+			// Address of the detour function.
+			//
+			// [in] mode:
+			// Whether the entry of the table or the table of the object gets replaced.
+			//
+			// [in] count:
+			// Number of entries of the virtual method table. Only used for VTableHookMode::SHADOW.
+			// Pass 0 to count the consecutive entries that point to executable memory.
+			VTableHook(void* pInterface, size_t index, const BYTE* detour, VTableHookMode mode = VTableHookMode::SLOT, size_t count = 0u);
+
+			~VTableHook();
+
+			// Enables the hook. Execution of origin function is redirected after calling this method.
+			//
+			// Return: True on success, false on failure
+			bool enable();
+
+			// Disables the hook. Execution of origin function is restored after calling this method.
+			// The shadow table stays allocated until destruction of the object, since other threads might still read from it.
+			//
+			// Return:
+			// True on success, false on failure.
+			bool disable();
+
+			// Checks if the hook is currently installed.
+			//
+			// Return:
+			// True if the hook is installed, false if it is not installed.
+			bool isHooked() const;
+
+			// Gets the origin function. The detour function should call this address to execute the origin function.
+			BYTE* getOrigin() const;
+			BYTE* getDetour() const;
+			BYTE* getVTable() const;
+		};
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,576 @@
+#include "instr.h"
+#include <string.h>
+
+namespace hax {
+
+	namespace instr {
+		// flags of the opcode tables
+		// ModR/M byte follows the opcode
+		constexpr uint8_t MR = 0x01u;
+		// eight bit immediate
+		constexpr uint8_t I8 = 0x02u;
+		// 16 bit immediate
+		constexpr uint8_t I16 = 0x04u;
+		// 16 or 32 bit immediate depending on the operand size
+		constexpr uint8_t IZ = 0x08u;
+		// eight bit relative branch displacement
+		constexpr uint8_t R8 = 0x10u;
+		// 16 or 32 bit relative branch displacement
+		constexpr uint8_t RZ = 0x20u;
+		// opcode needs special handling
+		constexpr uint8_t SP = 0x40u;
+		// invalid opcode
+		constexpr uint8_t XX = 0x80u;
+		// legacy prefix
+		constexpr uint8_t PF = 0xFFu;
+
+		// one byte opcode map of x86 code
+		static constexpr uint8_t ONE_BYTE_X86[0x100]{
+			/* 00 */ MR, MR, MR, MR, I8, IZ, 0, 0, MR, MR, MR, MR, I8, IZ, 0, SP,
+			/* 10 */ MR, MR, MR, MR, I8, IZ, 0, 0, MR, MR, MR, MR, I8, IZ, 0, 0,
+			/* 20 */ MR, MR, MR, MR, I8, IZ, PF, 0, MR, MR, MR, MR, I8, IZ, PF, 0,
+			/* 30 */ MR, MR, MR, MR, I8, IZ, PF, 0, MR, MR, MR, MR, I8, IZ, PF, 0,
+			/* 40 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			/* 50 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			/* 60 */ 0, 0, SP, MR, PF, PF, PF, PF, IZ, MR | IZ, I8, MR | I8, 0, 0, 0, 0,
+			/* 70 */ R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8,
+			/* 80 */ MR | I8, MR | IZ, MR | I8, MR | I8, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, SP,
+			/* 90 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, SP, 0, 0, 0, 0, 0,
+			/* A0 */ SP, SP, SP, SP, 0, 0, 0, 0, I8, IZ, 0, 0, 0, 0, 0, 0,
+			/* B0 */ I8, I8, I8, I8, I8, I8, I8, I8, IZ, IZ, IZ, IZ, IZ, IZ, IZ, IZ,
+			/* C0 */ MR | I8, MR | I8, I16, 0, SP, SP, MR | I8, MR | IZ, I16 | I8, 0, I16, 0, 0, I8, 0, 0,
+			/* D0 */ MR, MR, MR, MR, I8, I8, 0, 0, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* E0 */ R8, R8, R8, R8, I8, I8, I8, I8, RZ, RZ, SP, R8, 0, 0, 0, 0,
+			/* F0 */ PF, 0, PF, PF, 0, 0, SP, SP, 0, 0, 0, 0, 0, 0, MR, MR
+		};
+
+		// one byte opcode map of x64 code, 40-4F are REX prefixes
+		static constexpr uint8_t ONE_BYTE_X64[0x100]{
+			/* 00 */ MR, MR, MR, MR, I8, IZ, XX, XX, MR, MR, MR, MR, I8, IZ, XX, SP,
+			/* 10 */ MR, MR, MR, MR, I8, IZ, XX, XX, MR, MR, MR, MR, I8, IZ, XX, XX,
+			/* 20 */ MR, MR, MR, MR, I8, IZ, PF, XX, MR, MR, MR, MR, I8, IZ, PF, XX,
+			/* 30 */ MR, MR, MR, MR, I8, IZ, PF, XX, MR, MR, MR, MR, I8, IZ, PF, XX,
+			/* 40 */ SP, SP, SP, SP, SP, SP, SP, SP, SP, SP, SP, SP, SP, SP, SP, SP,
+			/* 50 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			/* 60 */ XX, XX, SP, MR, PF, PF, PF, PF, IZ, MR | IZ, I8, MR | I8, 0, 0, 0, 0,
+			/* 70 */ R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8, R8,
+			/* 80 */ MR | I8, MR | IZ, XX, MR | I8, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, SP,
+			/* 90 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, XX, 0, 0, 0, 0, 0,
+			/* A0 */ SP, SP, SP, SP, 0, 0, 0, 0, I8, IZ, 0, 0, 0, 0, 0, 0,
+			/* B0 */ I8, I8, I8, I8, I8, I8, I8, I8, SP, SP, SP, SP, SP, SP, SP, SP,
+			/* C0 */ MR | I8, MR | I8, I16, 0, SP, SP, MR | I8, MR | IZ, I16 | I8, 0, I16, 0, 0, I8, XX, 0,
+			/* D0 */ MR, MR, MR, MR, XX, XX, XX, 0, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* E0 */ R8, R8, R8, R8, I8, I8, I8, I8, RZ, RZ, XX, R8, 0, 0, 0, 0,
+			/* F0 */ PF, 0, PF, PF, 0, 0, SP, SP, 0, 0, 0, 0, 0, 0, MR, MR
+		};
+
+		// two byte opcode map (0F xx) of x86 and x64 code, also used for VEX map 1
+		static constexpr uint8_t TWO_BYTE[0x100]{
+			/* 00 */ MR, MR, MR, MR, XX, 0, 0, 0, 0, 0, XX, 0, XX, MR, 0, MR | I8,
+			/* 10 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* 20 */ MR, MR, MR, MR, XX, XX, XX, XX, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* 30 */ 0, 0, 0, 0, 0, 0, XX, 0, SP, XX, SP, XX, XX, XX, XX, XX,
+			/* 40 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* 50 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* 60 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* 70 */ MR | I8, MR | I8, MR | I8, MR | I8, MR, MR, MR, 0, MR, MR, XX, XX, MR, MR, MR, MR,
+			/* 80 */ RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ, RZ,
+			/* 90 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* A0 */ 0, 0, 0, MR, MR | I8, MR, XX, XX, 0, 0, 0, MR, MR | I8, MR, MR, MR,
+			/* B0 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR | I8, MR, MR, MR, MR, MR,
+			/* C0 */ MR, MR, MR | I8, MR, MR | I8, MR | I8, MR | I8, MR, 0, 0, 0, 0, 0, 0, 0, 0,
+			/* D0 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* E0 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR,
+			/* F0 */ MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR, MR
+		};
+
+		// bit set of the one byte opcodes execution never continues behind: ret, retf, int3, iret, jmp
+		static constexpr uint32_t TERMINATORS[8]{ 0u, 0u, 0u, 0u, 0u, 0u, 0x00009C0Cu, 0x00000E00u };
+
+		static size_t decodeModRm(const uint8_t* pCode, size_t pos, size_t limit, bool x64, bool addrSize, Instruction* pInstruction);
+		static size_t decodeVector(const uint8_t* pCode, size_t pos, size_t limit, uint8_t prefix, uint8_t* pFlags);
+		static size_t getRelocatedLength(const uint8_t* pInstructionCode, const Instruction* pInstruction);
+
+		size_t decode(const uint8_t* pCode, size_t size, bool x64, Instruction* pInstruction) {
+			*pInstruction = Instruction{};
+
+			const uint8_t* const oneByte = x64 ? ONE_BYTE_X64 : ONE_BYTE_X86;
+			const size_t limit = size < MAX_LENGTH ? size : MAX_LENGTH;
+			size_t pos = 0u;
+			bool opSize = false;
+			bool addrSize = false;
+			bool rexW = false;
+			uint8_t opcode = 0u;
+			uint8_t flags = 0u;
+
+			while (true) {
+
+				if (pos >= limit) return 0u;
+
+				opcode = pCode[pos];
+				flags = oneByte[opcode];
+
+				if (flags == PF) {
+
+					if (opcode == 0x66u) {
+						opSize = true;
+					}
+					else if (opcode == 0x67u) {
+						addrSize = true;
+					}
+
+					// a REX prefix is ignored if it is not directly in front of the opcode
+					rexW = false;
+				}
+				else if (x64 && (opcode & 0xF0u) == 0x40u) {
+					rexW = (opcode & 0x08u) != 0u;
+				}
+				else {
+					break;
+				}
+
+				pos++;
+			}
+
+			if (flags & XX) return 0u;
+
+			pInstruction->opcodeOffset = static_cast<uint8_t>(pos);
+			pos++;
+
+			const bool isOneByte = opcode != 0x0Fu;
+			size_t immSize = 0u;
+
+			if (!isOneByte) {
+
+				if (pos >= limit) return 0u;
+
+				const uint8_t opcode2 = pCode[pos++];
+				flags = TWO_BYTE[opcode2];
+
+				if (flags & XX) return 0u;
+
+				// three byte opcode maps 0F 38 xx and 0F 3A xx
+				if (flags & SP) {
+
+					if (pos >= limit) return 0u;
+
+					pos++;
+					flags = opcode2 == 0x38u ? MR : MR | I8;
+				}
+
+			}
+			else if (flags & SP) {
+
+				if (opcode == 0x62u || opcode == 0xC4u || opcode == 0xC5u || opcode == 0x8Fu) {
+
+					if (pos >= limit) return 0u;
+
+					const uint8_t next = pCode[pos];
+					bool isVector = false;
+
+					if (opcode == 0x8Fu) {
+						// XOP uses opcode maps 8 to 10, POP r/m has a zero reg field
+						isVector = (next & 0x1Fu) >= 0x08u;
+					}
+					else {
+						// BOUND, LES and LDS can not have a register operand, so in x86 code the prefix is only EVEX or VEX if mod is 3
+						isVector = x64 || (next & 0xC0u) == 0xC0u;
+					}
+
+					if (isVector) {
+						pos = decodeVector(pCode, pos, limit, opcode, &flags);
+
+						if (!pos) return 0u;
+
+					}
+					else {
+						flags = MR;
+					}
+
+				}
+				else if (opcode == 0x9Au || opcode == 0xEAu) {
+					// far pointer, only valid in x86 code
+					immSize = opSize ? 4u : 6u;
+					flags = 0u;
+				}
+				else if (opcode >= 0xA0u && opcode <= 0xA3u) {
+					// memory offset of the address size
+					if (x64) {
+						immSize = addrSize ? 4u : 8u;
+					}
+					else {
+						immSize = addrSize ? 2u : 4u;
+					}
+
+					flags = 0u;
+				}
+				else if (opcode >= 0xB8u && opcode <= 0xBFu) {
+					// only MOV r64, imm64 has an eight byte immediate
+					immSize = rexW ? 8u : (opSize ? 2u : 4u);
+					flags = 0u;
+				}
+				else if (opcode == 0xF6u || opcode == 0xF7u) {
+					// only TEST has an immediate in these groups
+					if (pos >= limit) return 0u;
+
+					if (((pCode[pos] >> 3u) & 0x07u) < 2u) {
+						immSize = opcode == 0xF6u ? 1u : (opSize ? 2u : 4u);
+					}
+
+					flags = MR;
+				}
+
+			}
+
+			if (flags & MR) {
+				const uint8_t modRm = pos < limit ? pCode[pos] : 0u;
+				pos = decodeModRm(pCode, pos, limit, x64, addrSize, pInstruction);
+
+				if (!pos) return 0u;
+
+				// JMP r/m and JMP FAR m
+				if (isOneByte && opcode == 0xFFu && (((modRm >> 3u) & 0x07u) == 4u || ((modRm >> 3u) & 0x07u) == 5u)) {
+					pInstruction->isTerminator = true;
+				}
+
+			}
+
+			if (flags & I8) {
+				immSize += 1u;
+			}
+
+			if (flags & I16) {
+				immSize += 2u;
+			}
+
+			if (flags & IZ) {
+				immSize += opSize ? 2u : 4u;
+			}
+
+			if (flags & (R8 | RZ)) {
+				pInstruction->relType = flags & R8 ? RelType::BRANCH8 : RelType::BRANCH32;
+				pInstruction->relOffset = static_cast<uint8_t>(pos + immSize);
+
+				// the operand size prefix is ignored for near branches in x64 code
+				if (flags & R8) {
+					pInstruction->relSize = 1u;
+				}
+				else {
+					pInstruction->relSize = !x64 && opSize ? 2u : 4u;
+				}
+
+				immSize += pInstruction->relSize;
+			}
+
+			pos += immSize;
+
+			if (pos > limit) return 0u;
+
+			if (isOneByte && (TERMINATORS[opcode >> 5u] >> (opcode & 0x1Fu)) & 1u) {
+				pInstruction->isTerminator = true;
+			}
+
+			pInstruction->length = static_cast<uint8_t>(pos);
+
+			return pos;
+		}
+
+
+		bool getStolenRange(const uint8_t* pCode, size_t size, size_t minSize, bool x64, StolenRange* pRange) {
+			pRange->size = 0u;
+			pRange->instructionCount = 0u;
+			pRange->relativeCount = 0u;
+
+			if (minSize > MAX_STOLEN_SIZE) return false;
+
+			size_t offset = 0u;
+
+			while (offset < minSize) {
+				Instruction* const pInstruction = &pRange->instructions[pRange->instructionCount];
+
+				if (!decode(pCode + offset, size - offset, x64, pInstruction)) return false;
+
+				pRange->offsets[pRange->instructionCount] = static_cast<uint8_t>(offset);
+				pRange->instructionCount++;
+
+				if (pInstruction->relType != RelType::NONE) {
+					pRange->relativeCount++;
+				}
+
+				offset += pInstruction->length;
+
+				// the bytes behind the instruction might belong to another function
+				if (pInstruction->isTerminator && offset < minSize) return false;
+
+			}
+
+			pRange->size = offset;
+
+			return true;
+		}
+
+
+		size_t getRelocatedSize(const uint8_t* pCode, const StolenRange* pRange) {
+			size_t size = 0u;
+
+			for (size_t i = 0u; i < pRange->instructionCount; i++) {
+				size += getRelocatedLength(pCode + pRange->offsets[i], &pRange->instructions[i]);
+			}
+
+			return size;
+		}
+
+
+		size_t relocate(const uint8_t* pCode, const StolenRange* pRange, uint64_t source, uint64_t destination, bool x64, uint8_t* pOut, size_t outSize) {
+			size_t newOffsets[MAX_STOLEN_SIZE]{};
+			size_t newSize = 0u;
+
+			for (size_t i = 0u; i < pRange->instructionCount; i++) {
+				newOffsets[i] = newSize;
+				newSize += getRelocatedLength(pCode + pRange->offsets[i], &pRange->instructions[i]);
+			}
+
+			if (newSize > outSize) return 0u;
+
+			for (size_t i = 0u; i < pRange->instructionCount; i++) {
+				const Instruction* const pInstruction = &pRange->instructions[i];
+				const uint8_t* const pSrc = pCode + pRange->offsets[i];
+				uint8_t* const pDst = pOut + newOffsets[i];
+
+				if (pInstruction->relType == RelType::NONE) {
+					memcpy(pDst, pSrc, pInstruction->length);
+
+					continue;
+				}
+
+				int64_t displacement = 0;
+
+				if (pInstruction->relSize == 1u) {
+					displacement = static_cast<int8_t>(pSrc[pInstruction->relOffset]);
+				}
+				else if (pInstruction->relSize == 4u) {
+					int32_t displacement32 = 0;
+					memcpy(&displacement32, pSrc + pInstruction->relOffset, sizeof(displacement32));
+					displacement = displacement32;
+				}
+				else {
+					// 16 bit branches truncate the instruction pointer
+					return 0u;
+				}
+
+				const uint64_t instructionEnd = source + pRange->offsets[i] + pInstruction->length;
+				uint64_t target = instructionEnd + displacement;
+
+				// branches into the range have to reach the relocated instruction
+				if (pInstruction->relType != RelType::RIP_RELATIVE && target >= source && target < source + pRange->size) {
+					size_t index = SIZE_MAX;
+
+					for (size_t j = 0u; j < pRange->instructionCount; j++) {
+
+						if (source + pRange->offsets[j] == target) {
+							index = j;
+
+							break;
+						}
+
+					}
+
+					if (index == SIZE_MAX) return 0u;
+
+					target = destination + newOffsets[index];
+				}
+
+				uint8_t* pRelative = nullptr;
+				size_t newLength = 0u;
+
+				if (pInstruction->relType == RelType::BRANCH8) {
+					const uint8_t opcode = pSrc[pInstruction->opcodeOffset];
+					uint8_t* const pOpcode = pDst + pInstruction->opcodeOffset;
+					memcpy(pDst, pSrc, pInstruction->opcodeOffset);
+
+					if (opcode == 0xEBu) {
+						// jmp rel32
+						pOpcode[0] = 0xE9u;
+						pRelative = pOpcode + 1;
+					}
+					else if (opcode >= 0x70u && opcode <= 0x7Fu) {
+						// jcc rel32
+						pOpcode[0] = 0x0Fu;
+						pOpcode[1] = static_cast<uint8_t>(opcode + 0x10u);
+						pRelative = pOpcode + 2;
+					}
+					else {
+						// loop and jecxz have no near form, they branch over a short jump to a near jump instead
+						pOpcode[0] = opcode;
+						pOpcode[1] = 0x02u;
+						pOpcode[2] = 0xEBu;
+						pOpcode[3] = 0x05u;
+						pOpcode[4] = 0xE9u;
+						pRelative = pOpcode + 5;
+					}
+
+					newLength = static_cast<size_t>(pRelative + sizeof(int32_t) - pDst);
+				}
+				else {
+					memcpy(pDst, pSrc, pInstruction->length);
+					pRelative = pDst + pInstruction->relOffset;
+					newLength = pInstruction->length;
+				}
+
+				// relative to the end of the relocated instruction
+				const int64_t newDisplacement = static_cast<int64_t>(target - (destination + newOffsets[i] + newLength));
+
+				// in x86 code every address is reachable since the displacement wraps around
+				if (x64 && (newDisplacement < INT32_MIN || newDisplacement > INT32_MAX)) return 0u;
+
+				const int32_t newDisplacement32 = static_cast<int32_t>(newDisplacement);
+				memcpy(pRelative, &newDisplacement32, sizeof(newDisplacement32));
+			}
+
+			return newSize;
+		}
+
+
+		static size_t decodeModRm(const uint8_t* pCode, size_t pos, size_t limit, bool x64, bool addrSize, Instruction* pInstruction) {
+
+			if (pos >= limit) return 0u;
+
+			const uint8_t modRm = pCode[pos++];
+			const uint8_t mod = modRm >> 6u;
+			const uint8_t rm = modRm & 0x07u;
+
+			if (mod == 3u) return pos;
+
+			size_t dispSize = 0u;
+
+			if (!x64 && addrSize) {
+				// 16 bit addressing has no SIB byte
+				if (mod == 0u) {
+					dispSize = rm == 6u ? 2u : 0u;
+				}
+				else {
+					dispSize = mod == 1u ? 1u : 2u;
+				}
+
+			}
+			else {
+				dispSize = mod == 1u ? 1u : (mod == 2u ? 4u : 0u);
+
+				if (rm == 4u) {
+
+					if (pos >= limit) return 0u;
+
+					const uint8_t sib = pCode[pos++];
+
+					// no base register
+					if (mod == 0u && (sib & 0x07u) == 5u) {
+						dispSize = 4u;
+					}
+
+				}
+				else if (mod == 0u && rm == 5u) {
+					dispSize = 4u;
+
+					// absolute address in x86 code, relative to the instruction pointer in x64 code
+					if (x64) {
+						pInstruction->relType = RelType::RIP_RELATIVE;
+						pInstruction->relOffset = static_cast<uint8_t>(pos);
+						pInstruction->relSize = 4u;
+					}
+
+				}
+
+			}
+
+			pos += dispSize;
+
+			if (pos > limit) return 0u;
+
+			return pos;
+		}
+
+
+		static size_t decodeVector(const uint8_t* pCode, size_t pos, size_t limit, uint8_t prefix, uint8_t* pFlags) {
+			size_t payloadSize = 0u;
+			uint8_t map = 0u;
+
+			if (prefix == 0xC5u) {
+				// two byte VEX implies map 1
+				payloadSize = 1u;
+				map = 1u;
+			}
+			else if (prefix == 0xC4u) {
+				payloadSize = 2u;
+				map = pCode[pos] & 0x1Fu;
+			}
+			else if (prefix == 0x8Fu) {
+				payloadSize = 2u;
+				map = pCode[pos] & 0x1Fu;
+			}
+			else {
+				// EVEX
+				payloadSize = 3u;
+				map = pCode[pos] & 0x07u;
+			}
+
+			pos += payloadSize;
+
+			if (pos >= limit) return 0u;
+
+			const uint8_t opcode = pCode[pos++];
+
+			if (prefix == 0x8Fu) {
+
+				if (map == 0x08u) {
+					*pFlags = MR | I8;
+				}
+				else if (map == 0x09u) {
+					*pFlags = MR;
+				}
+				else if (map == 0x0Au) {
+					*pFlags = MR | IZ;
+				}
+				else {
+					return 0u;
+				}
+
+			}
+			else if (map == 1u) {
+				*pFlags = TWO_BYTE[opcode];
+
+				if (*pFlags & (XX | SP | RZ)) return 0u;
+
+			}
+			else if (map == 2u || map == 5u || map == 6u) {
+				*pFlags = MR;
+			}
+			else if (map == 3u) {
+				*pFlags = MR | I8;
+			}
+			else {
+				return 0u;
+			}
+
+			return pos;
+		}
+
+
+		static size_t getRelocatedLength(const uint8_t* pInstructionCode, const Instruction* pInstruction) {
+
+			if (pInstruction->relType != RelType::BRANCH8) return pInstruction->length;
+
+			const uint8_t opcode = pInstructionCode[pInstruction->opcodeOffset];
+
+			// jmp rel32
+			if (opcode == 0xEBu) return pInstruction->opcodeOffset + 5u;
+
+			// jcc rel32
+			if (opcode >= 0x70u && opcode <= 0x7Fu) return pInstruction->opcodeOffset + 6u;
+
+			// loop or jecxz over a short jump to a near jump
+			return pInstruction->opcodeOffset + 9u;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Table driven length decoder for x86 and x64 instructions.
+// Determines the length of instructions and the location of their relative operands (short and near branches, RIP-relative memory operands) without disassembling them completely.
+// Used to determine how many bytes a hook has to steal at the beginning of a function and to relocate the stolen instructions to a gateway.
+// The functions do not call any API functions and do not depend on windows headers, so they work on any platform.
+
+namespace hax {
+
+	namespace instr {
+
+		// maximum length of an x86 or x64 instruction in bytes
+		constexpr size_t MAX_LENGTH = 15u;
+		// maximum size of a stolen range in bytes
+		constexpr size_t MAX_STOLEN_SIZE = 0x20u;
+		// maximum size of the stolen instructions after relocation, short branches grow from two to at most nine bytes
+		constexpr size_t MAX_RELOCATED_SIZE = (MAX_STOLEN_SIZE + MAX_LENGTH) * 5u;
+
+		enum class RelType : uint8_t {
+			NONE,
+			// short branch with an eight bit displacement (jmp, jcc, loop, jecxz)
+			BRANCH8,
+			// near branch with a 16 or 32 bit displacement (call, jmp, jcc)
+			BRANCH32,
+			// memory operand addressed relative to the instruction pointer, only in x64 code
+			RIP_RELATIVE
+		};
+
+		typedef struct Instruction {
+			// length of the instruction in bytes
+			uint8_t length;
+			// offset of the opcode behind the prefixes
+			uint8_t opcodeOffset;
+			// offset of the relative operand within the instruction
+			uint8_t relOffset;
+			// size of the relative operand in bytes
+			uint8_t relSize;
+			RelType relType;
+			// execution never continues behind the instruction (jmp, ret, int3)
+			bool isTerminator;
+		}Instruction;
+
+		// Instructions at the beginning of a function that get overwritten by a hook.
+		typedef struct StolenRange {
+			// size of the whole instructions in bytes
+			size_t size;
+			size_t instructionCount;
+			// offsets of the instructions from the beginning of the range
+			uint8_t offsets[MAX_STOLEN_SIZE];
+			Instruction instructions[MAX_STOLEN_SIZE];
+			// count of instructions with a relative operand
+			size_t relativeCount;
+		}StolenRange;
+
+		// Decodes the length and the relative operand of an instruction.
+		//
+		// Parameters:
+		//
+		// [in] pCode:
+		// Address of the instruction.
+		//
+		// [in] size:
+		// Number of readable bytes at pCode. No byte beyond is read.
+		//
+		// [in] x64:
+		// True if the instruction is x64 code, false if it is x86 code.
+		//
+		// [out] pInstruction:
+		// Pointer to the struct that receives the decoded instruction.
+		//
+		// Return:
+		// Length of the instruction in bytes or 0 if the bytes are no valid instruction or the instruction exceeds size.
+		size_t decode(const uint8_t* pCode, size_t size, bool x64, Instruction* pInstruction);
+
+		// Decodes the whole instructions at the beginning of a function that cover a minimum size.
+		//
+		// Parameters:
+		//
+		// [in] pCode:
+		// Address of the beginning of the function.
+		//
+		// [in] size:
+		// Number of readable bytes at pCode. No byte beyond is read.
+		//
+		// [in] minSize:
+		// Minimum size of the range in bytes. Five for a relative jump (op code: E9), 14 for an absolute x64 jump. At most MAX_STOLEN_SIZE.
+		//
+		// [in] x64:
+		// True if the function is x64 code, false if it is x86 code.
+		//
+		// [out] pRange:
+		// Pointer to the struct that receives the decoded instructions.
+		//
+		// Return:
+		// True on success, false if an instruction could not be decoded or the function ends before minSize is reached.
+		bool getStolenRange(const uint8_t* pCode, size_t size, size_t minSize, bool x64, StolenRange* pRange);
+
+		// Gets the size of the instructions of a stolen range after relocation. Short branches are expanded to near branches.
+		//
+		// Parameters:
+		//
+		// [in] pCode:
+		// Address of the beginning of the range.
+		//
+		// [in] pRange:
+		// Pointer to the stolen range decoded from pCode.
+		//
+		// Return:
+		// Size of the relocated instructions in bytes.
+		size_t getRelocatedSize(const uint8_t* pCode, const StolenRange* pRange);
+
+		// Relocates the instructions of a stolen range to another address.
+		// Relative operands are corrected to keep their targets. Branches into the range are redirected to the relocated instructions.
+		//
+		// Parameters:
+		//
+		// [in] pCode:
+		// Address of the beginning of the range.
+		//
+		// [in] pRange:
+		// Pointer to the stolen range decoded from pCode.
+		//
+		// [in] source:
+		// Address of the range within the virtual address space of the process executing it.
+		//
+		// [in] destination:
+		// Address the relocated instructions are executed at within the virtual address space of the process executing them.
+		//
+		// [in] x64:
+		// True if the range is x64 code, false if it is x86 code.
+		//
+		// [out] pOut:
+		// Buffer that receives the relocated instructions.
+		//
+		// [in] outSize:
+		// Size of the buffer in bytes. Has to be at least getRelocatedSize().
+		//
+		// Return:
+		// Size of the relocated instructions in bytes or 0 on failure (eg. a relative operand can not reach its target from the destination).
+		size_t relocate(const uint8_t* pCode, const StolenRange* pRange, uint64_t source, uint64_t destination, bool x64, uint8_t* pOut, size_t outSize);
+
+	}
+
+}
\ No newline at end of file
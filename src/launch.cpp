@@ -1,6 +1,7 @@
 #include "launch.h"
 #include "proc.h"
 #include "mem.h"
+#include "shellcode.h"
 #include <stdint.h>
 
 #define LOW_DWORD(ptr) (static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ptr)))
@@ -10,6 +11,21 @@ namespace hax {
 	namespace launch {
 		// how long to wait for return value of launched function in milliseconds
 		constexpr DWORD LAUNCH_TIMEOUT = 5000ul;
+		// bounds of the interval for polling the execution of launched shell code in microseconds
+		constexpr ULONGLONG POLL_INTERVAL_MIN = 1u;
+		constexpr ULONGLONG POLL_INTERVAL_MAX = 0x4000u;
+		// how many of the best ranked threads are tried one after another for hijacking
+		constexpr size_t HIJACK_CANDIDATE_COUNT = 4u;
+		// how long a hijacked thread has to start executing the shell code before the next candidate is hijacked in milliseconds
+		constexpr ULONGLONG HIJACK_PICKUP_TIMEOUT = 100u;
+		// to how many of the best ranked threads the APC is queued at once
+		constexpr size_t APC_THREAD_COUNT = 3u;
+		// size of the shell code of a launch: launch shell code followed by the completion shell code and data at COMPLETION_OFFSET
+		constexpr size_t SHELL_CODE_SIZE = 0x280u;
+		// how many remote pools can be added at once
+		constexpr size_t MAX_POOLS = 0x10u;
+		// maximum number of bytes of NtUserBeginPaint overwritten by the hook
+		constexpr size_t MAX_BEGIN_PAINT_STOLEN = 0x10u;
 
 		typedef struct HookData {
 			DWORD processId;
@@ -20,22 +36,141 @@ namespace hax {
 			HWND hWnd;
 		}HookData;
 
-		static DWORD getPageSize();
+		typedef struct Completion {
+			// event the caller waits on
+			HANDLE hEvent;
+			// duplicate of the event within the target process signaled by the completion shell code
+			HANDLE hRemoteEvent;
+		}Completion;
+
+		// offset of the completion shell code and data within the shell code page, behind the launch shell code
+		constexpr size_t COMPLETION_OFFSET = 0x200u;
+
+		enum class Method {
+			CREATE_THREAD,
+			HIJACK_THREAD,
+			SET_WINDOWS_HOOK,
+			HOOK_BEGIN_PAINT,
+			QUEUE_USER_APC
+		};
+
+		// state of a launch from start until it is finished by the waiter thread
+		struct AsyncLaunch {
+			HANDLE hProc;
+			Method method;
+			bool isWow64;
+			BYTE* pShellCode;
+			// pool the shell code was allocated from, nullptr if the shell code was allocated on its own
+			mem::RemotePool* pPool;
+			Completion completion;
+			// flag set by the shell code after execution, nullptr if the exit of hThread signals the execution
+			const BYTE* pFlagEx;
+			// return value written by the shell code, nullptr if the exit code of hThread is the return value
+			const BYTE* pRetEx;
+			uint64_t ret;
+			// created thread for createThread, target thread for hijackThread and queueUserApc
+			HANDLE hThread;
+			// context of the target thread before it was hijacked
+			WOW64_CONTEXT wow64Context;
+
+			#ifdef _WIN64
+
+			CONTEXT context;
+
+			#endif // _WIN64
+
+			HHOOK hHook;
+			BYTE* pHookedFunc;
+			BYTE* pGateway;
+			// pool the gateway was allocated from, nullptr if the gateway was allocated on its own
+			mem::RemotePool* pGatewayPool;
+			// original bytes of the hooked function, the gateway only contains them with relocated relative operands
+			BYTE stolen[MAX_BEGIN_PAINT_STOLEN];
+			size_t stolenSize;
+			// count of the threads the APC was queued to
+			size_t apcCount;
+			// ranked candidates for hijackThread, threadIndex is the index of the next candidate
+			DWORD threadIds[HIJACK_CANDIDATE_COUNT];
+			size_t threadCount;
+			size_t threadIndex;
+			// the hijacked thread is restored and the next candidate hijacked if the thread has not started the shell code by then, 0 once it has started
+			ULONGLONG pickupDeadline;
+			// launched function and argument as passed to the launch shell code
+			tLaunchableFunc pFunc;
+			void* pArg;
+			// object the waiter thread waits on, nullptr if the execution is polled
+			HANDLE hWaitObject;
+			ULONGLONG deadline;
+			ULONGLONG pollInterval;
+			bool cancelRequested;
+			bool executed;
+			volatile LONG state;
+			// manual reset event signaled when the launch is finished
+			HANDLE hDoneEvent;
+			LaunchTimes times;
+			// next outstanding launch of the waiter
+			AsyncLaunch* pNext;
+		};
+
+		// single thread that waits for all outstanding launches of the process
+		typedef struct Waiter {
+			SRWLOCK lock;
+			AsyncLaunch* pHead;
+			HANDLE hWakeEvent;
+			bool running;
+		}Waiter;
+
+		static Waiter waiter{ SRWLOCK_INIT, nullptr, nullptr, false };
+
+		// remote pool added for a process
+		typedef struct PoolEntry {
+			mem::RemotePool* pPool;
+			DWORD processId;
+			// launches and batches that allocated their shell code from the pool and are not finished yet
+			size_t useCount;
+		}PoolEntry;
+
+		typedef struct PoolRegistry {
+			SRWLOCK lock;
+			PoolEntry entries[MAX_POOLS];
+		}PoolRegistry;
+
+		static PoolRegistry poolRegistry{ SRWLOCK_INIT, {} };
+
+		// allocates shell code from the pool added for the process or on its own if there is no pool, ppPool receives the pool used
+		static BYTE* allocateShellCode(HANDLE hProc, size_t size, mem::RemotePool** ppPool);
+		static void freeShellCode(HANDLE hProc, BYTE* pShellCode, mem::RemotePool* pPool);
+		static mem::RemotePool* acquirePool(DWORD processId);
+		static void returnPool(mem::RemotePool* pPool);
+		static LONGLONG getTicks();
+		static AsyncLaunch* createLaunch(HANDLE hProc, Method method, bool allocShellCode);
+		// hands a started launch over to the waiter thread or discards it if the start failed
+		static AsyncLaunch* submitLaunch(AsyncLaunch* pLaunch, bool started);
+		static void discardLaunch(AsyncLaunch* pLaunch);
+		static bool launchSync(AsyncLaunch* pLaunch, void* pRet);
+		// writes shell code that calls the launched function and signals an event afterwards and replaces the launched function and argument with it
+		static bool setupCompletion(AsyncLaunch* pLaunch, tLaunchableFunc* ppFunc, void** ppArg);
+		static size_t getRankedThreadIds(DWORD processId, proc::ThreadUse use, DWORD threadIds[], size_t count);
+		// hijacks the next candidate thread of a launch that can be hijacked
+		static bool hijackNextThread(AsyncLaunch* pLaunch);
+		// the handle within the target is only closed if the completion shell code can not be executed anymore, otherwise it gets leaked
+		static void cleanupCompletion(HANDLE hProc, Completion* pCompletion, bool isFinished);
 
 		// x86 specific parts of the implementations
 		namespace x86 {
 
-			static bool createThread(HANDLE hProc, tNtCreateThreadEx pNtCreateThreadEx, tLaunchableFunc pFunc, void* pArg, void* pRet);
-			static bool hijackThread(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, DWORD threadId, tLaunchableFunc pFunc, void* pArg, void* pRet);
+			static bool createThread(AsyncLaunch* pLaunch, tNtCreateThreadEx pNtCreateThreadEx, tLaunchableFunc pFunc, void* pArg);
+			static bool hijackThread(AsyncLaunch* pLaunch, DWORD threadId, tLaunchableFunc pFunc, void* pArg);
 
 			#ifndef _WIN64
 
-			static bool setWindowsHook(HANDLE hProc, BYTE* pShellCode, HookData* pHookData, tLaunchableFunc pFunc, void* pArg, void* pRet);
+			static bool setWindowsHook(AsyncLaunch* pLaunch, HookData* pHookData, tLaunchableFunc pFunc, void* pArg);
 
 			#endif // !_WIN64
 
-			static bool hookBeginPaint(HANDLE hProc, BYTE* pShellCode, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg, void* pRet);
-			static bool queueUserApc(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, tLaunchableFunc pFunc, void* pArg, void* pRet);
+			static bool hookBeginPaint(AsyncLaunch* pLaunch, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg);
+			static bool queueUserApc(AsyncLaunch* pLaunch, const DWORD threadIds[], size_t threadCount, tLaunchableFunc pFunc, void* pArg);
+			static bool batch(HANDLE hProc, tLaunchFunc pLaunchFunc, LaunchCall calls[], size_t count);
 
 		}
 
@@ -44,11 +179,12 @@ namespace hax {
 		// x64 specific parts of the implementations
 		namespace x64 {
 
-			static bool createThread(HANDLE hProc, tNtCreateThreadEx pNtCreateThreadEx, BYTE* pShellCode, tLaunchableFunc pFunc, void* pArg, void* pRet);
-			static bool hijackThread(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, DWORD threadId, tLaunchableFunc pFunc, void* pArg, void* pRet);
-			static bool setWindowsHook(HANDLE hProc, BYTE* pShellCode, HookData* pHookData, tLaunchableFunc pFunc, void* pArg, void* pRet);
-			static bool hookBeginPaint(HANDLE hProc, BYTE* pShellCode, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg, void* pRet);
-			static bool queueUserApc(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, tLaunchableFunc pFunc, void* pArg, void* pRet);
+			static bool createThread(AsyncLaunch* pLaunch, tNtCreateThreadEx pNtCreateThreadEx, tLaunchableFunc pFunc, void* pArg);
+			static bool hijackThread(AsyncLaunch* pLaunch, DWORD threadId, tLaunchableFunc pFunc, void* pArg);
+			static bool setWindowsHook(AsyncLaunch* pLaunch, HookData* pHookData, tLaunchableFunc pFunc, void* pArg);
+			static bool hookBeginPaint(AsyncLaunch* pLaunch, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg);
+			static bool queueUserApc(AsyncLaunch* pLaunch, const DWORD threadIds[], size_t threadCount, tLaunchableFunc pFunc, void* pArg);
+			static bool batch(HANDLE hProc, tLaunchFunc pLaunchFunc, LaunchCall calls[], size_t count);
 
 		}
 
@@ -56,147 +192,146 @@ namespace hax {
 
 
 		bool createThread(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
-			const HMODULE hNtdll = proc::in::getModuleHandle("Ntdll.dll");
 
-			if (!hNtdll) return false;
+			return launchSync(createThreadAsync(hProc, pFunc, pArg), pRet);
+		}
 
-			const tNtCreateThreadEx pNtCreateThreadEx = reinterpret_cast<tNtCreateThreadEx>(proc::in::getProcAddress(hNtdll, "NtCreateThreadEx"));
 
-			if (!pNtCreateThreadEx) return false;
+		bool hijackThread(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
 
-			BOOL isWow64 = FALSE;
-			IsWow64Process(hProc, &isWow64);
+			return launchSync(hijackThreadAsync(hProc, pFunc, pArg), pRet);
+		}
 
-			bool success = false;
 
-			if (isWow64) {
+		bool setWindowsHook(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
 
-				success = x86::createThread(hProc, pNtCreateThreadEx, pFunc, pArg, pRet);
+			return launchSync(setWindowsHookAsync(hProc, pFunc, pArg), pRet);
+		}
 
-			}
-			else {
 
-				// x64 targets only feasable for x64 compilations
-				#ifdef _WIN64
+		bool hookBeginPaint(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
 
-				const DWORD pageSize = getPageSize();
+			return launchSync(hookBeginPaintAsync(hProc, pFunc, pArg), pRet);
+		}
 
-				if (!pageSize) return false;
 
-				// shell coding for x64 processes is done just to get the full 8 byte return value of x64 threads
-				// GetExitCodeThread only gets a DWORD value
-				BYTE* const pShellCode = reinterpret_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, pageSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+		bool queueUserApc(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
 
-				if (!pShellCode) return false;
+			return launchSync(queueUserApcAsync(hProc, pFunc, pArg), pRet);
+		}
 
-				success = x64::createThread(hProc, pNtCreateThreadEx, pShellCode, pFunc, pArg, pRet);
 
-				VirtualFreeEx(hProc, pShellCode, 0, MEM_RELEASE);
+		AsyncLaunch* createThreadAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg) {
+			const HMODULE hNtdll = proc::in::getModuleHandle("Ntdll.dll");
 
-				#endif
+			if (!hNtdll) return nullptr;
 
-			}
+			const tNtCreateThreadEx pNtCreateThreadEx = reinterpret_cast<tNtCreateThreadEx>(proc::in::getProcAddress(hNtdll, "NtCreateThreadEx"));
 
-			return success;
-		}
+			if (!pNtCreateThreadEx) return nullptr;
 
+			BOOL isWow64 = FALSE;
+			IsWow64Process(hProc, &isWow64);
 
-		bool hijackThread(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
-			const DWORD processId = GetProcessId(hProc);
+			// shell coding for x64 processes is done just to get the full 8 byte return value of x64 threads
+			// GetExitCodeThread only gets a DWORD value
+			AsyncLaunch* const pLaunch = createLaunch(hProc, Method::CREATE_THREAD, !isWow64);
 
-			if (!processId) return false;
+			if (!pLaunch) return nullptr;
 
-			// get the first/main thread entry
-			proc::ThreadEntry threadEntry{};
-			proc::getProcessThreadEntries(processId, &threadEntry, 1);
+			bool success = false;
 
-			const HANDLE hThread = OpenThread(THREAD_SET_CONTEXT | THREAD_GET_CONTEXT | THREAD_SUSPEND_RESUME, FALSE, threadEntry.threadId);
+			if (pLaunch->isWow64) {
 
-			if (!hThread) return false;
+				success = x86::createThread(pLaunch, pNtCreateThreadEx, pFunc, pArg);
 
-			const DWORD pageSize = getPageSize();
+			}
+			else {
 
-			if (!pageSize) return false;
+				// x64 targets only feasable for x64 compilations
+				#ifdef _WIN64
 
-			BYTE* const pShellCode = reinterpret_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, pageSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+				success = x64::createThread(pLaunch, pNtCreateThreadEx, pFunc, pArg);
 
-			if (!pShellCode) {
-				CloseHandle(hThread);
+				#endif
 
-				return false;
 			}
 
-			BOOL isWow64 = FALSE;
-			IsWow64Process(hProc, &isWow64);
+			// the exit of the thread signals the execution
+			pLaunch->hWaitObject = pLaunch->hThread;
 
-			bool success = false;
+			return submitLaunch(pLaunch, success);
+		}
 
-			if (isWow64) {
 
-				success = x86::hijackThread(hProc, pShellCode, hThread, threadEntry.threadId, pFunc, pArg, pRet);
+		AsyncLaunch* hijackThreadAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg) {
+			const DWORD processId = GetProcessId(hProc);
 
-			}
-			else {
+			if (!processId) return nullptr;
 
-				// x64 targets only feasable for x64 compilations
-				#ifdef _WIN64
+			// hijacked threads can not be restored safely in parallel, so the best ranked threads are tried one after another
+			DWORD threadIds[HIJACK_CANDIDATE_COUNT]{};
+			const size_t threadCount = getRankedThreadIds(processId, proc::ThreadUse::HIJACK, threadIds, _countof(threadIds));
 
-				success = x64::hijackThread(hProc, pShellCode, hThread, threadEntry.threadId, pFunc, pArg, pRet);
+			if (!threadCount) return nullptr;
 
-				#endif // _WIN64
+			AsyncLaunch* const pLaunch = createLaunch(hProc, Method::HIJACK_THREAD, true);
 
-			}
+			if (!pLaunch) return nullptr;
 
-			VirtualFreeEx(hProc, pShellCode, 0, MEM_RELEASE);
-			CloseHandle(hThread);
+			memcpy(pLaunch->threadIds, threadIds, sizeof(threadIds));
+			pLaunch->threadCount = threadCount;
 
-			return success;
+			// signal the completion via an event if possible, otherwise the flag in the shell code is only polled
+			setupCompletion(pLaunch, &pFunc, &pArg);
+
+			// the waiter thread hijacks the next candidate if the thread does not start executing the shell code in time
+			pLaunch->pFunc = pFunc;
+			pLaunch->pArg = pArg;
+
+			return submitLaunch(pLaunch, hijackNextThread(pLaunch));
 		}
 
 
-		bool setWindowsHook(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+		AsyncLaunch* setWindowsHookAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg) {
 			const DWORD processId = GetProcessId(hProc);
 
-			if (!processId) return false;
+			if (!processId) return nullptr;
 
 			// arbitrary but has to be loaded in both caller and target process
 			const HMODULE hHookedMod = proc::in::getModuleHandle("Kernel32.dll");
 
-			if (!hHookedMod) return false;
+			if (!hHookedMod) return nullptr;
 
 			const HMODULE hUser32 = proc::ex::getModuleHandle(hProc, "User32.dll");
 
-			if (!hUser32) return false;
+			if (!hUser32) return nullptr;
 
 			const FARPROC pCallNextHookEx = proc::ex::getProcAddress(hProc, hUser32, "CallNextHookEx");
 
-			if (!pCallNextHookEx) return false;
-
-			const DWORD pageSize = getPageSize();
+			if (!pCallNextHookEx) return nullptr;
 
-			if (!pageSize) return false;
+			AsyncLaunch* const pLaunch = createLaunch(hProc, Method::SET_WINDOWS_HOOK, true);
 
-			BYTE* const pShellCode = reinterpret_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, pageSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
-
-			if (!pShellCode) return false;
+			if (!pLaunch) return nullptr;
 
 			HookData hookData{};
 			hookData.processId = processId;
 			hookData.hModule = hHookedMod;
-			hookData.pHookFunc = reinterpret_cast<HOOKPROC>(pShellCode);
+			hookData.pHookFunc = reinterpret_cast<HOOKPROC>(pLaunch->pShellCode);
 			hookData.pCallNextHookEx = pCallNextHookEx;
 
-			BOOL isWow64 = FALSE;
-			IsWow64Process(hProc, &isWow64);
+			// signal the completion via an event if possible, otherwise the flag in the shell code is only polled
+			setupCompletion(pLaunch, &pFunc, &pArg);
 
 			bool success = false;
 
 			// installing hook only possible from process with matching architechture
-			if (isWow64) {
+			if (pLaunch->isWow64) {
 
 				#ifndef _WIN64
 
-				success = x86::setWindowsHook(hProc, pShellCode, &hookData, pFunc, pArg, pRet);
+				success = x86::setWindowsHook(pLaunch, &hookData, pFunc, pArg);
 
 				#endif // !_WIN64
 
@@ -205,43 +340,77 @@ namespace hax {
 
 				#ifdef _WIN64
 
-				success = x64::setWindowsHook(hProc, pShellCode, &hookData, pFunc, pArg, pRet);
+				success = x64::setWindowsHook(pLaunch, &hookData, pFunc, pArg);
 
 				#endif // _WIN64
 
 			}
 
-			VirtualFreeEx(hProc, pShellCode, 0, MEM_RELEASE);
-
-			return success;
+			return submitLaunch(pLaunch, success);
 		}
 
 
-		bool hookBeginPaint(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+		AsyncLaunch* hookBeginPaintAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg) {
 			const HMODULE hNtdll = proc::ex::getModuleHandle(hProc, "win32u.dll");
 
-			if (!hNtdll) return false;
+			if (!hNtdll) return nullptr;
 
 			BYTE* const pNtUserBeginPaint = reinterpret_cast<BYTE*>(proc::ex::getProcAddress(hProc, hNtdll, "NtUserBeginPaint"));
 
-			if (!pNtUserBeginPaint) return false;
+			if (!pNtUserBeginPaint) return nullptr;
 
-			const DWORD pageSize = getPageSize();
+			AsyncLaunch* const pLaunch = createLaunch(hProc, Method::HOOK_BEGIN_PAINT, true);
 
-			if (!pageSize) return false;
+			if (!pLaunch) return nullptr;
 
-			BYTE* const pShellCode = reinterpret_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, pageSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+			// signal the completion via an event if possible, otherwise the flag in the shell code is only polled
+			setupCompletion(pLaunch, &pFunc, &pArg);
 
-			if (!pShellCode) return false;
+			bool success = false;
 
-			BOOL isWow64 = FALSE;
-			IsWow64Process(hProc, &isWow64);
+			if (pLaunch->isWow64) {
+
+				success = x86::hookBeginPaint(pLaunch, pNtUserBeginPaint, pFunc, pArg);
+
+			}
+			else {
+
+				// x64 targets only feasable for x64 compilations
+				#ifdef _WIN64
+
+				success = x64::hookBeginPaint(pLaunch, pNtUserBeginPaint, pFunc, pArg);
+
+				#endif // _WIN64
+
+			}
+
+			return submitLaunch(pLaunch, success);
+		}
+
+
+		AsyncLaunch* queueUserApcAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg) {
+			const DWORD processId = GetProcessId(hProc);
+
+			if (!processId) return nullptr;
+
+			// the APC is queued to multiple threads at once, the first thread entering an alertable state executes the function
+			DWORD threadIds[APC_THREAD_COUNT]{};
+			const size_t threadCount = getRankedThreadIds(processId, proc::ThreadUse::APC, threadIds, _countof(threadIds));
+
+			if (!threadCount) return nullptr;
+
+			AsyncLaunch* const pLaunch = createLaunch(hProc, Method::QUEUE_USER_APC, true);
+
+			if (!pLaunch) return nullptr;
+
+			// signal the completion via an event if possible, otherwise the flag in the shell code is only polled
+			setupCompletion(pLaunch, &pFunc, &pArg);
 
 			bool success = false;
 
-			if (isWow64) {
+			if (pLaunch->isWow64) {
 
-				success = x86::hookBeginPaint(hProc, pShellCode, pNtUserBeginPaint, pFunc, pArg, pRet);
+				success = x86::queueUserApc(pLaunch, threadIds, threadCount, pFunc, pArg);
 
 			}
 			else {
@@ -249,68 +418,105 @@ namespace hax {
 				// x64 targets only feasable for x64 compilations
 				#ifdef _WIN64
 
-				success = x64::hookBeginPaint(hProc, pShellCode, pNtUserBeginPaint, pFunc, pArg, pRet);
+				success = x64::queueUserApc(pLaunch, threadIds, threadCount, pFunc, pArg);
 
 				#endif // _WIN64
 
 			}
 
-			VirtualFreeEx(hProc, pShellCode, 0, MEM_RELEASE);
+			return submitLaunch(pLaunch, success);
+		}
+
 
-			return success;
+		LaunchState poll(const AsyncLaunch* pLaunch) {
+
+			return static_cast<LaunchState>(InterlockedCompareExchange(const_cast<volatile LONG*>(&pLaunch->state), 0l, 0l));
 		}
 
 
-		bool queueUserApc(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet) {
-			const DWORD processId = GetProcessId(hProc);
+		LaunchState wait(AsyncLaunch* pLaunch, DWORD timeout) {
+			WaitForSingleObject(pLaunch->hDoneEvent, timeout);
 
-			proc::ProcessEntry procEntry{};
+			return poll(pLaunch);
+		}
 
-			if (!proc::getProcessEntry(processId, &procEntry)) return false;
 
-			proc::ThreadEntry* const pThreadEntries = new proc::ThreadEntry[procEntry.threadCount];
+		size_t waitAny(AsyncLaunch* const launches[], size_t count, DWORD timeout) {
 
-			if (!proc::getProcessThreadEntries(processId, pThreadEntries, procEntry.threadCount)) {
-				delete[] pThreadEntries;
+			if (!count || count > MAXIMUM_WAIT_OBJECTS) return SIZE_MAX;
 
-				return false;
+			HANDLE handles[MAXIMUM_WAIT_OBJECTS]{};
+
+			for (size_t i = 0u; i < count; i++) {
+				handles[i] = launches[i]->hDoneEvent;
 			}
 
-			DWORD threadId = 0ul;
+			const DWORD waitResult = WaitForMultipleObjects(static_cast<DWORD>(count), handles, FALSE, timeout);
 
-			// iterate in reverse to avoid threadpool worker threads
-			for (LONG i = procEntry.threadCount - 1; i >= 0; i--) {
+			if (waitResult >= WAIT_OBJECT_0 + count) return SIZE_MAX;
 
-				// SignalObjectAndWait, MsgWaitForMultipleObjectsEx, WaitForMultipleObjectsEx, WaitForSingleObjectEx set wait reason to WrQueue
-				// SleepEx sets wait reason to DelayExecution
-				if (pThreadEntries[i].waitReason == KWAIT_REASON::WrQueue || pThreadEntries[i].waitReason == KWAIT_REASON::DelayExecution) {
-					threadId = pThreadEntries[i].threadId;
+			return waitResult - WAIT_OBJECT_0;
+		}
 
-					break;
-				}
 
+		bool cancel(AsyncLaunch* pLaunch) {
+			AcquireSRWLockExclusive(&waiter.lock);
+
+			if (poll(pLaunch) == LaunchState::PENDING) {
+				pLaunch->cancelRequested = true;
+				SetEvent(waiter.hWakeEvent);
 			}
 
-			delete[] pThreadEntries;
+			ReleaseSRWLockExclusive(&waiter.lock);
+
+			// the waiter thread finishes the launch and cleans up
+			WaitForSingleObject(pLaunch->hDoneEvent, INFINITE);
+
+			return poll(pLaunch) == LaunchState::CANCELLED;
+		}
 
-			if (!threadId) return false;
 
-			const HANDLE hThread = OpenThread(THREAD_SET_CONTEXT, FALSE, threadId);
+		bool getReturnValue(const AsyncLaunch* pLaunch, void* pRet) {
 
-			if (!hThread) return false;
+			if (poll(pLaunch) != LaunchState::SUCCEEDED) return false;
 
-			const DWORD pageSize = getPageSize();
+			// x86 targets return four byte values
+			const size_t retSize = pLaunch->isWow64 ? sizeof(uint32_t) : sizeof(uint64_t);
 
-			if (!pageSize) return false;
+			return !memcpy_s(pRet, retSize, &pLaunch->ret, retSize);
+		}
 
-			BYTE* const pShellCode = reinterpret_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, pageSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
 
-			if (!pShellCode) {
-				CloseHandle(hThread);
+		bool getLaunchTimes(const AsyncLaunch* pLaunch, LaunchTimes* pTimes) {
 
-				return false;
+			if (poll(pLaunch) == LaunchState::PENDING) return false;
+
+			*pTimes = pLaunch->times;
+
+			return true;
+		}
+
+
+		void close(AsyncLaunch* pLaunch) {
+
+			if (!pLaunch) return;
+
+			if (poll(pLaunch) == LaunchState::PENDING) {
+				cancel(pLaunch);
 			}
 
+			CloseHandle(pLaunch->hDoneEvent);
+			delete pLaunch;
+
+			return;
+		}
+
+
+
+		bool batch(HANDLE hProc, tLaunchFunc pLaunchFunc, LaunchCall calls[], size_t count) {
+
+			if (!count) return true;
+
 			BOOL isWow64 = FALSE;
 			IsWow64Process(hProc, &isWow64);
 
@@ -318,7 +524,7 @@ namespace hax {
 
 			if (isWow64) {
 
-				success = x86::queueUserApc(hProc, pShellCode, hThread, pFunc, pArg, pRet);
+				success = x86::batch(hProc, pLaunchFunc, calls, count);
 
 			}
 			else {
@@ -326,28 +532,179 @@ namespace hax {
 				// x64 targets only feasable for x64 compilations
 				#ifdef _WIN64
 
-				success = x64::queueUserApc(hProc, pShellCode, hThread, pFunc, pArg, pRet);
+				success = x64::batch(hProc, pLaunchFunc, calls, count);
 
 				#endif // _WIN64
 
 			}
 
-			VirtualFreeEx(hProc, pShellCode, 0, MEM_RELEASE);
-			CloseHandle(hThread);
+			return success;
+		}
+
+
+		bool addPool(mem::RemotePool* pPool) {
+
+			if (!pPool) return false;
+
+			const DWORD processId = pPool->getProcessId();
+			PoolEntry* pFreeEntry = nullptr;
+			bool isAdded = false;
+
+			AcquireSRWLockExclusive(&poolRegistry.lock);
+
+			for (size_t i = 0u; i < MAX_POOLS; i++) {
+				PoolEntry* const pEntry = &poolRegistry.entries[i];
+
+				if (!pEntry->pPool) {
+
+					if (!pFreeEntry) {
+						pFreeEntry = pEntry;
+					}
+
+				}
+				else if (pEntry->processId == processId) {
+					isAdded = true;
+				}
+
+			}
+
+			const bool success = !isAdded && pFreeEntry;
+
+			if (success) {
+				pFreeEntry->pPool = pPool;
+				pFreeEntry->processId = processId;
+				pFreeEntry->useCount = 0u;
+			}
+
+			ReleaseSRWLockExclusive(&poolRegistry.lock);
+
+			return success;
+		}
+
+
+		bool removePool(mem::RemotePool* pPool) {
+
+			if (!pPool) return false;
+
+			bool success = false;
+
+			AcquireSRWLockExclusive(&poolRegistry.lock);
+
+			for (size_t i = 0u; i < MAX_POOLS; i++) {
+				PoolEntry* const pEntry = &poolRegistry.entries[i];
+
+				if (pEntry->pPool != pPool) continue;
+
+				if (!pEntry->useCount) {
+					*pEntry = PoolEntry{};
+					success = true;
+				}
+
+				break;
+			}
+
+			ReleaseSRWLockExclusive(&poolRegistry.lock);
 
 			return success;
 		}
 
 
-		static DWORD getPageSize() {
-			SYSTEM_INFO sysInfo{};
-			GetSystemInfo(&sysInfo);
+		static BYTE* allocateShellCode(HANDLE hProc, size_t size, mem::RemotePool** ppPool) {
+			*ppPool = acquirePool(GetProcessId(hProc));
+
+			if (*ppPool) {
+				BYTE* const pShellCode = (*ppPool)->allocate(size);
+
+				if (pShellCode) return pShellCode;
+
+				// fall back to an allocation of its own if the pool is exhausted
+				returnPool(*ppPool);
+				*ppPool = nullptr;
+			}
+
+			return static_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+		}
+
+
+		static void freeShellCode(HANDLE hProc, BYTE* pShellCode, mem::RemotePool* pPool) {
+
+			if (pPool) {
+				pPool->free(pShellCode);
+				returnPool(pPool);
+			}
+			else {
+				VirtualFreeEx(hProc, pShellCode, 0, MEM_RELEASE);
+			}
+
+			return;
+		}
+
+
+		static mem::RemotePool* acquirePool(DWORD processId) {
+			mem::RemotePool* pPool = nullptr;
+
+			AcquireSRWLockExclusive(&poolRegistry.lock);
+
+			for (size_t i = 0u; i < MAX_POOLS; i++) {
+				PoolEntry* const pEntry = &poolRegistry.entries[i];
+
+				if (pEntry->pPool && pEntry->processId == processId) {
+					pEntry->useCount++;
+					pPool = pEntry->pPool;
+
+					break;
+				}
+
+			}
+
+			ReleaseSRWLockExclusive(&poolRegistry.lock);
+
+			return pPool;
+		}
+
+
+		static void returnPool(mem::RemotePool* pPool) {
+			AcquireSRWLockExclusive(&poolRegistry.lock);
+
+			for (size_t i = 0u; i < MAX_POOLS; i++) {
+				PoolEntry* const pEntry = &poolRegistry.entries[i];
+
+				if (pEntry->pPool == pPool) {
+					pEntry->useCount--;
+
+					break;
+				}
+
+			}
+
+			ReleaseSRWLockExclusive(&poolRegistry.lock);
+
+			return;
+		}
+
+
+		static LONGLONG getTicks() {
+			LARGE_INTEGER ticks{};
+			QueryPerformanceCounter(&ticks);
 
-			return sysInfo.dwPageSize;
+			return ticks.QuadPart;
 		}
 
 
-		static bool checkShellCodeFlag(HANDLE hProc, const void* pFlag);
+		// thread that waits for the execution of all outstanding launches and finishes them
+		static DWORD WINAPI waiterThread(LPVOID lpParameter);
+		// cleans up after the execution, timeout or cancellation of a launch and sets its final state
+		static void finishLaunch(AsyncLaunch* pLaunch);
+		static bool isExecuted(const AsyncLaunch* pLaunch);
+		// restores the context of a hijacked thread
+		static bool restoreThread(const AsyncLaunch* pLaunch);
+		// restores a hijacked thread that has not started executing the shell code and hijacks the next candidate, false if there is no candidate left
+		static bool retryHijack(AsyncLaunch* pLaunch);
+		// saves the original bytes of NtUserBeginPaint and hooks it with the shell code of the launch, the gateway shares the pool of the shell code
+		static bool installBeginPaintHook(AsyncLaunch* pLaunch, BYTE* pNtUserBeginPaint, size_t originCallOffset, size_t stolenSize);
+		// patches the original bytes back to NtUserBeginPaint and frees the gateway
+		static bool unhookBeginPaint(const AsyncLaunch* pLaunch);
+		static void sleepMicroseconds(ULONGLONG microseconds);
 		// callback for setWindowsHook
 		static BOOL CALLBACK setHookCallback(HWND hWnd, LPARAM lParam);
 		// callback to resize window for hookUserBeginPaint
@@ -361,31 +718,44 @@ namespace hax {
 				uint32_t pFunc;
 				uint32_t pRet;
 				uint8_t flag;
+				// set by the first of multiple threads executing the shell code
+				uint8_t claimed;
+				// count of threads that executed the shell code
+				uint8_t runCount;
 			}LaunchData;
 
-			static bool createThread(HANDLE hProc, tNtCreateThreadEx pNtCreateThreadEx, tLaunchableFunc pFunc, void* pArg, void* pRet) {
-				HANDLE hThread = nullptr;
-
-				if (pNtCreateThreadEx(&hThread, THREAD_ALL_ACCESS, nullptr, hProc, reinterpret_cast<LPTHREAD_START_ROUTINE>(pFunc), pArg, 0, 0, 0, 0, nullptr) != STATUS_SUCCESS) return false;
-
-				if (!hThread) return false;
-
-				if (WaitForSingleObject(hThread, LAUNCH_TIMEOUT)) {
+			// struct for data within the completion shell code
+			typedef struct CompletionData {
+				uint32_t pFunc;
+				uint32_t pArg;
+				uint32_t pNtSetEvent;
+				uint32_t hEvent;
+				uint32_t ret;
+			}CompletionData;
 
-					#pragma warning (push)
-					#pragma warning (disable: 6258)
-					TerminateThread(hThread, 0);
-					#pragma warning (pop)
+			// ASM:
+			// push   ebx							save register
+			// mov    ebx, DWORD PTR[esp + 0x8]		load pCompletionData
+			// push   DWORD PTR[ebx + 0x4]			push pCompletionData->pArg for pCompletionData->pFunc call
+			// call   DWORD PTR[ebx]				call pCompletionData->pFunc
+			// mov    DWORD PTR[ebx + 0x10], eax	save return value to pCompletionData->ret
+			// push   0x0							PreviousState = nullptr
+			// push   DWORD PTR[ebx + 0xc]			EventHandle = pCompletionData->hEvent
+			// call   DWORD PTR[ebx + 0x8]			call pCompletionData->pNtSetEvent
+			// mov    eax, DWORD PTR[ebx + 0x10]	return pCompletionData->ret
+			// pop    ebx							restore register
+			// ret    0x4
+			static constexpr BYTE COMPLETION_SHELL[]{ 0x53, 0x8B, 0x5C, 0x24, 0x08, 0xFF, 0x73, 0x04, 0xFF, 0x13, 0x89, 0x43, 0x10, 0x6A, 0x00, 0xFF, 0x73, 0x0C, 0xFF, 0x53, 0x08, 0x8B, 0x43, 0x10, 0x5B, 0xC2, 0x04, 0x00 };
 
-					CloseHandle(hThread);
+			static bool createThread(AsyncLaunch* pLaunch, tNtCreateThreadEx pNtCreateThreadEx, tLaunchableFunc pFunc, void* pArg) {
+				HANDLE hThread = nullptr;
 
-					return false;
-				}
+				if (pNtCreateThreadEx(&hThread, THREAD_ALL_ACCESS, nullptr, pLaunch->hProc, reinterpret_cast<LPTHREAD_START_ROUTINE>(pFunc), pArg, 0, 0, 0, 0, nullptr) != STATUS_SUCCESS) return false;
 
-				GetExitCodeThread(hThread, reinterpret_cast<DWORD*>(pRet));
-				CloseHandle(hThread);
+				// the exit code of the thread is the return value
+				pLaunch->hThread = hThread;
 
-				return true;
+				return hThread != nullptr;
 			}
 
 			// ASM:
@@ -408,15 +778,19 @@ namespace hax {
 			// pop    ecx							restore register
 			// ret									return to old eip
 			static constexpr BYTE HIJACK_THREAD_SHELL[]{ 0x68, 0x00, 0x00, 0x00, 0x00, 0x51, 0x50, 0x52, 0x9C, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x8B, 0x41, 0x04, 0x51, 0xFF, 0x31, 0xFF, 0xD0, 0x59, 0x89, 0x41, 0x08, 0x9D, 0x5A, 0x58, 0xC6, 0x41, 0x0C, 0x01, 0x59, 0xC3 };
+			static constexpr shellcode::AbsSlot<uint32_t> HIJACK_THREAD_OLD_EIP{ 0x01u };
+			static constexpr shellcode::AbsSlot<uint32_t> HIJACK_THREAD_LAUNCH_DATA{ 0x0Au };
+			static_assert(shellcode::fits(HIJACK_THREAD_SHELL, HIJACK_THREAD_OLD_EIP) && shellcode::fits(HIJACK_THREAD_SHELL, HIJACK_THREAD_LAUNCH_DATA), "Slot out of shell code.");
 
-			static bool hijackThread(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, DWORD threadId, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool hijackThread(AsyncLaunch* pLaunch, DWORD threadId, tLaunchableFunc pFunc, void* pArg) {
+				const HANDLE hThread = pLaunch->hThread;
 
 				if (SuspendThread(hThread) == 0xFFFFFFFF) return false;
 
-				WOW64_CONTEXT wow64Context{};
-				wow64Context.ContextFlags = CONTEXT_CONTROL;
+				WOW64_CONTEXT* const pWow64Context = &pLaunch->wow64Context;
+				pWow64Context->ContextFlags = CONTEXT_CONTROL;
 
-				if (!Wow64GetThreadContext(hThread, &wow64Context)) {
+				if (!Wow64GetThreadContext(hThread, pWow64Context)) {
 					ResumeThread(hThread);
 
 					return false;
@@ -424,56 +798,55 @@ namespace hax {
 
 				BYTE localShell[sizeof(HIJACK_THREAD_SHELL) + sizeof(LaunchData)]{};
 				
-				if (memcpy_s(localShell, sizeof(localShell), HIJACK_THREAD_SHELL, sizeof(HIJACK_THREAD_SHELL))) return false;
+				if (memcpy_s(localShell, sizeof(localShell), HIJACK_THREAD_SHELL, sizeof(HIJACK_THREAD_SHELL))) {
+					ResumeThread(hThread);
+
+					return false;
+				}
 				
 				constexpr ptrdiff_t LAUNCH_DATA_OFFSET = sizeof(localShell) - sizeof(LaunchData);
 				LaunchData* const pLaunchData = reinterpret_cast<LaunchData*>(localShell + LAUNCH_DATA_OFFSET);
 				pLaunchData->pArg = LOW_DWORD(pArg);
 				pLaunchData->pFunc = LOW_DWORD(pFunc);
 
-				const uint32_t oldEip = wow64Context.Eip;
-				*reinterpret_cast<uint32_t*>(localShell + 0x01) = oldEip;
+				const uint32_t oldEip = pWow64Context->Eip;
+				HIJACK_THREAD_OLD_EIP.patch(localShell, oldEip);
 
-				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
-				*reinterpret_cast<uint32_t*>(localShell + 0x0A) = LOW_DWORD(pLaunchDataEx);
+				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pLaunch->pShellCode + LAUNCH_DATA_OFFSET);
+				HIJACK_THREAD_LAUNCH_DATA.patch(localShell, LOW_DWORD(pLaunchDataEx));
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) {
+				if (!WriteProcessMemory(pLaunch->hProc, pLaunch->pShellCode, localShell, sizeof(localShell), nullptr)) {
 					ResumeThread(hThread);
 
 					return false;
 				}
 
-				wow64Context.Eip = LOW_DWORD(pShellCode);
+				pLaunch->times.written = getTicks();
+
+				pWow64Context->Eip = LOW_DWORD(pLaunch->pShellCode);
 
-				if (!Wow64SetThreadContext(hThread, &wow64Context)) {
+				if (!Wow64SetThreadContext(hThread, pWow64Context)) {
+					pWow64Context->Eip = oldEip;
 					ResumeThread(hThread);
 
 					return false;
 				}
 
+				// keep the original context to restore it if the shell code does not get executed
+				pWow64Context->Eip = oldEip;
+
 				// post thread message to ensure thread execution
 				PostThreadMessageA(threadId, 0, 0, 0);
 
 				if (ResumeThread(hThread) == 0xFFFFFFFF) {
-					wow64Context.Eip = oldEip;
-					Wow64SetThreadContext(hThread, &wow64Context);
+					Wow64SetThreadContext(hThread, pWow64Context);
 					ResumeThread(hThread);
 
 					return false;
 				}
 
-				if (!checkShellCodeFlag(hProc, &pLaunchDataEx->flag)) {
-
-					if (SuspendThread(hThread) != 0xFFFFFFFF) {
-						wow64Context.Eip = oldEip;
-						Wow64SetThreadContext(hThread, &wow64Context);
-						ResumeThread(hThread);
-					}
-
-					return false;
-				}
-
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint32_t), nullptr)) return false;
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
 
 				return true;
 			}
@@ -505,8 +878,11 @@ namespace hax {
 			// pop    ebp
 			// ret    0xc
 			static constexpr BYTE WINDOWS_HOOK_SHELL[]{ 0x55, 0x89, 0xE5, 0xEB, 0x00, 0x50, 0x53, 0xBB, 0x00, 0x00, 0x00, 0x00, 0xC6, 0x43, 0xD0, 0x1B, 0x53, 0xFF, 0x33, 0xFF, 0x53, 0x04, 0x5B, 0x89, 0x43, 0x08, 0xC6, 0x43, 0x0C, 0x01, 0x5B, 0x58, 0xFF, 0x75, 0x10, 0xFF, 0x75, 0x0C, 0xFF, 0x75, 0x08, 0x6A, 0x00, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x5D, 0xC2, 0x0C, 0x00 };
+			static constexpr shellcode::AbsSlot<uint32_t> WINDOWS_HOOK_LAUNCH_DATA{ 0x08u };
+			static constexpr shellcode::RelSlot WINDOWS_HOOK_CALL_NEXT_HOOK{ 0x2Cu };
+			static_assert(shellcode::fits(WINDOWS_HOOK_SHELL, WINDOWS_HOOK_LAUNCH_DATA) && shellcode::fits(WINDOWS_HOOK_SHELL, WINDOWS_HOOK_CALL_NEXT_HOOK), "Slot out of shell code.");
 
-			static bool setWindowsHook(HANDLE hProc, BYTE* pShellCode, HookData* pHookData, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool setWindowsHook(AsyncLaunch* pLaunch, HookData* pHookData, tLaunchableFunc pFunc, void* pArg) {
 				BYTE localShell[sizeof(WINDOWS_HOOK_SHELL) + sizeof(LaunchData)]{};
 				
 				if (memcpy_s(localShell, sizeof(localShell), WINDOWS_HOOK_SHELL, sizeof(WINDOWS_HOOK_SHELL))) return false;
@@ -516,14 +892,21 @@ namespace hax {
 				pLaunchData->pArg = reinterpret_cast<uint32_t>(pArg);
 				pLaunchData->pFunc = reinterpret_cast<uint32_t>(pFunc);
 
+				BYTE* const pShellCode = pLaunch->pShellCode;
 				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
-				*reinterpret_cast<uint32_t*>(localShell + 0x08) = reinterpret_cast<uint32_t>(pLaunchDataEx);
-				*reinterpret_cast<uint32_t*>(localShell + 0x2C) = reinterpret_cast<uint32_t>(pHookData->pCallNextHookEx) - (reinterpret_cast<uint32_t>(pShellCode) + 0x30);
+				WINDOWS_HOOK_LAUNCH_DATA.patch(localShell, reinterpret_cast<uint32_t>(pLaunchDataEx));
+
+				if (!WINDOWS_HOOK_CALL_NEXT_HOOK.patch(localShell, reinterpret_cast<uintptr_t>(pShellCode), reinterpret_cast<uintptr_t>(pHookData->pCallNextHookEx))) return false;
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
+				if (!WriteProcessMemory(pLaunch->hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
+
+				pLaunch->times.written = getTicks();
 
 				EnumWindows(setHookCallback, reinterpret_cast<LPARAM>(pHookData));
 
+				// the hook is removed when the launch is finished
+				pLaunch->hHook = pHookData->hHook;
+
 				if (!pHookData->hHook || !pHookData->hWnd) return false;
 
 				// foreground window to activate the hook
@@ -531,15 +914,8 @@ namespace hax {
 				SetForegroundWindow(pHookData->hWnd);
 				SetForegroundWindow(hFgWnd);
 
-				if (!checkShellCodeFlag(hProc, &pLaunchDataEx->flag)) {
-					UnhookWindowsHookEx(pHookData->hHook);
-
-					return false;
-				}
-
-				UnhookWindowsHookEx(pHookData->hHook);
-
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint32_t), nullptr)) return false;
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
 
 				return true;
 			}
@@ -560,8 +936,11 @@ namespace hax {
 			// mov    eax, pGateway					jump to gateway to execute NtUserBeginPaint
 			// jmp    eax
 			static constexpr BYTE HOOK_BEGIN_PAINT_SHELL[]{ 0xEB, 0x00, 0x53, 0xBB, 0x00, 0x00, 0x00, 0x00, 0xC6, 0x43, 0xE1, 0x17, 0xFF, 0x33, 0xFF, 0x53, 0x04, 0x89, 0x43, 0x08, 0xC6, 0x43, 0x0C, 0x01, 0x5B, 0xB8, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xE0 };
+			static constexpr shellcode::AbsSlot<uint32_t> HOOK_BEGIN_PAINT_LAUNCH_DATA{ 0x04u };
+			static constexpr shellcode::AbsSlot<uint32_t> HOOK_BEGIN_PAINT_GATEWAY{ 0x1Au };
+			static_assert(shellcode::fits(HOOK_BEGIN_PAINT_SHELL, HOOK_BEGIN_PAINT_LAUNCH_DATA) && shellcode::fits(HOOK_BEGIN_PAINT_SHELL, HOOK_BEGIN_PAINT_GATEWAY), "Slot out of shell code.");
 
-			static bool hookBeginPaint(HANDLE hProc, BYTE* pShellCode, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool hookBeginPaint(AsyncLaunch* pLaunch, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg) {
 				BYTE localShell[sizeof(HOOK_BEGIN_PAINT_SHELL) + sizeof(LaunchData)]{};
 				
 				if (memcpy_s(localShell, sizeof(localShell), HOOK_BEGIN_PAINT_SHELL, sizeof(HOOK_BEGIN_PAINT_SHELL))) return false;
@@ -571,70 +950,57 @@ namespace hax {
 				pLaunchData->pArg = LOW_DWORD(pArg);
 				pLaunchData->pFunc = LOW_DWORD(pFunc);
 
+				BYTE* const pShellCode = pLaunch->pShellCode;
 				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
-				*reinterpret_cast<uint32_t*>(localShell + 0x04) = LOW_DWORD(pLaunchDataEx);
+				HOOK_BEGIN_PAINT_LAUNCH_DATA.patch(localShell, LOW_DWORD(pLaunchDataEx));
+
+				if (!WriteProcessMemory(pLaunch->hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
+				pLaunch->times.written = getTicks();
 
 				constexpr size_t LEN_STOLEN = 10;
-				BYTE* const pGateway = mem::ex::trampHook(hProc, pNtUserBeginPaint, pShellCode, 0x1A, LEN_STOLEN);
 
-				if (!pGateway) return false;
+				// the hook is removed when the launch is finished
+				if (!installBeginPaintHook(pLaunch, pNtUserBeginPaint, HOOK_BEGIN_PAINT_GATEWAY.offset, LEN_STOLEN)) return false;
 
-				const DWORD processId = GetProcessId(hProc);
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
+
+				const DWORD processId = GetProcessId(pLaunch->hProc);
 
 				if (processId) {
 					// resize the window to trigger NtUserBeginPaint execution
 					EnumWindows(resizeCallback, reinterpret_cast<LPARAM>(&processId));
 				}
 
-				const bool success = checkShellCodeFlag(hProc, &pLaunchDataEx->flag);
-
-				BYTE* const stolen = new BYTE[LEN_STOLEN]{};
-
-				// read the stolen bytes from the gateway
-				if (!ReadProcessMemory(hProc, pGateway, stolen, LEN_STOLEN, nullptr)) {
-					// if gateway gets deallocated here, the process will crash
-					delete[] stolen;
-
-					return false;
-				}
-
-				// patch the stolen bytes back
-				if (!mem::ex::patch(hProc, pNtUserBeginPaint, stolen, LEN_STOLEN)) {
-					// if gateway gets deallocated here, the process will crash
-					delete[] stolen;
-
-					return false;
-				}
-
-				delete[] stolen;
-				// now gateway can be deallocated safely
-				VirtualFreeEx(hProc, pGateway, 0, MEM_RELEASE);
-
-				if (!success) return false;
-
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint32_t), nullptr)) return false;
-
-				return true;
-			}
+				return true;
+			}
 
 
 			// ASM:
 			// push   ebp							setup stack frame
 			// mov    ebp, esp
 			// mov    ecx, DWORD PTR[ebp + 0x8]		load pLaunchData
+			// mov    al, 0x1
+			// xchg   BYTE PTR[ecx + 0xd], al		claim pLaunchData->claimed, the APC might be queued to multiple threads
+			// test   al, al
+			// jne    skip							skip pLaunchData->pFunc call if already claimed by another thread
 			// push   ecx							save register with pLaunchData
 			// push   DWORD PTR[ecx]				load pLaunchData->pArg for pLaunchData->pFunc call
 			// call   DWORD PTR[ecx + 0x4]			call pLaunchData->pFunc
 			// pop    ecx							restore register to pLaunchData
 			// mov    DWORD PTR[ecx + 0x8], eax		write return value to pLaunchData->pRet
+			// lock inc BYTE PTR[ecx + 0xe]			increment pLaunchData->runCount
 			// mov    BYTE PTR[ecx + 0xc], 0x1		set pLaunchData->flag to one
 			// pop    ebp							cleanup stack frame
 			// ret    0x4
-			static constexpr BYTE QUEUE_USER_APC_SHELL[]{ 0x55, 0x89, 0xE5, 0x8B, 0x4D, 0x08, 0x51, 0xFF, 0x31, 0xFF, 0x51, 0x04, 0x59, 0x89, 0x41, 0x08, 0xC6, 0x41, 0x0C, 0x01, 0x5D, 0xC2, 0x04, 0x00 };
+			// skip:
+			// lock inc BYTE PTR[ecx + 0xe]			increment pLaunchData->runCount
+			// pop    ebp							cleanup stack frame
+			// ret    0x4
+			static constexpr BYTE QUEUE_USER_APC_SHELL[]{ 0x55, 0x89, 0xE5, 0x8B, 0x4D, 0x08, 0xB0, 0x01, 0x86, 0x41, 0x0D, 0x84, 0xC0, 0x75, 0x16, 0x51, 0xFF, 0x31, 0xFF, 0x51, 0x04, 0x59, 0x89, 0x41, 0x08, 0xF0, 0xFE, 0x41, 0x0E, 0xC6, 0x41, 0x0C, 0x01, 0x5D, 0xC2, 0x04, 0x00, 0xF0, 0xFE, 0x41, 0x0E, 0x5D, 0xC2, 0x04, 0x00 };
 
-			static bool queueUserApc(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool queueUserApc(AsyncLaunch* pLaunch, const DWORD threadIds[], size_t threadCount, tLaunchableFunc pFunc, void* pArg) {
 				BYTE localShell[sizeof(QUEUE_USER_APC_SHELL) + sizeof(LaunchData)]{};
 				
 				if (memcpy_s(localShell, sizeof(localShell), QUEUE_USER_APC_SHELL, sizeof(QUEUE_USER_APC_SHELL))) return false;
@@ -644,7 +1010,9 @@ namespace hax {
 				pLaunchData->pArg = LOW_DWORD(pArg);
 				pLaunchData->pFunc = LOW_DWORD(pFunc);
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
+				if (!WriteProcessMemory(pLaunch->hProc, pLaunch->pShellCode, localShell, sizeof(localShell), nullptr)) return false;
+
+				pLaunch->times.written = getTicks();
 
 				const HMODULE hNtdll = proc::in::getModuleHandle("ntdll.dll");
 
@@ -654,17 +1022,117 @@ namespace hax {
 
 				if (!pRtlQueueApcWow64Thread) return false;
 
-				LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
+				LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pLaunch->pShellCode + LAUNCH_DATA_OFFSET);
 
-				if (pRtlQueueApcWow64Thread(hThread, pShellCode, pLaunchDataEx, nullptr, nullptr) != STATUS_SUCCESS) return false;
+				for (size_t i = 0u; i < threadCount; i++) {
+					const HANDLE hThread = OpenThread(THREAD_SET_CONTEXT, FALSE, threadIds[i]);
 
-				if (!checkShellCodeFlag(hProc, &pLaunchDataEx->flag)) return false;
+					if (!hThread) continue;
 
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint32_t), nullptr)) return false;
+					if (pRtlQueueApcWow64Thread(hThread, pLaunch->pShellCode, pLaunchDataEx, nullptr, nullptr) == STATUS_SUCCESS) {
+						pLaunch->apcCount++;
+					}
+
+					CloseHandle(hThread);
+				}
+
+				if (!pLaunch->apcCount) return false;
+
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
 
 				return true;
 			}
 
+
+			// ASM:
+			// push   ebx							save registers
+			// push   esi
+			// push   edi
+			// mov    ebx, DWORD PTR[esp + 0x10]	load pBatchData
+			// mov    esi, DWORD PTR[ebx]			load pBatchData->count
+			// lea    edi, [ebx + 0x4]				load pLaunchData of the first call
+			// test   esi, esi
+			// je     done
+			// loop:
+			// push   DWORD PTR[edi]				push pLaunchData->pArg for pLaunchData->pFunc call
+			// call   DWORD PTR[edi + 0x4]			call pLaunchData->pFunc
+			// mov    DWORD PTR[edi + 0x8], eax		write return value to pLaunchData->pRet
+			// mov    BYTE PTR[edi + 0xc], 0x1		set pLaunchData->flag to one
+			// add    edi, 0x10						advance to pLaunchData of the next call
+			// dec    esi
+			// jne    loop
+			// done:
+			// mov    eax, DWORD PTR[ebx]			return pBatchData->count
+			// pop    edi							restore registers
+			// pop    esi
+			// pop    ebx
+			// ret    0x4
+			static constexpr BYTE BATCH_SHELL[]{ 0x53, 0x56, 0x57, 0x8B, 0x5C, 0x24, 0x10, 0x8B, 0x33, 0x8D, 0x7B, 0x04, 0x85, 0xF6, 0x74, 0x12, 0xFF, 0x37, 0xFF, 0x57, 0x04, 0x89, 0x47, 0x08, 0xC6, 0x47, 0x0C, 0x01, 0x83, 0xC7, 0x10, 0x4E, 0x75, 0xEE, 0x8B, 0x03, 0x5F, 0x5E, 0x5B, 0xC2, 0x04, 0x00 };
+
+			static bool batch(HANDLE hProc, tLaunchFunc pLaunchFunc, LaunchCall calls[], size_t count) {
+				// the batch data consists of the call count followed by the launch data of each call
+				constexpr size_t BATCH_DATA_OFFSET = (sizeof(BATCH_SHELL) + 0xF) & ~static_cast<size_t>(0xF);
+				const size_t size = BATCH_DATA_OFFSET + sizeof(uint32_t) + count * sizeof(LaunchData);
+				BYTE* const localShell = new BYTE[size]{};
+				
+				memcpy(localShell, BATCH_SHELL, sizeof(BATCH_SHELL));
+				*reinterpret_cast<uint32_t*>(localShell + BATCH_DATA_OFFSET) = static_cast<uint32_t>(count);
+				LaunchData* const pLaunchData = reinterpret_cast<LaunchData*>(localShell + BATCH_DATA_OFFSET + sizeof(uint32_t));
+
+				for (size_t i = 0u; i < count; i++) {
+					pLaunchData[i].pArg = LOW_DWORD(calls[i].pArg);
+					pLaunchData[i].pFunc = LOW_DWORD(calls[i].pFunc);
+				}
+
+				mem::RemotePool* pPool = nullptr;
+				BYTE* const pShellCode = allocateShellCode(hProc, size, &pPool);
+
+				if (!pShellCode) {
+					delete[] localShell;
+
+					return false;
+				}
+
+				BYTE* const pBatchDataEx = pShellCode + BATCH_DATA_OFFSET;
+				bool success = false;
+				bool canFree = true;
+
+				if (WriteProcessMemory(hProc, pShellCode, localShell, size, nullptr)) {
+					uint32_t executed = 0u;
+
+					if (pLaunchFunc(hProc, reinterpret_cast<tLaunchableFunc>(pShellCode), pBatchDataEx, &executed)) {
+						// retrive the return values and flags of all calls with one read
+						success = ReadProcessMemory(hProc, pBatchDataEx + sizeof(uint32_t), pLaunchData, count * sizeof(LaunchData), nullptr);
+					}
+					else {
+						// a failed or timed out launch (eg. a hijacked thread or a queued APC) might still execute the shell code later
+						canFree = false;
+					}
+
+				}
+
+				// shell code that might still get executed stays allocated and keeps its pool in use like in finishLaunch
+				if (canFree) {
+					freeShellCode(hProc, pShellCode, pPool);
+				}
+
+				if (success) {
+
+					for (size_t i = 0u; i < count; i++) {
+
+						if (!pLaunchData[i].flag) success = false;
+
+						calls[i].ret = reinterpret_cast<void*>(static_cast<uintptr_t>(pLaunchData[i].pRet));
+					}
+
+				}
+
+				delete[] localShell;
+
+				return success;
+			}
+
 		}
 
 
@@ -678,8 +1146,37 @@ namespace hax {
 				uint64_t pFunc;
 				uint64_t pRet;
 				uint8_t flag;
+				// set by the first of multiple threads executing the shell code
+				uint8_t claimed;
+				// count of threads that executed the shell code
+				uint8_t runCount;
 			}LaunchData;
 
+			// struct for data within the completion shell code
+			typedef struct CompletionData {
+				uint64_t pFunc;
+				uint64_t pArg;
+				uint64_t pNtSetEvent;
+				uint64_t hEvent;
+				uint64_t ret;
+			}CompletionData;
+
+			// ASM:
+			// push   rbx							save register
+			// sub    rsp, 0x20						setup shadow space for function calls
+			// mov    rbx, rcx						save pCompletionData
+			// mov    rcx, QWORD PTR[rbx + 0x8]		load pCompletionData->pArg for pCompletionData->pFunc call
+			// call   QWORD PTR[rbx]				call pCompletionData->pFunc
+			// mov    QWORD PTR[rbx + 0x20], rax	save return value to pCompletionData->ret
+			// mov    rcx, QWORD PTR[rbx + 0x18]	EventHandle = pCompletionData->hEvent
+			// xor    edx, edx						PreviousState = nullptr
+			// call   QWORD PTR[rbx + 0x10]			call pCompletionData->pNtSetEvent
+			// mov    rax, QWORD PTR[rbx + 0x20]	return pCompletionData->ret
+			// add    rsp, 0x20						cleanup shadow space
+			// pop    rbx							restore register
+			// ret
+			static constexpr BYTE COMPLETION_SHELL[]{ 0x53, 0x48, 0x83, 0xEC, 0x20, 0x48, 0x89, 0xCB, 0x48, 0x8B, 0x4B, 0x08, 0xFF, 0x13, 0x48, 0x89, 0x43, 0x20, 0x48, 0x8B, 0x4B, 0x18, 0x31, 0xD2, 0xFF, 0x53, 0x10, 0x48, 0x8B, 0x43, 0x20, 0x48, 0x83, 0xC4, 0x20, 0x5B, 0xC3 };
+
 			// ASM:
 			// push rcx								save pLaunchData
 			// mov rax, rcx							load pLaunchData->pArg for pLaunchData->pFunc call
@@ -693,7 +1190,7 @@ namespace hax {
 			// ret
 			static constexpr BYTE CREATE_THREAD_SHELL[]{ 0x51, 0x48, 0x8B, 0xC1, 0x48, 0x8B, 0x08, 0x48, 0x83, 0xEC, 0x20, 0xFF, 0x50, 0x08, 0x48, 0x83, 0xC4, 0x20, 0x59, 0x48, 0x89, 0x41, 0x10, 0x48, 0x31, 0xC0, 0xC3 };
 
-			static bool createThread(HANDLE hProc, tNtCreateThreadEx pNtCreateThreadEx, BYTE* pShellCode, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool createThread(AsyncLaunch* pLaunch, tNtCreateThreadEx pNtCreateThreadEx, tLaunchableFunc pFunc, void* pArg) {
 				BYTE localShell[sizeof(CREATE_THREAD_SHELL) + sizeof(LaunchData)]{};
 
 				if (memcpy_s(localShell, sizeof(localShell), CREATE_THREAD_SHELL, sizeof(CREATE_THREAD_SHELL))) return false;
@@ -703,31 +1200,20 @@ namespace hax {
 				pLaunchData->pArg = reinterpret_cast<uint64_t>(pArg);
 				pLaunchData->pFunc = reinterpret_cast<uint64_t>(pFunc);
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
-
-				LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
-				HANDLE hThread = nullptr;
-
-				if (pNtCreateThreadEx(&hThread, THREAD_ALL_ACCESS, nullptr, hProc, reinterpret_cast<LPTHREAD_START_ROUTINE>(pShellCode), pLaunchDataEx, 0, 0, 0, 0, nullptr) != STATUS_SUCCESS) return false;
-
-				if (!hThread) return false;
-
-				if (WaitForSingleObject(hThread, LAUNCH_TIMEOUT)) {
+				if (!WriteProcessMemory(pLaunch->hProc, pLaunch->pShellCode, localShell, sizeof(localShell), nullptr)) return false;
 
-					#pragma warning (push)
-					#pragma warning (disable: 6258)
-					TerminateThread(hThread, 0);
-					#pragma warning (pop)
+				pLaunch->times.written = getTicks();
 
-					CloseHandle(hThread);
+				LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pLaunch->pShellCode + LAUNCH_DATA_OFFSET);
+				HANDLE hThread = nullptr;
 
-					return false;
-				}
+				if (pNtCreateThreadEx(&hThread, THREAD_ALL_ACCESS, nullptr, pLaunch->hProc, reinterpret_cast<LPTHREAD_START_ROUTINE>(pLaunch->pShellCode), pLaunchDataEx, 0, 0, 0, 0, nullptr) != STATUS_SUCCESS) return false;
 
-				ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint64_t), nullptr);
-				CloseHandle(hThread);
+				// the exit of the thread signals the execution, so only the return value is read from the shell code
+				pLaunch->hThread = hThread;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
 
-				return true;
+				return hThread != nullptr;
 			}
 
 
@@ -759,14 +1245,15 @@ namespace hax {
 			// ret
 			static constexpr BYTE HIJACK_THREAD_SHELL[]{ 0xFF, 0x35, 0x4F, 0x00, 0x00, 0x00, 0x50, 0x51, 0x52, 0x41, 0x50, 0x41, 0x51, 0x41, 0x52, 0x41, 0x53, 0x9C, 0x48, 0x8B, 0x0D, 0x2C, 0x00, 0x00, 0x00, 0x48, 0x8B, 0x05, 0x2D, 0x00, 0x00, 0x00, 0x48, 0x83, 0xEC, 0x20, 0xFF, 0xD0, 0x48, 0x83, 0xC4, 0x20, 0x48, 0x89, 0x05, 0x24, 0x00, 0x00, 0x00, 0x9D, 0x41, 0x5B, 0x41, 0x5A, 0x41, 0x59, 0x41, 0x58, 0x5A, 0x59, 0x58, 0xC6, 0x05, 0x19, 0x00, 0x00, 0x00, 0x01, 0xC3 };
 
-			static bool hijackThread(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, DWORD threadId, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool hijackThread(AsyncLaunch* pLaunch, DWORD threadId, tLaunchableFunc pFunc, void* pArg) {
+				const HANDLE hThread = pLaunch->hThread;
 
 				if (SuspendThread(hThread) == 0xFFFFFFFF) return false;
 
-				CONTEXT context{};
-				context.ContextFlags = CONTEXT_CONTROL;
+				CONTEXT* const pContext = &pLaunch->context;
+				pContext->ContextFlags = CONTEXT_CONTROL;
 
-				if (!GetThreadContext(hThread, &context)) {
+				if (!GetThreadContext(hThread, pContext)) {
 					ResumeThread(hThread);
 
 					return false;
@@ -774,57 +1261,55 @@ namespace hax {
 
 				BYTE localShell[sizeof(HIJACK_THREAD_SHELL) + sizeof(LaunchData)]{};
 
-				if (memcpy_s(localShell, sizeof(localShell), HIJACK_THREAD_SHELL, sizeof(HIJACK_THREAD_SHELL))) return false;
+				if (memcpy_s(localShell, sizeof(localShell), HIJACK_THREAD_SHELL, sizeof(HIJACK_THREAD_SHELL))) {
+					ResumeThread(hThread);
+
+					return false;
+				}
 				
 				constexpr ptrdiff_t LAUNCH_DATA_OFFSET = sizeof(localShell) - sizeof(LaunchData);
 				LaunchData* const pLaunchData = reinterpret_cast<LaunchData*>(localShell + LAUNCH_DATA_OFFSET);
 				pLaunchData->pArg = reinterpret_cast<uint64_t>(pArg);
 				pLaunchData->pFunc = reinterpret_cast<uint64_t>(pFunc);
 
-				const uint64_t oldRip = context.Rip;
+				const uint64_t oldRip = pContext->Rip;
 				// save old rip at pRet for convenience
 				// it is used before it is overwritten by the return value
 				pLaunchData->pRet = oldRip;
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) {
+				if (!WriteProcessMemory(pLaunch->hProc, pLaunch->pShellCode, localShell, sizeof(localShell), nullptr)) {
 					ResumeThread(hThread);
 
 					return false;
 				}
 
-				context.Rip = reinterpret_cast<uint64_t>(pShellCode);
+				pLaunch->times.written = getTicks();
+
+				pContext->Rip = reinterpret_cast<uint64_t>(pLaunch->pShellCode);
 
-				if (!SetThreadContext(hThread, &context)) {
+				if (!SetThreadContext(hThread, pContext)) {
+					pContext->Rip = oldRip;
 					ResumeThread(hThread);
 
 					return false;
 				}
 
+				// keep the original context to restore it if the shell code does not get executed
+				pContext->Rip = oldRip;
+
 				// post thread message to ensure thread execution
 				PostThreadMessageA(threadId, 0, 0, 0);
 
 				if (ResumeThread(hThread) == 0xFFFFFFFF) {
-					context.Rip = oldRip;
-					SetThreadContext(hThread, &context);
+					SetThreadContext(hThread, pContext);
 					ResumeThread(hThread);
 
 					return false;
 				}
 
-				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
-
-				if (!checkShellCodeFlag(hProc, &pLaunchDataEx->flag)) {
-
-					if (SuspendThread(hThread) != 0xFFFFFFFF) {
-						context.Rip = oldRip;
-						SetThreadContext(hThread, &context);
-						ResumeThread(hThread);
-					}
-
-					return false;
-				}
-
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint64_t), nullptr)) return false;
+				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pLaunch->pShellCode + LAUNCH_DATA_OFFSET);
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
 
 				return true;
 			}
@@ -857,8 +1342,10 @@ namespace hax {
 			// pop    rbp
 			// ret
 			static constexpr BYTE WINDOWS_HOOK_SHELL[]{ 0x55, 0x54, 0x53, 0x41, 0x50, 0x52, 0x51, 0xEB, 0x00, 0xC6, 0x05, 0xF8, 0xFF, 0xFF, 0xFF, 0x2A, 0x48, 0x8B, 0x0D, 0x39, 0x00, 0x00, 0x00, 0x48, 0x83, 0xEC, 0x28, 0xFF, 0x15, 0x37, 0x00, 0x00, 0x00, 0x48, 0x83, 0xC4, 0x28, 0x48, 0x89, 0x05, 0x34, 0x00, 0x00, 0x00, 0xC6, 0x05, 0x35, 0x00, 0x00, 0x00, 0x01, 0x5A, 0x41, 0x58, 0x41, 0x59, 0x48, 0xBB, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x83, 0xEC, 0x28, 0xFF, 0xD3, 0x48, 0x83, 0xC4, 0x28, 0x5B, 0x5C, 0x5D, 0xC3 };
+			static constexpr shellcode::AbsSlot<uint64_t> WINDOWS_HOOK_CALL_NEXT_HOOK{ 0x3Au };
+			static_assert(shellcode::fits(WINDOWS_HOOK_SHELL, WINDOWS_HOOK_CALL_NEXT_HOOK), "Slot out of shell code.");
 
-			static bool setWindowsHook(HANDLE hProc, BYTE* pShellCode, HookData* pHookData, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool setWindowsHook(AsyncLaunch* pLaunch, HookData* pHookData, tLaunchableFunc pFunc, void* pArg) {
 				BYTE localShell[sizeof(WINDOWS_HOOK_SHELL) + sizeof(LaunchData)]{};
 				
 				if (memcpy_s(localShell, sizeof(localShell), WINDOWS_HOOK_SHELL, sizeof(WINDOWS_HOOK_SHELL))) return false;
@@ -868,14 +1355,19 @@ namespace hax {
 				pLaunchData->pArg = reinterpret_cast<uint64_t>(pArg);
 				pLaunchData->pFunc = reinterpret_cast<uint64_t>(pFunc);
 
-				*reinterpret_cast<uint64_t*>(localShell + 0x3A) = reinterpret_cast<uint64_t>(pHookData->pCallNextHookEx);
+				WINDOWS_HOOK_CALL_NEXT_HOOK.patch(localShell, reinterpret_cast<uint64_t>(pHookData->pCallNextHookEx));
 
-				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
+				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pLaunch->pShellCode + LAUNCH_DATA_OFFSET);
+
+				if (!WriteProcessMemory(pLaunch->hProc, pLaunch->pShellCode, localShell, sizeof(localShell), nullptr)) return false;
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
+				pLaunch->times.written = getTicks();
 
 				EnumWindows(setHookCallback, reinterpret_cast<LPARAM>(pHookData));
 
+				// the hook is removed when the launch is finished
+				pLaunch->hHook = pHookData->hHook;
+
 				if (!pHookData->hHook || !pHookData->hWnd) return false;
 
 				// foreground window to activate the hook
@@ -883,15 +1375,8 @@ namespace hax {
 				SetForegroundWindow(pHookData->hWnd);
 				SetForegroundWindow(hFgWnd);
 
-				if (!checkShellCodeFlag(hProc, &pLaunchDataEx->flag)) {
-					UnhookWindowsHookEx(pHookData->hHook);
-
-					return false;
-				}
-
-				UnhookWindowsHookEx(pHookData->hHook);
-
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint64_t), nullptr)) return false;
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
 
 				return true;
 			}
@@ -913,8 +1398,10 @@ namespace hax {
 			// movabs rax, pGateway					jump to gateway to execute NtUserBeginPaint
 			// jmp    rax
 			static constexpr BYTE HOOK_BEGIN_PAINT_SHELL[]{ 0xEB, 0x00, 0xC6, 0x05, 0xF8, 0xFF, 0xFF, 0xFF, 0x2E, 0x51, 0x52, 0x48, 0x8B, 0x0D, 0x2A, 0x00, 0x00, 0x00, 0x48, 0x83, 0xEC, 0x28, 0xFF, 0x15, 0x28, 0x00, 0x00, 0x00, 0x48, 0x83, 0xC4, 0x28, 0x48, 0x89, 0x05, 0x25, 0x00, 0x00, 0x00, 0xC6, 0x05, 0x26, 0x00, 0x00, 0x00, 0x01, 0x5A, 0x59, 0x48, 0xB8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xE0 };
+			static constexpr shellcode::AbsSlot<uint64_t> HOOK_BEGIN_PAINT_GATEWAY{ 0x32u };
+			static_assert(shellcode::fits(HOOK_BEGIN_PAINT_SHELL, HOOK_BEGIN_PAINT_GATEWAY), "Slot out of shell code.");
 
-			static bool hookBeginPaint(HANDLE hProc, BYTE* pShellCode, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool hookBeginPaint(AsyncLaunch* pLaunch, BYTE* pNtUserBeginPaint, tLaunchableFunc pFunc, void* pArg) {
 				BYTE localShell[sizeof(HOOK_BEGIN_PAINT_SHELL) + sizeof(LaunchData)]{};
 				
 				if (memcpy_s(localShell, sizeof(localShell), HOOK_BEGIN_PAINT_SHELL, sizeof(HOOK_BEGIN_PAINT_SHELL))) return false;
@@ -924,58 +1411,35 @@ namespace hax {
 				pLaunchData->pArg = reinterpret_cast<uint64_t>(pArg);
 				pLaunchData->pFunc = reinterpret_cast<uint64_t>(pFunc);
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) {
-					VirtualFreeEx(hProc, pShellCode, 0, MEM_RELEASE);
+				if (!WriteProcessMemory(pLaunch->hProc, pLaunch->pShellCode, localShell, sizeof(localShell), nullptr)) return false;
 
-					return false;
-				}
+				pLaunch->times.written = getTicks();
 
 				constexpr size_t LEN_STOLEN = 8;
-				BYTE* const pGateway = mem::ex::trampHook(hProc, pNtUserBeginPaint, pShellCode, 0x32, LEN_STOLEN);
 
-				if (!pGateway) return false;
+				// the hook is removed when the launch is finished
+				if (!installBeginPaintHook(pLaunch, pNtUserBeginPaint, HOOK_BEGIN_PAINT_GATEWAY.offset, LEN_STOLEN)) return false;
 
-				const DWORD processId = GetProcessId(hProc);
+				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pLaunch->pShellCode + LAUNCH_DATA_OFFSET);
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
+
+				const DWORD processId = GetProcessId(pLaunch->hProc);
 
 				if (processId) {
 					// resize the window to trigger UserBeginPaint execution
 					EnumWindows(resizeCallback, reinterpret_cast<LPARAM>(&processId));
 				}
 
-				const LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
-				const bool success = checkShellCodeFlag(hProc, &pLaunchDataEx->flag);
-
-				BYTE* const pStolen = new BYTE[LEN_STOLEN]{};
-
-				// read the stolen bytes from the gateway
-				if (!ReadProcessMemory(hProc, pGateway, pStolen, LEN_STOLEN, nullptr)) {
-					// if gateway gets deallocated here, the process will crash
-					delete[] pStolen;
-
-					return false;
-				}
-
-				// patch the stolen bytes back
-				if (!mem::ex::patch(hProc, pNtUserBeginPaint, pStolen, LEN_STOLEN)) {
-					// if gateway gets deallocated here, the process will crash
-					delete[] pStolen;
-
-					return false;
-				}
-
-				delete[] pStolen;
-				// now gateway can be deallocated safely
-				VirtualFreeEx(hProc, pGateway, 0, MEM_RELEASE);
-
-				if (!success) return false;
-
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint64_t), nullptr)) return false;
-
 				return true;
 			}
 
 			// ASM:
 			// push   rcx							save register with pLaunchData
+			// mov    al, 0x1
+			// xchg   BYTE PTR[rcx + 0x19], al		claim pLaunchData->claimed, the APC might be queued to multiple threads
+			// test   al, al
+			// jne    skip							skip pLaunchData->pFunc call if already claimed by another thread
 			// mov    rax, QWORD PTR[rcx + 0x8]		load pLaunchData->pFunc for call
 			// mov    rcx, QWORD PTR[rcx]			load pLaunchData->pArg for pLaunchData->pFunc call
 			// sub    rsp, 0x20						setup shadow space for function call
@@ -983,11 +1447,16 @@ namespace hax {
 			// add    rsp, 0x20						cleanup shadow space of function call
 			// pop    rcx							restore register to pLaunchData
 			// mov    QWORD PTR[rcx + 0x10], rax	write return value to pLaunchData->pRet
+			// lock inc BYTE PTR[rcx + 0x1a]		increment pLaunchData->runCount
 			// mov    BYTE PTR[rcx + 0x18], 0x1		set pLaunchData->flag to one
 			// ret
-			static constexpr BYTE QUEUE_USER_APC_SHELL[]{ 0x51, 0x48, 0x8B, 0x41, 0x08, 0x48, 0x8B, 0x09, 0x48, 0x83, 0xEC, 0x20, 0xFF, 0xD0, 0x48, 0x83, 0xC4, 0x20, 0x59, 0x48, 0x89, 0x41, 0x10, 0xC6, 0x41, 0x18, 0x01, 0xC3 };
+			// skip:
+			// pop    rcx							restore register to pLaunchData
+			// lock inc BYTE PTR[rcx + 0x1a]		increment pLaunchData->runCount
+			// ret
+			static constexpr BYTE QUEUE_USER_APC_SHELL[]{ 0x51, 0xB0, 0x01, 0x86, 0x41, 0x19, 0x84, 0xC0, 0x75, 0x1F, 0x48, 0x8B, 0x41, 0x08, 0x48, 0x8B, 0x09, 0x48, 0x83, 0xEC, 0x20, 0xFF, 0xD0, 0x48, 0x83, 0xC4, 0x20, 0x59, 0x48, 0x89, 0x41, 0x10, 0xF0, 0xFE, 0x41, 0x1A, 0xC6, 0x41, 0x18, 0x01, 0xC3, 0x59, 0xF0, 0xFE, 0x41, 0x1A, 0xC3 };
 
-			static bool queueUserApc(HANDLE hProc, BYTE* pShellCode, HANDLE hThread, tLaunchableFunc pFunc, void* pArg, void* pRet) {
+			static bool queueUserApc(AsyncLaunch* pLaunch, const DWORD threadIds[], size_t threadCount, tLaunchableFunc pFunc, void* pArg) {
 				BYTE localShell[sizeof(QUEUE_USER_APC_SHELL) + sizeof(LaunchData)]{};
 				
 				if (memcpy_s(localShell, sizeof(localShell), QUEUE_USER_APC_SHELL, sizeof(QUEUE_USER_APC_SHELL))) return false;
@@ -997,41 +1466,797 @@ namespace hax {
 				pLaunchData->pArg = reinterpret_cast<uint64_t>(pArg);
 				pLaunchData->pFunc = reinterpret_cast<uint64_t>(pFunc);
 
-				if (!WriteProcessMemory(hProc, pShellCode, localShell, sizeof(localShell), nullptr)) return false;
+				if (!WriteProcessMemory(pLaunch->hProc, pLaunch->pShellCode, localShell, sizeof(localShell), nullptr)) return false;
 
-				LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pShellCode + LAUNCH_DATA_OFFSET);
+				pLaunch->times.written = getTicks();
 
-				if (!QueueUserAPC(reinterpret_cast<PAPCFUNC>(pShellCode), hThread, reinterpret_cast<ULONG_PTR>(pLaunchDataEx))) return false;
+				LaunchData* const pLaunchDataEx = reinterpret_cast<LaunchData*>(pLaunch->pShellCode + LAUNCH_DATA_OFFSET);
 
-				if (!checkShellCodeFlag(hProc, &pLaunchDataEx->flag)) return false;
+				for (size_t i = 0u; i < threadCount; i++) {
+					const HANDLE hThread = OpenThread(THREAD_SET_CONTEXT, FALSE, threadIds[i]);
 
-				if (!ReadProcessMemory(hProc, &pLaunchDataEx->pRet, pRet, sizeof(uint64_t), nullptr)) return false;
+					if (!hThread) continue;
+
+					if (QueueUserAPC(reinterpret_cast<PAPCFUNC>(pLaunch->pShellCode), hThread, reinterpret_cast<ULONG_PTR>(pLaunchDataEx))) {
+						pLaunch->apcCount++;
+					}
+
+					CloseHandle(hThread);
+				}
+
+				if (!pLaunch->apcCount) return false;
+
+				pLaunch->pFlagEx = &pLaunchDataEx->flag;
+				pLaunch->pRetEx = reinterpret_cast<const BYTE*>(&pLaunchDataEx->pRet);
 
 				return true;
 			}
 
+
+			// ASM:
+			// push   rbx							save registers
+			// push   rsi
+			// push   rdi
+			// sub    rsp, 0x20						setup shadow space for function calls
+			// mov    rbx, rcx						save pBatchData
+			// mov    rsi, QWORD PTR[rbx]			load pBatchData->count
+			// lea    rdi, [rbx + 0x8]				load pLaunchData of the first call
+			// test   rsi, rsi
+			// je     done
+			// loop:
+			// mov    rcx, QWORD PTR[rdi]			load pLaunchData->pArg for pLaunchData->pFunc call
+			// call   QWORD PTR[rdi + 0x8]			call pLaunchData->pFunc
+			// mov    QWORD PTR[rdi + 0x10], rax	write return value to pLaunchData->pRet
+			// mov    BYTE PTR[rdi + 0x18], 0x1		set pLaunchData->flag to one
+			// add    rdi, 0x20						advance to pLaunchData of the next call
+			// dec    rsi
+			// jne    loop
+			// done:
+			// mov    rax, QWORD PTR[rbx]			return pBatchData->count
+			// add    rsp, 0x20						cleanup shadow space
+			// pop    rdi							restore registers
+			// pop    rsi
+			// pop    rbx
+			// ret
+			static constexpr BYTE BATCH_SHELL[]{ 0x53, 0x56, 0x57, 0x48, 0x83, 0xEC, 0x20, 0x48, 0x89, 0xCB, 0x48, 0x8B, 0x33, 0x48, 0x8D, 0x7B, 0x08, 0x48, 0x85, 0xF6, 0x74, 0x17, 0x48, 0x8B, 0x0F, 0xFF, 0x57, 0x08, 0x48, 0x89, 0x47, 0x10, 0xC6, 0x47, 0x18, 0x01, 0x48, 0x83, 0xC7, 0x20, 0x48, 0xFF, 0xCE, 0x75, 0xE9, 0x48, 0x8B, 0x03, 0x48, 0x83, 0xC4, 0x20, 0x5F, 0x5E, 0x5B, 0xC3 };
+
+			static bool batch(HANDLE hProc, tLaunchFunc pLaunchFunc, LaunchCall calls[], size_t count) {
+				// the batch data consists of the call count followed by the launch data of each call
+				constexpr size_t BATCH_DATA_OFFSET = (sizeof(BATCH_SHELL) + 0xF) & ~static_cast<size_t>(0xF);
+				const size_t size = BATCH_DATA_OFFSET + sizeof(uint64_t) + count * sizeof(LaunchData);
+				BYTE* const localShell = new BYTE[size]{};
+
+				memcpy(localShell, BATCH_SHELL, sizeof(BATCH_SHELL));
+				*reinterpret_cast<uint64_t*>(localShell + BATCH_DATA_OFFSET) = count;
+				LaunchData* const pLaunchData = reinterpret_cast<LaunchData*>(localShell + BATCH_DATA_OFFSET + sizeof(uint64_t));
+
+				for (size_t i = 0u; i < count; i++) {
+					pLaunchData[i].pArg = reinterpret_cast<uint64_t>(calls[i].pArg);
+					pLaunchData[i].pFunc = reinterpret_cast<uint64_t>(calls[i].pFunc);
+				}
+
+				mem::RemotePool* pPool = nullptr;
+				BYTE* const pShellCode = allocateShellCode(hProc, size, &pPool);
+
+				if (!pShellCode) {
+					delete[] localShell;
+
+					return false;
+				}
+
+				BYTE* const pBatchDataEx = pShellCode + BATCH_DATA_OFFSET;
+				bool success = false;
+				bool canFree = true;
+
+				if (WriteProcessMemory(hProc, pShellCode, localShell, size, nullptr)) {
+					uint64_t executed = 0u;
+
+					if (pLaunchFunc(hProc, reinterpret_cast<tLaunchableFunc>(pShellCode), pBatchDataEx, &executed)) {
+						// retrive the return values and flags of all calls with one read
+						success = ReadProcessMemory(hProc, pBatchDataEx + sizeof(uint64_t), pLaunchData, count * sizeof(LaunchData), nullptr);
+					}
+					else {
+						// a failed or timed out launch (eg. a hijacked thread or a queued APC) might still execute the shell code later
+						canFree = false;
+					}
+
+				}
+
+				// shell code that might still get executed stays allocated and keeps its pool in use like in finishLaunch
+				if (canFree) {
+					freeShellCode(hProc, pShellCode, pPool);
+				}
+
+				if (success) {
+
+					for (size_t i = 0u; i < count; i++) {
+
+						if (!pLaunchData[i].flag) success = false;
+
+						calls[i].ret = reinterpret_cast<void*>(pLaunchData[i].pRet);
+					}
+
+				}
+
+				delete[] localShell;
+
+				return success;
+			}
+
 		}
 
 		#endif // _WIN64
 
 
+		static AsyncLaunch* createLaunch(HANDLE hProc, Method method, bool allocShellCode) {
+			AsyncLaunch* const pLaunch = new AsyncLaunch{};
+			pLaunch->times.start = getTicks();
+			pLaunch->hProc = hProc;
+			pLaunch->method = method;
+			pLaunch->state = static_cast<LONG>(LaunchState::PENDING);
+
+			BOOL isWow64 = FALSE;
+			IsWow64Process(hProc, &isWow64);
+			pLaunch->isWow64 = isWow64 == TRUE;
+
+			pLaunch->hDoneEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+			if (!pLaunch->hDoneEvent) {
+				delete pLaunch;
+
+				return nullptr;
+			}
+
+			if (allocShellCode) {
+				pLaunch->pShellCode = allocateShellCode(hProc, SHELL_CODE_SIZE, &pLaunch->pPool);
+
+				if (!pLaunch->pShellCode) {
+					CloseHandle(pLaunch->hDoneEvent);
+					delete pLaunch;
+
+					return nullptr;
+				}
+
+			}
+
+			pLaunch->times.allocated = getTicks();
+
+			return pLaunch;
+		}
+
+
+		static AsyncLaunch* submitLaunch(AsyncLaunch* pLaunch, bool started) {
+
+			if (!started) {
+				discardLaunch(pLaunch);
+
+				return nullptr;
+			}
+
+			pLaunch->times.triggered = getTicks();
+
+			// launches without shell code do not write to the target
+			if (!pLaunch->times.written) {
+				pLaunch->times.written = pLaunch->times.allocated;
+			}
+
+			// wait for the completion event if there is no thread to wait for
+			if (!pLaunch->hWaitObject) {
+				pLaunch->hWaitObject = pLaunch->completion.hEvent;
+			}
+
+			pLaunch->deadline = GetTickCount64() + LAUNCH_TIMEOUT;
+			pLaunch->pollInterval = POLL_INTERVAL_MIN;
+
+			AcquireSRWLockExclusive(&waiter.lock);
+
+			if (!waiter.hWakeEvent) {
+				waiter.hWakeEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+			}
+
+			bool queued = waiter.hWakeEvent != nullptr;
+
+			if (queued && !waiter.running) {
+				const HANDLE hWaiterThread = CreateThread(nullptr, 0u, waiterThread, nullptr, 0ul, nullptr);
+
+				if (hWaiterThread) {
+					CloseHandle(hWaiterThread);
+					waiter.running = true;
+				}
+				else {
+					queued = false;
+				}
+
+			}
+
+			if (queued) {
+				pLaunch->pNext = waiter.pHead;
+				waiter.pHead = pLaunch;
+				SetEvent(waiter.hWakeEvent);
+			}
+
+			ReleaseSRWLockExclusive(&waiter.lock);
+
+			// a launch that cannot be watched is cleaned up right away
+			if (!queued) {
+				discardLaunch(pLaunch);
+
+				return nullptr;
+			}
+
+			return pLaunch;
+		}
+
+
+		static void discardLaunch(AsyncLaunch* pLaunch) {
+			finishLaunch(pLaunch);
+			close(pLaunch);
+
+			return;
+		}
+
+
+		static bool launchSync(AsyncLaunch* pLaunch, void* pRet) {
+
+			if (!pLaunch) return false;
+
+			// the waiter thread finishes the launch after LAUNCH_TIMEOUT at the latest
+			wait(pLaunch, INFINITE);
+
+			const bool success = getReturnValue(pLaunch, pRet);
+			close(pLaunch);
+
+			return success;
+		}
+
+
+		static DWORD WINAPI waiterThread(LPVOID lpParameter) {
+			UNREFERENCED_PARAMETER(lpParameter);
+
+			HANDLE handles[MAXIMUM_WAIT_OBJECTS]{};
+			AsyncLaunch* waited[MAXIMUM_WAIT_OBJECTS]{};
+
+			while (true) {
+				AsyncLaunch* pFinished = nullptr;
+				DWORD count = 1ul;
+				handles[0] = waiter.hWakeEvent;
+				// in microseconds
+				ULONGLONG timeout = LAUNCH_TIMEOUT * 1000ull;
+				const ULONGLONG now = GetTickCount64();
+
+				AcquireSRWLockExclusive(&waiter.lock);
+
+				if (!waiter.pHead) {
+					// the thread gets created again by the next submitted launch
+					waiter.running = false;
+					ReleaseSRWLockExclusive(&waiter.lock);
+
+					return 0ul;
+				}
+
+				AsyncLaunch** ppCur = &waiter.pHead;
+
+				while (*ppCur) {
+					AsyncLaunch* const pCur = *ppCur;
+					// launches without wait object and launches beyond the wait object limit are polled
+					const bool polled = !pCur->hWaitObject || count == MAXIMUM_WAIT_OBJECTS;
+
+					if (polled && !pCur->executed) {
+						pCur->executed = isExecuted(pCur);
+					}
+
+					bool isFinished = pCur->executed || pCur->cancelRequested || now >= pCur->deadline;
+
+					// a hijacked thread that has not been scheduled in time does not count as launched
+					if (!isFinished && pCur->pickupDeadline && now >= pCur->pickupDeadline) {
+						isFinished = !retryHijack(pCur);
+					}
+
+					if (isFinished) {
+						// unlink the launch to finish it outside of the lock
+						*ppCur = pCur->pNext;
+						pCur->pNext = pFinished;
+						pFinished = pCur;
+
+						continue;
+					}
+
+					if (polled) {
+						timeout = min(timeout, pCur->pollInterval);
+						// poll with an exponentially growing interval so a quick execution is not delayed by a fixed sleep
+						pCur->pollInterval = min(pCur->pollInterval * 2u, POLL_INTERVAL_MAX);
+					}
+					else {
+						handles[count] = pCur->hWaitObject;
+						waited[count] = pCur;
+						count++;
+					}
+
+					timeout = min(timeout, (pCur->deadline - now) * 1000u);
+
+					if (pCur->pickupDeadline) {
+						timeout = min(timeout, (pCur->pickupDeadline - now) * 1000u);
+					}
+
+					ppCur = &pCur->pNext;
+				}
+
+				ReleaseSRWLockExclusive(&waiter.lock);
+
+				if (pFinished) {
+
+					while (pFinished) {
+						// the launch might get deleted as soon as it is finished
+						AsyncLaunch* const pNext = pFinished->pNext;
+						finishLaunch(pFinished);
+						pFinished = pNext;
+					}
+
+					continue;
+				}
+
+				// WaitForMultipleObjects has a resolution of milliseconds, shorter intervals are waited for afterwards
+				const DWORD waitResult = WaitForMultipleObjects(count, handles, FALSE, static_cast<DWORD>(timeout / 1000u));
+
+				if (waitResult == WAIT_TIMEOUT) {
+
+					if (timeout < 1000u) {
+						sleepMicroseconds(timeout);
+					}
+
+				}
+				else if (waitResult > WAIT_OBJECT_0 && waitResult < WAIT_OBJECT_0 + count) {
+					AsyncLaunch* const pSignaled = waited[waitResult - WAIT_OBJECT_0];
+					pSignaled->executed = isExecuted(pSignaled);
+
+					// the event gets signaled right after the launched function returned, the flag is set by the launch shell code shortly after
+					if (!pSignaled->executed) {
+						pSignaled->hWaitObject = nullptr;
+					}
+
+				}
+				else if (waitResult == WAIT_FAILED) {
+					sleepMicroseconds(POLL_INTERVAL_MAX);
+				}
+
+			}
+
+		}
+
+
+		static void finishLaunch(AsyncLaunch* pLaunch) {
+			pLaunch->times.completed = getTicks();
+
+			if (!pLaunch->executed) {
+				pLaunch->executed = isExecuted(pLaunch);
+			}
+
+			// the shell code must not be freed as long as it might still get executed
+			bool canFree = true;
+
+			if (pLaunch->method == Method::CREATE_THREAD) {
+
+				if (!pLaunch->executed && pLaunch->hThread) {
+
+					#pragma warning (push)
+					#pragma warning (disable: 6258)
+					TerminateThread(pLaunch->hThread, 0);
+					#pragma warning (pop)
+
+				}
+
+			}
+			else if (pLaunch->method == Method::HIJACK_THREAD) {
+
+				// the flag is only set if the thread was hijacked successfully
+				if (!pLaunch->executed && pLaunch->pFlagEx) {
+					canFree = restoreThread(pLaunch);
+				}
+
+			}
+			else if (pLaunch->method == Method::SET_WINDOWS_HOOK) {
+
+				if (pLaunch->hHook) {
+					UnhookWindowsHookEx(pLaunch->hHook);
+				}
+
+			}
+			else if (pLaunch->method == Method::HOOK_BEGIN_PAINT) {
+
+				if (pLaunch->pGateway) {
+					canFree = unhookBeginPaint(pLaunch);
+				}
+
+			}
+			else if (pLaunch->method == Method::QUEUE_USER_APC) {
+
+				// queued APCs can not be removed, so the shell code has to stay until every thread executed it
+				if (pLaunch->apcCount) {
+					BYTE runCount = 0u;
+					// the run count follows the flag and the claim
+					ReadProcessMemory(pLaunch->hProc, pLaunch->pFlagEx + 2, &runCount, sizeof(runCount), nullptr);
+					canFree = runCount >= pLaunch->apcCount;
+				}
+
+			}
+
+			bool success = pLaunch->executed;
+
+			if (success) {
+
+				if (pLaunch->pRetEx) {
+					// x86 targets return four byte values
+					const size_t retSize = pLaunch->isWow64 ? sizeof(uint32_t) : sizeof(uint64_t);
+					success = ReadProcessMemory(pLaunch->hProc, pLaunch->pRetEx, &pLaunch->ret, retSize, nullptr);
+				}
+				else {
+					DWORD exitCode = 0ul;
+					success = GetExitCodeThread(pLaunch->hThread, &exitCode);
+					pLaunch->ret = exitCode;
+				}
+
+			}
+
+			if (pLaunch->hThread) {
+				CloseHandle(pLaunch->hThread);
+				pLaunch->hThread = nullptr;
+			}
+
+			// a shell code that might still get executed would set the event via a stale handle value
+			cleanupCompletion(pLaunch->hProc, &pLaunch->completion, canFree);
+
+			// shell code that might still get executed stays allocated and keeps its pool in use
+			// so removePool fails instead of the pool releasing the shell code when it is destroyed
+			if (pLaunch->pShellCode && canFree) {
+				freeShellCode(pLaunch->hProc, pLaunch->pShellCode, pLaunch->pPool);
+			}
+
+			pLaunch->pShellCode = nullptr;
+			pLaunch->pPool = nullptr;
+
+			LaunchState state = LaunchState::FAILED;
+
+			if (success) {
+				state = LaunchState::SUCCEEDED;
+			}
+			else if (pLaunch->cancelRequested) {
+				state = LaunchState::CANCELLED;
+			}
+
+			pLaunch->times.finished = getTicks();
+			InterlockedExchange(&pLaunch->state, static_cast<LONG>(state));
+			SetEvent(pLaunch->hDoneEvent);
+
+			return;
+		}
+
+
 		// check via flag if shell code has been executed
-		static bool checkShellCodeFlag(HANDLE hProc, const void* pFlag) {
-			bool flag = false;
-			const ULONGLONG start = GetTickCount64();
+		static bool isExecuted(const AsyncLaunch* pLaunch) {
 
-			do {
-				ReadProcessMemory(hProc, pFlag, &flag, sizeof(flag), nullptr);
+			// the exit of the created thread signals the execution
+			if (!pLaunch->pFlagEx) return pLaunch->hThread && WaitForSingleObject(pLaunch->hThread, 0ul) == WAIT_OBJECT_0;
 
-				if (flag) break;
+			bool flag = false;
 
-				Sleep(50);
-			} while (GetTickCount64() - start < LAUNCH_TIMEOUT);
+			if (!ReadProcessMemory(pLaunch->hProc, pLaunch->pFlagEx, &flag, sizeof(flag), nullptr)) return false;
 
 			return flag;
 		}
 
 
+		static size_t getRankedThreadIds(DWORD processId, proc::ThreadUse use, DWORD threadIds[], size_t count) {
+			proc::ProcessEntry procEntry{};
+
+			if (!proc::getProcessEntry(processId, &procEntry) || !procEntry.threadCount) return 0u;
+
+			proc::ThreadEntry* const pThreadEntries = new proc::ThreadEntry[procEntry.threadCount];
+
+			if (!proc::getProcessThreadEntries(processId, pThreadEntries, procEntry.threadCount)) {
+				delete[] pThreadEntries;
+
+				return 0u;
+			}
+
+			size_t* const pRanking = new size_t[procEntry.threadCount];
+			const size_t rankedCount = proc::rankThreads(pThreadEntries, procEntry.threadCount, use, pRanking);
+			const size_t idCount = rankedCount < count ? rankedCount : count;
+
+			for (size_t i = 0u; i < idCount; i++) {
+				threadIds[i] = pThreadEntries[pRanking[i]].threadId;
+			}
+
+			delete[] pRanking;
+			delete[] pThreadEntries;
+
+			return idCount;
+		}
+
+
+		static bool hijackNextThread(AsyncLaunch* pLaunch) {
+
+			while (pLaunch->threadIndex < pLaunch->threadCount) {
+				const DWORD threadId = pLaunch->threadIds[pLaunch->threadIndex];
+				pLaunch->threadIndex++;
+
+				pLaunch->hThread = OpenThread(THREAD_SET_CONTEXT | THREAD_GET_CONTEXT | THREAD_SUSPEND_RESUME, FALSE, threadId);
+
+				if (!pLaunch->hThread) continue;
+
+				bool success = false;
+
+				if (pLaunch->isWow64) {
+
+					success = x86::hijackThread(pLaunch, threadId, pLaunch->pFunc, pLaunch->pArg);
+
+				}
+				else {
+
+					// x64 targets only feasable for x64 compilations
+					#ifdef _WIN64
+
+					success = x64::hijackThread(pLaunch, threadId, pLaunch->pFunc, pLaunch->pArg);
+
+					#endif // _WIN64
+
+				}
+
+				if (success) {
+					pLaunch->pickupDeadline = GetTickCount64() + HIJACK_PICKUP_TIMEOUT;
+
+					return true;
+				}
+
+				CloseHandle(pLaunch->hThread);
+				pLaunch->hThread = nullptr;
+			}
+
+			return false;
+		}
+
+
+		static bool restoreThread(const AsyncLaunch* pLaunch) {
+
+			if (SuspendThread(pLaunch->hThread) == 0xFFFFFFFF) return false;
+
+			BOOL restored = FALSE;
+
+			if (pLaunch->isWow64) {
+				restored = Wow64SetThreadContext(pLaunch->hThread, &pLaunch->wow64Context);
+			}
+			else {
+
+				#ifdef _WIN64
+
+				restored = SetThreadContext(pLaunch->hThread, &pLaunch->context);
+
+				#endif // _WIN64
+
+			}
+
+			ResumeThread(pLaunch->hThread);
+
+			return restored == TRUE;
+		}
+
+
+		static bool retryHijack(AsyncLaunch* pLaunch) {
+
+			// the thread can not start executing the shell code while it is checked
+			if (SuspendThread(pLaunch->hThread) == 0xFFFFFFFF) return true;
+
+			uintptr_t instructionPointer = 0u;
+			BOOL hasContext = FALSE;
+
+			if (pLaunch->isWow64) {
+				WOW64_CONTEXT wow64Context{};
+				wow64Context.ContextFlags = CONTEXT_CONTROL;
+				hasContext = Wow64GetThreadContext(pLaunch->hThread, &wow64Context);
+				instructionPointer = wow64Context.Eip;
+			}
+			else {
+
+				#ifdef _WIN64
+
+				CONTEXT context{};
+				context.ContextFlags = CONTEXT_CONTROL;
+				hasContext = GetThreadContext(pLaunch->hThread, &context);
+				instructionPointer = context.Rip;
+
+				#endif // _WIN64
+
+			}
+
+			// a thread still at the entry of the shell code has not been scheduled since it was hijacked
+			const bool isWaiting = hasContext && instructionPointer == reinterpret_cast<uintptr_t>(pLaunch->pShellCode) && !isExecuted(pLaunch);
+			const bool restored = isWaiting && restoreThread(pLaunch);
+
+			ResumeThread(pLaunch->hThread);
+
+			// the thread executes the shell code or can not be restored, so it is waited for until the launch times out
+			if (!restored) {
+				pLaunch->pickupDeadline = 0u;
+
+				return true;
+			}
+
+			CloseHandle(pLaunch->hThread);
+			pLaunch->hThread = nullptr;
+			pLaunch->pFlagEx = nullptr;
+			pLaunch->pRetEx = nullptr;
+
+			return hijackNextThread(pLaunch);
+		}
+
+
+		static bool installBeginPaintHook(AsyncLaunch* pLaunch, BYTE* pNtUserBeginPaint, size_t originCallOffset, size_t stolenSize) {
+
+			if (stolenSize > MAX_BEGIN_PAINT_STOLEN) return false;
+
+			// the gateway relocates the stolen instructions, so the original bytes are saved for unhooking
+			if (!ReadProcessMemory(pLaunch->hProc, pNtUserBeginPaint, pLaunch->stolen, stolenSize, nullptr)) return false;
+
+			mem::RemotePool* pGatewayPool = pLaunch->pPool;
+			BYTE* pGateway = mem::ex::trampHook(pLaunch->hProc, pNtUserBeginPaint, pLaunch->pShellCode, originCallOffset, stolenSize, SIZE_MAX, pGatewayPool);
+
+			// fall back to an allocation of its own if the pool is exhausted
+			if (!pGateway && pGatewayPool) {
+				pGatewayPool = nullptr;
+				pGateway = mem::ex::trampHook(pLaunch->hProc, pNtUserBeginPaint, pLaunch->pShellCode, originCallOffset, stolenSize);
+			}
+
+			if (!pGateway) return false;
+
+			pLaunch->pHookedFunc = pNtUserBeginPaint;
+			pLaunch->pGateway = pGateway;
+			pLaunch->pGatewayPool = pGatewayPool;
+			pLaunch->stolenSize = stolenSize;
+
+			return true;
+		}
+
+
+		static bool unhookBeginPaint(const AsyncLaunch* pLaunch) {
+
+			// patch the original bytes back, if this fails the gateway must not be deallocated or the process will crash
+			if (!mem::ex::patch(pLaunch->hProc, pLaunch->pHookedFunc, pLaunch->stolen, pLaunch->stolenSize)) return false;
+
+			// now gateway can be deallocated safely
+			if (pLaunch->pGatewayPool) {
+				pLaunch->pGatewayPool->free(pLaunch->pGateway);
+			}
+			else {
+				VirtualFreeEx(pLaunch->hProc, pLaunch->pGateway, 0, MEM_RELEASE);
+			}
+
+			return true;
+		}
+
+
+		static bool setupCompletion(AsyncLaunch* pLaunch, tLaunchableFunc* ppFunc, void** ppArg) {
+			const HANDLE hProc = pLaunch->hProc;
+			BYTE* const pCompletionShell = pLaunch->pShellCode + COMPLETION_OFFSET;
+			Completion* const pCompletion = &pLaunch->completion;
+			const HMODULE hNtdll = proc::ex::getModuleHandle(hProc, "ntdll.dll");
+
+			if (!hNtdll) return false;
+
+			const FARPROC pNtSetEvent = proc::ex::getProcAddress(hProc, hNtdll, "NtSetEvent");
+
+			if (!pNtSetEvent) return false;
+
+			pCompletion->hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+			if (!pCompletion->hEvent) return false;
+
+			// fails without PROCESS_DUP_HANDLE access rights
+			if (!DuplicateHandle(GetCurrentProcess(), pCompletion->hEvent, hProc, &pCompletion->hRemoteEvent, EVENT_MODIFY_STATE, FALSE, 0ul)) {
+				cleanupCompletion(hProc, pCompletion, true);
+
+				return false;
+			}
+
+			bool success = false;
+
+			if (pLaunch->isWow64) {
+				BYTE localShell[sizeof(x86::COMPLETION_SHELL) + sizeof(x86::CompletionData)]{};
+				memcpy(localShell, x86::COMPLETION_SHELL, sizeof(x86::COMPLETION_SHELL));
+
+				x86::CompletionData* const pCompletionData = reinterpret_cast<x86::CompletionData*>(localShell + sizeof(x86::COMPLETION_SHELL));
+				pCompletionData->pFunc = LOW_DWORD(*ppFunc);
+				pCompletionData->pArg = LOW_DWORD(*ppArg);
+				pCompletionData->pNtSetEvent = LOW_DWORD(pNtSetEvent);
+				pCompletionData->hEvent = LOW_DWORD(pCompletion->hRemoteEvent);
+
+				success = WriteProcessMemory(hProc, pCompletionShell, localShell, sizeof(localShell), nullptr);
+
+				if (success) {
+					*ppArg = pCompletionShell + sizeof(x86::COMPLETION_SHELL);
+				}
+
+			}
+			else {
+
+				#ifdef _WIN64
+
+				BYTE localShell[sizeof(x64::COMPLETION_SHELL) + sizeof(x64::CompletionData)]{};
+				memcpy(localShell, x64::COMPLETION_SHELL, sizeof(x64::COMPLETION_SHELL));
+
+				x64::CompletionData* const pCompletionData = reinterpret_cast<x64::CompletionData*>(localShell + sizeof(x64::COMPLETION_SHELL));
+				pCompletionData->pFunc = reinterpret_cast<uint64_t>(*ppFunc);
+				pCompletionData->pArg = reinterpret_cast<uint64_t>(*ppArg);
+				pCompletionData->pNtSetEvent = reinterpret_cast<uint64_t>(pNtSetEvent);
+				pCompletionData->hEvent = reinterpret_cast<uint64_t>(pCompletion->hRemoteEvent);
+
+				success = WriteProcessMemory(hProc, pCompletionShell, localShell, sizeof(localShell), nullptr);
+
+				if (success) {
+					*ppArg = pCompletionShell + sizeof(x64::COMPLETION_SHELL);
+				}
+
+				#endif // _WIN64
+
+			}
+
+			if (!success) {
+				cleanupCompletion(hProc, pCompletion, true);
+
+				return false;
+			}
+
+			*ppFunc = reinterpret_cast<tLaunchableFunc>(pCompletionShell);
+
+			return true;
+		}
+
+
+		static void cleanupCompletion(HANDLE hProc, Completion* pCompletion, bool isFinished) {
+
+			// the target might reuse the handle value for another object as soon as it is closed
+			if (!isFinished) {
+				pCompletion->hRemoteEvent = nullptr;
+			}
+
+			// close the duplicated handle within the target process
+			if (pCompletion->hRemoteEvent) {
+				DuplicateHandle(hProc, pCompletion->hRemoteEvent, nullptr, nullptr, 0ul, FALSE, DUPLICATE_CLOSE_SOURCE);
+				pCompletion->hRemoteEvent = nullptr;
+			}
+
+			if (pCompletion->hEvent) {
+				CloseHandle(pCompletion->hEvent);
+				pCompletion->hEvent = nullptr;
+			}
+
+			return;
+		}
+
+
+		static void sleepMicroseconds(ULONGLONG microseconds) {
+
+			// Sleep has a resolution of milliseconds at best
+			if (microseconds >= 1000u) {
+				Sleep(static_cast<DWORD>(microseconds / 1000u));
+
+				return;
+			}
+
+			LARGE_INTEGER frequency{};
+			LARGE_INTEGER start{};
+			LARGE_INTEGER now{};
+			QueryPerformanceFrequency(&frequency);
+			QueryPerformanceCounter(&start);
+
+			do {
+				// give up the rest of the time slice while spinning
+				SwitchToThread();
+				QueryPerformanceCounter(&now);
+			} while (static_cast<ULONGLONG>(now.QuadPart - start.QuadPart) * 1000000u < microseconds * static_cast<ULONGLONG>(frequency.QuadPart));
+
+			return;
+		}
+
+
 		// set WNDPROC hook in the thread of a window of the target process
 		static BOOL CALLBACK setHookCallback(HWND hWnd, LPARAM lParam) {
 			HookData* const pHookCallbackData = reinterpret_cast<HookData*>(lParam);
@@ -1,10 +1,17 @@
 #pragma once
+#include "RemotePool.h"
 #include <Windows.h>
 
 // Functions to launch code execution in an external target process.
 // x64 compilations of these functions (except setWindowsHook) can launch code in x64 and x86 targets.
 // x86 compilations of these functions can only launch code in x86 targets.
 // setWindowsHook can only launch code in targets with matching architechure.
+// hijackThread, setWindowsHook, hookBeginPaint and queueUserApc wait for an event signaled via NtSetEvent in the target after the launched code returned.
+// This requires PROCESS_DUP_HANDLE access rights to duplicate the event into the target. Without them the execution is polled with an exponentially growing interval.
+// Each launch function has an asynchronous counterpart that returns a handle right after the execution was triggered.
+// A single waiter thread watches all outstanding launches, finishes them after execution, timeout or cancellation and cleans up the target.
+// The synchronous functions are wrappers that wait for the handle of their asynchronous counterpart.
+// By default each launch allocates a page for its shell code. If a remote pool is added for the target process the shell code is allocated from the pool instead.
 
 namespace hax {
 
@@ -13,6 +20,42 @@ namespace hax {
 		typedef void* (WINAPI* tLaunchableFunc)(void* pArg);
 		typedef bool (*tLaunchFunc)(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet);
 
+		// Handle to an asynchronous launch.
+		struct AsyncLaunch;
+
+		enum class LaunchState : LONG {
+			PENDING,
+			SUCCEEDED,
+			FAILED,
+			CANCELLED
+		};
+
+		// Timestamps of the phases of an asynchronous launch in QueryPerformanceCounter ticks.
+		typedef struct LaunchTimes {
+			// launch function called after the lookup of the required exports
+			LONGLONG start;
+			// shell code allocated
+			LONGLONG allocated;
+			// shell code written
+			LONGLONG written;
+			// execution triggered
+			LONGLONG triggered;
+			// execution, timeout or cancellation detected by the waiter thread
+			LONGLONG completed;
+			// target cleaned up
+			LONGLONG finished;
+		}LaunchTimes;
+
+		typedef AsyncLaunch* (*tLaunchAsyncFunc)(HANDLE hProc, tLaunchableFunc pFunc, void* pArg);
+
+		// A single call of a batch launch.
+		typedef struct LaunchCall {
+			tLaunchableFunc pFunc;
+			void* pArg;
+			// return value of the function, set by batch
+			void* ret;
+		}LaunchCall;
+
 		// Launches code execution by creating a thread in the target process via NtCreateThreadEx.
 		// Waits for the thread and retrives the return value. Can retrive 8 byte return values for x64 targets (unlike GetExitCodeThread).
 		// 
@@ -41,6 +84,8 @@ namespace hax {
 
 		// Launches code execution by hijacking an existing thread of the target process.
 		// Suspends the thread, switches it's context and resumes it executing the desired code.
+		// The threads of the target are ranked by how soon they are expected to resume execution (see proc::rankThreads). The best ranked threads are tried one after another until one executes the shell code.
+		// A hijacked thread that has not been scheduled within 100 milliseconds is restored and the next thread is hijacked instead.
 		// Waits for successfull execution and retrives the return value.
 		// Most reliable option if createRemoteThread fails due to counter measures.
 		// 
@@ -132,6 +177,8 @@ namespace hax {
 		// Waits for successfull execution and retrives the return value.
 		// APCs only get called when the thread to which they are queued is in an alertable state.
 		// Will fail on target processes with no waiting thread in an alertable state.
+		// The APC is queued to the best ranked waiting threads at once (see proc::rankThreads). Only the first thread executing the APC calls the function.
+		// If not all of the threads executed the APC when the launch finishes the shell code is not freed, because a queued APC can not be removed.
 		// 
 		// Parameters:
 		// 
@@ -156,6 +203,172 @@ namespace hax {
 		// True on success or false on failure.
 		bool queueUserApc(HANDLE hProc, tLaunchableFunc pFunc, void* pArg, void* pRet);
 
+		// Launches code execution of multiple functions with a single launch.
+		// Writes the data of all calls with one allocation and one write and launches shell code that calls the functions sequentially in the order of the array.
+		// Retrives all return values with one read after the launch.
+		// If the launch function fails the shell code might still get executed later, so it is not freed and a pool it was allocated from stays in use (see removePool).
+		// 
+		// Parameters:
+		// 
+		// [in] hProc:
+		// Handle to the process in which context the code should be launched.
+		// Needs at least PROCESS_QUERY_LIMITED_INFORMATION, PROCESS_VM_OPERATION, PROCESS_VM_WRITE, and PROCESS_VM_READ access rights
+		// plus the access rights needed by the launch function.
+		// 
+		// [in] pLaunchFunc:
+		// Launch function that is used to execute the shell code calling the functions (eg. createThread or hijackThread).
+		// 
+		// [in/out] calls:
+		// Array of the calls that should be executed. The functions have to follow the calling conventions described for the launch functions.
+		// The ret member of each call receives the return value of the function.
+		// 
+		// [in] count:
+		// Element count of the calls array.
+		// 
+		// Return:
+		// True if all functions were executed or false on failure.
+		bool batch(HANDLE hProc, tLaunchFunc pLaunchFunc, LaunchCall calls[], size_t count);
+
+
+		// Asynchronous counterparts of the launch functions above.
+		// Trigger the execution and return without waiting for it. The returned launch is finished by the waiter thread.
+		// The requirements of each function are the same as for its synchronous counterpart.
+		// 
+		// Parameters:
+		// 
+		// [in] hProc:
+		// Handle to the process in which context the code should be launched.
+		// The handle has to stay valid until the launch is finished.
+		// 
+		// [in] pFunc:
+		// Pointer to the code that should be executed. Same calling conventions as for the synchronous functions.
+		// 
+		// [in] pArg:
+		// Argument of the function.
+		// 
+		// Return:
+		// Handle to the launch or nullptr if the execution could not be triggered. Has to be closed with close().
+		AsyncLaunch* createThreadAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg);
+		AsyncLaunch* hijackThreadAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg);
+		AsyncLaunch* setWindowsHookAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg);
+		AsyncLaunch* hookBeginPaintAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg);
+		AsyncLaunch* queueUserApcAsync(HANDLE hProc, tLaunchableFunc pFunc, void* pArg);
+
+		// Gets the current state of a launch without waiting.
+		// 
+		// Parameters:
+		// 
+		// [in] pLaunch:
+		// Handle to the launch.
+		// 
+		// Return:
+		// State of the launch. Launches that are not executed within five seconds fail.
+		LaunchState poll(const AsyncLaunch* pLaunch);
+
+		// Waits for a launch to be finished.
+		// 
+		// Parameters:
+		// 
+		// [in] pLaunch:
+		// Handle to the launch.
+		// 
+		// [in] timeout:
+		// Timeout in milliseconds. Pass INFINITE to wait until the launch is finished, which takes five seconds at most.
+		// 
+		// Return:
+		// State of the launch. PENDING if the timeout elapsed.
+		LaunchState wait(AsyncLaunch* pLaunch, DWORD timeout);
+
+		// Waits for any of multiple launches to be finished.
+		// 
+		// Parameters:
+		// 
+		// [in] launches:
+		// Array of handles to launches.
+		// 
+		// [in] count:
+		// Element count of the launches array. At most MAXIMUM_WAIT_OBJECTS.
+		// 
+		// [in] timeout:
+		// Timeout in milliseconds.
+		// 
+		// Return:
+		// Index of a finished launch in the array or SIZE_MAX on timeout or failure.
+		size_t waitAny(AsyncLaunch* const launches[], size_t count, DWORD timeout);
+
+		// Cancels a pending launch and waits until it is cleaned up.
+		// Created threads are terminated, hijacked threads are restored and hooks are removed.
+		// 
+		// Parameters:
+		// 
+		// [in] pLaunch:
+		// Handle to the launch.
+		// 
+		// Return:
+		// True if the launch was cancelled or false if it was finished before.
+		bool cancel(AsyncLaunch* pLaunch);
+
+		// Retrives the return value of a succeeded launch.
+		// 
+		// Parameters:
+		// 
+		// [in] pLaunch:
+		// Handle to the launch.
+		// 
+		// [out] pRet:
+		// Pointer for the return value of the launched function. Receives four bytes for x86 targets and eight bytes for x64 targets.
+		// 
+		// Return:
+		// True on success or false if the launch is not succeeded.
+		bool getReturnValue(const AsyncLaunch* pLaunch, void* pRet);
+
+		// Retrives the timestamps of the phases of a finished launch.
+		// 
+		// Parameters:
+		// 
+		// [in] pLaunch:
+		// Handle to the launch.
+		// 
+		// [out] pTimes:
+		// Pointer for the timestamps.
+		// 
+		// Return:
+		// True on success or false if the launch is still pending.
+		bool getLaunchTimes(const AsyncLaunch* pLaunch, LaunchTimes* pTimes);
+
+		// Closes the handle to a launch. Cancels the launch if it is still pending.
+		// 
+		// Parameters:
+		// 
+		// [in] pLaunch:
+		// Handle to the launch. Invalid after the call.
+		void close(AsyncLaunch* pLaunch);
+
+		// Adds a remote pool the shell code of all following launches and batches into the process of the pool is allocated from.
+		// Only one pool per process can be added.
+		// 
+		// Parameters:
+		// 
+		// [in] pPool:
+		// Pointer to the pool. Has to stay valid until it is removed with removePool().
+		// 
+		// Return:
+		// True on success or false if a pool for the process was added before or too many pools are added.
+		bool addPool(mem::RemotePool* pPool);
+
+		// Removes a remote pool added by addPool(). Following launches into the process of the pool allocate their shell code on their own again.
+		// 
+		// Parameters:
+		// 
+		// [in] pPool:
+		// Pointer to the pool.
+		// 
+		// Return:
+		// True on success or false if the pool was not added or launches that allocated their shell code from the pool are not finished yet.
+		// Shell code of a launch that might still be executed after the launch is finished (eg. hijacked thread did not run) stays allocated within the pool and keeps the pool in use,
+		// so the pool can not be removed anymore and has to stay valid until the target process exits.
+		bool removePool(mem::RemotePool* pPool);
+
 	}
 
 }
\ No newline at end of file
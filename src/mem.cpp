@@ -1,5 +1,8 @@
 #pragma once
 #include "mem.h"
+#include "RegionMap.h"
+#include "RemotePool.h"
+#include "instr.h"
 #include <stdint.h>
 
 namespace hax {
@@ -13,44 +16,94 @@ namespace hax {
 			uintptr_t min;
 			uintptr_t max;
 			uintptr_t pageSize;
+			uintptr_t granularity;
 		}AddressRange;
 
 		// gets the range of address that is reachable by a relative jump
 		static void getNearAddressRange(const BYTE* pBase, AddressRange* pAddrRange);
 
+		// walks the regions from the start of the range to both sides until a free region the block fits into is found on each side and gets the aligned address closest to the given address
+		static BYTE* queryNearFreeAddress(HANDLE hProc, const BYTE* address, const AddressRange* pAddrRange, size_t size);
+
+		// maximum attempts to allocate at a free address that might have been allocated since it was looked up
+		constexpr unsigned int NEAR_ALLOC_ATTEMPTS = 4u;
+
 		// ASM:
 		// jmp QWORD PTR[rip + 0x0000000000000000]
 		constexpr BYTE X64_JUMP[]{ 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 
+		#else
+
+		// ASM:
+		// jmp DWORD PTR ds:0x00000000
+		constexpr BYTE X86_RELAY_JUMP[]{ 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
 		#endif // _WIN64
 
+		// offset of the address slot within the absolute jump of a relay
+		constexpr size_t RELAY_SLOT_OFFSET = 0x6u;
+
+		// gets the offset of a relay at or after the end of the gateway code, so the address slot of the relay is pointer aligned and can be exchanged atomically
+		static size_t getRelayOffset(size_t codeEnd);
+
+		// frees a gateway allocated either from a pool or by a VirtualAllocEx call of its own
+		static void freeGateway(HANDLE hProc, BYTE* gateway, RemotePool* pPool);
+		static void freeGateway(BYTE* gateway, RemotePool* pPool);
+
 		// ASM:
 		// nop
 		constexpr BYTE NOP = 0x90;
 
+		// ASM:
+		// jmp -0x2 (jumps to itself)
+		constexpr BYTE SPIN_JUMP[]{ 0xEB, 0xFE };
+
+		// atomically replaces bytes within an aligned qword (or aligned 16 bytes for x64) by a compare and exchange, the memory has to be writable
+		static bool exchangeAligned(BYTE* dst, const BYTE src[], size_t size);
+
 		// ASM:
 		// jmp 0x00000000
 		constexpr BYTE X86_JUMP[]{ 0xE9, 0x00, 0x00, 0x00, 0x00 };
 
 		namespace ex {
 
-			BYTE* trampHook(HANDLE hProc, BYTE* origin, BYTE* detour, size_t originCallOffset, size_t size, size_t relativeAddressOffset) {
+			BYTE* trampHook(HANDLE hProc, BYTE* origin, BYTE* detour, size_t originCallOffset, size_t size, size_t relativeAddressOffset, RemotePool* pPool) {
 
 				if (relativeAddressOffset != SIZE_MAX && relativeAddressOffset + sizeof(uint32_t) > size)
 				{
 					return nullptr;
 				}
 
-				BYTE* gateway = nullptr;
-				size_t targetPtrSize = 0;
-
 				BOOL isWow64 = false;
 				IsWow64Process(hProc, &isWow64);
 
+				// read the overwritten bytes of the origin
+				BYTE* stolen = new BYTE[size]{};
+
+				if (!ReadProcessMemory(hProc, origin, stolen, size, nullptr)) {
+					delete[] stolen;
+
+					return nullptr;
+				}
+
+				// decode the stolen instructions to relocate their relative operands unless the offset of a relative address is passed
+				instr::StolenRange range{};
+				const bool isDecoded = relativeAddressOffset == SIZE_MAX && instr::getStolenRange(stolen, size, size, !isWow64, &range);
+				const size_t codeSize = isDecoded ? instr::getRelocatedSize(stolen, &range) : size;
+
+				BYTE* gateway = nullptr;
+				size_t targetPtrSize = 0;
+
 				if (isWow64) {
 					// allocate enough memory for the relative jump (gateway to origin)
 					// VirtualAllocEx can be used for x86 targets since in x86 every address is reachable by a relative jump and the relay is not neccessary
-					gateway = static_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, size + sizeof(X86_JUMP), MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+					if (pPool) {
+						gateway = pPool->allocate(codeSize + sizeof(X86_JUMP));
+					}
+					else {
+						gateway = static_cast<BYTE*>(VirtualAllocEx(hProc, nullptr, codeSize + sizeof(X86_JUMP), MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+					}
+
 					targetPtrSize = sizeof(uint32_t);
 				}
 				else {
@@ -59,48 +112,66 @@ namespace hax {
 					#ifdef _WIN64
 
 					// allocate enough memory for the relative jump (gateway to origin) and the absolute relay jump (relay to detour) near the origin (reachable by relative jump)
-					gateway = virtualAllocNear(hProc, origin, size + sizeof(X86_JUMP) + sizeof(X64_JUMP));
+					const size_t gatewaySize = codeSize + sizeof(X86_JUMP) + sizeof(X64_JUMP);
+					gateway = pPool ? pPool->allocate(gatewaySize, origin) : virtualAllocNear(hProc, origin, gatewaySize);
 					targetPtrSize = sizeof(uint64_t);
 
 					#endif // _WIN64
 
 				}
 
-				if (!gateway) return nullptr;
+				if (!gateway) {
+					delete[] stolen;
+
+					return nullptr;
+				}
 
 				// overwrite the origin call placeholder
 				if (!WriteProcessMemory(hProc, detour + originCallOffset, &gateway, targetPtrSize, nullptr)) {
-					VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+					freeGateway(hProc, gateway, pPool);
+					delete[] stolen;
 
 					return nullptr;
 				}
 
-				// write the overwritten bytes of the origin to the gateway
-				BYTE* stolen = new BYTE[size]{};
+				BYTE* code = stolen;
 
-				if (!ReadProcessMemory(hProc, origin, stolen, size, nullptr)) {
-					VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
-					delete[] stolen;
+				if (isDecoded) {
+					code = new BYTE[codeSize]{};
+
+					// relocate the stolen instructions to the gateway
+					if (!instr::relocate(stolen, &range, reinterpret_cast<uintptr_t>(origin), reinterpret_cast<uintptr_t>(gateway), !isWow64, code, codeSize)) {
+						freeGateway(hProc, gateway, pPool);
+						delete[] code;
+						delete[] stolen;
+
+						return nullptr;
+					}
 
-					return nullptr;
 				}
 
-				if (!WriteProcessMemory(hProc, gateway, stolen, size, nullptr)) {
-					VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
-					delete[] stolen;
+				// write the overwritten bytes of the origin to the gateway
+				const bool written = WriteProcessMemory(hProc, gateway, code, codeSize, nullptr);
 
-					return nullptr;
+				if (code != stolen) {
+					delete[] code;
 				}
 
 				delete[] stolen;
 
+				if (!written) {
+					freeGateway(hProc, gateway, pPool);
+
+					return nullptr;
+				}
+
 				// correct the relative address
 				if (relativeAddressOffset != SIZE_MAX) {
 
 					int32_t oldRelativeAddress = 0;
 
 					if (!ReadProcessMemory(hProc, origin + relativeAddressOffset, &oldRelativeAddress, sizeof(oldRelativeAddress), nullptr)) {
-						VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+						freeGateway(hProc, gateway, pPool);
 
 						return nullptr;
 					}
@@ -108,12 +179,13 @@ namespace hax {
 					const ptrdiff_t correctedRelativeAddress = oldRelativeAddress + reinterpret_cast<uintptr_t>(origin) - reinterpret_cast<uintptr_t>(gateway);
 
 					if (correctedRelativeAddress < INT32_MIN || correctedRelativeAddress > INT32_MAX) {
+						freeGateway(hProc, gateway, pPool);
 
 						return nullptr;
 					}
 
 					if (!WriteProcessMemory(hProc, gateway + relativeAddressOffset, &correctedRelativeAddress, sizeof(uint32_t), nullptr)) {
-						VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+						freeGateway(hProc, gateway, pPool);
 
 						return nullptr;
 					}
@@ -121,8 +193,8 @@ namespace hax {
 				}
 
 				// relative jump from the gateway to the origin
-				if (!relJmp(hProc, gateway + size, origin + sizeof(X86_JUMP), sizeof(X86_JUMP))) {
-					VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+				if (!relJmp(hProc, gateway + codeSize, origin + sizeof(X86_JUMP), sizeof(X86_JUMP))) {
+					freeGateway(hProc, gateway, pPool);
 
 					return nullptr;
 				}
@@ -131,7 +203,7 @@ namespace hax {
 
 					// relative jump directly from origin to detour (will always be reachable in x86 targets)
 					if (!relJmp(hProc, origin, detour, size)) {
-						VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+						freeGateway(hProc, gateway, pPool);
 
 						return nullptr;
 					}
@@ -144,18 +216,18 @@ namespace hax {
 
 					// in x64 targets an absolute jump is needed to reliably jump from the origin to the detour
 					// instead of patching the origin with a longer absolute jump, a relay is used that can be reached by a relative jump
-					BYTE* const relay = gateway + size + sizeof(X86_JUMP);
+					BYTE* const relay = gateway + codeSize + sizeof(X86_JUMP);
 
 					// absolute jump from the relay to the detour function
 					if (!absJumpX64(hProc, relay, detour, sizeof(X64_JUMP))) {
-						VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+						freeGateway(hProc, gateway, pPool);
 
 						return nullptr;
 					}
 
 					// relative jump from the origin to the relay
 					if (!relJmp(hProc, origin, relay, size)) {
-						VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+						freeGateway(hProc, gateway, pPool);
 
 						return nullptr;
 					}
@@ -174,31 +246,41 @@ namespace hax {
 				AddressRange range{};
 				getNearAddressRange(address, &range);
 
-				uintptr_t offset = range.pageSize;
-				bool exhausted = false;
-				BYTE* retAddress = nullptr;
+				for (unsigned int i = 0u; i < NEAR_ALLOC_ATTEMPTS; i++) {
+					BYTE* const nearAddress = queryNearFreeAddress(hProc, address, &range, size);
 
-				// try to allocte the memory at the beginning of every memory page in range until successful
-				while (!exhausted) {
-					const uintptr_t high = range.start + offset;
-					const uintptr_t low = (range.start > offset) ? range.start - offset : 0;
+					if (!nearAddress) return nullptr;
 
-					if (high < range.max) {
-						retAddress = static_cast<BYTE*>(VirtualAllocEx(hProc, reinterpret_cast<void*>(high), size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+					BYTE* const retAddress = static_cast<BYTE*>(VirtualAllocEx(hProc, nearAddress, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
 
-						if (retAddress) return retAddress;
+					if (retAddress) return retAddress;
 
-					}
+				}
 
-					if (low > range.min) {
-						retAddress = static_cast<BYTE*>(VirtualAllocEx(hProc, reinterpret_cast<void*>(low), size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+				return nullptr;
+			}
 
-						if (retAddress) return retAddress;
 
-					}
+			BYTE* virtualAllocNear(RegionMap* pRegionMap, const BYTE* address, size_t size) {
+				AddressRange range{};
+				getNearAddressRange(address, &range);
+
+				const HANDLE hProc = pRegionMap->getProcessHandle();
+
+				for (unsigned int i = 0u; i < NEAR_ALLOC_ATTEMPTS; i++) {
+					BYTE* const nearAddress = findNearFreeAddress(
+						pRegionMap->getRegions(), pRegionMap->getCount(), address, size, range.granularity, reinterpret_cast<BYTE*>(range.min), reinterpret_cast<BYTE*>(range.max)
+					);
+
+					if (!nearAddress) return nullptr;
+
+					BYTE* const retAddress = static_cast<BYTE*>(VirtualAllocEx(hProc, nearAddress, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+
+					// the region has been allocated either way if the snapshot was outdated
+					if (!pRegionMap->refresh(nearAddress, size)) return retAddress;
+
+					if (retAddress) return retAddress;
 
-					offset += range.pageSize;
-					exhausted = high > range.max && low < range.min;
 				}
 
 				return nullptr;
@@ -219,18 +301,20 @@ namespace hax {
 
 				if (size < sizeof(X86_JUMP)) return nullptr;
 
-				if (!nop(hProc, origin, size)) return nullptr;
-
-				BYTE jump[sizeof(X86_JUMP)]{};
-
-				if (memcpy_s(jump, sizeof(jump), X86_JUMP, sizeof(X86_JUMP))) return nullptr;
+				// the jump padded with NOPs is written by a single call instead of writing the NOPs first
+				BYTE* const jump = new BYTE[size]{};
+				memset(jump, NOP, size);
+				memcpy(jump, X86_JUMP, sizeof(X86_JUMP));
 				
-				const uint32_t offset = static_cast<uint32_t>(detour - origin - sizeof(jump));
+				const uint32_t offset = static_cast<uint32_t>(detour - origin - sizeof(X86_JUMP));
 
-				// copies the jump offset to after the relative jump op code in the stack buffer
-				if (memcpy_s(jump + 0x1, sizeof(uint32_t), &offset, sizeof(uint32_t))) return nullptr;
+				// copies the jump offset to after the relative jump op code in the buffer
+				memcpy(jump + 0x1, &offset, sizeof(uint32_t));
 
-				if (!patch(hProc, origin, jump, sizeof(jump))) return nullptr;
+				const bool success = patch(hProc, origin, jump, size);
+				delete[] jump;
+
+				if (!success) return nullptr;
 
 				return origin + size;
 			}
@@ -312,6 +396,22 @@ namespace hax {
 			}
 
 
+			size_t getReadableSize(HANDLE hProc, const BYTE* address, size_t size) {
+				MEMORY_BASIC_INFORMATION mbi{};
+				size_t readable = 0u;
+
+				// usually the first region covers the whole range
+				while (readable < size && VirtualQueryEx(hProc, address + readable, &mbi, sizeof(mbi))) {
+
+					if (mbi.State != MEM_COMMIT || mbi.Protect == PAGE_NOACCESS || (mbi.Protect & PAGE_GUARD)) break;
+
+					readable = static_cast<size_t>(static_cast<const BYTE*>(mbi.BaseAddress) + mbi.RegionSize - address);
+				}
+
+				return readable < size ? readable : size;
+			}
+
+
 			BYTE* findSigAddress(HANDLE hProc, const BYTE* base, size_t size, const char* signature) {
 				// size of byte string signature of format "DE AD"
 				const size_t sigSize = (strlen(signature) + 1u) / 3u;
@@ -366,6 +466,82 @@ namespace hax {
 				return address;
 			}
 
+			BYTE* findSigAddress(const RegionMap* pRegionMap, const BYTE* base, size_t size, const char* signature) {
+				// size of byte string signature of format "DE AD"
+				const size_t sigSize = (strlen(signature) + 1u) / 3u;
+				int* const sig = new int[sigSize] {};
+
+				if (!helper::bytestringToInt(signature, sig, sigSize)) {
+					delete[] sig;
+
+					return nullptr;
+				}
+
+				const HANDLE hProc = pRegionMap->getProcessHandle();
+				const BYTE* const end = base + size;
+				BYTE* address = nullptr;
+				// heap buffer to scan, reused for all regions
+				BYTE* buffer = nullptr;
+				size_t bufferSize = 0u;
+				// the last bytes of the previous region are kept at the beginning of the buffer, so signatures straddling two adjacent regions are found
+				size_t carry = 0u;
+				const BYTE* carryEnd = nullptr;
+
+				// scan only regions that are readable without changing the protection
+				for (const Region* pCur = pRegionMap->first(REGION_READABLE, base); pCur && pCur->base < end; pCur = pRegionMap->next(pCur, REGION_READABLE)) {
+					// clamp the region to the range to be searched
+					const BYTE* const scanBase = max(pCur->base, base);
+					const size_t scanSize = min(pCur->base + pCur->size, end) - scanBase;
+
+					// the carried bytes are only valid if the region continues the previous one
+					if (scanBase != carryEnd) {
+						carry = 0u;
+					}
+
+					if (carry + scanSize > bufferSize) {
+						BYTE* const grownBuffer = new BYTE[carry + scanSize];
+
+						if (carry) {
+							memcpy(grownBuffer, buffer, carry);
+						}
+
+						delete[] buffer;
+						buffer = grownBuffer;
+						bufferSize = carry + scanSize;
+					}
+
+					if (!ReadProcessMemory(hProc, scanBase, buffer + carry, scanSize, nullptr)) {
+						carryEnd = nullptr;
+
+						continue;
+					}
+
+					const size_t bufferedSize = carry + scanSize;
+
+					if (bufferedSize >= sigSize) {
+						// address of found signature within heap buffer
+						const BYTE* const inBufferAddress = helper::findSignature(buffer, bufferedSize, sig, sigSize);
+
+						if (inBufferAddress) {
+							address = const_cast<BYTE*>(scanBase) - carry + (inBufferAddress - buffer);
+
+							break;
+						}
+
+					}
+
+					// keeps the bytes a signature continuing in the next region could start with
+					carry = min(bufferedSize, sigSize - 1u);
+					memmove(buffer, buffer + bufferedSize - carry, carry);
+					carryEnd = scanBase + scanSize;
+				}
+
+				delete[] buffer;
+				delete[] sig;
+
+				return address;
+			}
+
 
 			bool copyRemoteString(HANDLE hProc, char* dst, const BYTE* src, size_t size) {
 
@@ -405,34 +581,97 @@ namespace hax {
 
 		namespace in {
 
-			BYTE* trampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset) {
+			BYTE* trampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset, RemotePool* pPool) {
+				
+				if (size < sizeof(X86_JUMP)) return nullptr;
+				
+				BYTE* const jump = new BYTE[size]{};
+				BYTE* const gateway = prepareTrampHook(origin, detour, size, relativeAddressOffset, pPool, jump);
+
+				if (!gateway) {
+					delete[] jump;
+
+					return nullptr;
+				}
+
+				// jump from the origin to the relay or the detour
+				if (!patchAtomic(origin, jump, size)) {
+					delete[] jump;
+					freeGateway(gateway, pPool);
+
+					return nullptr;
+				}
+
+				delete[] jump;
+
+				return gateway;
+			}
+
+
+			BYTE* prepareTrampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset, RemotePool* pPool, BYTE jump[], size_t* pRelaySlotOffset) {
+
+				if (size < sizeof(X86_JUMP)) return nullptr;
 
 				if (relativeAddressOffset != SIZE_MAX && relativeAddressOffset + sizeof(uint32_t) > size)
 				{
 					return nullptr;
 				}
 
+				#ifdef _WIN64
+
+				constexpr bool x64 = true;
+
+				#else
+
+				constexpr bool x64 = false;
+
+				#endif // _WIN64
+
+				// decode the stolen instructions to relocate their relative operands unless the offset of a relative address is passed
+				instr::StolenRange range{};
+				const bool isDecoded = relativeAddressOffset == SIZE_MAX && instr::getStolenRange(origin, size, size, x64, &range);
+				const size_t codeSize = isDecoded ? instr::getRelocatedSize(origin, &range) : size;
+
 				// allocate memory for the gateway
+				// gateways are at least pointer aligned, so the relay is aligned relative to the gateway
 				#ifdef _WIN64
 
 				// allocate enough memory for the relative jump (gateway to origin) and the absolute relay jump (relay to detour) near the origin (reachable by relative jump)
-				BYTE* const gateway = virtualAllocNear(origin, size + sizeof(X86_JUMP) + sizeof(X64_JUMP));
+				const size_t relayOffset = getRelayOffset(codeSize + sizeof(X86_JUMP));
+				const size_t gatewaySize = relayOffset + sizeof(X64_JUMP);
+				BYTE* const gateway = pPool ? pPool->allocate(gatewaySize, origin) : virtualAllocNear(origin, gatewaySize);
 
 				#else
 
-				// allocate enough memory for the relative jump (gateway to origin)
-				// VirtualAllocEx can be used for x86 targets since in x86 every address is reachable by a relative jump and the relay is not neccessary
-				BYTE* gateway = static_cast<BYTE*>(VirtualAlloc(nullptr, size + sizeof(X86_JUMP), MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+				// allocate enough memory for the relative jump (gateway to origin) and the relay if requested
+				// VirtualAllocEx can be used for x86 targets since in x86 every address is reachable by a relative jump and the relay is only needed for its address slot
+				const size_t relayOffset = pRelaySlotOffset ? getRelayOffset(codeSize + sizeof(X86_JUMP)) : codeSize + sizeof(X86_JUMP);
+				const size_t gatewaySize = pRelaySlotOffset ? relayOffset + sizeof(X86_RELAY_JUMP) : relayOffset;
+				BYTE* const gateway = pPool ? pPool->allocate(gatewaySize) : static_cast<BYTE*>(VirtualAlloc(nullptr, gatewaySize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
 
 				#endif
 
 				if (!gateway) return nullptr;
 
-				// write the overwritten bytes of the origin to the gateway
-				if (memcpy_s(gateway, size, origin, size)) {
-					VirtualFree(gateway, 0, MEM_RELEASE);
+				if (isDecoded) {
+
+					// write the relocated stolen instructions to the gateway
+					if (!instr::relocate(origin, &range, reinterpret_cast<uintptr_t>(origin), reinterpret_cast<uintptr_t>(gateway), x64, gateway, codeSize)) {
+						freeGateway(gateway, pPool);
+
+						return nullptr;
+					}
+
+				}
+				else {
+
+					// write the overwritten bytes of the origin to the gateway
+					if (memcpy_s(gateway, size, origin, size)) {
+						freeGateway(gateway, pPool);
+
+						return nullptr;
+					}
 
-					return nullptr;
 				}
 
 				// correct the relative address
@@ -442,12 +681,13 @@ namespace hax {
 					const ptrdiff_t correctedRelativeAddress = oldRelativeAddress + reinterpret_cast<uintptr_t>(origin) - reinterpret_cast<uintptr_t>(gateway);
 
 					if (correctedRelativeAddress < INT32_MIN || correctedRelativeAddress > INT32_MAX) {
+						freeGateway(gateway, pPool);
 
 						return nullptr;
 					}
 					
 					if (memcpy_s(gateway + relativeAddressOffset, sizeof(uint32_t), &correctedRelativeAddress, sizeof(uint32_t))) {
-						VirtualFree(gateway, 0, MEM_RELEASE);
+						freeGateway(gateway, pPool);
 
 						return nullptr;
 					}
@@ -455,43 +695,83 @@ namespace hax {
 				}
 
 				// relative jump from the gateway to the origin
-				if (!relJmp(gateway + size, origin + sizeof(X86_JUMP), sizeof(X86_JUMP))) {
-					VirtualFree(gateway, 0, MEM_RELEASE);
+				if (!relJmp(gateway + codeSize, origin + sizeof(X86_JUMP), sizeof(X86_JUMP))) {
+					freeGateway(gateway, pPool);
 
 					return nullptr;
 				}
 
+				// the padding in front of the relay is never executed
+				if (relayOffset != codeSize + sizeof(X86_JUMP)) {
+					memset(gateway + codeSize + sizeof(X86_JUMP), NOP, relayOffset - codeSize - sizeof(X86_JUMP));
+				}
+
+				BYTE* const relay = gateway + relayOffset;
+
 				#ifdef _WIN64
 
 				// in x64 targets an absolute jump is needed to reliably jump from the origin to the detour
 				// instead of patching the origin with a longer absolute jump, a relay is used that can be reached by a relative jump
-				BYTE* const relay = gateway + size + sizeof(X86_JUMP);
 
 				// absolute jump from the relay to the detour function
 				if (!absJumpX64(relay, detour, sizeof(X64_JUMP))) {
-					VirtualFree(gateway, 0, MEM_RELEASE);
+					freeGateway(gateway, pPool);
 
 					return nullptr;
 				}
 
-				// relative jump from the origin to the relay
-				if (!relJmp(origin, relay, size)) {
-					VirtualFree(gateway, 0, MEM_RELEASE);
+				// the relay has to be reachable by the relative jump from the origin
+				const ptrdiff_t distance = relay - (origin + sizeof(X86_JUMP));
+
+				if (distance < INT32_MIN || distance > INT32_MAX) {
+					freeGateway(gateway, pPool);
 
 					return nullptr;
 				}
 
+				const BYTE* const target = relay;
+
 				#else
 
-				// relative jump directly from origin to detour (will always be reachable in x86 targets)
-				if (!relJmp(origin, detour, size)) {
-					VirtualFree(gateway, 0, MEM_RELEASE);
+				const BYTE* target = detour;
 
-					return nullptr;
+				if (pRelaySlotOffset) {
+					BYTE relayJump[sizeof(X86_RELAY_JUMP)]{};
+					memcpy(relayJump, X86_RELAY_JUMP, sizeof(X86_RELAY_JUMP));
+
+					// indirect jump through the address slot right behind the instruction
+					const BYTE* const pSlot = relay + RELAY_SLOT_OFFSET;
+					memcpy(relayJump + 0x2, &pSlot, sizeof(uint32_t));
+					memcpy(relayJump + RELAY_SLOT_OFFSET, &detour, sizeof(uint32_t));
+
+					if (!patch(relay, relayJump, sizeof(relayJump))) {
+						freeGateway(gateway, pPool);
+
+						return nullptr;
+					}
+
+					target = relay;
 				}
 
+				// otherwise relative jump directly from origin to detour (will always be reachable in x86 targets)
+
 				#endif
 
+				if (pRelaySlotOffset) {
+					*pRelaySlotOffset = relayOffset + RELAY_SLOT_OFFSET;
+				}
+
+				// relative jump from the origin to the relay or the detour padded with NOPs, written to the buffer instead of the origin
+				memset(jump, NOP, size);
+				jump[0] = X86_JUMP[0];
+				const uint32_t offset = static_cast<uint32_t>(target - origin - sizeof(X86_JUMP));
+
+				if (memcpy_s(jump + 0x1, sizeof(uint32_t), &offset, sizeof(uint32_t))) {
+					freeGateway(gateway, pPool);
+
+					return nullptr;
+				}
+
 				return gateway;
 			}
 
@@ -502,31 +782,39 @@ namespace hax {
 				AddressRange range{};
 				getNearAddressRange(address, &range);
 
-				uintptr_t offset = range.pageSize;
-				bool exhausted = false;
-				BYTE* retAddress = nullptr;
+				for (unsigned int i = 0u; i < NEAR_ALLOC_ATTEMPTS; i++) {
+					BYTE* const nearAddress = queryNearFreeAddress(GetCurrentProcess(), address, &range, size);
 
-				// try to allocte the memory at the beginning of every memory page in range until successful
-				while (!exhausted) {
-					const uintptr_t high = range.start + offset;
-					const uintptr_t low = (range.start > offset) ? range.start - offset : 0;
+					if (!nearAddress) return nullptr;
 
-					if (high < range.max) {
-						retAddress = static_cast<BYTE*>(VirtualAlloc(reinterpret_cast<void*>(high), size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+					BYTE* const retAddress = static_cast<BYTE*>(VirtualAlloc(nearAddress, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
 
-						if (retAddress) return retAddress;
+					if (retAddress) return retAddress;
 
-					}
+				}
 
-					if (low > range.min) {
-						retAddress = static_cast<BYTE*>(VirtualAlloc(reinterpret_cast<void*>(low), size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+				return nullptr;
+			}
 
-						if (retAddress) return retAddress;
 
-					}
+			BYTE* virtualAllocNear(RegionMap* pRegionMap, const BYTE* address, size_t size) {
+				AddressRange range{};
+				getNearAddressRange(address, &range);
+
+				for (unsigned int i = 0u; i < NEAR_ALLOC_ATTEMPTS; i++) {
+					BYTE* const nearAddress = findNearFreeAddress(
+						pRegionMap->getRegions(), pRegionMap->getCount(), address, size, range.granularity, reinterpret_cast<BYTE*>(range.min), reinterpret_cast<BYTE*>(range.max)
+					);
+
+					if (!nearAddress) return nullptr;
+
+					BYTE* const retAddress = static_cast<BYTE*>(VirtualAlloc(nearAddress, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+
+					// the region has been allocated either way if the snapshot was outdated
+					if (!pRegionMap->refresh(nearAddress, size)) return retAddress;
+
+					if (retAddress) return retAddress;
 
-					offset += range.pageSize;
-					exhausted = high > range.max && low < range.min;
 				}
 
 				return nullptr;
@@ -547,18 +835,20 @@ namespace hax {
 
 				if (size < sizeof(X86_JUMP)) return nullptr;
 
-				if (!nop(origin, size)) return nullptr;
-
-				BYTE jump[sizeof(X86_JUMP)]{};
+				// the jump padded with NOPs is built completely before the origin gets patched, so no thread executes a partially written jump
+				BYTE* const jump = new BYTE[size]{};
+				memset(jump, NOP, size);
+				memcpy(jump, X86_JUMP, sizeof(X86_JUMP));
 
-				if (memcpy_s(jump, sizeof(jump), X86_JUMP, sizeof(X86_JUMP))) return nullptr;
+				const uint32_t offset = static_cast<uint32_t>(detour - origin - sizeof(X86_JUMP));
 
-				const uint32_t offset = static_cast<uint32_t>(detour - origin - sizeof(jump));
+				// copies the jump offset after the relative jump op code in the buffer
+				memcpy(jump + 0x1, &offset, sizeof(uint32_t));
 
-				// copies the jump offset after the relative jump op code in the stack buffer
-				if (memcpy_s(jump + 0x1, sizeof(uint32_t), &offset, sizeof(uint32_t))) return nullptr;
+				const bool success = patchAtomic(origin, jump, size);
+				delete[] jump;
 
-				if (!patch(origin, jump, sizeof(jump))) return nullptr;
+				if (!success) return nullptr;
 
 				return origin + size;
 			}
@@ -569,16 +859,17 @@ namespace hax {
 			BYTE* absJumpX64(BYTE* origin, const BYTE* detour, size_t size) {
 				if (size < sizeof(X64_JUMP)) return nullptr;
 
-				if (!nop(origin, size)) return nullptr;
+				BYTE* const jump = new BYTE[size]{};
+				memset(jump, NOP, size);
+				memcpy(jump, X64_JUMP, sizeof(X64_JUMP));
 
-				BYTE jump[sizeof(X64_JUMP)]{};
+				// copies the jump offset to after the jmp QWORD PTR [rip+x] op code in the buffer
+				memcpy(jump + 0x6, &detour, sizeof(uint64_t));
 
-				if (memcpy_s(jump, sizeof(jump), X64_JUMP, sizeof(X64_JUMP))) return nullptr;
+				const bool success = patchAtomic(origin, jump, size);
+				delete[] jump;
 
-				// copies the jump offset to after the jmp QWORD PTR [rip+x] op code in the stack buffer
-				if (memcpy_s(jump + 0x6, sizeof(uint64_t), &detour, sizeof(uint64_t))) return nullptr;
-
-				if (!patch(origin, jump, sizeof(jump))) return nullptr;
+				if (!success) return nullptr;
 
 				return origin + size;
 			}
@@ -609,6 +900,49 @@ namespace hax {
 			}
 
 
+			bool patchAtomic(BYTE* dst, const BYTE src[], size_t size) {
+
+				if (!size) return false;
+
+				DWORD protect = 0ul;
+
+				if (!VirtualProtect(dst, size, PAGE_EXECUTE_READWRITE, &protect)) return false;
+
+				const HANDLE hProc = GetCurrentProcess();
+
+				// single store covering the whole window
+				if (exchangeAligned(dst, src, size)) {
+					FlushInstructionCache(hProc, dst, size);
+
+					return VirtualProtect(dst, size, protect, &protect) == TRUE;
+				}
+
+				// threads reaching the window spin on the jump to itself while the rest of the window is written
+				if (!exchangeAligned(dst, SPIN_JUMP, sizeof(SPIN_JUMP))) {
+					SHORT spin = 0;
+					memcpy(&spin, SPIN_JUMP, sizeof(spin));
+					// locked instructions are atomic regardless of the alignment
+					InterlockedExchange16(reinterpret_cast<SHORT volatile*>(dst), spin);
+				}
+
+				FlushInstructionCache(hProc, dst, sizeof(SPIN_JUMP));
+
+				memcpy(dst + sizeof(SPIN_JUMP), src + sizeof(SPIN_JUMP), size - sizeof(SPIN_JUMP));
+				FlushInstructionCache(hProc, dst, size);
+
+				// releases the spinning threads into the new code
+				if (!exchangeAligned(dst, src, sizeof(SPIN_JUMP))) {
+					SHORT head = 0;
+					memcpy(&head, src, sizeof(head));
+					InterlockedExchange16(reinterpret_cast<SHORT volatile*>(dst), head);
+				}
+
+				FlushInstructionCache(hProc, dst, size);
+
+				return VirtualProtect(dst, size, protect, &protect) == TRUE;
+			}
+
+
 			void* getVirtualFunction(const void* pInterface, size_t index) {
 				void* const* pVTable = *reinterpret_cast<void***>(const_cast<void*>(pInterface));
 
@@ -632,6 +966,22 @@ namespace hax {
 			}
 
 
+			size_t getReadableSize(const BYTE* address, size_t size) {
+				MEMORY_BASIC_INFORMATION mbi{};
+				size_t readable = 0u;
+
+				// usually the first region covers the whole range
+				while (readable < size && VirtualQuery(address + readable, &mbi, sizeof(mbi))) {
+
+					if (mbi.State != MEM_COMMIT || mbi.Protect == PAGE_NOACCESS || (mbi.Protect & PAGE_GUARD)) break;
+
+					readable = static_cast<size_t>(static_cast<const BYTE*>(mbi.BaseAddress) + mbi.RegionSize - address);
+				}
+
+				return readable < size ? readable : size;
+			}
+
+
 			BYTE* findSigAddress(const BYTE* base, size_t size, const char* signature) {
 				// size of byte string signature of format "DE AD"
 				const size_t sigSize = (strlen(signature) + 1) / 3;
@@ -663,6 +1013,50 @@ namespace hax {
 				return address;
 			}
 
+			BYTE* findSigAddress(const RegionMap* pRegionMap, const BYTE* base, size_t size, const char* signature) {
+				// size of byte string signature of format "DE AD"
+				const size_t sigSize = (strlen(signature) + 1) / 3;
+				int* const sig = new int[sigSize] {};
+
+				if (!helper::bytestringToInt(signature, sig, sigSize)) {
+					delete[] sig;
+
+					return nullptr;
+				}
+
+				const BYTE* const end = base + size;
+				BYTE* address = nullptr;
+				// number of bytes at the end of the previous region that are scanned again, so signatures straddling two adjacent regions are found
+				size_t carry = 0u;
+				const BYTE* carryEnd = nullptr;
+
+				// scan only regions that are readable without changing the protection
+				for (const Region* pCur = pRegionMap->first(REGION_READABLE, base); pCur && pCur->base < end; pCur = pRegionMap->next(pCur, REGION_READABLE)) {
+					// clamp the region to the range to be searched
+					const BYTE* const scanBase = max(pCur->base, base);
+					const size_t scanSize = min(pCur->base + pCur->size, end) - scanBase;
+
+					// the previous region is only readable up to the boundary if the region continues it
+					if (scanBase != carryEnd) {
+						carry = 0u;
+					}
+
+					if (carry + scanSize >= sigSize) {
+						address = helper::findSignature(scanBase - carry, carry + scanSize, sig, sigSize);
+
+						if (address) break;
+
+					}
+
+					carry = min(carry + scanSize, sigSize - 1u);
+					carryEnd = scanBase + scanSize;
+				}
+
+				delete[] sig;
+
+				return address;
+			}
+
 
 			template <typename LE>
 			bool unlinkListEntry(LE listEntry) {
@@ -692,6 +1086,7 @@ namespace hax {
 			GetSystemInfo(&sysInfo);
 
 			pAddrRange->pageSize = sysInfo.dwPageSize;
+			pAddrRange->granularity = sysInfo.dwAllocationGranularity;
 			// start at the beginning of the page where pBase is located
 			pAddrRange->start = reinterpret_cast<uintptr_t>(pBase) - (reinterpret_cast<uintptr_t>(pBase) % pAddrRange->pageSize);
 
@@ -705,9 +1100,138 @@ namespace hax {
 			pAddrRange->max = min(maxAddress, reinterpret_cast<uintptr_t>(sysInfo.lpMaximumApplicationAddress));
 		}
 
+
+		static BYTE* queryNearFreeAddress(HANDLE hProc, const BYTE* address, const AddressRange* pAddrRange, size_t size) {
+			const uintptr_t start = reinterpret_cast<uintptr_t>(address);
+			const BYTE* const minAddress = reinterpret_cast<const BYTE*>(pAddrRange->min);
+			const BYTE* const maxAddress = reinterpret_cast<const BYTE*>(pAddrRange->max);
+			MEMORY_BASIC_INFORMATION mbi{};
+
+			BYTE* above = nullptr;
+			uintptr_t cur = pAddrRange->start;
+
+			// walk upwards region by region including the region of the start
+			while (!above && cur < pAddrRange->max && VirtualQueryEx(hProc, reinterpret_cast<void*>(cur), &mbi, sizeof(mbi))) {
+
+				if (mbi.State == MEM_FREE) {
+					const Region region{ static_cast<BYTE*>(mbi.BaseAddress), mbi.RegionSize, mbi.State, mbi.Protect, mbi.Type, nullptr };
+					above = findNearFreeAddress(&region, 1u, address, size, pAddrRange->granularity, minAddress, maxAddress);
+				}
+
+				const uintptr_t next = reinterpret_cast<uintptr_t>(mbi.BaseAddress) + mbi.RegionSize;
+
+				// checks for wrap around
+				if (next <= cur) break;
+
+				cur = next;
+			}
+
+			const uintptr_t aboveDistance = above ? max(reinterpret_cast<uintptr_t>(above), start) - min(reinterpret_cast<uintptr_t>(above), start) : UINTPTR_MAX;
+			BYTE* below = nullptr;
+			cur = pAddrRange->start;
+
+			// walk downwards region by region until a free address is found or the regions are farther away than the one found above
+			while (!below && cur > pAddrRange->min && start - cur < aboveDistance && VirtualQueryEx(hProc, reinterpret_cast<void*>(cur - 1u), &mbi, sizeof(mbi))) {
+
+				if (mbi.State == MEM_FREE) {
+					const Region region{ static_cast<BYTE*>(mbi.BaseAddress), mbi.RegionSize, mbi.State, mbi.Protect, mbi.Type, nullptr };
+					below = findNearFreeAddress(&region, 1u, address, size, pAddrRange->granularity, minAddress, maxAddress);
+				}
+
+				const uintptr_t next = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+
+				// checks for wrap around
+				if (next >= cur) break;
+
+				cur = next;
+			}
+
+			if (!below) return above;
+
+			const uintptr_t belowDistance = max(reinterpret_cast<uintptr_t>(below), start) - min(reinterpret_cast<uintptr_t>(below), start);
+
+			return belowDistance < aboveDistance ? below : above;
+		}
+
 		#endif // _WIN64		
 
 
+		static size_t getRelayOffset(size_t codeEnd) {
+			constexpr size_t alignment = sizeof(void*);
+
+			return ((codeEnd + RELAY_SLOT_OFFSET + alignment - 1u) & ~(alignment - 1u)) - RELAY_SLOT_OFFSET;
+		}
+
+
+		static void freeGateway(HANDLE hProc, BYTE* gateway, RemotePool* pPool) {
+
+			if (pPool) {
+				pPool->free(gateway);
+			}
+			else {
+				VirtualFreeEx(hProc, gateway, 0, MEM_RELEASE);
+			}
+
+			return;
+		}
+
+
+		static void freeGateway(BYTE* gateway, RemotePool* pPool) {
+
+			if (pPool) {
+				pPool->free(gateway);
+			}
+			else {
+				VirtualFree(gateway, 0, MEM_RELEASE);
+			}
+
+			return;
+		}
+
+
+		static bool exchangeAligned(BYTE* dst, const BYTE src[], size_t size) {
+			const uintptr_t address = reinterpret_cast<uintptr_t>(dst);
+			const size_t offset = address & (sizeof(LONG64) - 1u);
+
+			if (offset + size <= sizeof(LONG64)) {
+				LONG64 volatile* const pQword = reinterpret_cast<LONG64 volatile*>(address - offset);
+				LONG64 oldQword = 0;
+				LONG64 newQword = 0;
+
+				// the bytes around the window might be changed by someone else in the meantime
+				do {
+					oldQword = *pQword;
+					newQword = oldQword;
+					memcpy(reinterpret_cast<BYTE*>(&newQword) + offset, src, size);
+				} while (InterlockedCompareExchange64(pQword, newQword, oldQword) != oldQword);
+
+				return true;
+			}
+
+			#ifdef _WIN64
+
+			const size_t offset16 = address & (2u * sizeof(LONG64) - 1u);
+
+			if (offset16 + size <= 2u * sizeof(LONG64)) {
+				LONG64 volatile* const pBlock = reinterpret_cast<LONG64 volatile*>(address - offset16);
+				// receives the current value if the exchange fails
+				LONG64 oldBlock[2]{ pBlock[0], pBlock[1] };
+				LONG64 newBlock[2]{};
+
+				do {
+					memcpy(newBlock, oldBlock, sizeof(newBlock));
+					memcpy(reinterpret_cast<BYTE*>(newBlock) + offset16, src, size);
+				} while (!InterlockedCompareExchange128(pBlock, newBlock[1], newBlock[0], oldBlock));
+
+				return true;
+			}
+
+			#endif // _WIN64
+
+			return false;
+		}
+
+
 		namespace helper {
 
 			bool bytestringToInt(const char* charSig, int intSig[], size_t sigSize) {
@@ -740,7 +1264,7 @@ namespace hax {
 				BYTE* address = nullptr;
 
 				// loop over the memory to be searched
-				for (size_t i = 0; i < size - sigSize; i++) {
+				for (size_t i = 0; i + sigSize <= size; i++) {
 					bool found = true;
 
 					// loop over signature at every position in memory to be searched
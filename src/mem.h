@@ -25,6 +25,9 @@ namespace hax {
 
 	namespace mem {
 
+		class RegionMap;
+		class RemotePool;
+
 		// Functions to interact with the virtual memory of an external process.
 		// Compiled to x64 the external functions are designed to work both on x64 targets as well as x86 targets.
 		// Compiled to x86 interacting with x64 processes is neihter supported nor feasable.
@@ -55,23 +58,29 @@ namespace hax {
 			// Number of bytes that get overwritten by the jump at the beginning of the origin function.
 			// The overwritten instructions get executed by the gateway right before executing the origin function.
 			// Has to be at least five! Only complete instructions should be overwritten!
-			// It is necessary to look at the disassembly of the origin function to determine when the first complete instruction finishes after the first five bytes.
+			// instr::getStolenRange can be used to determine the size of the whole instructions covering the first five bytes.
 			// 
 			// [in] relativeAddressOffset:
 			// The offset of a relative Address if there is one in the first <size> bytes of the origin function.
-			// It is necessary to look at the disassembly of the origin function to determine if there is a relative address in the first <size> bytes.
-			// If there is no relative address in the first <size> bytes of the origin function the default value of SIZE_MAX should be passed. This value will then be ignored.
+			// If the default value of SIZE_MAX is passed the overwritten instructions are decoded and all their relative operands (branches and RIP-relative memory operands) are relocated.
+			// Short branches are expanded to near branches, so the relocated instructions in the gateway can be longer than <size> bytes.
+			// If the instructions can not be decoded they are copied without relocation.
+			//
+			// [in] pPool:
+			// Pool the gateway is allocated from. Has to be created for the same target process. Many gateways near each other share the arenas of the pool.
+			// If nullptr is passed the gateway gets an allocation of its own.
 			//
 			// Return:
 			// Pointer to the gateway within the virtual address space of the target process or nullptr on failure (eg because of architecture incompatibility)
 			// This address is called by the detour function at the address given by originCall.
-			// The stolen bytes of the orgin function are located here.
-			// Call VirtualFreeEx on the return value to free the memory in the target process.
-			BYTE* trampHook(HANDLE hProc, BYTE* origin, BYTE* detour, size_t originCallOffset, size_t size, size_t relativeAddressOffset = SIZE_MAX);
+			// The stolen bytes of the orgin function are located here, with relocated relative operands.
+			// Call VirtualFreeEx on the return value to free the memory in the target process or return it to the pool it was allocated from.
+			BYTE* trampHook(HANDLE hProc, BYTE* origin, BYTE* detour, size_t originCallOffset, size_t size, size_t relativeAddressOffset = SIZE_MAX, RemotePool* pPool = nullptr);
 
 			#ifdef _WIN64
 
 			// Allocates memory in the virtual address space of an external process that is reachable by a relative jump (op code: E9) from a given address.
+			// Walks the memory regions from the address to both sides via VirtualQueryEx and allocates at the nearest allocation granularity aligned free address.
 			// Reserves and commits the memory pages with PAGE_EXECUTE_READWRITE protection.
 			// Only neccessary for x64 target processes because the whole x86 address space can be reached by a relative jump.
 			// The Win32 APIs VirtualAllocEx can be used as an alternative for x86.
@@ -93,6 +102,27 @@ namespace hax {
 			// Nullpointer if no memory is available or the function failed for other reasons.
 			BYTE* virtualAllocNear(HANDLE hProc, const BYTE* address, size_t size);
 
+			// Allocates memory in the virtual address space of an external process that is reachable by a relative jump (op code: E9) from a given address.
+			// Looks up the nearest free region in a snapshot of the memory regions instead of querying the address space.
+			// Reserves and commits the memory pages with PAGE_EXECUTE_READWRITE protection.
+			// 
+			// Parameters:
+			// 
+			// [in/out] pRegionMap:
+			// Snapshot of the memory regions of the target process. Gets refreshed for the allocated range on success.
+			// The process handle of the snapshot needs at least PROCESS_QUERY_INFORMATION and PROCESS_VM_OPERATION access rights.
+			// 
+			// [in] address:
+			// The address within the virtual address space of the target process from which the allocated memory should be reachable by a relative jump (op code: E9).
+			// 
+			// [in] size:
+			// Size of the allocated memory region in bytes.
+			// 
+			// Return:
+			// Pointer to the allocated memory region.
+			// Nullpointer if no memory is available or the function failed for other reasons.
+			BYTE* virtualAllocNear(RegionMap* pRegionMap, const BYTE* address, size_t size);
+
 			#endif // _WIN64
 
 			// Patches a relative jump (op code: E9) into an external process.
@@ -225,6 +255,24 @@ namespace hax {
 			// Example: *(*(*(base + offset[0]) + offset[1]) + offset[2])
 			BYTE* getMultiLevelPointer(HANDLE hProc, const BYTE* base, const size_t offsets[], size_t size);
 
+			// Gets the number of bytes that can be read at an address within the virtual address space of an external process.
+			// 
+			// Parameters:
+			// 
+			// [in] hProc:
+			// Handle to the target process.
+			// Needs at least PROCESS_QUERY_LIMITED_INFORMATION access rights.
+			// 
+			// [in] address:
+			// Address within the virtual address space of the target process.
+			// 
+			// [in] size:
+			// Maximum number of bytes.
+			// 
+			// Return:
+			// Number of bytes at the address up to size that lie within committed pages that are not PAGE_NOACCESS or guard pages.
+			size_t getReadableSize(HANDLE hProc, const BYTE* address, size_t size);
+
 			// Finds the address of a byte signature within the virtual address space of an external process.
 			// 
 			// Parameters:
@@ -249,6 +297,32 @@ namespace hax {
 			// Nullpointer if the signature was not found or the function failed.
 			BYTE* findSigAddress(HANDLE hProc, const BYTE* base, size_t size, const char* signature);
 
+			// Finds the address of a byte signature within the virtual address space of an external process.
+			// Only scans the readable regions of a snapshot of the memory regions instead of querying the address space. Does not change any memory protection.
+			// Signatures straddling adjacent readable regions are found as well.
+			// 
+			// Parameters:
+			// 
+			// [in] pRegionMap:
+			// Snapshot of the memory regions of the target process.
+			// The process handle of the snapshot needs at least PROCESS_QUERY_INFORMATION and PROCESS_VM_READ access rights.
+			// 
+			// [in] base:
+			// Address where the search should start.
+			// 
+			// [in] size:
+			// Amount of bytes that should be searched.
+			// 
+			// [in] signature:
+			// The byte signature base hex that should be looked for as null terminated string.
+			// Bytes have to be two characters and separeted by spaces. "??" can be used as wildcards.
+			// Example: "DE AD ?? EF"
+			// 
+			// Return:
+			// The address where the byte signature was found within the virtual address space of the target process.
+			// Nullpointer if the signature was not found or the function failed.
+			BYTE* findSigAddress(const RegionMap* pRegionMap, const BYTE* base, size_t size, const char* signature);
+
 			// Copies a nullterminated string from an external process to a buffer allocated in the virtual memory of the caller process.
 			// Copies characters until a null character is copied or the target buffer is full.
 			// 
@@ -321,22 +395,60 @@ namespace hax {
 			// Number of bytes that get overwritten by the jump at the beginning of the origin function.
 			// The overwritten instructions get executed by the gateway right before executing the origin function.
 			// Has to be at least five! Only complete instructions should be overwritten!
-			// It is necessary to look at the disassembly of the origin function to determine when the first complete instruction finishes after the first five bytes.
+			// instr::getStolenRange can be used to determine the size of the whole instructions covering the first five bytes.
 			// 
 			// [in] relativeAddressOffset:
 			// The offset of a relative Address if there is one in the first <size> bytes of the origin function.
-			// It is necessary to look at the disassembly of the origin function to determine if there is a relative address in the first <size> bytes.
-			// If there is no relative address in the first <size> bytes of the origin function the default value of SIZE_MAX should be passed. This value will then be ignored.
+			// If the default value of SIZE_MAX is passed the overwritten instructions are decoded and all their relative operands (branches and RIP-relative memory operands) are relocated.
+			// Short branches are expanded to near branches, so the relocated instructions in the gateway can be longer than <size> bytes.
+			// If the instructions can not be decoded they are copied without relocation.
+			// 
+			// [in] pPool:
+			// Pool the gateway is allocated from. Has to be created for the caller process. Many gateways near each other share the arenas of the pool.
+			// If nullptr is passed the gateway gets an allocation of its own.
 			// 
 			// Return:
 			// Pointer to the gateway. This address should be called by the detour function with the same calling convention as the origin function.
-			// The stolen bytes of the orgin function are located here.
-			// Call VirtualFree on the return value to free the memory in the process.
-			BYTE* trampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset = SIZE_MAX);
+			// The stolen bytes of the orgin function are located here, with relocated relative operands.
+			// Call VirtualFree on the return value to free the memory in the process or return it to the pool it was allocated from.
+			BYTE* trampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset = SIZE_MAX, RemotePool* pPool = nullptr);
+
+			// Prepares a trampoline hook in the caller process without patching the origin function.
+			// Writes the gateway and builds the jump to the detour, so several hooks can be prepared first and their origins patched in a single pass.
+			// 
+			// Parameters:
+			// 
+			// [in] origin:
+			// Address of the origin function to be hooked within the virtual address space of the caller process. Only gets read.
+			// 
+			// [in] detour:
+			// Address of the function that should be executed on a call of the origin function within the virtual address space of the caller process.
+			// 
+			// [in] size:
+			// Number of bytes that get overwritten by the jump at the beginning of the origin function. See trampHook.
+			// 
+			// [in] relativeAddressOffset:
+			// The offset of a relative Address if there is one in the first <size> bytes of the origin function. See trampHook.
+			// 
+			// [in] pPool:
+			// Pool the gateway is allocated from. See trampHook. Pass nullptr for an allocation of its own.
+			// 
+			// [out] jump:
+			// Buffer of at least <size> bytes that receives the jump padded with NOPs. Patching it to the origin installs the hook.
+			// 
+			// [out] pRelaySlotOffset:
+			// Receives the offset of the address the relay jumps to within the gateway. The address is pointer aligned and initially points to the detour.
+			// Exchanging it atomically redirects the hooked function without patching the origin again, eg. to the gateway to bypass the detour.
+			// x64 gateways always contain a relay. For x86 the origin jumps to a relay only if this parameter is not nullptr, otherwise it jumps to the detour directly.
+			// 
+			// Return:
+			// Pointer to the gateway or nullptr on failure. Call VirtualFree on the return value to free the memory in the process or return it to the pool it was allocated from.
+			BYTE* prepareTrampHook(BYTE* origin, const BYTE* detour, size_t size, size_t relativeAddressOffset, RemotePool* pPool, BYTE jump[], size_t* pRelaySlotOffset = nullptr);
 
 			#ifdef _WIN64
 
 			// Allocates memory in the virtual address space of the caller process that is reachable by a relative jump (op code: E9) from a given address.
+			// Walks the memory regions from the address to both sides via VirtualQuery and allocates at the nearest allocation granularity aligned free address.
 			// Reserves and commits the memory pages with PAGE_EXECUTE_READWRITE protection.
 			// Only neccessary for x64 target processes because the whole x86 address space can be reached by a relative jump.
 			// The Win32 APIs VirtualAllocEx can be used as an alternative for x86.
@@ -354,6 +466,26 @@ namespace hax {
 			// Nullpointer if no memory is available or the function failed.
 			BYTE* virtualAllocNear(const BYTE* address, size_t size);
 
+			// Allocates memory in the virtual address space of the caller process that is reachable by a relative jump (op code: E9) from a given address.
+			// Looks up the nearest free region in a snapshot of the memory regions instead of querying the address space.
+			// Reserves and commits the memory pages with PAGE_EXECUTE_READWRITE protection.
+			// 
+			// Parameters:
+			// 
+			// [in/out] pRegionMap:
+			// Snapshot of the memory regions of the caller process. Gets refreshed for the allocated range on success.
+			// 
+			// [in] address:
+			// The address within the virtual address space of the caller process from which the allocated memory should be reachable by a relative jump (op code: E9).
+			// 
+			// [in] size:
+			// Size of the allocated memory region in bytes.
+			// 
+			// Return:
+			// Pointer to the allocated memory region
+			// Nullpointer if no memory is available or the function failed.
+			BYTE* virtualAllocNear(RegionMap* pRegionMap, const BYTE* address, size_t size);
+
 			#endif // _WIN64
 
 			// Patches a relative jump (op code: E9) into the caller process.
@@ -430,6 +562,29 @@ namespace hax {
 			// True on success, false on failure.
 			bool patch(BYTE* dst, const BYTE src[], size_t size);
 
+			// Patches code of the caller process that might be executed by other threads at the same time. The threads do not have to be suspended.
+			// If the patched window lies within an aligned qword (or an aligned 16 bytes block for x64), the whole window is written by a single compare and exchange.
+			// Otherwise the first two bytes are atomically replaced by a jump to itself first, so threads reaching the window spin on it.
+			// Then the remaining bytes are written and finally the first two bytes are atomically replaced by the new ones, which releases the spinning threads.
+			// Either way a thread never executes a partially written instruction at the beginning of the window.
+			// Threads interrupted at an instruction boundary within the window behind the first instruction still see the new bytes, so only the first instruction
+			// should be a likely position of an instruction pointer, eg. the beginning of a function.
+			// 
+			// Parameters:
+			// 
+			// [in] dst:
+			// The address that should be patched within the virtual address space of the caller process.
+			// 
+			// [in] src:
+			// The buffer that should be patched into the caller process. The complete replacement of the window including any padding.
+			// 
+			// [in] size:
+			// Size of the source buffer.
+			// 
+			// Return:
+			// True on success, false on failure.
+			bool patchAtomic(BYTE* dst, const BYTE src[], size_t size);
+
 			// Gets the address of a virtual function within the virtual address space of an external process.
 			// 
 			// Parameters:
@@ -462,6 +617,20 @@ namespace hax {
 			// Example: *(*(*(base + offset[0]) + offset[1]) + offset[2])
 			BYTE* getMultiLevelPointer(const BYTE* base, const size_t offsets[], size_t size);
 
+			// Gets the number of bytes that can be read at an address within the virtual address space of the caller process.
+			// 
+			// Parameters:
+			// 
+			// [in] address:
+			// Address within the virtual address space of the caller process.
+			// 
+			// [in] size:
+			// Maximum number of bytes.
+			// 
+			// Return:
+			// Number of bytes at the address up to size that lie within committed pages that are not PAGE_NOACCESS or guard pages.
+			size_t getReadableSize(const BYTE* address, size_t size);
+
 			// Finds the address of a byte signature within the virtual address space of the caller process.
 			// 
 			// Parameters:
@@ -482,6 +651,31 @@ namespace hax {
 			// Nullpointer if the signature was not found or the function failed.
 			BYTE* findSigAddress(const BYTE* base, size_t size, const char* signature);
 
+			// Finds the address of a byte signature within the virtual address space of the caller process.
+			// Only scans the readable regions of a snapshot of the memory regions instead of querying the address space.
+			// Signatures straddling adjacent readable regions are found as well.
+			// 
+			// Parameters:
+			// 
+			// [in] pRegionMap:
+			// Snapshot of the memory regions of the caller process.
+			// 
+			// [in] base:
+			// Address where the search should start.
+			// 
+			// [in] size:
+			// Amount of bytes that should be searched.
+			// 
+			// [in] signature:
+			// The byte signature base hex that should be looked for as null terminated string.
+			// Bytes have to be two characters and separeted by spaces. "??" can be used as wildcards.
+			// Example: "DE AD ?? EF"
+			// 
+			// Return:
+			// The address where the byte signature was found within the virtual address space of the caller process.
+			// Nullpointer if the signature was not found or the function failed.
+			BYTE* findSigAddress(const RegionMap* pRegionMap, const BYTE* base, size_t size, const char* signature);
+
 			// Unlinks an entry of a Win32 API doubly linked list in the target process.
 			// Found for example in the loader data of the process environment block of a process (see undocWinDefs.h).
 			// 
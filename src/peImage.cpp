@@ -0,0 +1,398 @@
+#include "peImage.h"
+#include <string.h>
+
+namespace hax {
+
+	namespace launch {
+
+		static_assert(sizeof(pe::DosHeader) == 0x40u && sizeof(pe::FileHeader) == 0x14u && sizeof(pe::SectionHeader) == 0x28u, "Unexpected PE header layout.");
+		static_assert(sizeof(pe::OptionalHeader32) == 0xE0u && sizeof(pe::OptionalHeader64) == 0xF0u, "Unexpected optional header layout.");
+
+		// access flags of a page, combined to an index into PAGE_PROTECTIONS
+		constexpr uint8_t PAGE_BIT_READ = 1u << 0;
+		constexpr uint8_t PAGE_BIT_WRITE = 1u << 1;
+		constexpr uint8_t PAGE_BIT_EXECUTE = 1u << 2;
+		static constexpr uint32_t PAGE_PROTECTIONS[]{
+			IMAGE_PROTECT_NOACCESS, IMAGE_PROTECT_READONLY, IMAGE_PROTECT_READWRITE, IMAGE_PROTECT_READWRITE,
+			IMAGE_PROTECT_EXECUTE, IMAGE_PROTECT_EXECUTE_READ, IMAGE_PROTECT_EXECUTE_READWRITE, IMAGE_PROTECT_EXECUTE_READWRITE
+		};
+
+		PeImage::PeImage() : _pImage{}, _size{}, _imageSize{}, _preferredBase{}, _pProtections{}, _protectionCount{}, _is64Bit{} {}
+
+
+		PeImage::~PeImage() {
+			this->reset();
+		}
+
+
+		bool PeImage::layout(const uint8_t* pFile, size_t fileSize, size_t extraSize) {
+			this->reset();
+
+			if (!pFile || fileSize < sizeof(pe::DosHeader)) return false;
+
+			const pe::DosHeader* const pDosHeader = reinterpret_cast<const pe::DosHeader*>(pFile);
+
+			if (pDosHeader->e_magic != pe::DOS_SIGNATURE || pDosHeader->e_lfanew < 0) return false;
+
+			const size_t ntOffset = static_cast<size_t>(pDosHeader->e_lfanew);
+			const size_t optOffset = ntOffset + sizeof(uint32_t) + sizeof(pe::FileHeader);
+
+			if (optOffset > fileSize || *reinterpret_cast<const uint32_t*>(pFile + ntOffset) != pe::NT_SIGNATURE) return false;
+
+			const pe::FileHeader* const pFileHeader = reinterpret_cast<const pe::FileHeader*>(pFile + ntOffset + sizeof(uint32_t));
+
+			if (!(pFileHeader->Characteristics & pe::FILE_DLL)) return false;
+
+			const size_t sectionOffset = optOffset + pFileHeader->SizeOfOptionalHeader;
+
+			if (sectionOffset + pFileHeader->NumberOfSections * sizeof(pe::SectionHeader) > fileSize) return false;
+
+			uint32_t sizeOfHeaders = 0u;
+
+			if (pFileHeader->Machine == pe::MACHINE_AMD64 && pFileHeader->SizeOfOptionalHeader >= sizeof(pe::OptionalHeader64)) {
+				const pe::OptionalHeader64* const pOptHeader64 = reinterpret_cast<const pe::OptionalHeader64*>(pFile + optOffset);
+
+				if (pOptHeader64->Magic != pe::OPTIONAL_HDR64_MAGIC) return false;
+
+				this->_is64Bit = true;
+				this->_imageSize = pOptHeader64->SizeOfImage;
+				this->_preferredBase = pOptHeader64->ImageBase;
+				sizeOfHeaders = pOptHeader64->SizeOfHeaders;
+			}
+			else if (pFileHeader->Machine == pe::MACHINE_I386 && pFileHeader->SizeOfOptionalHeader >= sizeof(pe::OptionalHeader32)) {
+				const pe::OptionalHeader32* const pOptHeader32 = reinterpret_cast<const pe::OptionalHeader32*>(pFile + optOffset);
+
+				if (pOptHeader32->Magic != pe::OPTIONAL_HDR32_MAGIC) return false;
+
+				this->_is64Bit = false;
+				this->_imageSize = pOptHeader32->SizeOfImage;
+				this->_preferredBase = pOptHeader32->ImageBase;
+				sizeOfHeaders = pOptHeader32->SizeOfHeaders;
+			}
+			else {
+
+				return false;
+			}
+
+			// the optional header is accessed within the local buffer later on, so it has to be part of the copied headers
+			if (sectionOffset > sizeOfHeaders || sizeOfHeaders > fileSize || sizeOfHeaders > this->_imageSize) {
+				this->reset();
+
+				return false;
+			}
+
+			this->_size = static_cast<size_t>(alignToPage(this->_imageSize) + extraSize);
+			this->_pImage = new uint8_t[this->_size]{};
+			memcpy(this->_pImage, pFile, sizeOfHeaders);
+
+			const pe::SectionHeader* const pSectionHeaders = reinterpret_cast<const pe::SectionHeader*>(pFile + sectionOffset);
+
+			for (uint16_t i = 0u; i < pFileHeader->NumberOfSections; i++) {
+				const pe::SectionHeader* const pCurSection = &pSectionHeaders[i];
+				// the raw data is padded to the file alignment and might exceed the virtual size
+				size_t copySize = pCurSection->SizeOfRawData;
+
+				if (pCurSection->VirtualSize && pCurSection->VirtualSize < copySize) {
+					copySize = pCurSection->VirtualSize;
+				}
+
+				// uninitialized data stays zeroed
+				if (!copySize) continue;
+
+				if (static_cast<uint64_t>(pCurSection->PointerToRawData) + copySize > fileSize || static_cast<uint64_t>(pCurSection->VirtualAddress) + copySize > this->_imageSize) {
+					this->reset();
+
+					return false;
+				}
+
+				memcpy(this->_pImage + pCurSection->VirtualAddress, pFile + pCurSection->PointerToRawData, copySize);
+			}
+
+			this->buildProtections(pSectionHeaders, pFileHeader->NumberOfSections);
+
+			return true;
+		}
+
+
+		bool PeImage::relocate(uint64_t base) {
+
+			if (!this->_pImage) return false;
+
+			// x86 images have to be mapped within the lower four gigabytes
+			if (!this->_is64Bit && base > 0xFFFFFFFFu) return false;
+
+			uint8_t* const pOptHeader = this->getOptionalHeader();
+			// relative to the current base of the local buffer so the image can be relocated multiple times
+			uint64_t* const pImageBase64 = reinterpret_cast<uint64_t*>(pOptHeader + offsetof(pe::OptionalHeader64, ImageBase));
+			uint32_t* const pImageBase32 = reinterpret_cast<uint32_t*>(pOptHeader + offsetof(pe::OptionalHeader32, ImageBase));
+			const uint64_t delta = base - (this->_is64Bit ? *pImageBase64 : *pImageBase32);
+
+			if (!delta) return true;
+
+			const pe::DirectoryEntry* const pRelocDir = this->getDataDirectory(pe::DIRECTORY_ENTRY_BASERELOC);
+
+			// images without relocations can only be mapped at their preferred base
+			if (!pRelocDir || !pRelocDir->VirtualAddress || !pRelocDir->Size) return false;
+
+			const uint8_t* pCurBlock = this->getRvaAddress(pRelocDir->VirtualAddress, pRelocDir->Size);
+
+			if (!pCurBlock) return false;
+
+			const uint8_t* const pEnd = pCurBlock + pRelocDir->Size;
+
+			while (pCurBlock + sizeof(pe::BaseRelocation) <= pEnd) {
+				const pe::BaseRelocation* const pRelocation = reinterpret_cast<const pe::BaseRelocation*>(pCurBlock);
+
+				if (pRelocation->SizeOfBlock < sizeof(pe::BaseRelocation) || pCurBlock + pRelocation->SizeOfBlock > pEnd) return false;
+
+				const uint16_t* const pEntries = reinterpret_cast<const uint16_t*>(pCurBlock + sizeof(pe::BaseRelocation));
+				const size_t entryCount = (pRelocation->SizeOfBlock - sizeof(pe::BaseRelocation)) / sizeof(uint16_t);
+
+				for (size_t i = 0u; i < entryCount; i++) {
+					// upper four bits are the type, lower twelve bits the offset within the page of the block
+					const uint16_t type = pEntries[i] >> 12;
+					const uint64_t rva = static_cast<uint64_t>(pRelocation->VirtualAddress) + (pEntries[i] & 0xFFFu);
+
+					// absolute entries pad the blocks to a four byte boundary
+					if (type == pe::REL_BASED_ABSOLUTE) continue;
+
+					if (type == pe::REL_BASED_HIGHLOW) {
+						uint32_t* const pAddress = reinterpret_cast<uint32_t*>(this->getRvaAddress(rva, sizeof(uint32_t)));
+
+						if (!pAddress) return false;
+
+						*pAddress += static_cast<uint32_t>(delta);
+					}
+					else if (type == pe::REL_BASED_DIR64) {
+						uint64_t* const pAddress = reinterpret_cast<uint64_t*>(this->getRvaAddress(rva, sizeof(uint64_t)));
+
+						if (!pAddress) return false;
+
+						*pAddress += delta;
+					}
+					else {
+
+						return false;
+					}
+
+				}
+
+				pCurBlock += pRelocation->SizeOfBlock;
+			}
+
+			if (this->_is64Bit) {
+				*pImageBase64 = base;
+			}
+			else {
+				*pImageBase32 = static_cast<uint32_t>(base);
+			}
+
+			return true;
+		}
+
+
+		void PeImage::reset() {
+
+			if (this->_pImage) {
+				delete[] this->_pImage;
+				this->_pImage = nullptr;
+			}
+
+			if (this->_pProtections) {
+				delete[] this->_pProtections;
+				this->_pProtections = nullptr;
+			}
+
+			this->_size = 0u;
+			this->_imageSize = 0u;
+			this->_preferredBase = 0u;
+			this->_protectionCount = 0u;
+			this->_is64Bit = false;
+
+			return;
+		}
+
+
+		uint8_t* PeImage::getImage() const {
+
+			return this->_pImage;
+		}
+
+
+		size_t PeImage::getSize() const {
+
+			return this->_size;
+		}
+
+
+		uint32_t PeImage::getImageSize() const {
+
+			return this->_imageSize;
+		}
+
+
+		uint64_t PeImage::getPreferredBase() const {
+
+			return this->_preferredBase;
+		}
+
+
+		uint32_t PeImage::getEntryRva() const {
+
+			if (!this->_pImage) return 0u;
+
+			const uint8_t* const pOptHeader = this->getOptionalHeader();
+
+			if (this->_is64Bit) return reinterpret_cast<const pe::OptionalHeader64*>(pOptHeader)->AddressOfEntryPoint;
+
+			return reinterpret_cast<const pe::OptionalHeader32*>(pOptHeader)->AddressOfEntryPoint;
+		}
+
+
+		const ImageProtection* PeImage::getProtections() const {
+
+			return this->_pProtections;
+		}
+
+
+		size_t PeImage::getProtectionCount() const {
+
+			return this->_protectionCount;
+		}
+
+
+		bool PeImage::is64Bit() const {
+
+			return this->_is64Bit;
+		}
+
+
+		const pe::DirectoryEntry* PeImage::getDataDirectory(uint32_t index) const {
+
+			if (!this->_pImage) return nullptr;
+
+			const uint8_t* const pOptHeader = this->getOptionalHeader();
+
+			if (this->_is64Bit) {
+				const pe::OptionalHeader64* const pOptHeader64 = reinterpret_cast<const pe::OptionalHeader64*>(pOptHeader);
+
+				if (index >= pOptHeader64->NumberOfRvaAndSizes || index >= pe::NUMBEROF_DIRECTORY_ENTRIES) return nullptr;
+
+				return &pOptHeader64->DataDirectory[index];
+			}
+			else {
+				const pe::OptionalHeader32* const pOptHeader32 = reinterpret_cast<const pe::OptionalHeader32*>(pOptHeader);
+
+				if (index >= pOptHeader32->NumberOfRvaAndSizes || index >= pe::NUMBEROF_DIRECTORY_ENTRIES) return nullptr;
+
+				return &pOptHeader32->DataDirectory[index];
+			}
+
+		}
+
+
+		uint8_t* PeImage::getRvaAddress(uint64_t rva, size_t size) const {
+
+			if (!this->_pImage || rva + size > this->_imageSize) return nullptr;
+
+			return this->_pImage + rva;
+		}
+
+
+		const char* PeImage::getRvaString(uint64_t rva) const {
+			const uint8_t* const pString = this->getRvaAddress(rva, sizeof(char));
+
+			if (!pString) return nullptr;
+
+			// the string has to be terminated within the image
+			if (!memchr(pString, '\0', static_cast<size_t>(this->_imageSize - rva))) return nullptr;
+
+			return reinterpret_cast<const char*>(pString);
+		}
+
+
+		void PeImage::buildProtections(const pe::SectionHeader* pSectionHeaders, uint16_t sectionCount) {
+			const size_t pageCount = static_cast<size_t>(alignToPage(this->_imageSize) / IMAGE_PAGE_SIZE);
+			// every page is at least readable, this covers the headers and gaps between sections
+			uint8_t* const pPageBits = new uint8_t[pageCount];
+			memset(pPageBits, PAGE_BIT_READ, pageCount);
+
+			for (uint16_t i = 0u; i < sectionCount; i++) {
+				const pe::SectionHeader* const pCurSection = &pSectionHeaders[i];
+				const uint64_t size = pCurSection->VirtualSize ? pCurSection->VirtualSize : pCurSection->SizeOfRawData;
+
+				if (!size) continue;
+
+				uint8_t bits = 0u;
+
+				if (pCurSection->Characteristics & pe::SCN_MEM_READ) {
+					bits |= PAGE_BIT_READ;
+				}
+
+				if (pCurSection->Characteristics & pe::SCN_MEM_WRITE) {
+					bits |= PAGE_BIT_WRITE;
+				}
+
+				if (pCurSection->Characteristics & pe::SCN_MEM_EXECUTE) {
+					bits |= PAGE_BIT_EXECUTE;
+				}
+
+				const uint64_t firstPage = pCurSection->VirtualAddress / IMAGE_PAGE_SIZE;
+				uint64_t endPage = alignToPage(pCurSection->VirtualAddress + size) / IMAGE_PAGE_SIZE;
+
+				if (endPage > pageCount) {
+					endPage = pageCount;
+				}
+
+				// sections with an alignment smaller than a page can share pages
+				for (uint64_t page = firstPage; page < endPage; page++) {
+					pPageBits[page] |= bits;
+				}
+
+			}
+
+			size_t runCount = 0u;
+
+			for (size_t i = 0u; i < pageCount; i++) {
+
+				if (!i || pPageBits[i] != pPageBits[i - 1u]) {
+					runCount++;
+				}
+
+			}
+
+			this->_pProtections = new ImageProtection[runCount]{};
+
+			for (size_t i = 0u; i < pageCount; i++) {
+
+				if (!i || pPageBits[i] != pPageBits[i - 1u]) {
+					ImageProtection* const pNewProtection = &this->_pProtections[this->_protectionCount];
+					pNewProtection->rva = static_cast<uint32_t>(i * IMAGE_PAGE_SIZE);
+					pNewProtection->protect = PAGE_PROTECTIONS[pPageBits[i]];
+					this->_protectionCount++;
+				}
+
+				this->_pProtections[this->_protectionCount - 1u].size += IMAGE_PAGE_SIZE;
+			}
+
+			delete[] pPageBits;
+
+			return;
+		}
+
+
+		uint8_t* PeImage::getOptionalHeader() const {
+			const pe::DosHeader* const pDosHeader = reinterpret_cast<const pe::DosHeader*>(this->_pImage);
+
+			return this->_pImage + pDosHeader->e_lfanew + sizeof(uint32_t) + sizeof(pe::FileHeader);
+		}
+
+
+		uint64_t alignToPage(uint64_t value) {
+
+			return (value + IMAGE_PAGE_SIZE - 1u) & ~static_cast<uint64_t>(IMAGE_PAGE_SIZE - 1u);
+		}
+
+	}
+
+}
\ No newline at end of file
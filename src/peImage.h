@@ -0,0 +1,281 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Class to prepare a DLL image for manual mapping in a local buffer: the sections are laid out, the base relocations are applied and the protections of the pages are determined.
+// The class does not call any API functions and does not depend on windows headers, so it works on any platform. The PE structures it needs are defined below.
+// The ManualMapper class uses it to prepare the image before resolving the imports and committing the image to the target.
+
+namespace hax {
+
+	namespace launch {
+
+		// Subset of the PE structures and constants of winnt.h with the same layout.
+		namespace pe {
+
+			constexpr uint16_t DOS_SIGNATURE = 0x5A4Du;
+			constexpr uint32_t NT_SIGNATURE = 0x00004550u;
+			constexpr uint16_t FILE_DLL = 0x2000u;
+			constexpr uint16_t MACHINE_I386 = 0x014Cu;
+			constexpr uint16_t MACHINE_AMD64 = 0x8664u;
+			constexpr uint16_t OPTIONAL_HDR32_MAGIC = 0x10Bu;
+			constexpr uint16_t OPTIONAL_HDR64_MAGIC = 0x20Bu;
+			constexpr uint32_t SCN_MEM_EXECUTE = 0x20000000u;
+			constexpr uint32_t SCN_MEM_READ = 0x40000000u;
+			constexpr uint32_t SCN_MEM_WRITE = 0x80000000u;
+			constexpr uint16_t REL_BASED_ABSOLUTE = 0u;
+			constexpr uint16_t REL_BASED_HIGHLOW = 3u;
+			constexpr uint16_t REL_BASED_DIR64 = 10u;
+			constexpr uint32_t DIRECTORY_ENTRY_BASERELOC = 5u;
+			constexpr uint32_t NUMBEROF_DIRECTORY_ENTRIES = 16u;
+
+			typedef struct DosHeader {
+				uint16_t e_magic;
+				uint16_t unused[29];
+				// file offset of the NT headers
+				int32_t e_lfanew;
+			}DosHeader;
+
+			typedef struct FileHeader {
+				uint16_t Machine;
+				uint16_t NumberOfSections;
+				uint32_t TimeDateStamp;
+				uint32_t PointerToSymbolTable;
+				uint32_t NumberOfSymbols;
+				uint16_t SizeOfOptionalHeader;
+				uint16_t Characteristics;
+			}FileHeader;
+
+			typedef struct DirectoryEntry {
+				uint32_t VirtualAddress;
+				uint32_t Size;
+			}DirectoryEntry;
+
+			typedef struct OptionalHeader32 {
+				uint16_t Magic;
+				uint8_t MajorLinkerVersion;
+				uint8_t MinorLinkerVersion;
+				uint32_t SizeOfCode;
+				uint32_t SizeOfInitializedData;
+				uint32_t SizeOfUninitializedData;
+				uint32_t AddressOfEntryPoint;
+				uint32_t BaseOfCode;
+				uint32_t BaseOfData;
+				uint32_t ImageBase;
+				uint32_t SectionAlignment;
+				uint32_t FileAlignment;
+				uint16_t MajorOperatingSystemVersion;
+				uint16_t MinorOperatingSystemVersion;
+				uint16_t MajorImageVersion;
+				uint16_t MinorImageVersion;
+				uint16_t MajorSubsystemVersion;
+				uint16_t MinorSubsystemVersion;
+				uint32_t Win32VersionValue;
+				uint32_t SizeOfImage;
+				uint32_t SizeOfHeaders;
+				uint32_t CheckSum;
+				uint16_t Subsystem;
+				uint16_t DllCharacteristics;
+				uint32_t SizeOfStackReserve;
+				uint32_t SizeOfStackCommit;
+				uint32_t SizeOfHeapReserve;
+				uint32_t SizeOfHeapCommit;
+				uint32_t LoaderFlags;
+				uint32_t NumberOfRvaAndSizes;
+				DirectoryEntry DataDirectory[NUMBEROF_DIRECTORY_ENTRIES];
+			}OptionalHeader32;
+
+			typedef struct OptionalHeader64 {
+				uint16_t Magic;
+				uint8_t MajorLinkerVersion;
+				uint8_t MinorLinkerVersion;
+				uint32_t SizeOfCode;
+				uint32_t SizeOfInitializedData;
+				uint32_t SizeOfUninitializedData;
+				uint32_t AddressOfEntryPoint;
+				uint32_t BaseOfCode;
+				uint64_t ImageBase;
+				uint32_t SectionAlignment;
+				uint32_t FileAlignment;
+				uint16_t MajorOperatingSystemVersion;
+				uint16_t MinorOperatingSystemVersion;
+				uint16_t MajorImageVersion;
+				uint16_t MinorImageVersion;
+				uint16_t MajorSubsystemVersion;
+				uint16_t MinorSubsystemVersion;
+				uint32_t Win32VersionValue;
+				uint32_t SizeOfImage;
+				uint32_t SizeOfHeaders;
+				uint32_t CheckSum;
+				uint16_t Subsystem;
+				uint16_t DllCharacteristics;
+				uint64_t SizeOfStackReserve;
+				uint64_t SizeOfStackCommit;
+				uint64_t SizeOfHeapReserve;
+				uint64_t SizeOfHeapCommit;
+				uint32_t LoaderFlags;
+				uint32_t NumberOfRvaAndSizes;
+				DirectoryEntry DataDirectory[NUMBEROF_DIRECTORY_ENTRIES];
+			}OptionalHeader64;
+
+			typedef struct SectionHeader {
+				uint8_t Name[8];
+				// Misc.VirtualSize of IMAGE_SECTION_HEADER
+				uint32_t VirtualSize;
+				uint32_t VirtualAddress;
+				uint32_t SizeOfRawData;
+				uint32_t PointerToRawData;
+				uint32_t PointerToRelocations;
+				uint32_t PointerToLinenumbers;
+				uint16_t NumberOfRelocations;
+				uint16_t NumberOfLinenumbers;
+				uint32_t Characteristics;
+			}SectionHeader;
+
+			typedef struct BaseRelocation {
+				uint32_t VirtualAddress;
+				uint32_t SizeOfBlock;
+			}BaseRelocation;
+
+		}
+
+		// page size of x86 and x64 windows, not queried so the local image preparation does not depend on the system
+		constexpr uint32_t IMAGE_PAGE_SIZE = 0x1000u;
+
+		// values of the PAGE_* protection constants of the windows api stored in ImageProtection::protect
+		constexpr uint32_t IMAGE_PROTECT_NOACCESS = 0x01u;
+		constexpr uint32_t IMAGE_PROTECT_READONLY = 0x02u;
+		constexpr uint32_t IMAGE_PROTECT_READWRITE = 0x04u;
+		constexpr uint32_t IMAGE_PROTECT_EXECUTE = 0x10u;
+		constexpr uint32_t IMAGE_PROTECT_EXECUTE_READ = 0x20u;
+		constexpr uint32_t IMAGE_PROTECT_EXECUTE_READWRITE = 0x40u;
+
+		// Protection of a range of pages of a mapped image.
+		typedef struct ImageProtection {
+			// page aligned offset of the range from the image base
+			uint32_t rva;
+			uint32_t size;
+			uint32_t protect;
+		}ImageProtection;
+
+		class PeImage {
+		private:
+			// local buffer of the image followed by the extra bytes requested by layout()
+			uint8_t* _pImage;
+			size_t _size;
+			uint32_t _imageSize;
+			uint64_t _preferredBase;
+			ImageProtection* _pProtections;
+			size_t _protectionCount;
+			bool _is64Bit;
+
+		public:
+			PeImage();
+
+			// Frees the local buffers.
+			~PeImage();
+
+			// owns the image and protection buffers, so copies would free them twice
+			PeImage(const PeImage&) = delete;
+			PeImage& operator=(const PeImage&) = delete;
+
+			// Copies the headers and sections of a DLL file to their virtual offsets within a local buffer and determines the protections of the pages.
+			//
+			// Parameters:
+			//
+			// [in] pFile:
+			// Pointer to the raw bytes of the DLL file.
+			//
+			// [in] fileSize:
+			// Size of the DLL file in bytes.
+			//
+			// [in] extraSize:
+			// Number of zeroed bytes allocated after the page aligned image within the local buffer (eg. for loader shell code).
+			//
+			// Return:
+			// True on success or false on failure or if the file is not a valid x86 or x64 DLL.
+			bool layout(const uint8_t* pFile, size_t fileSize, size_t extraSize = 0u);
+
+			// Applies the base relocations of the laid out image for a base address.
+			// The image can be relocated multiple times.
+			//
+			// Parameters:
+			//
+			// [in] base:
+			// Base address the image is relocated to.
+			//
+			// Return:
+			// True on success or false on failure or if the image can not be relocated to the base address.
+			bool relocate(uint64_t base);
+
+			// Frees the local buffers.
+			void reset();
+
+			// Gets the local buffer of the image.
+			//
+			// Return:
+			// Pointer to the local buffer or nullptr if no image is laid out.
+			uint8_t* getImage() const;
+
+			// Gets the size of the local buffer: the page aligned image size plus the extra bytes passed to layout().
+			size_t getSize() const;
+			uint32_t getImageSize() const;
+			uint64_t getPreferredBase() const;
+			uint32_t getEntryRva() const;
+
+			// Gets the protections of the laid out image. Adjacent pages with equal protection are combined to one range.
+			//
+			// Return:
+			// Pointer to an array of getProtectionCount() protections ordered by their offset.
+			const ImageProtection* getProtections() const;
+			size_t getProtectionCount() const;
+
+			bool is64Bit() const;
+
+			// Gets a data directory of the laid out image.
+			//
+			// Parameters:
+			//
+			// [in] index:
+			// Index of the data directory (eg. IMAGE_DIRECTORY_ENTRY_IMPORT).
+			//
+			// Return:
+			// Pointer to the data directory within the local buffer or nullptr if the image has no data directory at the index.
+			const pe::DirectoryEntry* getDataDirectory(uint32_t index) const;
+
+			// Gets the address of a range within the local buffer.
+			//
+			// Parameters:
+			//
+			// [in] rva:
+			// Offset of the range from the image base.
+			//
+			// [in] size:
+			// Size of the range in bytes.
+			//
+			// Return:
+			// Pointer to the range within the local buffer or nullptr if the range exceeds the image.
+			uint8_t* getRvaAddress(uint64_t rva, size_t size) const;
+
+			// Gets a null terminated string within the local buffer.
+			//
+			// Parameters:
+			//
+			// [in] rva:
+			// Offset of the string from the image base.
+			//
+			// Return:
+			// Pointer to the string within the local buffer or nullptr if it is not terminated within the image.
+			const char* getRvaString(uint64_t rva) const;
+
+		private:
+			void buildProtections(const pe::SectionHeader* pSectionHeaders, uint16_t sectionCount);
+			uint8_t* getOptionalHeader() const;
+		};
+
+		// Aligns a value up to IMAGE_PAGE_SIZE.
+		uint64_t alignToPage(uint64_t value);
+
+	}
+
+}
\ No newline at end of file
@@ -94,10 +94,14 @@ namespace hax {
 				if (static_cast<DWORD>(reinterpret_cast<uintptr_t>(pCurSysProcInfo->UniqueProcessId)) == processId) {
 
 					for (ULONG i = 0; i < pCurSysProcInfo->NumberOfThreads && i < size; i++) {
-						pThreadEntries[i].ownerProcessId = static_cast<DWORD>(reinterpret_cast<uintptr_t>(pCurSysProcInfo->Threads[i].ClientId.UniqueThread));
-						pThreadEntries[i].threadId = static_cast<DWORD>(reinterpret_cast<uintptr_t>(pCurSysProcInfo->Threads[i].ClientId.UniqueThread));
-						pThreadEntries[i].threadState = pCurSysProcInfo->Threads[i].ThreadState;
-						pThreadEntries[i].waitReason = pCurSysProcInfo->Threads[i].WaitReason;
+						const SYSTEM_THREAD_INFORMATION* const pThreadInfo = &pCurSysProcInfo->Threads[i];
+						pThreadEntries[i].ownerProcessId = static_cast<DWORD>(reinterpret_cast<uintptr_t>(pThreadInfo->ClientId.UniqueProcess));
+						pThreadEntries[i].threadId = static_cast<DWORD>(reinterpret_cast<uintptr_t>(pThreadInfo->ClientId.UniqueThread));
+						pThreadEntries[i].threadState = pThreadInfo->ThreadState;
+						pThreadEntries[i].waitReason = pThreadInfo->WaitReason;
+						pThreadEntries[i].priority = pThreadInfo->Priority;
+						pThreadEntries[i].cpuTime = static_cast<ULONGLONG>(pThreadInfo->KernelTime.QuadPart) + static_cast<ULONGLONG>(pThreadInfo->UserTime.QuadPart);
+						pThreadEntries[i].contextSwitches = pThreadInfo->ContextSwitches;
 					}
 
 					found = true;
@@ -114,6 +118,8 @@ namespace hax {
 		}
 
 
+		static int compareOwnerProcessId(const void* pLeft, const void* pRight);
+
 		HANDLE getDuplicateProcessHandle(DWORD desiredAccess, BOOL inheritable, DWORD processId) {
 			const DWORD curProcessId = GetCurrentProcessId();
 
@@ -123,57 +129,125 @@ namespace hax {
 
 			if (!hCallerProc) return nullptr;
 
-			const SYSTEM_HANDLE_INFORMATION* const pSysHandleInfoBuffer = getSystemInformation<SYSTEM_HANDLE_INFORMATION>(SystemHandleInformation);
+			// a handle with minimal access rights is opened to look up the object type index and the kernel object address of the target process in the handle table
+			// opening with these access rights usually succeeds even if opening with the desired access rights does not
+			const HANDLE hQueryProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+
+			// the extended handle information holds full sized process IDs and handle values unlike SystemHandleInformation, which truncates them to a USHORT
+			const SYSTEM_HANDLE_INFORMATION_EX* const pSysHandleInfoBuffer = getSystemInformation<SYSTEM_HANDLE_INFORMATION_EX>(SystemExtendedHandleInformation);
 
 			if (!pSysHandleInfoBuffer) {
-				CloseHandle(hCallerProc);
+
+				if (hQueryProc) {
+					CloseHandle(hQueryProc);
+				}
 
 				return nullptr;
 			}
 
-			HANDLE hProc = nullptr;
+			const ULONG_PTR handleCount = pSysHandleInfoBuffer->NumberOfHandles;
+			const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* const pHandles = pSysHandleInfoBuffer->Handles;
 
-			for (ULONG i = 0; i < pSysHandleInfoBuffer->NumberOfHandles; i++) {
-				const SYSTEM_HANDLE_TABLE_ENTRY_INFO curHandleInfo = pSysHandleInfoBuffer->Handles[i];
+			// fallback values if the target process could not be opened
+			constexpr USHORT PROCESS_TYPE = 7;
+			USHORT processTypeIndex = PROCESS_TYPE;
+			const void* pTargetObject = nullptr;
 
-				constexpr UCHAR PROCESS_TYPE = 7;
-				
-				if (curHandleInfo.ObjectTypeIndex != PROCESS_TYPE) continue;
+			if (hQueryProc) {
+
+				for (ULONG_PTR i = 0; i < handleCount; i++) {
+					
+					if (pHandles[i].UniqueProcessId == curProcessId && pHandles[i].HandleValue == reinterpret_cast<ULONG_PTR>(hQueryProc)) {
+						processTypeIndex = pHandles[i].ObjectTypeIndex;
+						// null if the caller lacks the privileges to see kernel addresses
+						pTargetObject = pHandles[i].Object;
+
+						break;
+					}
 
-				// pointless if caller process is owner process
-				if (curHandleInfo.UniqueProcessId == curProcessId) continue;
+				}
 
-				// pointless if target process is owner process
-				if (curHandleInfo.UniqueProcessId == processId) continue;
+				CloseHandle(hQueryProc);
+			}
 
-				if ((curHandleInfo.GrantedAccess & desiredAccess) != desiredAccess) continue;
+			const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX** const ppCandidates = new const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX*[handleCount];
+			size_t candidateCount = 0u;
+
+			// first pass only filters the entries without any system calls
+			// written without branches so the compiler can vectorize it
+			for (ULONG_PTR i = 0; i < handleCount; i++) {
+				const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* const pCurHandleInfo = &pHandles[i];
+
+				const bool isCandidate =
+					pCurHandleInfo->ObjectTypeIndex == processTypeIndex &
+					(pCurHandleInfo->GrantedAccess & desiredAccess) == desiredAccess &
+					// pointless if caller process is owner process
+					pCurHandleInfo->UniqueProcessId != curProcessId &
+					// pointless if target process is owner process
+					pCurHandleInfo->UniqueProcessId != processId &
+					// if the object address is known, only handles to the target process remain
+					(!pTargetObject | pCurHandleInfo->Object == pTargetObject);
+
+				ppCandidates[candidateCount] = pCurHandleInfo;
+				candidateCount += isCandidate;
+			}
 
-				const HANDLE hOwnerProc = OpenProcess(PROCESS_DUP_HANDLE, FALSE, curHandleInfo.UniqueProcessId);
+			// group the candidates by owner so every owner process only has to be opened once
+			qsort(ppCandidates, candidateCount, sizeof(*ppCandidates), compareOwnerProcessId);
 
-				if (!hOwnerProc) continue;
+			HANDLE hProc = nullptr;
+			size_t groupStart = 0u;
 
-				if (!DuplicateHandle(hOwnerProc, reinterpret_cast<HANDLE>(curHandleInfo.HandleValue), hCallerProc, &hProc, 0, inheritable, DUPLICATE_SAME_ACCESS)) {
-					CloseHandle(hOwnerProc);
+			while (!hProc && groupStart < candidateCount) {
+				const ULONG_PTR ownerProcessId = ppCandidates[groupStart]->UniqueProcessId;
+				size_t groupEnd = groupStart + 1u;
 
-					continue;
+				while (groupEnd < candidateCount && ppCandidates[groupEnd]->UniqueProcessId == ownerProcessId) {
+					groupEnd++;
 				}
 
-				CloseHandle(hOwnerProc);
+				const HANDLE hOwnerProc = OpenProcess(PROCESS_DUP_HANDLE, FALSE, static_cast<DWORD>(ownerProcessId));
+
+				if (hOwnerProc) {
 
-				if (!hProc) continue;
+					for (size_t i = groupStart; i < groupEnd; i++) {
 
-				if (GetProcessId(hProc) == processId) break;
+						if (!DuplicateHandle(hOwnerProc, reinterpret_cast<HANDLE>(ppCandidates[i]->HandleValue), hCallerProc, &hProc, 0, inheritable, DUPLICATE_SAME_ACCESS)) {
+							hProc = nullptr;
+
+							continue;
+						}
 
-				CloseHandle(hProc);
-				hProc = nullptr;
+						if (!hProc) continue;
+
+						// the object address already identifies the target process
+						if (pTargetObject || GetProcessId(hProc) == processId) break;
+
+						CloseHandle(hProc);
+						hProc = nullptr;
+					}
+
+					CloseHandle(hOwnerProc);
+				}
+
+				groupStart = groupEnd;
 			}
 
+			delete[] ppCandidates;
 			delete[] pSysHandleInfoBuffer;
 
 			return hProc;
 		}
 
 
+		static int compareOwnerProcessId(const void* pLeft, const void* pRight) {
+			const ULONG_PTR left = (*reinterpret_cast<const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* const*>(pLeft))->UniqueProcessId;
+			const ULONG_PTR right = (*reinterpret_cast<const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* const*>(pRight))->UniqueProcessId;
+
+			return (left > right) - (left < right);
+		}
+
+
 		// use with care!
 		// ITYPE and infoClass parameters have to correspond (e.g. SYSTEM_PROCESS_INFORMATION <-> SystemProcessInformation)
 		// return value points to an array on the heap
@@ -194,10 +268,21 @@ namespace hax {
 
 			if (!(ntStatus == STATUS_INFO_LENGTH_MISMATCH || ntStatus == STATUS_SUCCESS)) return nullptr;
 
+			ITYPE* pSysInfoBuffer = nullptr;
+
 			// always allocate dynamic buffer because ntStatus should always be STATUS_INFO_LENGTH_MISMATCH
-			ITYPE* const pSysInfoBuffer = reinterpret_cast<ITYPE*>(new BYTE[outSize]);
+			// the information (especially the handle table) can grow in between the calls, so some slack is added and the query is retried a few times
+			for (int i = 0; i < 4; i++) {
+				delete[] pSysInfoBuffer;
 
-			ntStatus = pNtQuerySystemInformation(infoClass, pSysInfoBuffer, outSize, &outSize);
+				const ULONG bufferSize = outSize + outSize / 8ul;
+				pSysInfoBuffer = reinterpret_cast<ITYPE*>(new BYTE[bufferSize]);
+
+				ntStatus = pNtQuerySystemInformation(infoClass, pSysInfoBuffer, bufferSize, &outSize);
+
+				if (ntStatus != STATUS_INFO_LENGTH_MISMATCH) break;
+
+			}
 
 			if (ntStatus != STATUS_SUCCESS) {
 				delete[] pSysInfoBuffer;
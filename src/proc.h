@@ -1,5 +1,6 @@
 #pragma once
 #include "undocWinTypes.h"
+#include "threadRank.h"
 
 // Functions to retrieve information about of a windows process.
 // Some functions are implemented to emulate functions of the Win32 API and delcared as similarly as possible.
@@ -17,13 +18,6 @@ namespace hax {
 			char exeFile[MAX_PATH];
 		}ProcessEntry;
 
-		typedef struct ThreadEntry {
-			DWORD threadId;
-			DWORD ownerProcessId;
-			THREAD_STATE threadState;
-			KWAIT_REASON waitReason;
-		}ThreadEntry;
-
 		typedef struct PeHeaders {
 			const IMAGE_DOS_HEADER* pDosHeader;
 			const IMAGE_NT_HEADERS* pNtHeaders;
@@ -95,6 +89,8 @@ namespace hax {
 		// The caller process should use the handle as if it had opened the handle itself (including closing it).
 		// Duplication will not grant additional access rights.
 		// Running as admin increases success chance significantly.
+		// Every process owning a candidate handle is opened at most once. If the target process can be opened with PROCESS_QUERY_LIMITED_INFORMATION access rights
+		// and the kernel object addresses are visible to the caller, candidates are matched by object address without duplicating non-matching handles.
 		//
 		// Parameters:
 		// 
@@ -0,0 +1,81 @@
+#include "regionSearch.h"
+
+namespace hax {
+
+	namespace mem {
+
+		// slightly less than the reach of a relative jump, so a block is reachable from anywhere within the allocation granularity around the address
+		constexpr uintptr_t NEAR_REACH = 0x7FFF0000u;
+
+		uint8_t* findNearFreeAddress(const Region regions[], size_t count, const uint8_t* address, size_t size, size_t granularity, const uint8_t* minAddress, const uint8_t* maxAddress) {
+
+			if (!size || !granularity) return nullptr;
+
+			const uintptr_t start = reinterpret_cast<uintptr_t>(address);
+			// checks int underflow and overflow
+			const uintptr_t reachMin = start > NEAR_REACH ? start - NEAR_REACH : 0u;
+			const uintptr_t reachMax = UINTPTR_MAX - start > NEAR_REACH ? start + NEAR_REACH : UINTPTR_MAX;
+			const uintptr_t rangeMin = reachMin > reinterpret_cast<uintptr_t>(minAddress) ? reachMin : reinterpret_cast<uintptr_t>(minAddress);
+			const uintptr_t rangeMax = reachMax < reinterpret_cast<uintptr_t>(maxAddress) ? reachMax : reinterpret_cast<uintptr_t>(maxAddress);
+
+			if (rangeMax <= rangeMin) return nullptr;
+
+			size_t low = 0u;
+			size_t high = count;
+
+			// binary search for the first region that ends after the beginning of the range
+			while (low < high) {
+				const size_t mid = low + (high - low) / 2u;
+
+				if (reinterpret_cast<uintptr_t>(regions[mid].base) + regions[mid].size <= rangeMin) {
+					low = mid + 1u;
+				}
+				else {
+					high = mid;
+				}
+
+			}
+
+			uintptr_t nearAddress = 0u;
+			uintptr_t nearDistance = UINTPTR_MAX;
+
+			for (size_t i = low; i < count; i++) {
+				const Region* const pCur = &regions[i];
+				const uintptr_t regionStart = reinterpret_cast<uintptr_t>(pCur->base);
+
+				// regions are ordered, so all further regions are out of range or farther away than the nearest candidate
+				if (regionStart >= rangeMax || (nearAddress && regionStart > start && regionStart - start >= nearDistance)) break;
+
+				if (pCur->state != REGION_STATE_FREE) continue;
+
+				// clamp the free region to the reachable range
+				const uintptr_t regionEnd = regionStart + pCur->size;
+				const uintptr_t freeLow = regionStart > rangeMin ? regionStart : rangeMin;
+				const uintptr_t freeHigh = regionEnd < rangeMax ? regionEnd : rangeMax;
+
+				if (freeHigh <= freeLow || freeHigh - freeLow < size) continue;
+
+				// highest aligned address at or below the start and lowest aligned address at or above the start the block fits at within the region
+				const uintptr_t lowTop = start < freeHigh - size ? start : freeHigh - size;
+				const uintptr_t below = lowTop - lowTop % granularity;
+				const uintptr_t highBottom = start > freeLow ? start : freeLow;
+				const uintptr_t above = highBottom + (granularity - highBottom % granularity) % granularity;
+
+				if (below >= freeLow && below && start - below < nearDistance) {
+					nearAddress = below;
+					nearDistance = start - below;
+				}
+
+				if (above >= highBottom && above <= freeHigh - size && above - start < nearDistance) {
+					nearAddress = above;
+					nearDistance = above - start;
+				}
+
+			}
+
+			return reinterpret_cast<uint8_t*>(nearAddress);
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Memory region type of the RegionMap class and the search for free addresses near a given address within a list of regions.
+// The search does not call any API functions and does not depend on windows headers, so it works on arbitrary region lists on any platform.
+
+namespace hax {
+
+	namespace mem {
+
+		// MEM_FREE state of the windows api
+		constexpr unsigned long REGION_STATE_FREE = 0x10000ul;
+
+		// Alike MEMORY_BASIC_INFORMATION without the unused or unnecessary fields plus the owning module.
+		typedef struct Region {
+			uint8_t* base;
+			size_t size;
+			// MEM_* state, PAGE_* protection and MEM_* type as DWORD values
+			unsigned long state;
+			unsigned long protect;
+			unsigned long type;
+			// base address (HMODULE) of the module for image backed regions, nullptr for all other regions
+			void* hModule;
+		}Region;
+
+		// Finds the free address closest to a given address at which a block can be allocated and is reachable by a relative jump (op code: E9) from the given address.
+		//
+		// Parameters:
+		//
+		// [in] regions:
+		// Regions ordered by base address without overlaps, eg. the regions of a RegionMap snapshot. Only regions with REGION_STATE_FREE state are considered.
+		//
+		// [in] count:
+		// Number of regions.
+		//
+		// [in] address:
+		// The address from which the whole block should be reachable by a relative jump.
+		//
+		// [in] size:
+		// Size of the block in bytes.
+		//
+		// [in] granularity:
+		// Alignment of the returned address. Has to be the allocation granularity of the system for the address to be passed to VirtualAlloc(Ex).
+		//
+		// [in] minAddress:
+		// Lowest address that can be allocated (lpMinimumApplicationAddress).
+		//
+		// [in] maxAddress:
+		// Highest address that can be allocated (lpMaximumApplicationAddress).
+		//
+		// Return:
+		// Aligned address within a free region the whole block fits into or nullptr if there is none within reach.
+		uint8_t* findNearFreeAddress(const Region regions[], size_t count, const uint8_t* address, size_t size, size_t granularity, const uint8_t* minAddress, const uint8_t* maxAddress);
+
+	}
+
+}
\ No newline at end of file
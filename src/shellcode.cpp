@@ -0,0 +1,61 @@
+#include "shellcode.h"
+#include "mem.h"
+
+namespace hax {
+
+	namespace shellcode {
+
+		Slot findSlot(const BYTE shell[], size_t shellSize, const char* pattern) {
+
+			if (!shell || !pattern) return Slot{ INVALID_OFFSET, 0u };
+
+			const BYTE* const pPlaceholder = mem::in::findSigAddress(shell, shellSize, pattern);
+
+			if (!pPlaceholder) return Slot{ INVALID_OFFSET, 0u };
+
+			// size of byte string pattern of format "DE AD"
+			return Slot{ static_cast<size_t>(pPlaceholder - shell), (strlen(pattern) + 1u) / 3u };
+		}
+
+
+		BYTE* createStub(const BYTE shell[], size_t shellSize, size_t dataOffset, size_t dataSize, const AbsSlot<uint32_t> relocations[], size_t relocationCount) {
+
+			if (!shell || shellSize > dataOffset || (relocationCount && !relocations)) return nullptr;
+
+			BYTE* const stub = static_cast<BYTE*>(VirtualAlloc(nullptr, dataOffset + dataSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+			if (!stub) return nullptr;
+
+			memcpy(stub, shell, shellSize);
+
+			for (size_t i = 0u; i < relocationCount; i++) {
+				// only x86 stubs are relocated, their addresses fit 32 bits
+				relocations[i].relocate(stub, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(stub)));
+			}
+
+			DWORD protect = 0ul;
+
+			if (!VirtualProtect(stub, dataOffset, PAGE_EXECUTE_READ, &protect)) {
+				VirtualFree(stub, 0, MEM_RELEASE);
+
+				return nullptr;
+			}
+
+			FlushInstructionCache(GetCurrentProcess(), stub, shellSize);
+
+			return stub;
+		}
+
+
+		void freeStub(BYTE* stub) {
+
+			if (stub) {
+				VirtualFree(stub, 0, MEM_RELEASE);
+			}
+
+			return;
+		}
+
+	}
+
+}
\ No newline at end of file
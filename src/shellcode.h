@@ -0,0 +1,238 @@
+#pragma once
+#include <Windows.h>
+#include <stdint.h>
+#include <string.h>
+
+// Templates for shell code with placeholders that are patched at run time.
+// A template is a constexpr byte array accompanied by named slots that hold the offset and the type of each placeholder.
+// The slots are checked against the size of the array at compile time, so patching a copy of the array is a direct store instead of a signature scan.
+// Example:
+//
+// static constexpr BYTE SHELL[]{ 0xB8, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xE0 };	mov eax, pGateway; jmp eax
+// static constexpr shellcode::AbsSlot<uint32_t> SHELL_GATEWAY{ 0x01u };
+// static_assert(shellcode::fits(SHELL, SHELL_GATEWAY), "Slot out of shell code.");
+//
+// BYTE localShell[sizeof(SHELL)]{};
+// memcpy(localShell, SHELL, sizeof(SHELL));
+// SHELL_GATEWAY.patch(localShell, gateway);
+
+namespace hax {
+
+	namespace shellcode {
+
+		// offset of a slot that was not found within the shell code
+		constexpr size_t INVALID_OFFSET = SIZE_MAX;
+
+		// Position of a placeholder within shell code independent of its type.
+		// Taken by functions that patch shell code of either architecture, typed slots convert to it implicitly.
+		typedef struct Slot {
+			size_t offset;
+			size_t size;
+		}Slot;
+
+		// Slot of a placeholder for an absolute value of type T, eg. an immediate operand or a pointer.
+		template <typename T>
+		class AbsSlot {
+		public:
+			const size_t offset;
+
+			constexpr AbsSlot(size_t offset) : offset{ offset } {}
+
+			constexpr operator Slot() const {
+
+				return Slot{ this->offset, sizeof(T) };
+			}
+
+			// Writes a value to the placeholder within a copy of the shell code.
+			//
+			// Parameters:
+			//
+			// [out] shell:
+			// Copy of the shell code the slot belongs to.
+			//
+			// [in] value:
+			// Value that replaces the placeholder.
+			void patch(BYTE shell[], T value) const {
+				memcpy(shell + this->offset, &value, sizeof(T));
+
+				return;
+			}
+
+			// Adds a base address to the offset held by the placeholder within a copy of the shell code, eg. for x86 shell code that addresses its data absolutely.
+			//
+			// Parameters:
+			//
+			// [out] shell:
+			// Copy of the shell code the slot belongs to.
+			//
+			// [in] base:
+			// Value added to the placeholder.
+			void relocate(BYTE shell[], T base) const {
+				T value{};
+				memcpy(&value, shell + this->offset, sizeof(T));
+				this->patch(shell, static_cast<T>(value + base));
+
+				return;
+			}
+		};
+
+		// Slot of a placeholder for a 32 bit displacement relative to the end of its instruction, eg. the operand of a relative call or jump.
+		class RelSlot {
+		public:
+			const size_t offset;
+			// offset of the instruction following the one the displacement belongs to
+			const size_t next;
+
+			// The displacement is the last operand of its instruction.
+			constexpr RelSlot(size_t offset) : offset{ offset }, next{ offset + sizeof(int32_t) } {}
+
+			constexpr RelSlot(size_t offset, size_t next) : offset{ offset }, next{ next } {}
+
+			constexpr operator Slot() const {
+
+				return Slot{ this->offset, sizeof(int32_t) };
+			}
+
+			// Writes the displacement to a target address to the placeholder within a copy of the shell code.
+			//
+			// Parameters:
+			//
+			// [out] shell:
+			// Copy of the shell code the slot belongs to.
+			//
+			// [in] shellAddress:
+			// Address the shell code is executed at.
+			//
+			// [in] target:
+			// Address the instruction should reference.
+			//
+			// Return:
+			// True on success, false if the target is not reachable by a 32 bit displacement from the shell code.
+			bool patch(BYTE shell[], uintptr_t shellAddress, uintptr_t target) const {
+				// wraps around for x86 compilations, where every address is reachable
+				const intptr_t displacement = static_cast<intptr_t>(target - (shellAddress + this->next));
+
+				if (displacement < INT32_MIN || displacement > INT32_MAX) return false;
+
+				const int32_t value = static_cast<int32_t>(displacement);
+				memcpy(shell + this->offset, &value, sizeof(value));
+
+				return true;
+			}
+		};
+
+		// Checks at compile time if an absolute slot lies within a shell code template.
+		//
+		// Parameters:
+		//
+		// [in] shell:
+		// The shell code template.
+		//
+		// [in] slot:
+		// Slot of a placeholder within the template.
+		//
+		// Return:
+		// True if the placeholder lies within the template, false if it does not.
+		template <size_t Size, typename T>
+		constexpr bool fits(const BYTE(&shell)[Size], AbsSlot<T> slot) {
+
+			return sizeof(shell) >= sizeof(T) && slot.offset <= sizeof(shell) - sizeof(T);
+		}
+
+		// Checks at compile time if all absolute slots of an array lie within a shell code template.
+		//
+		// Parameters:
+		//
+		// [in] shell:
+		// The shell code template.
+		//
+		// [in] slots:
+		// Slots of placeholders within the template.
+		//
+		// Return:
+		// True if all placeholders lie within the template, false if any does not.
+		template <size_t Size, typename T, size_t Count>
+		constexpr bool fits(const BYTE(&shell)[Size], const AbsSlot<T>(&slots)[Count]) {
+
+			for (size_t i = 0u; i < Count; i++) {
+
+				if (!fits(shell, slots[i])) return false;
+
+			}
+
+			return true;
+		}
+
+		// Checks at compile time if a relative slot lies within a shell code template.
+		//
+		// Parameters:
+		//
+		// [in] shell:
+		// The shell code template.
+		//
+		// [in] slot:
+		// Slot of a placeholder within the template.
+		//
+		// Return:
+		// True if the placeholder and the end of its instruction lie within the template, false if they do not.
+		template <size_t Size>
+		constexpr bool fits(const BYTE(&shell)[Size], RelSlot slot) {
+
+			return slot.offset + sizeof(int32_t) <= slot.next && slot.next <= sizeof(shell);
+		}
+
+		// Finds the slot of a placeholder within shell code that is not a template by a pattern.
+		//
+		// Parameters:
+		//
+		// [in] shell:
+		// Address of the shell code.
+		//
+		// [in] shellSize:
+		// Size of the shell code in bytes.
+		//
+		// [in] pattern:
+		// Pattern of the placeholder of the format "EF BE DA DE". "??" can be used as wildcards. Mind the endianness!
+		//
+		// Return:
+		// The slot of the first match of the pattern with the size of the pattern. The offset is INVALID_OFFSET if the pattern was not found.
+		Slot findSlot(const BYTE shell[], size_t shellSize, const char* pattern);
+
+		// Allocates a stub within the caller process for shell code that keeps its data on a page of its own behind the code.
+		// The shell code is copied to the beginning of the stub and the code pages are protected PAGE_EXECUTE_READ while the data stays PAGE_READWRITE and zeroed.
+		//
+		// Parameters:
+		//
+		// [in] shell:
+		// The shell code template.
+		//
+		// [in] shellSize:
+		// Size of the shell code template in bytes.
+		//
+		// [in] dataOffset:
+		// Page aligned offset of the data from the beginning of the stub. Has to be at least shellSize.
+		//
+		// [in] dataSize:
+		// Size of the data in bytes.
+		//
+		// [in] relocations:
+		// Slots of x86 placeholders that hold an offset from the beginning of the stub and are rebased to the address of the stub. Pass nullptr for position independent shell code.
+		//
+		// [in] relocationCount:
+		// Number of relocation slots.
+		//
+		// Return:
+		// Address of the stub on success or nullptr on failure. Has to be freed by freeStub().
+		BYTE* createStub(const BYTE shell[], size_t shellSize, size_t dataOffset, size_t dataSize, const AbsSlot<uint32_t> relocations[] = nullptr, size_t relocationCount = 0u);
+
+		// Frees a stub allocated by createStub().
+		//
+		// Parameters:
+		//
+		// [in] stub:
+		// Address of the stub. nullptr is ignored.
+		void freeStub(BYTE* stub);
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "threadRank.h"
+#include <stdlib.h>
+
+namespace hax {
+
+	namespace proc {
+
+		// costs of the thread states and wait reasons in the order of the expected time to resume execution
+		// a cost step outweighs any priority difference
+		constexpr uint32_t COST_STEP = 0x100u;
+		constexpr int32_t MAX_PRIORITY = 0x1F;
+
+		static uint32_t getHijackCost(const ThreadEntry* pThreadEntry);
+		static uint32_t getApcCost(const ThreadEntry* pThreadEntry);
+
+		uint32_t scoreThread(const ThreadEntry* pThreadEntry, ThreadUse use) {
+			const uint32_t cost = use == ThreadUse::HIJACK ? getHijackCost(pThreadEntry) : getApcCost(pThreadEntry);
+
+			if (cost == THREAD_SCORE_UNUSABLE) return THREAD_SCORE_UNUSABLE;
+
+			// threads with higher priority get scheduled first
+			int32_t priority = pThreadEntry->priority;
+
+			if (priority < 0) {
+				priority = 0;
+			}
+
+			if (priority > MAX_PRIORITY) {
+				priority = MAX_PRIORITY;
+			}
+
+			return cost * COST_STEP + static_cast<uint32_t>(MAX_PRIORITY - priority);
+		}
+
+
+		typedef struct RankedThread {
+			size_t index;
+			uint32_t score;
+			uint64_t cpuTime;
+			uint32_t contextSwitches;
+			// ties of otherwise equal threads are broken by the index, for APCs later threads are preferred to avoid threadpool workers
+			bool preferLater;
+		}RankedThread;
+
+		static int compareRankedThreads(const void* pLeft, const void* pRight);
+
+		size_t rankThreads(const ThreadEntry threadEntries[], size_t count, ThreadUse use, size_t ranking[]) {
+
+			if (!count) return 0u;
+
+			RankedThread* const pRankedThreads = new RankedThread[count]{};
+			size_t usableCount = 0u;
+
+			for (size_t i = 0u; i < count; i++) {
+				const uint32_t score = scoreThread(&threadEntries[i], use);
+
+				if (score == THREAD_SCORE_UNUSABLE) continue;
+
+				RankedThread* const pRankedThread = &pRankedThreads[usableCount];
+				pRankedThread->index = i;
+				pRankedThread->score = score;
+				pRankedThread->cpuTime = threadEntries[i].cpuTime;
+				pRankedThread->contextSwitches = threadEntries[i].contextSwitches;
+				pRankedThread->preferLater = use == ThreadUse::APC;
+				usableCount++;
+			}
+
+			qsort(pRankedThreads, usableCount, sizeof(RankedThread), compareRankedThreads);
+
+			for (size_t i = 0u; i < usableCount; i++) {
+				ranking[i] = pRankedThreads[i].index;
+			}
+
+			delete[] pRankedThreads;
+
+			return usableCount;
+		}
+
+
+		static uint32_t getHijackCost(const ThreadEntry* pThreadEntry) {
+
+			if (pThreadEntry->threadState == THREAD_STATE::Running) return 0u;
+
+			if (pThreadEntry->threadState == THREAD_STATE::Ready || pThreadEntry->threadState == THREAD_STATE::Standby) return 1u;
+
+			if (pThreadEntry->threadState == THREAD_STATE::Terminated) return THREAD_SCORE_UNUSABLE;
+
+			if (pThreadEntry->threadState != THREAD_STATE::Waiting) return 12u;
+
+			const KWAIT_REASON waitReason = pThreadEntry->waitReason;
+
+			// suspended threads do not resume by themselves
+			if (waitReason == KWAIT_REASON::Suspended || waitReason == KWAIT_REASON::WrSuspended) return THREAD_SCORE_UNUSABLE;
+
+			// message loops get woken up by the posted thread message
+			if (waitReason == KWAIT_REASON::WrUserRequest) return 2u;
+
+			if (waitReason == KWAIT_REASON::UserRequest || waitReason == KWAIT_REASON::DelayExecution || waitReason == KWAIT_REASON::WrDelayExecution) return 4u;
+
+			if (waitReason == KWAIT_REASON::WrAlertByThreadId) return 6u;
+
+			// idle threadpool workers might wait for a long time
+			if (waitReason == KWAIT_REASON::WrQueue) return 8u;
+
+			return 12u;
+		}
+
+
+		static uint32_t getApcCost(const ThreadEntry* pThreadEntry) {
+
+			// APCs are only executed by threads waiting in an alertable state
+			if (pThreadEntry->threadState != THREAD_STATE::Waiting) return THREAD_SCORE_UNUSABLE;
+
+			// SleepEx sets wait reason to DelayExecution
+			if (pThreadEntry->waitReason == KWAIT_REASON::DelayExecution) return 0u;
+
+			// SignalObjectAndWait, MsgWaitForMultipleObjectsEx, WaitForMultipleObjectsEx, WaitForSingleObjectEx set wait reason to WrQueue
+			if (pThreadEntry->waitReason == KWAIT_REASON::WrQueue) return 1u;
+
+			// might be an alertable wait as well but is also used for most non-alertable waits
+			if (pThreadEntry->waitReason == KWAIT_REASON::UserRequest) return 4u;
+
+			return THREAD_SCORE_UNUSABLE;
+		}
+
+
+		static int compareRankedThreads(const void* pLeft, const void* pRight) {
+			const RankedThread* const pLeftThread = static_cast<const RankedThread*>(pLeft);
+			const RankedThread* const pRightThread = static_cast<const RankedThread*>(pRight);
+
+			if (pLeftThread->score != pRightThread->score) return pLeftThread->score < pRightThread->score ? -1 : 1;
+
+			// more cpu time and context switches indicate a more active thread
+			if (pLeftThread->cpuTime != pRightThread->cpuTime) return pLeftThread->cpuTime > pRightThread->cpuTime ? -1 : 1;
+
+			if (pLeftThread->contextSwitches != pRightThread->contextSwitches) return pLeftThread->contextSwitches > pRightThread->contextSwitches ? -1 : 1;
+
+			const int indexOrder = (pLeftThread->index > pRightThread->index) - (pLeftThread->index < pRightThread->index);
+
+			return pLeftThread->preferLater ? -indexOrder : indexOrder;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Functions to rank the threads of a process by how soon they are expected to resume execution, eg. to pick the threads for hijacking or queueing APCs.
+// The functions do not call any API functions and do not depend on windows headers, so they work on any platform.
+// The thread entries are retrieved by proc::getProcessThreadEntries.
+
+// Wait reasons and states of threads as reported by NtQuerySystemInformation (see undocWinTypes.h).
+typedef enum _KWAIT_REASON {
+    Executive,
+    FreePage,
+    PageIn,
+    PoolAllocation,
+    DelayExecution,
+    Suspended,
+    UserRequest,
+    WrExecutive,
+    WrFreePage,
+    WrPageIn,
+    WrPoolAllocation,
+    WrDelayExecution,
+    WrSuspended,
+    WrUserRequest,
+    WrEventPair,
+    WrQueue,
+    WrLpcReceive,
+    WrLpcReply,
+    WrVirtualMemory,
+    WrPageOut,
+    WrRendezvous,
+    WrKeyedEvent,
+    WrTerminated,
+    WrProcessInSwap,
+    WrCpuRateControl,
+    WrCalloutStack,
+    WrKernel,
+    WrResource,
+    WrPushLock,
+    WrMutex,
+    WrQuantumEnd,
+    WrDispatchInt,
+    WrPreempted,
+    WrYieldExecution,
+    WrFastMutex,
+    WrGuardedMutex,
+    WrRundown,
+    WrAlertByThreadId,
+    WrDeferredPreempt,
+    MaximumWaitReason
+} KWAIT_REASON;
+
+typedef enum _THREAD_STATE {
+    Initialized,
+    Ready,
+    Running,
+    Standby,
+    Terminated,
+    Waiting,
+    Transition,
+    TsUnknown,
+    MaximumThreadState
+} THREAD_STATE;
+
+namespace hax {
+
+	namespace proc {
+
+		typedef struct ThreadEntry {
+			uint32_t threadId;
+			uint32_t ownerProcessId;
+			THREAD_STATE threadState;
+			KWAIT_REASON waitReason;
+			// dynamic priority of the thread
+			int32_t priority;
+			// kernel and user time of the thread in 100 nanosecond intervals
+			uint64_t cpuTime;
+			uint32_t contextSwitches;
+		}ThreadEntry;
+
+		// Purpose a thread is ranked for.
+		enum class ThreadUse {
+			// The thread gets suspended and its context gets changed.
+			HIJACK,
+			// A user-mode APC gets queued to the thread, so it has to wait in an alertable state.
+			APC
+		};
+
+		// Score of threads that can not be used for a purpose.
+		constexpr uint32_t THREAD_SCORE_UNUSABLE = 0xFFFFFFFFu;
+
+		// Estimates how soon a thread resumes execution based on its state, wait reason and priority.
+		// Does not call any API functions, so it works on arbitrary thread entries.
+		// 
+		// Parameters:
+		// 
+		// [in] pThreadEntry:
+		// Thread entry of the thread.
+		// 
+		// [in] use:
+		// Purpose the thread should be used for.
+		// 
+		// Return:
+		// Score of the thread. The lower the score the sooner the thread is expected to resume execution.
+		// THREAD_SCORE_UNUSABLE if the thread can not be used for the purpose.
+		uint32_t scoreThread(const ThreadEntry* pThreadEntry, ThreadUse use);
+
+		// Ranks threads by how soon they are expected to resume execution.
+		// Threads with equal scores are ordered by their CPU time and context switches, which indicate recent activity.
+		// Does not call any API functions, so it works on arbitrary thread entries.
+		// 
+		// Parameters:
+		// 
+		// [in] threadEntries:
+		// Array of the thread entries.
+		// 
+		// [in] count:
+		// Element count of the threadEntries array.
+		// 
+		// [in] use:
+		// Purpose the threads should be used for.
+		// 
+		// [out] ranking:
+		// Array that receives the indices of the usable threads within threadEntries, best thread first. Has to hold count elements.
+		// 
+		// Return:
+		// Count of usable threads written to ranking.
+		size_t rankThreads(const ThreadEntry threadEntries[], size_t count, ThreadUse use, size_t ranking[]);
+
+	}
+
+}
\ No newline at end of file
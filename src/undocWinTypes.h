@@ -1,5 +1,6 @@
 #pragma once
 #include <Windows.h>
+#include "threadRank.h"
 
 // Definitions of undocumented windows structures and functions.
 // These structures have been tested for Windows 11 22H2 and might change with future windows updates.
@@ -643,64 +644,12 @@ typedef enum _SYSTEM_INFORMATION_CLASS {
     SystemExceptionInformation = 33,
     SystemRegistryQuotaInformation = 37,
     SystemLookasideInformation = 45,
+    SystemExtendedHandleInformation = 64,
     SystemCodeIntegrityInformation = 103,
     SystemPolicyInformation = 134,
 } SYSTEM_INFORMATION_CLASS;
 
-typedef enum _KWAIT_REASON {
-    Executive,
-    FreePage,
-    PageIn,
-    PoolAllocation,
-    DelayExecution,
-    Suspended,
-    UserRequest,
-    WrExecutive,
-    WrFreePage,
-    WrPageIn,
-    WrPoolAllocation,
-    WrDelayExecution,
-    WrSuspended,
-    WrUserRequest,
-    WrEventPair,
-    WrQueue,
-    WrLpcReceive,
-    WrLpcReply,
-    WrVirtualMemory,
-    WrPageOut,
-    WrRendezvous,
-    WrKeyedEvent,
-    WrTerminated,
-    WrProcessInSwap,
-    WrCpuRateControl,
-    WrCalloutStack,
-    WrKernel,
-    WrResource,
-    WrPushLock,
-    WrMutex,
-    WrQuantumEnd,
-    WrDispatchInt,
-    WrPreempted,
-    WrYieldExecution,
-    WrFastMutex,
-    WrGuardedMutex,
-    WrRundown,
-    WrAlertByThreadId,
-    WrDeferredPreempt,
-    MaximumWaitReason
-} KWAIT_REASON;
-
-typedef enum _THREAD_STATE {
-    Initialized,
-    Ready,
-    Running,
-    Standby,
-    Terminated,
-    Waiting,
-    Transition,
-    TsUnknown,
-    MaximumThreadState
-} THREAD_STATE;
+// KWAIT_REASON and THREAD_STATE are defined in threadRank.h, so the thread ranking does not depend on windows headers
 
 typedef struct _CLIENT_ID {
     HANDLE UniqueProcess;
@@ -774,6 +723,23 @@ typedef struct _SYSTEM_HANDLE_INFORMATION {
     SYSTEM_HANDLE_TABLE_ENTRY_INFO Handles[1];
 } SYSTEM_HANDLE_INFORMATION, * PSYSTEM_HANDLE_INFORMATION;
 
+typedef struct _SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX {
+    PVOID Object;
+    ULONG_PTR UniqueProcessId;
+    ULONG_PTR HandleValue;
+    ULONG GrantedAccess;
+    USHORT CreatorBackTraceIndex;
+    USHORT ObjectTypeIndex;
+    ULONG HandleAttributes;
+    ULONG Reserved;
+} SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX, * PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX;
+
+typedef struct _SYSTEM_HANDLE_INFORMATION_EX {
+    ULONG_PTR NumberOfHandles;
+    ULONG_PTR Reserved;
+    SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handles[1];
+} SYSTEM_HANDLE_INFORMATION_EX, * PSYSTEM_HANDLE_INFORMATION_EX;
+
 typedef NTSTATUS(__stdcall* tNtQuerySystemInformation) (
     SYSTEM_INFORMATION_CLASS SystemInformationClass,
     PVOID SystemInformation,
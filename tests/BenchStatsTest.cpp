@@ -0,0 +1,180 @@
+#include "test.h"
+#include "../src/BenchStats.h"
+#include <string.h>
+
+// Launcher that replays scripted latencies instead of launching code in a process. Every failEvery-th launch fails.
+typedef struct SimulatedLauncher {
+	const double* latencies;
+	size_t latencyCount;
+	size_t failEvery;
+	size_t calls;
+}SimulatedLauncher;
+
+static bool simulateLaunch(SimulatedLauncher* pLauncher, double* pSeconds) {
+	pLauncher->calls++;
+
+	if (pLauncher->failEvery && !(pLauncher->calls % pLauncher->failEvery)) return false;
+
+	*pSeconds = pLauncher->latencies[(pLauncher->calls - 1u) % pLauncher->latencyCount];
+
+	return true;
+}
+
+
+// records the runs like the LaunchBench example does
+static void benchLauncher(SimulatedLauncher* pLauncher, hax::BenchStats* pStats, size_t runs) {
+
+	for (size_t i = 0u; i < runs; i++) {
+		double seconds = 0.;
+
+		if (simulateLaunch(pLauncher, &seconds)) {
+			pStats->addSample(seconds);
+		}
+		else {
+			pStats->addFailure();
+		}
+
+	}
+
+	return;
+}
+
+
+static void testEmpty() {
+	hax::BenchStats stats("empty", 0x10u);
+
+	CHECK(stats.getCount() == 0u);
+	CHECK(stats.getPercentile(50.) == 0.);
+	CHECK(stats.getMean() == 0.);
+	CHECK(stats.getFailureRate() == 0.);
+}
+
+
+static void testPercentiles() {
+	// 1 to 100 milliseconds in reverse order, so the samples have to be sorted
+	double latencies[100]{};
+
+	for (size_t i = 0u; i < 100u; i++) {
+		latencies[i] = static_cast<double>(100u - i) / 1000.;
+	}
+
+	SimulatedLauncher launcher{ latencies, 100u, 0u, 0u };
+	hax::BenchStats stats("percentiles", 100u);
+	benchLauncher(&launcher, &stats, 100u);
+
+	CHECK(stats.getCount() == 100u);
+	CHECK(stats.getFailures() == 0u);
+	CHECK_NEAR(stats.getPercentile(0.), 0.001, 1e-12);
+	CHECK_NEAR(stats.getPercentile(100.), 0.1, 1e-12);
+	// rank 0.5 * 99 = 49.5 between 50 ms and 51 ms
+	CHECK_NEAR(stats.getPercentile(50.), 0.0505, 1e-12);
+	// rank 0.9 * 99 = 89.1 between 90 ms and 91 ms
+	CHECK_NEAR(stats.getPercentile(90.), 0.0901, 1e-12);
+	CHECK_NEAR(stats.getMean(), 0.0505, 1e-12);
+}
+
+
+static void testSingleSample() {
+	const double latency = 0.25;
+	SimulatedLauncher launcher{ &latency, 1u, 0u, 0u };
+	hax::BenchStats stats("single", 1u);
+	benchLauncher(&launcher, &stats, 1u);
+
+	CHECK_NEAR(stats.getPercentile(0.), 0.25, 1e-12);
+	CHECK_NEAR(stats.getPercentile(50.), 0.25, 1e-12);
+	CHECK_NEAR(stats.getPercentile(99.), 0.25, 1e-12);
+}
+
+
+static void testSortedPercentile() {
+	const double sorted[]{ 1., 2., 4., 8. };
+
+	CHECK(hax::BenchStats::getPercentile(nullptr, 0u, 50.) == 0.);
+	CHECK(hax::BenchStats::getPercentile(sorted, 0u, 50.) == 0.);
+	CHECK(hax::BenchStats::getPercentile(sorted, 4u, -1.) == 1.);
+	CHECK(hax::BenchStats::getPercentile(sorted, 4u, 101.) == 8.);
+	// rank 0.5 * 3 = 1.5 between 2 and 4
+	CHECK_NEAR(hax::BenchStats::getPercentile(sorted, 4u, 50.), 3., 1e-12);
+	// rank 0.9 * 3 = 2.7 between 4 and 8
+	CHECK_NEAR(hax::BenchStats::getPercentile(sorted, 4u, 90.), 6.8, 1e-12);
+	CHECK_NEAR(hax::BenchStats::getPercentile(sorted, 1u, 99.), 1., 1e-12);
+}
+
+
+static void testFailureRate() {
+	const double latencies[]{ 0.001, 0.002, 0.003 };
+	SimulatedLauncher launcher{ latencies, 3u, 4u, 0u };
+	hax::BenchStats stats("failures", 100u);
+	benchLauncher(&launcher, &stats, 100u);
+
+	CHECK(stats.getFailures() == 25u);
+	CHECK(stats.getCount() == 75u);
+	CHECK_NEAR(stats.getFailureRate(), 0.25, 1e-12);
+
+	stats.reset();
+
+	CHECK(stats.getCount() == 0u);
+	CHECK(stats.getFailures() == 0u);
+}
+
+
+static void testCapacity() {
+	const double latencies[]{ 0.001, 0.002 };
+	SimulatedLauncher launcher{ latencies, 2u, 0u, 0u };
+	hax::BenchStats stats("capacity", 4u);
+	benchLauncher(&launcher, &stats, 10u);
+
+	// samples beyond the capacity are ignored
+	CHECK(stats.getCount() == 4u);
+	CHECK_NEAR(stats.getMean(), 0.0015, 1e-12);
+}
+
+
+static void testPrintRow() {
+	const double latencies[]{ 0.000010, 0.000020, 0.000030, 0.000040 };
+	SimulatedLauncher launcher{ latencies, 4u, 5u, 0u };
+	hax::BenchStats stats("simulated", 0x10u);
+	benchLauncher(&launcher, &stats, 5u);
+
+	FILE* const pFile = tmpfile();
+	CHECK(pFile != nullptr);
+
+	if (!pFile) return;
+
+	stats.printRow(pFile);
+	rewind(pFile);
+
+	char row[0x100]{};
+	CHECK(fgets(row, sizeof(row), pFile) != nullptr);
+	fclose(pFile);
+
+	char label[0x20]{};
+	size_t runs = 0u;
+	double failurePercent = 0.;
+	double mean = 0.;
+	double p50 = 0.;
+	double p90 = 0.;
+	double p99 = 0.;
+	double max = 0.;
+
+	CHECK(sscanf(row, "%31s %zu %lf %lf %lf %lf %lf %lf", label, &runs, &failurePercent, &mean, &p50, &p90, &p99, &max) == 8);
+	CHECK(!strcmp(label, "simulated"));
+	CHECK(runs == 5u);
+	CHECK_NEAR(failurePercent, 20., 1e-9);
+	CHECK_NEAR(mean, 25., 0.01);
+	CHECK_NEAR(p50, 25., 0.01);
+	CHECK_NEAR(max, 40., 0.01);
+}
+
+
+int main() {
+	RUN_TEST(testEmpty);
+	RUN_TEST(testPercentiles);
+	RUN_TEST(testSortedPercentile);
+	RUN_TEST(testSingleSample);
+	RUN_TEST(testFailureRate);
+	RUN_TEST(testCapacity);
+	RUN_TEST(testPrintRow);
+
+	return finishTests("BenchStatsTest");
+}
\ No newline at end of file
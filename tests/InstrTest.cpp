@@ -0,0 +1,290 @@
+#include "test.h"
+#include "../src/instr.h"
+#include <string.h>
+
+using hax::instr::Instruction;
+using hax::instr::RelType;
+using hax::instr::StolenRange;
+
+typedef struct Sample {
+	uint8_t bytes[hax::instr::MAX_LENGTH];
+	size_t length;
+	bool x64;
+	RelType relType;
+	uint8_t relOffset;
+	uint8_t relSize;
+	bool isTerminator;
+}Sample;
+
+// instructions of common function prologues and epilogues as emitted by MSVC, clang and gcc
+static const Sample SAMPLES[]{
+	// push rbp
+	{ { 0x55 }, 1u, true, RelType::NONE, 0u, 0u, false },
+	// mov rbp, rsp
+	{ { 0x48, 0x89, 0xE5 }, 3u, true, RelType::NONE, 0u, 0u, false },
+	// sub rsp, 0x28
+	{ { 0x48, 0x83, 0xEC, 0x28 }, 4u, true, RelType::NONE, 0u, 0u, false },
+	// sub rsp, 0x1000
+	{ { 0x48, 0x81, 0xEC, 0x00, 0x10, 0x00, 0x00 }, 7u, true, RelType::NONE, 0u, 0u, false },
+	// mov QWORD PTR [rsp+0x8], rbx
+	{ { 0x48, 0x89, 0x5C, 0x24, 0x08 }, 5u, true, RelType::NONE, 0u, 0u, false },
+	// mov rax, QWORD PTR [rip+0x12345678]
+	{ { 0x48, 0x8B, 0x05, 0x78, 0x56, 0x34, 0x12 }, 7u, true, RelType::RIP_RELATIVE, 3u, 4u, false },
+	// lea rcx, [rip-0x10]
+	{ { 0x48, 0x8D, 0x0D, 0xF0, 0xFF, 0xFF, 0xFF }, 7u, true, RelType::RIP_RELATIVE, 3u, 4u, false },
+	// cmp BYTE PTR [rip+0x10], 0x0 has the immediate behind the displacement
+	{ { 0x80, 0x3D, 0x10, 0x00, 0x00, 0x00, 0x00 }, 7u, true, RelType::RIP_RELATIVE, 2u, 4u, false },
+	// mov DWORD PTR [rip+0x10], 0x1
+	{ { 0xC7, 0x05, 0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00 }, 10u, true, RelType::RIP_RELATIVE, 2u, 4u, false },
+	// movabs rax, 0x1122334455667788
+	{ { 0x48, 0xB8, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11 }, 10u, true, RelType::NONE, 0u, 0u, false },
+	// mov eax, 0x1
+	{ { 0xB8, 0x01, 0x00, 0x00, 0x00 }, 5u, true, RelType::NONE, 0u, 0u, false },
+	// mov ax, 0x1
+	{ { 0x66, 0xB8, 0x01, 0x00 }, 4u, true, RelType::NONE, 0u, 0u, false },
+	// test BYTE PTR [rcx], 0x1
+	{ { 0xF6, 0x01, 0x01 }, 3u, true, RelType::NONE, 0u, 0u, false },
+	// not DWORD PTR [rcx] has no immediate
+	{ { 0xF7, 0x11 }, 2u, true, RelType::NONE, 0u, 0u, false },
+	// call rel32
+	{ { 0xE8, 0x00, 0x01, 0x00, 0x00 }, 5u, true, RelType::BRANCH32, 1u, 4u, false },
+	// jmp rel32
+	{ { 0xE9, 0x00, 0x01, 0x00, 0x00 }, 5u, true, RelType::BRANCH32, 1u, 4u, true },
+	// jmp rel8
+	{ { 0xEB, 0x10 }, 2u, true, RelType::BRANCH8, 1u, 1u, true },
+	// je rel8
+	{ { 0x74, 0x10 }, 2u, true, RelType::BRANCH8, 1u, 1u, false },
+	// jne rel32
+	{ { 0x0F, 0x85, 0x00, 0x01, 0x00, 0x00 }, 6u, true, RelType::BRANCH32, 2u, 4u, false },
+	// jmp QWORD PTR [rip+0x0]
+	{ { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 }, 6u, true, RelType::RIP_RELATIVE, 2u, 4u, true },
+	// call QWORD PTR [rip+0x0]
+	{ { 0xFF, 0x15, 0x00, 0x00, 0x00, 0x00 }, 6u, true, RelType::RIP_RELATIVE, 2u, 4u, false },
+	// ret
+	{ { 0xC3 }, 1u, true, RelType::NONE, 0u, 0u, true },
+	// int3
+	{ { 0xCC }, 1u, true, RelType::NONE, 0u, 0u, true },
+	// nop DWORD PTR [rax+rax*1+0x0]
+	{ { 0x0F, 0x1F, 0x44, 0x00, 0x00 }, 5u, true, RelType::NONE, 0u, 0u, false },
+	// movaps XMMWORD PTR [rsp+0x20], xmm6
+	{ { 0x0F, 0x29, 0x74, 0x24, 0x20 }, 5u, true, RelType::NONE, 0u, 0u, false },
+	// pshufb xmm0, xmm1 (three byte map 0F 38)
+	{ { 0x66, 0x0F, 0x38, 0x00, 0xC1 }, 5u, true, RelType::NONE, 0u, 0u, false },
+	// palignr xmm0, xmm1, 0x4 (three byte map 0F 3A)
+	{ { 0x66, 0x0F, 0x3A, 0x0F, 0xC1, 0x04 }, 6u, true, RelType::NONE, 0u, 0u, false },
+	// vmovups ymm0, YMMWORD PTR [rcx] (two byte VEX)
+	{ { 0xC5, 0xFC, 0x10, 0x01 }, 4u, true, RelType::NONE, 0u, 0u, false },
+	// vmovdqu ymm0, YMMWORD PTR [rip+0x10] (three byte VEX)
+	{ { 0xC4, 0xE1, 0x7E, 0x6F, 0x05, 0x10, 0x00, 0x00, 0x00 }, 9u, true, RelType::RIP_RELATIVE, 5u, 4u, false },
+	// lock cmpxchg QWORD PTR [rcx], rdx
+	{ { 0xF0, 0x48, 0x0F, 0xB1, 0x11 }, 5u, true, RelType::NONE, 0u, 0u, false },
+	// mov rax, QWORD PTR gs:0x30
+	{ { 0x65, 0x48, 0x8B, 0x04, 0x25, 0x30, 0x00, 0x00, 0x00 }, 9u, true, RelType::NONE, 0u, 0u, false },
+	// push ebp
+	{ { 0x55 }, 1u, false, RelType::NONE, 0u, 0u, false },
+	// mov ebp, esp
+	{ { 0x8B, 0xEC }, 2u, false, RelType::NONE, 0u, 0u, false },
+	// mov edi, edi (hot patch prologue)
+	{ { 0x8B, 0xFF }, 2u, false, RelType::NONE, 0u, 0u, false },
+	// mov eax, DWORD PTR ds:0x12345678 is absolute in x86 code
+	{ { 0xA1, 0x78, 0x56, 0x34, 0x12 }, 5u, false, RelType::NONE, 0u, 0u, false },
+	// mov eax, DWORD PTR [0x12345678] via ModR/M is absolute in x86 code
+	{ { 0x8B, 0x05, 0x78, 0x56, 0x34, 0x12 }, 6u, false, RelType::NONE, 0u, 0u, false },
+	// inc eax is no REX prefix in x86 code
+	{ { 0x40 }, 1u, false, RelType::NONE, 0u, 0u, false },
+	// mov ax, WORD PTR [bx+si+0x10] with 16 bit addressing
+	{ { 0x66, 0x67, 0x8B, 0x40, 0x10 }, 5u, false, RelType::NONE, 0u, 0u, false },
+	// call rel32
+	{ { 0xE8, 0x00, 0x01, 0x00, 0x00 }, 5u, false, RelType::BRANCH32, 1u, 4u, false },
+	// jmp rel16 with operand size prefix
+	{ { 0x66, 0xE9, 0x00, 0x01 }, 4u, false, RelType::BRANCH32, 2u, 2u, true },
+	// loop rel8
+	{ { 0xE2, 0xFE }, 2u, false, RelType::BRANCH8, 1u, 1u, false },
+	// ret 0x8
+	{ { 0xC2, 0x08, 0x00 }, 3u, false, RelType::NONE, 0u, 0u, true },
+	// enter 0x10, 0x0
+	{ { 0xC8, 0x10, 0x00, 0x00 }, 4u, false, RelType::NONE, 0u, 0u, false },
+	// jmp far 0x8:0x12345678
+	{ { 0xEA, 0x78, 0x56, 0x34, 0x12, 0x08, 0x00 }, 7u, false, RelType::NONE, 0u, 0u, true },
+	// les eax, FWORD PTR [ecx] is no VEX prefix in x86 code
+	{ { 0xC4, 0x01 }, 2u, false, RelType::NONE, 0u, 0u, false }
+};
+
+
+static void testSamples() {
+
+	for (size_t i = 0u; i < sizeof(SAMPLES) / sizeof(SAMPLES[0]); i++) {
+		const Sample* const pSample = &SAMPLES[i];
+		Instruction instruction{};
+
+		if (hax::instr::decode(pSample->bytes, sizeof(pSample->bytes), pSample->x64, &instruction) != pSample->length) {
+			fprintf(stderr, "sample %zu: wrong length %u\n", i, instruction.length);
+		}
+
+		CHECK(instruction.length == pSample->length);
+		CHECK(instruction.relType == pSample->relType);
+		CHECK(instruction.isTerminator == pSample->isTerminator);
+
+		if (pSample->relType != RelType::NONE) {
+			CHECK(instruction.relOffset == pSample->relOffset);
+			CHECK(instruction.relSize == pSample->relSize);
+		}
+
+	}
+
+}
+
+
+static void testInvalid() {
+	Instruction instruction{};
+
+	// invalid in x64 code
+	const uint8_t pushEs[]{ 0x06 };
+	CHECK(!hax::instr::decode(pushEs, sizeof(pushEs), true, &instruction));
+	CHECK(hax::instr::decode(pushEs, sizeof(pushEs), false, &instruction) == 1u);
+
+	const uint8_t unassigned[]{ 0x0F, 0x04 };
+	CHECK(!hax::instr::decode(unassigned, sizeof(unassigned), true, &instruction));
+
+	// prefixes only
+	const uint8_t prefixes[]{ 0x66, 0x66, 0x66 };
+	CHECK(!hax::instr::decode(prefixes, sizeof(prefixes), true, &instruction));
+
+	// more than 15 bytes
+	uint8_t tooLong[0x10]{};
+	memset(tooLong, 0x66, sizeof(tooLong) - 1u);
+	tooLong[sizeof(tooLong) - 1u] = 0x90;
+	CHECK(!hax::instr::decode(tooLong, sizeof(tooLong), true, &instruction));
+}
+
+
+static void testTruncated() {
+	Instruction instruction{};
+	const uint8_t movRip[]{ 0x48, 0x8B, 0x05, 0x78, 0x56, 0x34, 0x12 };
+
+	// no byte beyond size is read
+	for (size_t size = 0u; size < sizeof(movRip); size++) {
+		CHECK(!hax::instr::decode(movRip, size, true, &instruction));
+	}
+
+	CHECK(hax::instr::decode(movRip, sizeof(movRip), true, &instruction) == sizeof(movRip));
+}
+
+
+static void testStolenRange() {
+	// push rbp; mov rbp, rsp; sub rsp, 0x20; mov rax, [rip+0x100]; ret
+	const uint8_t code[]{ 0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0x48, 0x8B, 0x05, 0x00, 0x01, 0x00, 0x00, 0xC3 };
+	StolenRange range{};
+
+	CHECK(hax::instr::getStolenRange(code, sizeof(code), 5u, true, &range));
+	CHECK(range.size == 8u);
+	CHECK(range.instructionCount == 3u);
+	CHECK(range.offsets[2] == 4u);
+	CHECK(!range.relativeCount);
+
+	CHECK(hax::instr::getStolenRange(code, sizeof(code), 14u, true, &range));
+	CHECK(range.size == 15u);
+	CHECK(range.relativeCount == 1u);
+
+	// the function ends before the minimum size
+	const uint8_t shortFunc[]{ 0x31, 0xC0, 0xC3, 0xCC, 0xCC, 0xCC };
+	CHECK(!hax::instr::getStolenRange(shortFunc, sizeof(shortFunc), 5u, true, &range));
+
+	// not enough readable bytes
+	CHECK(!hax::instr::getStolenRange(code, 6u, 5u, true, &range));
+	CHECK(!hax::instr::getStolenRange(code, sizeof(code), hax::instr::MAX_STOLEN_SIZE + 1u, true, &range));
+}
+
+
+static void testRelocateRipRelative() {
+	// mov rax, [rip+0x100]; nop
+	const uint8_t code[]{ 0x48, 0x8B, 0x05, 0x00, 0x01, 0x00, 0x00, 0x90 };
+	StolenRange range{};
+	CHECK(hax::instr::getStolenRange(code, sizeof(code), 8u, true, &range));
+	CHECK(hax::instr::getRelocatedSize(code, &range) == sizeof(code));
+
+	const uint64_t source = 0x7FF700001000u;
+	const uint64_t destination = source + 0x10000u;
+	uint8_t out[hax::instr::MAX_RELOCATED_SIZE]{};
+	CHECK(hax::instr::relocate(code, &range, source, destination, true, out, sizeof(out)) == sizeof(code));
+
+	int32_t displacement = 0;
+	memcpy(&displacement, out + 3u, sizeof(displacement));
+	// the operand keeps addressing source + 7 + 0x100
+	CHECK(destination + 7u + displacement == source + 7u + 0x100u);
+	CHECK(!memcmp(out, code, 3u) && out[7] == 0x90);
+
+	// targets out of reach of a 32 bit displacement
+	CHECK(!hax::instr::relocate(code, &range, source, source + 0x100000000u, true, out, sizeof(out)));
+	// output buffer too small
+	CHECK(!hax::instr::relocate(code, &range, source, destination, true, out, sizeof(code) - 1u));
+}
+
+
+static void testRelocateBranches() {
+	// je +0x20; jmp +0x100
+	const uint8_t code[]{ 0x74, 0x20, 0xE9, 0x00, 0x01, 0x00, 0x00 };
+	StolenRange range{};
+	CHECK(hax::instr::getStolenRange(code, sizeof(code), 7u, false, &range));
+	CHECK(range.relativeCount == 2u);
+	// je rel8 grows to je rel32
+	CHECK(hax::instr::getRelocatedSize(code, &range) == 6u + 5u);
+
+	const uint64_t source = 0x401000u;
+	const uint64_t destination = 0x10000000u;
+	uint8_t out[hax::instr::MAX_RELOCATED_SIZE]{};
+	CHECK(hax::instr::relocate(code, &range, source, destination, false, out, sizeof(out)) == 11u);
+
+	CHECK(out[0] == 0x0F && out[1] == 0x84);
+	int32_t displacement = 0;
+	memcpy(&displacement, out + 2u, sizeof(displacement));
+	CHECK(static_cast<uint32_t>(destination + 6u + displacement) == source + 2u + 0x20u);
+
+	CHECK(out[6] == 0xE9);
+	memcpy(&displacement, out + 7u, sizeof(displacement));
+	CHECK(static_cast<uint32_t>(destination + 11u + displacement) == source + 7u + 0x100u);
+
+	// loop has no near form and branches over a short jump to a near jump
+	const uint8_t loop[]{ 0xE2, 0x10, 0x90, 0x90, 0x90 };
+	CHECK(hax::instr::getStolenRange(loop, sizeof(loop), 5u, false, &range));
+	CHECK(hax::instr::relocate(loop, &range, source, destination, false, out, sizeof(out)) == 9u + 3u);
+	CHECK(out[0] == 0xE2 && out[1] == 0x02 && out[2] == 0xEB && out[3] == 0x05 && out[4] == 0xE9);
+	memcpy(&displacement, out + 5u, sizeof(displacement));
+	CHECK(static_cast<uint32_t>(destination + 9u + displacement) == source + 2u + 0x10u);
+}
+
+
+static void testRelocateIntoRange() {
+	// jne +0x2 to the second nop within the range; nop; nop; nop
+	const uint8_t code[]{ 0x75, 0x02, 0x90, 0x90, 0x90 };
+	StolenRange range{};
+	CHECK(hax::instr::getStolenRange(code, sizeof(code), 5u, true, &range));
+
+	const uint64_t source = 0x7FF700001000u;
+	const uint64_t destination = source - 0x1000u;
+	uint8_t out[hax::instr::MAX_RELOCATED_SIZE]{};
+	CHECK(hax::instr::relocate(code, &range, source, destination, true, out, sizeof(out)) == 6u + 3u);
+
+	int32_t displacement = 0;
+	memcpy(&displacement, out + 2u, sizeof(displacement));
+	// the branch targets the relocated copy of the nop at offset 4, which moved to offset 8
+	CHECK(destination + 6u + displacement == destination + 8u);
+
+	// branches into the middle of a stolen instruction can not be relocated
+	const uint8_t intoMiddle[]{ 0x75, 0x01, 0x48, 0x89, 0xE5 };
+	CHECK(hax::instr::getStolenRange(intoMiddle, sizeof(intoMiddle), 5u, true, &range));
+	CHECK(!hax::instr::relocate(intoMiddle, &range, source, destination, true, out, sizeof(out)));
+}
+
+
+int main() {
+	RUN_TEST(testSamples);
+	RUN_TEST(testInvalid);
+	RUN_TEST(testTruncated);
+	RUN_TEST(testStolenRange);
+	RUN_TEST(testRelocateRipRelative);
+	RUN_TEST(testRelocateBranches);
+	RUN_TEST(testRelocateIntoRange);
+
+	return finishTests("InstrTest");
+}
\ No newline at end of file
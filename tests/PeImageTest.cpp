@@ -0,0 +1,278 @@
+#include "test.h"
+#include "../src/peImage.h"
+#include <string.h>
+
+using hax::launch::PeImage;
+using hax::launch::ImageProtection;
+namespace pe = hax::launch::pe;
+
+// Layout of the synthetic DLL files built by buildDll:
+// headers at file offset 0x0, .text at 0x200 (rva 0x1000, RX), .data at 0x400 (rva 0x2000, RW, two pages of which the second is uninitialized), .reloc at 0x600 (rva 0x4000, R)
+constexpr size_t FILE_SIZE = 0x800u;
+constexpr uint32_t IMAGE_SIZE = 0x5000u;
+constexpr uint32_t TEXT_RVA = 0x1000u;
+constexpr uint32_t DATA_RVA = 0x2000u;
+constexpr uint32_t RELOC_RVA = 0x4000u;
+constexpr uint64_t PREFERRED_BASE64 = 0x180000000u;
+constexpr uint32_t PREFERRED_BASE32 = 0x10000000u;
+
+static void addSection(uint8_t* pFile, size_t sectionOffset, uint16_t index, const char* name, uint32_t rva, uint32_t virtualSize, uint32_t rawOffset, uint32_t characteristics) {
+	pe::SectionHeader* const pSection = reinterpret_cast<pe::SectionHeader*>(pFile + sectionOffset) + index;
+	memcpy(pSection->Name, name, strlen(name));
+	pSection->VirtualSize = virtualSize;
+	pSection->VirtualAddress = rva;
+	pSection->SizeOfRawData = 0x200u;
+	pSection->PointerToRawData = rawOffset;
+	pSection->Characteristics = characteristics;
+}
+
+
+// builds a DLL with a pointer to its code at the start of .data and a relocation for the pointer if hasRelocations is set
+static void buildDll(uint8_t* pFile, bool is64Bit, bool hasRelocations) {
+	memset(pFile, 0, FILE_SIZE);
+
+	pe::DosHeader* const pDosHeader = reinterpret_cast<pe::DosHeader*>(pFile);
+	pDosHeader->e_magic = pe::DOS_SIGNATURE;
+	pDosHeader->e_lfanew = 0x40;
+	*reinterpret_cast<uint32_t*>(pFile + 0x40u) = pe::NT_SIGNATURE;
+
+	pe::FileHeader* const pFileHeader = reinterpret_cast<pe::FileHeader*>(pFile + 0x44u);
+	pFileHeader->Machine = is64Bit ? pe::MACHINE_AMD64 : pe::MACHINE_I386;
+	pFileHeader->NumberOfSections = 3u;
+	pFileHeader->SizeOfOptionalHeader = static_cast<uint16_t>(is64Bit ? sizeof(pe::OptionalHeader64) : sizeof(pe::OptionalHeader32));
+	pFileHeader->Characteristics = pe::FILE_DLL;
+
+	const size_t optOffset = 0x44u + sizeof(pe::FileHeader);
+	pe::DirectoryEntry* pDirectories = nullptr;
+
+	if (is64Bit) {
+		pe::OptionalHeader64* const pOptHeader = reinterpret_cast<pe::OptionalHeader64*>(pFile + optOffset);
+		pOptHeader->Magic = pe::OPTIONAL_HDR64_MAGIC;
+		pOptHeader->AddressOfEntryPoint = TEXT_RVA;
+		pOptHeader->ImageBase = PREFERRED_BASE64;
+		pOptHeader->SizeOfImage = IMAGE_SIZE;
+		pOptHeader->SizeOfHeaders = 0x200u;
+		pOptHeader->NumberOfRvaAndSizes = pe::NUMBEROF_DIRECTORY_ENTRIES;
+		pDirectories = pOptHeader->DataDirectory;
+		*reinterpret_cast<uint64_t*>(pFile + 0x400u) = PREFERRED_BASE64 + TEXT_RVA;
+	}
+	else {
+		pe::OptionalHeader32* const pOptHeader = reinterpret_cast<pe::OptionalHeader32*>(pFile + optOffset);
+		pOptHeader->Magic = pe::OPTIONAL_HDR32_MAGIC;
+		pOptHeader->AddressOfEntryPoint = TEXT_RVA;
+		pOptHeader->ImageBase = PREFERRED_BASE32;
+		pOptHeader->SizeOfImage = IMAGE_SIZE;
+		pOptHeader->SizeOfHeaders = 0x200u;
+		pOptHeader->NumberOfRvaAndSizes = pe::NUMBEROF_DIRECTORY_ENTRIES;
+		pDirectories = pOptHeader->DataDirectory;
+		*reinterpret_cast<uint32_t*>(pFile + 0x400u) = PREFERRED_BASE32 + TEXT_RVA;
+	}
+
+	const size_t sectionOffset = optOffset + pFileHeader->SizeOfOptionalHeader;
+	addSection(pFile, sectionOffset, 0u, ".text", TEXT_RVA, 0x10u, 0x200u, pe::SCN_MEM_READ | pe::SCN_MEM_EXECUTE);
+	addSection(pFile, sectionOffset, 1u, ".data", DATA_RVA, 0x1800u, 0x400u, pe::SCN_MEM_READ | pe::SCN_MEM_WRITE);
+	addSection(pFile, sectionOffset, 2u, ".reloc", RELOC_RVA, 0xCu, 0x600u, pe::SCN_MEM_READ);
+
+	// the raw data of .text is padded beyond its virtual size
+	memset(pFile + 0x200u, 0xCC, 0x200u);
+	pFile[0x200u] = 0xC3;
+
+	if (hasRelocations) {
+		pe::BaseRelocation* const pRelocation = reinterpret_cast<pe::BaseRelocation*>(pFile + 0x600u);
+		pRelocation->VirtualAddress = DATA_RVA;
+		pRelocation->SizeOfBlock = sizeof(pe::BaseRelocation) + 2u * sizeof(uint16_t);
+		uint16_t* const pEntries = reinterpret_cast<uint16_t*>(pRelocation + 1);
+		pEntries[0] = static_cast<uint16_t>((is64Bit ? pe::REL_BASED_DIR64 : pe::REL_BASED_HIGHLOW) << 12);
+		pEntries[1] = pe::REL_BASED_ABSOLUTE;
+
+		pDirectories[pe::DIRECTORY_ENTRY_BASERELOC].VirtualAddress = RELOC_RVA;
+		pDirectories[pe::DIRECTORY_ENTRY_BASERELOC].Size = pRelocation->SizeOfBlock;
+	}
+
+}
+
+
+static void testLayout() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, true, true);
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE, 0x1000u));
+	CHECK(image.is64Bit());
+	CHECK(image.getImageSize() == IMAGE_SIZE);
+	CHECK(image.getSize() == IMAGE_SIZE + 0x1000u);
+	CHECK(image.getPreferredBase() == PREFERRED_BASE64);
+	CHECK(image.getEntryRva() == TEXT_RVA);
+
+	const uint8_t* const pImage = image.getImage();
+	CHECK(!memcmp(pImage, file, 0x200u));
+	CHECK(pImage[TEXT_RVA] == 0xC3);
+	// only the virtual size of .text is copied
+	CHECK(pImage[TEXT_RVA + 0x10u] == 0x00);
+	CHECK(*reinterpret_cast<const uint64_t*>(pImage + DATA_RVA) == PREFERRED_BASE64 + TEXT_RVA);
+	// the uninitialized part of .data stays zeroed
+	CHECK(pImage[DATA_RVA + 0x1000u] == 0x00);
+
+	CHECK(image.getRvaAddress(TEXT_RVA, 1u) == pImage + TEXT_RVA);
+	CHECK(!image.getRvaAddress(IMAGE_SIZE - 1u, 2u));
+	CHECK(image.getDataDirectory(pe::DIRECTORY_ENTRY_BASERELOC)->VirtualAddress == RELOC_RVA);
+	CHECK(!image.getDataDirectory(pe::NUMBEROF_DIRECTORY_ENTRIES));
+}
+
+
+static void testLayout32() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, false, true);
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE));
+	CHECK(!image.is64Bit());
+	CHECK(image.getSize() == IMAGE_SIZE);
+	CHECK(image.getPreferredBase() == PREFERRED_BASE32);
+	CHECK(image.getEntryRva() == TEXT_RVA);
+	CHECK(*reinterpret_cast<const uint32_t*>(image.getImage() + DATA_RVA) == PREFERRED_BASE32 + TEXT_RVA);
+}
+
+
+static void testInvalidFiles() {
+	uint8_t file[FILE_SIZE];
+	PeImage image;
+
+	CHECK(!image.layout(nullptr, FILE_SIZE));
+
+	buildDll(file, true, true);
+	CHECK(!image.layout(file, 0x100u));
+
+	buildDll(file, true, true);
+	file[0] = 'X';
+	CHECK(!image.layout(file, FILE_SIZE));
+	CHECK(!image.getImage());
+
+	buildDll(file, true, true);
+	reinterpret_cast<pe::FileHeader*>(file + 0x44u)->Characteristics = 0u;
+	CHECK(!image.layout(file, FILE_SIZE));
+
+	buildDll(file, true, true);
+	reinterpret_cast<pe::FileHeader*>(file + 0x44u)->Machine = 0x1C0u;
+	CHECK(!image.layout(file, FILE_SIZE));
+
+	// raw data of .reloc beyond the end of the file
+	buildDll(file, true, true);
+	CHECK(!image.layout(file, 0x608u));
+	CHECK(!image.getImage());
+}
+
+
+static void testRelocate() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, true, true);
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE));
+
+	const uint64_t base = 0x7FF600000000u;
+	CHECK(image.relocate(base));
+	CHECK(*reinterpret_cast<const uint64_t*>(image.getImage() + DATA_RVA) == base + TEXT_RVA);
+
+	// relocating again is relative to the current base
+	CHECK(image.relocate(0x10000u));
+	CHECK(*reinterpret_cast<const uint64_t*>(image.getImage() + DATA_RVA) == 0x10000u + TEXT_RVA);
+	CHECK(image.relocate(PREFERRED_BASE64));
+	CHECK(!memcmp(image.getImage(), file, 0x200u));
+}
+
+
+static void testRelocate32() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, false, true);
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE));
+	CHECK(image.relocate(0x00400000u));
+	CHECK(*reinterpret_cast<const uint32_t*>(image.getImage() + DATA_RVA) == 0x00400000u + TEXT_RVA);
+	// x86 images have to be below four gigabytes
+	CHECK(!image.relocate(0x100000000u));
+}
+
+
+static void testNoRelocations() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, true, false);
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE));
+	CHECK(image.relocate(PREFERRED_BASE64));
+	CHECK(!image.relocate(PREFERRED_BASE64 + 0x10000u));
+}
+
+
+static void testInvalidRelocations() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, true, true);
+	// block size beyond the directory
+	reinterpret_cast<pe::BaseRelocation*>(file + 0x600u)->SizeOfBlock = 0x100u;
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE));
+	CHECK(!image.relocate(0x10000u));
+
+	buildDll(file, true, true);
+	// unsupported relocation type
+	reinterpret_cast<uint16_t*>(file + 0x600u + sizeof(pe::BaseRelocation))[0] = 0x1000u;
+	CHECK(image.layout(file, FILE_SIZE));
+	CHECK(!image.relocate(0x10000u));
+}
+
+
+static void testProtections() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, true, true);
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE));
+
+	static const ImageProtection expected[]{
+		{ 0x0000u, 0x1000u, hax::launch::IMAGE_PROTECT_READONLY },
+		{ TEXT_RVA, 0x1000u, hax::launch::IMAGE_PROTECT_EXECUTE_READ },
+		{ DATA_RVA, 0x2000u, hax::launch::IMAGE_PROTECT_READWRITE },
+		{ RELOC_RVA, 0x1000u, hax::launch::IMAGE_PROTECT_READONLY }
+	};
+
+	CHECK(image.getProtectionCount() == sizeof(expected) / sizeof(expected[0]));
+
+	if (image.getProtectionCount() != sizeof(expected) / sizeof(expected[0])) return;
+
+	for (size_t i = 0u; i < image.getProtectionCount(); i++) {
+		CHECK(image.getProtections()[i].rva == expected[i].rva);
+		CHECK(image.getProtections()[i].size == expected[i].size);
+		CHECK(image.getProtections()[i].protect == expected[i].protect);
+	}
+
+}
+
+
+static void testRvaString() {
+	uint8_t file[FILE_SIZE];
+	buildDll(file, true, true);
+	memcpy(file + 0x420u, "kernel32.dll", sizeof("kernel32.dll"));
+
+	PeImage image;
+	CHECK(image.layout(file, FILE_SIZE));
+	CHECK(image.getRvaString(DATA_RVA + 0x20u) && !strcmp(image.getRvaString(DATA_RVA + 0x20u), "kernel32.dll"));
+	CHECK(!image.getRvaString(IMAGE_SIZE));
+}
+
+
+int main() {
+	RUN_TEST(testLayout);
+	RUN_TEST(testLayout32);
+	RUN_TEST(testInvalidFiles);
+	RUN_TEST(testRelocate);
+	RUN_TEST(testRelocate32);
+	RUN_TEST(testNoRelocations);
+	RUN_TEST(testInvalidRelocations);
+	RUN_TEST(testProtections);
+	RUN_TEST(testRvaString);
+
+	return finishTests("PeImageTest");
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "test.h"
+#include "../src/regionSearch.h"
+
+using hax::mem::Region;
+
+constexpr unsigned long STATE_COMMIT = 0x1000ul;
+constexpr size_t GRANULARITY = 0x10000u;
+constexpr uintptr_t MIN_ADDRESS = 0x10000u;
+constexpr uintptr_t MAX_ADDRESS = 0x7FFFFFFEFFFFu;
+
+static Region makeRegion(uintptr_t base, size_t size, unsigned long state) {
+	Region region{};
+	region.base = reinterpret_cast<uint8_t*>(base);
+	region.size = size;
+	region.state = state;
+
+	return region;
+}
+
+
+static uintptr_t findNear(const Region regions[], size_t count, uintptr_t address, size_t size, uintptr_t minAddress = MIN_ADDRESS, uintptr_t maxAddress = MAX_ADDRESS) {
+
+	return reinterpret_cast<uintptr_t>(hax::mem::findNearFreeAddress(regions, count, reinterpret_cast<const uint8_t*>(address), size, GRANULARITY, reinterpret_cast<const uint8_t*>(minAddress), reinterpret_cast<const uint8_t*>(maxAddress)));
+}
+
+
+static void testNearestBelow() {
+	const Region regions[]{
+		makeRegion(0x0FF00000u, 0x100000u, hax::mem::REGION_STATE_FREE),
+		makeRegion(0x10000000u, 0x100000u, STATE_COMMIT),
+		makeRegion(0x10100000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	// highest aligned address the block fits at below the committed region
+	CHECK(findNear(regions, 3u, 0x10050000u, 0x1000u) == 0x0FFF0000u);
+}
+
+
+static void testNearestAbove() {
+	const Region regions[]{
+		makeRegion(0x0FF00000u, 0x100000u, hax::mem::REGION_STATE_FREE),
+		makeRegion(0x10000000u, 0x100000u, STATE_COMMIT),
+		makeRegion(0x10100000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	CHECK(findNear(regions, 3u, 0x100D0000u, 0x1000u) == 0x10100000u);
+}
+
+
+static void testWithinFreeRegion() {
+	const Region regions[]{
+		makeRegion(0x10000000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	CHECK(findNear(regions, 1u, 0x10058000u, 0x1000u) == 0x10050000u);
+	CHECK(findNear(regions, 1u, 0x10050000u, 0x1000u) == 0x10050000u);
+}
+
+
+static void testGranularity() {
+	const Region regions[]{
+		makeRegion(0x10000000u, 0x101000u, STATE_COMMIT),
+		makeRegion(0x10101000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	const uintptr_t nearAddress = findNear(regions, 2u, 0x10050000u, 0x1000u);
+
+	CHECK(nearAddress == 0x10110000u);
+	CHECK(nearAddress % GRANULARITY == 0u);
+}
+
+
+static void testBlockDoesNotFit() {
+	const Region regions[]{
+		makeRegion(0x10000000u, 0x100000u, STATE_COMMIT),
+		makeRegion(0x10100000u, 0x10000u, hax::mem::REGION_STATE_FREE),
+		makeRegion(0x10110000u, 0x100000u, STATE_COMMIT),
+		makeRegion(0x10210000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	CHECK(findNear(regions, 4u, 0x10050000u, 0x10000u) == 0x10100000u);
+	// the first free region is too small, the next one fits
+	CHECK(findNear(regions, 4u, 0x10050000u, 0x20000u) == 0x10210000u);
+	CHECK(findNear(regions, 2u, 0x10050000u, 0x20000u) == 0u);
+	// an unaligned free region the aligned block does not fit into
+	const Region unaligned[]{
+		makeRegion(0x10000000u, 0x101000u, STATE_COMMIT),
+		makeRegion(0x10101000u, 0xE000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	CHECK(findNear(unaligned, 2u, 0x10050000u, 0x1000u) == 0u);
+}
+
+
+static void testReach() {
+	const uintptr_t address = 0x100000000u;
+	const Region farRegions[]{
+		makeRegion(0x10000u, address - 0x10000u, STATE_COMMIT),
+		makeRegion(address, 0x80000000u, STATE_COMMIT),
+		makeRegion(address + 0x80000000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	CHECK(findNear(farRegions, 3u, address, 0x1000u) == 0u);
+
+	const Region nearRegions[]{
+		makeRegion(0x10000u, address - 0x10000u, STATE_COMMIT),
+		makeRegion(address, 0x7FFE0000u, STATE_COMMIT),
+		makeRegion(address + 0x7FFE0000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	const uintptr_t nearAddress = findNear(nearRegions, 3u, address, 0x1000u);
+
+	CHECK(nearAddress == address + 0x7FFE0000u);
+	CHECK(nearAddress + 0x1000u - address < 0x80000000u);
+}
+
+
+static void testAddressLimits() {
+	const Region regions[]{
+		makeRegion(0x0FF00000u, 0x100000u, hax::mem::REGION_STATE_FREE),
+		makeRegion(0x10000000u, 0x100000u, STATE_COMMIT),
+		makeRegion(0x10100000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	// the nearer free region below is excluded by the minimum address
+	CHECK(findNear(regions, 3u, 0x10050000u, 0x1000u, 0x10000000u) == 0x10100000u);
+	// the free region above is excluded by the maximum address
+	CHECK(findNear(regions, 3u, 0x100D0000u, 0x1000u, MIN_ADDRESS, 0x10100000u) == 0x0FFF0000u);
+	CHECK(findNear(regions, 3u, 0x10050000u, 0x1000u, 0x10000000u, 0x10100000u) == 0u);
+	// the block has to end at or before the maximum address
+	CHECK(findNear(regions, 3u, 0x10050000u, 0x1000u, 0x10000000u, 0x10100800u) == 0u);
+}
+
+
+static void testInvalid() {
+	const Region regions[]{
+		makeRegion(0x10000000u, 0x100000u, hax::mem::REGION_STATE_FREE)
+	};
+
+	CHECK(findNear(nullptr, 0u, 0x10050000u, 0x1000u) == 0u);
+	CHECK(findNear(regions, 0u, 0x10050000u, 0x1000u) == 0u);
+	CHECK(findNear(regions, 1u, 0x10050000u, 0u) == 0u);
+	CHECK(reinterpret_cast<uintptr_t>(hax::mem::findNearFreeAddress(regions, 1u, reinterpret_cast<const uint8_t*>(0x10050000u), 0x1000u, 0u, reinterpret_cast<const uint8_t*>(MIN_ADDRESS), reinterpret_cast<const uint8_t*>(MAX_ADDRESS))) == 0u);
+	CHECK(findNear(regions, 1u, 0x10050000u, 0x1000u, MAX_ADDRESS, MIN_ADDRESS) == 0u);
+}
+
+
+int main() {
+	RUN_TEST(testNearestBelow);
+	RUN_TEST(testNearestAbove);
+	RUN_TEST(testWithinFreeRegion);
+	RUN_TEST(testGranularity);
+	RUN_TEST(testBlockDoesNotFit);
+	RUN_TEST(testReach);
+	RUN_TEST(testAddressLimits);
+	RUN_TEST(testInvalid);
+
+	return finishTests("RegionSearchTest");
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "test.h"
+#include "../src/threadRank.h"
+
+using hax::proc::ThreadEntry;
+using hax::proc::ThreadUse;
+
+static ThreadEntry makeThread(uint32_t threadId, THREAD_STATE state, KWAIT_REASON waitReason, int32_t priority, uint64_t cpuTime = 0u, uint32_t contextSwitches = 0u) {
+	ThreadEntry threadEntry{};
+	threadEntry.threadId = threadId;
+	threadEntry.ownerProcessId = 4u;
+	threadEntry.threadState = state;
+	threadEntry.waitReason = waitReason;
+	threadEntry.priority = priority;
+	threadEntry.cpuTime = cpuTime;
+	threadEntry.contextSwitches = contextSwitches;
+
+	return threadEntry;
+}
+
+
+static void testHijackScores() {
+	const ThreadEntry running = makeThread(1u, THREAD_STATE::Running, KWAIT_REASON::Executive, 8);
+	const ThreadEntry ready = makeThread(2u, THREAD_STATE::Ready, KWAIT_REASON::Executive, 8);
+	const ThreadEntry messageLoop = makeThread(3u, THREAD_STATE::Waiting, KWAIT_REASON::WrUserRequest, 8);
+	const ThreadEntry sleeping = makeThread(4u, THREAD_STATE::Waiting, KWAIT_REASON::DelayExecution, 8);
+	const ThreadEntry worker = makeThread(5u, THREAD_STATE::Waiting, KWAIT_REASON::WrQueue, 8);
+	const ThreadEntry suspended = makeThread(6u, THREAD_STATE::Waiting, KWAIT_REASON::Suspended, 8);
+	const ThreadEntry terminated = makeThread(7u, THREAD_STATE::Terminated, KWAIT_REASON::Executive, 8);
+
+	CHECK(hax::proc::scoreThread(&running, ThreadUse::HIJACK) < hax::proc::scoreThread(&ready, ThreadUse::HIJACK));
+	CHECK(hax::proc::scoreThread(&ready, ThreadUse::HIJACK) < hax::proc::scoreThread(&messageLoop, ThreadUse::HIJACK));
+	CHECK(hax::proc::scoreThread(&messageLoop, ThreadUse::HIJACK) < hax::proc::scoreThread(&sleeping, ThreadUse::HIJACK));
+	CHECK(hax::proc::scoreThread(&sleeping, ThreadUse::HIJACK) < hax::proc::scoreThread(&worker, ThreadUse::HIJACK));
+	CHECK(hax::proc::scoreThread(&suspended, ThreadUse::HIJACK) == hax::proc::THREAD_SCORE_UNUSABLE);
+	CHECK(hax::proc::scoreThread(&terminated, ThreadUse::HIJACK) == hax::proc::THREAD_SCORE_UNUSABLE);
+}
+
+
+static void testApcScores() {
+	const ThreadEntry sleeping = makeThread(1u, THREAD_STATE::Waiting, KWAIT_REASON::DelayExecution, 8);
+	const ThreadEntry alertable = makeThread(2u, THREAD_STATE::Waiting, KWAIT_REASON::WrQueue, 8);
+	const ThreadEntry userRequest = makeThread(3u, THREAD_STATE::Waiting, KWAIT_REASON::UserRequest, 8);
+	const ThreadEntry running = makeThread(4u, THREAD_STATE::Running, KWAIT_REASON::Executive, 8);
+	const ThreadEntry messageLoop = makeThread(5u, THREAD_STATE::Waiting, KWAIT_REASON::WrUserRequest, 8);
+
+	CHECK(hax::proc::scoreThread(&sleeping, ThreadUse::APC) < hax::proc::scoreThread(&alertable, ThreadUse::APC));
+	CHECK(hax::proc::scoreThread(&alertable, ThreadUse::APC) < hax::proc::scoreThread(&userRequest, ThreadUse::APC));
+	// APCs are only delivered to waiting threads
+	CHECK(hax::proc::scoreThread(&running, ThreadUse::APC) == hax::proc::THREAD_SCORE_UNUSABLE);
+	CHECK(hax::proc::scoreThread(&messageLoop, ThreadUse::APC) == hax::proc::THREAD_SCORE_UNUSABLE);
+}
+
+
+static void testPriority() {
+	const ThreadEntry high = makeThread(1u, THREAD_STATE::Ready, KWAIT_REASON::Executive, 15);
+	const ThreadEntry low = makeThread(2u, THREAD_STATE::Ready, KWAIT_REASON::Executive, 1);
+	const ThreadEntry negative = makeThread(3u, THREAD_STATE::Ready, KWAIT_REASON::Executive, -5);
+	const ThreadEntry zero = makeThread(4u, THREAD_STATE::Ready, KWAIT_REASON::Executive, 0);
+	const ThreadEntry realtimeMessageLoop = makeThread(5u, THREAD_STATE::Waiting, KWAIT_REASON::WrUserRequest, 100);
+
+	CHECK(hax::proc::scoreThread(&high, ThreadUse::HIJACK) < hax::proc::scoreThread(&low, ThreadUse::HIJACK));
+	// priorities are clamped to the valid range
+	CHECK(hax::proc::scoreThread(&negative, ThreadUse::HIJACK) == hax::proc::scoreThread(&zero, ThreadUse::HIJACK));
+	// the state outweighs any priority
+	CHECK(hax::proc::scoreThread(&zero, ThreadUse::HIJACK) < hax::proc::scoreThread(&realtimeMessageLoop, ThreadUse::HIJACK));
+}
+
+
+static void testRankHijack() {
+	const ThreadEntry threadEntries[]{
+		makeThread(10u, THREAD_STATE::Waiting, KWAIT_REASON::WrQueue, 8),
+		makeThread(11u, THREAD_STATE::Waiting, KWAIT_REASON::Suspended, 8),
+		makeThread(12u, THREAD_STATE::Waiting, KWAIT_REASON::WrUserRequest, 10),
+		makeThread(13u, THREAD_STATE::Running, KWAIT_REASON::Executive, 8),
+		makeThread(14u, THREAD_STATE::Waiting, KWAIT_REASON::WrUserRequest, 10, 500u),
+		makeThread(15u, THREAD_STATE::Terminated, KWAIT_REASON::Executive, 8)
+	};
+
+	size_t ranking[6]{};
+	const size_t count = hax::proc::rankThreads(threadEntries, 6u, ThreadUse::HIJACK, ranking);
+
+	CHECK(count == 4u);
+	CHECK(ranking[0] == 3u);
+	// equal scores are ordered by cpu time
+	CHECK(ranking[1] == 4u);
+	CHECK(ranking[2] == 2u);
+	CHECK(ranking[3] == 0u);
+}
+
+
+static void testRankApcTies() {
+	// equal threads are ranked from the last to the first for APCs
+	const ThreadEntry threadEntries[]{
+		makeThread(20u, THREAD_STATE::Waiting, KWAIT_REASON::WrQueue, 8),
+		makeThread(21u, THREAD_STATE::Waiting, KWAIT_REASON::WrQueue, 8),
+		makeThread(22u, THREAD_STATE::Waiting, KWAIT_REASON::WrQueue, 8, 0u, 3u),
+		makeThread(23u, THREAD_STATE::Running, KWAIT_REASON::Executive, 8)
+	};
+
+	size_t ranking[4]{};
+	const size_t count = hax::proc::rankThreads(threadEntries, 4u, ThreadUse::APC, ranking);
+
+	CHECK(count == 3u);
+	// more context switches rank first
+	CHECK(ranking[0] == 2u);
+	CHECK(ranking[1] == 1u);
+	CHECK(ranking[2] == 0u);
+}
+
+
+static void testRankEmpty() {
+	const ThreadEntry threadEntries[]{ makeThread(30u, THREAD_STATE::Running, KWAIT_REASON::Executive, 8) };
+	size_t ranking[1]{ 0xFFu };
+
+	CHECK(hax::proc::rankThreads(threadEntries, 0u, ThreadUse::HIJACK, ranking) == 0u);
+	CHECK(hax::proc::rankThreads(threadEntries, 1u, ThreadUse::APC, ranking) == 0u);
+	CHECK(ranking[0] == 0xFFu);
+}
+
+
+int main() {
+	RUN_TEST(testHijackScores);
+	RUN_TEST(testApcScores);
+	RUN_TEST(testPriority);
+	RUN_TEST(testRankHijack);
+	RUN_TEST(testRankApcTies);
+	RUN_TEST(testRankEmpty);
+
+	return finishTests("ThreadRankTest");
+}
\ No newline at end of file
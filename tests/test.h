@@ -0,0 +1,40 @@
+#pragma once
+#include <stdio.h>
+#include <math.h>
+
+// Minimal checks for the tests of the platform independent parts of the library.
+// Every test file is a program of its own that returns the number of failed checks, so the tests can be built and run on any platform (see the Makefile).
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do { \
+		if (fabs(static_cast<double>(actual) - static_cast<double>(expected)) > (tolerance)) { \
+			fprintf(stderr, "%s:%d: check failed: %s == %s (%f != %f)\n", __FILE__, __LINE__, #actual, #expected, static_cast<double>(actual), static_cast<double>(expected)); \
+			testFailures++; \
+		} \
+	} while (0)
+
+// Runs a test function and prints its name if any of its checks failed.
+#define RUN_TEST(test) \
+	do { \
+		const int failuresBefore = testFailures; \
+		test(); \
+		if (testFailures != failuresBefore) { \
+			fprintf(stderr, "%s failed\n", #test); \
+		} \
+	} while (0)
+
+static int finishTests(const char* name) {
+	printf("%s: %s\n", name, testFailures ? "FAILED" : "passed");
+
+	return testFailures;
+}
\ No newline at end of file